@@ -0,0 +1,116 @@
+#include "image_loader.h"
+
+#include <kelgin/io.h>
+
+#include <png.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr size_t image_count = 1000;
+constexpr size_t image_size = 256;
+
+bool writeTestImages(const std::filesystem::path &dir,
+					 std::vector<std::filesystem::path> &paths) {
+	std::vector<uint8_t> pixels(image_size * image_size * 4);
+
+	for (size_t i = 0; i < image_count; ++i) {
+		for (size_t p = 0; p < image_size * image_size; ++p) {
+			pixels[p * 4 + 0] = static_cast<uint8_t>(p + i);
+			pixels[p * 4 + 1] = static_cast<uint8_t>((p / image_size) ^ i);
+			pixels[p * 4 + 2] = static_cast<uint8_t>(p * 7);
+			pixels[p * 4 + 3] = 255;
+		}
+
+		png_image png;
+		memset(&png, 0, sizeof(png));
+		png.version = PNG_IMAGE_VERSION;
+		png.width = image_size;
+		png.height = image_size;
+		png.format = PNG_FORMAT_RGBA;
+
+		std::filesystem::path path = dir / (std::to_string(i) + ".png");
+		if (!png_image_write_to_file(&png, path.c_str(), 0, pixels.data(), 0,
+									 nullptr)) {
+			return false;
+		}
+		paths.push_back(std::move(path));
+	}
+
+	return true;
+}
+
+double loadAll(gin::ImageLoader &loader, gin::WaitScope &wait_scope,
+			   const std::vector<std::filesystem::path> &paths) {
+	size_t loaded = 0;
+	auto begin = std::chrono::steady_clock::now();
+
+	for (auto &path : paths) {
+		loader.load(path)
+			.then([&loaded](gin::Our<const gin::Image> &&) { ++loaded; })
+			.detach();
+	}
+
+	while (loader.pending() > 0) {
+		if (loader.poll() == 0) {
+			std::this_thread::yield();
+		}
+		wait_scope.poll();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	if (loaded != paths.size()) {
+		std::cerr << "Only " << loaded << " of " << paths.size()
+				  << " images decoded" << std::endl;
+	}
+	return std::chrono::duration<double, std::milli>{end - begin}.count();
+}
+} // namespace
+
+int main() {
+	using namespace gin;
+
+	ErrorOr<AsyncIoContext> err_async = setupAsyncIo();
+	if (err_async.isError()) {
+		std::cerr << "Couldn't setup AsyncIoContext" << std::endl;
+		return -1;
+	}
+	AsyncIoContext &async = err_async.value();
+	WaitScope wait_scope{async.event_loop};
+
+	std::filesystem::path dir =
+		std::filesystem::temp_directory_path() / "kelgin_image_benchmark";
+	std::filesystem::create_directories(dir);
+
+	std::vector<std::filesystem::path> paths;
+	if (!writeTestImages(dir, paths)) {
+		std::cerr << "Couldn't write test images" << std::endl;
+		return -1;
+	}
+
+	size_t hardware_threads =
+		std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::cout << "Loading " << image_count << " images of " << image_size
+			  << "x" << image_size << std::endl;
+
+	for (size_t threads : {static_cast<size_t>(1), hardware_threads}) {
+		ImageLoader loader{threads, 512u << 20};
+
+		double cold = loadAll(loader, wait_scope, paths);
+		double warm = loadAll(loader, wait_scope, paths);
+
+		std::cout << threads << " thread(s): cold " << cold << " ms, warm "
+				  << warm << " ms" << std::endl;
+	}
+
+	std::filesystem::remove_all(dir);
+
+	return 0;
+}
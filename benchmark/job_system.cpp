@@ -0,0 +1,107 @@
+#include "common/math.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr size_t transform_count = 1u << 20;
+constexpr size_t particle_count = 1u << 22;
+constexpr size_t warmup_runs = 3;
+constexpr size_t measured_runs = 20;
+
+gin::Transform3Batch<float> randomTransforms(std::mt19937 &rng) {
+	std::uniform_real_distribution<float> position{-100.f, 100.f};
+	std::uniform_real_distribution<float> angle{0.f, 6.28f};
+
+	gin::Transform3Batch<float> batch;
+	batch.reserve(transform_count);
+	for (size_t i = 0; i < transform_count; ++i) {
+		gin::Transform3<float> transform;
+		transform.position = {position(rng), position(rng), position(rng)};
+		transform.rotation = gin::Quaternion<float>::fromEuler(
+			angle(rng), angle(rng), angle(rng));
+		batch.push_back(transform);
+	}
+	return batch;
+}
+
+template <typename Func> double measure(Func &&func) {
+	for (size_t i = 0; i < warmup_runs; ++i) {
+		func();
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < measured_runs; ++i) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>{end - begin}.count() /
+		   measured_runs;
+}
+} // namespace
+
+/**
+ * Runs the same loops on 1 up to all hardware threads. Model matrices are
+ * mostly bound by memory bandwidth, the particle loop by arithmetic, so the
+ * two show where scaling flattens out for each.
+ */
+int main() {
+	using namespace gin;
+
+	size_t max_threads =
+		std::max(static_cast<size_t>(std::thread::hardware_concurrency()),
+				 static_cast<size_t>(1));
+
+	std::mt19937 rng{1};
+	Transform3Batch<float> from = randomTransforms(rng);
+	Transform3Batch<float> to = randomTransforms(rng);
+	std::vector<float> matrices(transform_count * 16);
+
+	std::vector<float> positions(particle_count);
+	std::vector<float> velocities(particle_count, 1.f);
+
+	std::cout << "threads, model matrices ms, speedup, particles ms, speedup"
+			  << std::endl;
+
+	double matrices_base = 0.0;
+	double particles_base = 0.0;
+	for (size_t threads = 1; threads <= max_threads; ++threads) {
+		JobSystem jobs{threads};
+
+		double matrices_ms = measure([&]() {
+			jobs.parallelFor(transform_count, [&](size_t begin, size_t end) {
+				buildModelMatrices(from, to, 0.5f, matrices.data(), begin, end);
+			});
+		});
+
+		double particles_ms = measure([&]() {
+			jobs.parallelFor(particle_count, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					// Damped spring, enough work per element to hide the loads
+					for (size_t s = 0; s < 8; ++s) {
+						velocities[i] =
+							velocities[i] * 0.99f - positions[i] * 0.01f;
+						positions[i] += velocities[i] * 0.016f;
+					}
+				}
+			});
+		});
+
+		if (threads == 1) {
+			matrices_base = matrices_ms;
+			particles_base = particles_ms;
+		}
+
+		std::cout << threads << ", " << matrices_ms << ", "
+				  << matrices_base / matrices_ms << ", " << particles_ms
+				  << ", " << particles_base / particles_ms << std::endl;
+	}
+
+	return 0;
+}
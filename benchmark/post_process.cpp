@@ -0,0 +1,157 @@
+#include "graphics.h"
+#include "post_process.h"
+
+#include "../example/teapot_mesh.h"
+#include "../example/texture_data.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+constexpr size_t width = 1920;
+constexpr size_t height = 1080;
+constexpr size_t warmup_frames = 30;
+constexpr size_t measured_frames = 300;
+
+/**
+ * Renders one frame per call and sums up the GPU time of every pass. Results
+ * arrive a few frames late, so the sums start after the warmup.
+ */
+double renderFrames(gin::LowLevelRender &render,
+					const gin::RenderPostStageId &stage,
+					std::chrono::steady_clock::time_point &time, size_t frames,
+					std::vector<double> &pass_sums) {
+	const auto frame_step = std::chrono::milliseconds{16};
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t f = 0; f < frames; ++f) {
+		time += frame_step;
+		render.step(time);
+		render.flush();
+
+		gin::ErrorOr<gin::RenderPostStageStatistics> stats =
+			render.getPostStageStatistics(stage);
+		if (stats.isValue()) {
+			const std::vector<float> &ms = stats.value().pass_milliseconds;
+			pass_sums.resize(ms.size(), 0.0);
+			for (size_t i = 0; i < ms.size(); ++i) {
+				pass_sums[i] += ms[i];
+			}
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>{end - begin}.count() /
+		   frames;
+}
+
+void report(const std::string &name,
+			const std::vector<gin::RenderPostPass> &passes, double frame_ms,
+			const std::vector<double> &pass_sums) {
+	std::cout << name << ": " << frame_ms << " ms/frame" << std::endl;
+	for (size_t i = 0; i < passes.size() && i < pass_sums.size(); ++i) {
+		bool last = i + 1 == passes.size();
+		std::cout << "  pass " << i << " at "
+				  << (last ? 1.f : passes[i].scale)
+				  << " scale: " << pass_sums[i] / measured_frames << " ms"
+				  << std::endl;
+	}
+}
+} // namespace
+
+int main() {
+	using namespace gin;
+
+	ErrorOr<AsyncIoContext> err_async = setupAsyncIo();
+	if (err_async.isError()) {
+		std::cerr << "Couldn't setup AsyncIoContext" << std::endl;
+		return -1;
+	}
+	AsyncIoContext &async = err_async.value();
+	WaitScope wait_scope{async.event_loop};
+
+	Graphics graphics{loadAllRenderPluginsIn("./bin/plugins/")};
+	LowLevelRender *render = graphics.getRenderer(*async.io, "ogl33");
+	if (!render) {
+		std::cerr << "No ogl33 renderer present" << std::endl;
+		return -1;
+	}
+
+	LowLevelRender3D *render_3d = render->interface3D();
+	if (!render_3d) {
+		std::cerr << "Missing 3D interface" << std::endl;
+		return -1;
+	}
+
+	ErrorOr<RenderWindowId> win_id =
+		render->createWindow({width, height}, "Kelgin Post Process Benchmark");
+	if (win_id.isError()) {
+		std::cerr << "Couldn't create window" << std::endl;
+		return -1;
+	}
+	render->flush();
+	render->setWindowVisibility(win_id.value(), true);
+	// Every step should reach the window
+	render->setWindowDesiredFPS(win_id.value(), 100000.f);
+
+	// A single teapot drawn into a transient texture as the source
+	Program3dId program_id = render_3d->createProgram3d().value();
+	Mesh3dId mesh_id = render_3d->createMesh3d(createTeapotMesh()).value();
+	TextureId texture_id = render->createTexture(default_image).value();
+	RenderProperty3dId rp_id =
+		render_3d->createProperty3d(mesh_id, texture_id).value();
+	RenderScene3dId scene_id = render_3d->createScene3d().value();
+	RenderObject3dId teapot_id =
+		render_3d->createObject3d(scene_id, rp_id).value();
+	render_3d->setObject3dPosition(scene_id, teapot_id, 0.f, -1.5f, 0.f);
+
+	RenderCamera3dId camera_id = render_3d->createCamera3d().value();
+	render_3d->setCamera3dPerspective(
+		camera_id, 0.8f, static_cast<float>(width) / height, 0.1f, 0.f, true);
+	render_3d->setCamera3dPosition(camera_id, 0.f, 0.f, 10.f);
+
+	RenderTextureId scene_texture =
+		render->createRenderTexture(width, height, true).value();
+	RenderViewportId viewport_id = render->createViewport().value();
+	render_3d
+		->createStage3d(scene_texture, viewport_id, scene_id, camera_id,
+						program_id)
+		.value();
+
+	PostProgramId blur = render->createPostBlurProgram().value();
+	PostProgramId copy = render->createPostProgram().value();
+	RenderPostStageId post_id =
+		render->createPostStage(scene_texture, win_id.value()).value();
+
+	std::vector<RenderPostPass> copy_passes{RenderPostPass{copy}};
+	std::vector<RenderPostPass> reduced_passes =
+		gaussianBlurPasses(blur, copy).value();
+	std::vector<RenderPostPass> full_passes =
+		gaussianBlurPasses(blur, copy, {1.f}).value();
+
+	std::cout << "Post processing " << width << "x" << height << std::endl;
+
+	auto time = std::chrono::steady_clock::now();
+	struct Run {
+		std::string name;
+		const std::vector<RenderPostPass> &passes;
+	};
+	for (const Run &run : {Run{"copy only", copy_passes},
+						   Run{"blur at half and quarter", reduced_passes},
+						   Run{"blur at full resolution", full_passes}}) {
+		render->setPostStagePasses(post_id, run.passes);
+
+		std::vector<double> pass_sums;
+		renderFrames(*render, post_id, time, warmup_frames, pass_sums);
+		pass_sums.clear();
+		double frame_ms = renderFrames(*render, post_id, time,
+									   measured_frames, pass_sums);
+		report(run.name, run.passes, frame_ms, pass_sums);
+	}
+
+	render->destroyPostStage(post_id);
+	render->destroyWindow(win_id.value());
+
+	return 0;
+}
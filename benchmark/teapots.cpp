@@ -0,0 +1,227 @@
+#include "graphics.h"
+#include "mesh_simplification.h"
+
+#include "../example/mesh_data.h"
+#include "../example/teapot_mesh.h"
+#include "../example/texture_data.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+constexpr size_t grid_size = 100;
+constexpr size_t teapot_count = grid_size * grid_size;
+constexpr size_t warmup_frames = 30;
+constexpr size_t measured_frames = 300;
+
+constexpr float spacing = 7.f;
+
+/// Renders one frame per call. The frame time is simulated, so every step draws.
+double renderFrames(gin::LowLevelRender &render, gin::LowLevelRender3D &render_3d,
+					const gin::RenderScene3dId &scene,
+					const std::vector<gin::RenderObject3dId> &teapots,
+					std::chrono::steady_clock::time_point &time, size_t frames,
+					bool animate) {
+	const auto frame_step = std::chrono::milliseconds{16};
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t f = 0; f < frames; ++f) {
+		if (animate) {
+			render.updateTime(time, time + frame_step);
+			float angle = static_cast<float>(f) * 0.05f;
+			for (size_t i = 0; i < teapots.size(); ++i) {
+				render_3d.setObject3dRotation(scene, teapots[i], 0.3f,
+											  angle + i * 0.01f, 0.f);
+			}
+		}
+
+		time += frame_step;
+		render.step(time);
+		render.flush();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>{end - begin}.count() /
+		   frames;
+}
+
+std::vector<gin::RenderObject3dId>
+createGrid(gin::LowLevelRender3D &render_3d, const gin::RenderScene3dId &scene,
+		   const gin::RenderProperty3dId &property) {
+	std::vector<gin::RenderObject3dId> teapots;
+	teapots.reserve(teapot_count);
+	float offset = (grid_size - 1) * spacing * 0.5f;
+	for (size_t i = 0; i < grid_size; ++i) {
+		for (size_t j = 0; j < grid_size; ++j) {
+			gin::RenderObject3dId id =
+				render_3d.createObject3d(scene, property).value();
+			render_3d.setObject3dPosition(scene, id, i * spacing - offset,
+										  j * spacing - offset, 0.f);
+			teapots.push_back(id);
+		}
+	}
+	return teapots;
+}
+} // namespace
+
+int main() {
+	using namespace gin;
+
+	ErrorOr<AsyncIoContext> err_async = setupAsyncIo();
+	if (err_async.isError()) {
+		std::cerr << "Couldn't setup AsyncIoContext" << std::endl;
+		return -1;
+	}
+	AsyncIoContext &async = err_async.value();
+	WaitScope wait_scope{async.event_loop};
+
+	Graphics graphics{loadAllRenderPluginsIn("./bin/plugins/")};
+	LowLevelRender *render = graphics.getRenderer(*async.io, "ogl33");
+	if (!render) {
+		std::cerr << "No ogl33 renderer present" << std::endl;
+		return -1;
+	}
+
+	LowLevelRender3D *render_3d = render->interface3D();
+	if (!render_3d) {
+		std::cerr << "Missing 3D interface" << std::endl;
+		return -1;
+	}
+
+	ErrorOr<RenderWindowId> win_id =
+		render->createWindow({1280, 720}, "Kelgin Teapot Benchmark");
+	if (win_id.isError()) {
+		std::cerr << "Couldn't create window" << std::endl;
+		return -1;
+	}
+	render->flush();
+	render->setWindowVisibility(win_id.value(), true);
+	// Every step should reach the window
+	render->setWindowDesiredFPS(win_id.value(), 100000.f);
+
+	Program3dId program_id = render_3d->createProgram3d().value();
+	Mesh3dData mesh = createTeapotMesh();
+	Mesh3dId mesh_id = render_3d->createMesh3d(mesh).value();
+	TextureId texture_id = render->createTexture(default_image).value();
+	RenderProperty3dId rp_id =
+		render_3d->createProperty3d(mesh_id, texture_id).value();
+
+	RenderScene3dId scene_id = render_3d->createScene3d().value();
+	std::vector<RenderObject3dId> teapots =
+		createGrid(*render_3d, scene_id, rp_id);
+	float offset = (grid_size - 1) * spacing * 0.5f;
+
+	RenderCamera3dId camera_id = render_3d->createCamera3d().value();
+	float half_height = offset + spacing;
+	float half_width = half_height * 1280.f / 720.f;
+	render_3d->setCamera3dOrthographic(camera_id, -half_width, half_width,
+									   half_height, -half_height, 0.1f, 100.f);
+	render_3d->setCamera3dPosition(camera_id, 0.f, 0.f, 50.f);
+
+	RenderViewportId viewport_id = render->createViewport().value();
+	RenderStage3dId stage_id =
+		render_3d
+			->createStage3d(win_id.value(), viewport_id, scene_id, camera_id,
+							program_id)
+			.value();
+
+	std::cout << "Rendering " << teapot_count << " teapots with "
+			  << mesh.indices.size() / 3 << " triangles each" << std::endl;
+
+	auto time = std::chrono::steady_clock::now();
+	renderFrames(*render, *render_3d, scene_id, teapots, time, warmup_frames,
+				 false);
+
+	double still = renderFrames(*render, *render_3d, scene_id, teapots, time,
+								measured_frames, false);
+	double animated = renderFrames(*render, *render_3d, scene_id, teapots,
+								   time, measured_frames, true);
+
+	std::cout << "static: " << still << " ms/frame" << std::endl;
+	std::cout << "rotating: " << animated << " ms/frame" << std::endl;
+
+	// The same grid seen from a low angle in perspective, so distant teapots
+	// switch to coarser levels of detail
+	Mesh3dData lod_mesh = createTeapotMesh();
+	if (generateMesh3dLods(lod_mesh, 4).failed()) {
+		std::cerr << "Couldn't simplify the teapot" << std::endl;
+		return -1;
+	}
+	Mesh3dId lod_mesh_id = render_3d->createMesh3d(lod_mesh).value();
+	RenderProperty3dId lod_rp_id =
+		render_3d->createProperty3d(lod_mesh_id, texture_id).value();
+	RenderScene3dId lod_scene_id = render_3d->createScene3d().value();
+	std::vector<RenderObject3dId> lod_teapots =
+		createGrid(*render_3d, lod_scene_id, lod_rp_id);
+
+	RenderCamera3dId lod_camera_id = render_3d->createCamera3d().value();
+	render_3d->setCamera3dPerspective(lod_camera_id, 0.8f, 1280.f / 720.f,
+									  0.1f, 0.f, true);
+	render_3d->setCamera3dPosition(lod_camera_id, 0.f, -offset - 20.f, 30.f);
+	render_3d->setCamera3dRotation(lod_camera_id, 1.2f, 0.f, 0.f);
+
+	render_3d->destroyStage3d(stage_id);
+	RenderStage3dId lod_stage_id =
+		render_3d
+			->createStage3d(win_id.value(), viewport_id, lod_scene_id,
+							lod_camera_id, program_id)
+			.value();
+
+	renderFrames(*render, *render_3d, lod_scene_id, lod_teapots, time,
+				 warmup_frames, false);
+	double lod = renderFrames(*render, *render_3d, lod_scene_id, lod_teapots,
+							  time, measured_frames, false);
+	RenderStage3dStatistics stats =
+		render_3d->getStage3dStatistics(lod_stage_id).value();
+
+	std::cout << "perspective with " << lod_mesh.lods.size()
+			  << " levels of detail: " << lod << " ms/frame" << std::endl;
+	std::cout << "  " << stats.drawn_objects << " teapots, "
+			  << stats.drawn_triangles << " triangles drawn, "
+			  << stats.saved_triangles << " saved" << std::endl;
+
+	// A 2D overlay on the same window. The 3D stage leaves reversed depth
+	// behind, which the 2D stage has to switch back before drawing.
+	LowLevelRender2D *render_2d = render->interface2D();
+	if (!render_2d) {
+		std::cerr << "Missing 2D interface" << std::endl;
+		return -1;
+	}
+	ProgramId hud_program_id = render_2d->createProgram().value();
+	MeshId hud_mesh_id = render_2d->createMesh(default_mesh).value();
+	RenderPropertyId hud_rp_id =
+		render_2d->createProperty(hud_mesh_id, texture_id).value();
+	RenderSceneId hud_scene_id = render_2d->createScene().value();
+	for (size_t i = 0; i < 16; ++i) {
+		RenderObjectId id =
+			render_2d->createObject(hud_scene_id, hud_rp_id).value();
+		render_2d->setObjectPosition(hud_scene_id, id, i * 2.5f - 19.f, 9.f);
+	}
+	RenderCameraId hud_camera_id = render_2d->createCamera().value();
+	render_2d->setCameraOrthographic(hud_camera_id, -20.f * 1280.f / 720.f,
+									 20.f * 1280.f / 720.f, -10.f, 10.f);
+	RenderStageId hud_stage_id =
+		render_2d
+			->createStage(win_id.value(), viewport_id, hud_scene_id,
+						  hud_camera_id, hud_program_id)
+			.value();
+
+	renderFrames(*render, *render_3d, lod_scene_id, lod_teapots, time,
+				 warmup_frames, false);
+	double overlay = renderFrames(*render, *render_3d, lod_scene_id,
+								  lod_teapots, time, measured_frames, false);
+	std::cout << "perspective with a 2D overlay: " << overlay << " ms/frame"
+			  << std::endl;
+	render_2d->destroyStage(hud_stage_id);
+
+	RenderProgramStatistics programs = render->getProgramStatistics();
+	std::cout << "programs: " << programs.compiled_programs << " compiled in "
+			  << programs.compile_milliseconds << " ms, "
+			  << programs.cached_programs << " loaded from the cache in "
+			  << programs.cache_milliseconds << " ms" << std::endl;
+
+	render->destroyWindow(win_id.value());
+
+	return 0;
+}
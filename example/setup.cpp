@@ -1,43 +1,12 @@
 #include "graphics.h"
+#include "image_loader.h"
 
 #include <iostream>
 
 #include "./mesh_data.h"
-#include "./shaders.h"
 #include "./texture_data.h"
 
-#include "stb_image.h"
 #include <array>
-#include <cstring>
-
-gin::Image loadFromFile(const std::string &path) {
-	gin::Image image;
-
-	int32_t cmps = 0;
-	int32_t width = 0;
-	int32_t height = 0;
-	uint8_t *data = stbi_load(path.c_str(), &width, &height, &cmps, 4);
-
-	if (!data) {
-		return image;
-	}
-	if (cmps <= 0 || cmps > 255 || width <= 0 || height <= 0) {
-		stbi_image_free(data);
-		return image;
-	}
-
-	image.channels = 4;
-	image.width = static_cast<size_t>(width);
-	image.height = static_cast<size_t>(height);
-
-	image.pixels.resize(image.width * image.height * image.channels);
-
-	memcpy(&image.pixels[0], data,
-		   sizeof(uint8_t) * image.width * image.height * image.channels);
-	stbi_image_free(data);
-
-	return image;
-}
 
 int main() {
 	using namespace gin;
@@ -77,31 +46,49 @@ int main() {
 	render->setWindowDesiredFPS(win_id, 60.f);
 
 	//	=========================== Programs =================================
+	ProgramId base_program_id = render_2d->createProgram().value();
+	const ProgramFeatures features =
+		ProgramFeature::AlphaTest | ProgramFeature::GpuInterpolation;
+	// Compiled during setup instead of on the first frame using them
+	render_2d->prewarmProgramVariants(base_program_id, {features});
 	ProgramId program_id =
-		render_2d->createProgram(default_vertex_shader, default_fragment_shader)
-			.value();
+		render_2d->getProgramVariant(base_program_id, features).value();
 
 	//	============================ Meshes ==================================
 	MeshId mesh_id = render_2d->createMesh(default_mesh).value();
 	MeshId bg_mesh_id = render_2d->createMesh(bg_mesh).value();
 
 	//  =========================== Textures =================================
-	TextureId texture_id =
-		render->createTexture(loadFromFile("test.png")).value();
 	TextureId green_square_tex_id =
 		render->createTexture(default_image).value();
-	TextureId bg_tex_id = render->createTexture(loadFromFile("bg.png")).value();
 
 	//	============================ Scenes ==================================
 	RenderSceneId scene_id = render_2d->createScene().value();
 
 	//	===================== Render Properties ==============================
 	RenderPropertyId rp_id =
-		render_2d->createProperty(mesh_id, texture_id).value();
+		render_2d->createProperty(mesh_id, green_square_tex_id).value();
 	RenderPropertyId gsq_rp_id =
 		render_2d->createProperty(mesh_id, green_square_tex_id).value();
 	RenderPropertyId bg_rp_id =
-		render_2d->createProperty(bg_mesh_id, bg_tex_id).value();
+		render_2d->createProperty(bg_mesh_id, green_square_tex_id).value();
+
+	// Decoded in the background. The properties show the placeholder texture
+	// until the images arrive.
+	ImageLoader image_loader;
+	auto loadTexture = [&](const std::string &path,
+						   const RenderPropertyId &property) {
+		image_loader.load(path)
+			.then([&, property](Our<const Image> &&image) {
+				ErrorOr<TextureId> texture = render->createTexture(*image);
+				if (texture.isValue()) {
+					render_2d->setPropertyTexture(property, texture.value());
+				}
+			})
+			.detach();
+	};
+	loadTexture("test.png", rp_id);
+	loadTexture("bg.png", bg_rp_id);
 
 	//	======================= Render Objects ===============================
 	RenderObjectId ro_id = render_2d->createObject(scene_id, gsq_rp_id).value();
@@ -130,6 +117,8 @@ int main() {
 			render_2d->setObjectLayer(scene_id, bg_ro_ids[i][j], 0.2f);
 		}
 	}
+	// The background only moves when the camera crosses a tile, so it's baked
+	render_2d->setLayerStatic(scene_id, 0.2f, true);
 	render_2d->setObjectPosition(scene_id, ro_spin_id, 5.f, 0.f);
 
 	RenderCameraId camera_id = render_2d->createCamera().value();
@@ -282,6 +271,7 @@ int main() {
 		render->step(time);
 
 		render->flush();
+		image_loader.poll();
 		wait_scope.wait(std::chrono::milliseconds{1});
 
 		fps = fps * kalman +
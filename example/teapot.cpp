@@ -2,18 +2,21 @@
 
 #include <iostream>
 
-#include "./mesh_data.h"
-#include "./shaders.h"
+#include "./teapot_mesh.h"
 #include "./texture_data.h"
 
-#include "stb_image.h"
 #include <array>
-#include <cstring>
+#include <chrono>
 
 int main() {
 	using namespace gin;
 
 	ErrorOr<AsyncIoContext> err_async = setupAsyncIo();
+	if (err_async.isError()) {
+		std::cerr << "Couldn't load AsyncIoContext" << std::endl;
+		return -1;
+	}
+
 	AsyncIoContext &async = err_async.value();
 	WaitScope wait_scope{async.event_loop};
 
@@ -29,54 +32,106 @@ int main() {
 		std::cerr << "No ogl33 renderer present" << std::endl;
 		return -1;
 	}
-	/*
-	RenderWindowId win_id = 0;
-
-	render->createWindow({600,400}, "Kelgin Setup Example").then([&render,
-	&win_id](RenderWindowId id){ render->flush();
-
-		render->setWindowVisibility(id, true).then([&render,id](){
-			render->setWindowDesiredFPS(id, 60.f).detach();
-		}).detach();
 
-		win_id = id;
-	}).detach();
+	LowLevelRender3D *render_3d = render->interface3D();
+	if (!render_3d) {
+		std::cerr << "Missing 3D interface" << std::endl;
+		return -1;
+	}
 
-	wait_scope.poll();
+	RenderWindowId win_id =
+		render->createWindow({600, 400}, "Kelgin Teapot Example").value();
+	render->flush();
+	render->setWindowVisibility(win_id, true);
+	render->setWindowDesiredFPS(win_id, 60.f);
 
-	Program3dId program_id = render->createProgram3d().take().value();
+	Program3dId program_id = render_3d->createProgram3d().value();
 
-	// Mesh3dId mesh_id = render->createMesh3d().value();
+	Mesh3dId mesh_id = render_3d->createMesh3d(createTeapotMesh()).value();
+	TextureId texture_id = render->createTexture(default_image).value();
 
-	RenderScene3dId scene_id = render->createScene3d().take().value();
+	RenderProperty3dId rp_id =
+		render_3d->createProperty3d(mesh_id, texture_id).value();
 
-	// RenderProperty3dId rp_id = render->createProperty3d(
+	RenderScene3dId scene_id = render_3d->createScene3d().value();
+	RenderObject3dId teapot_id =
+		render_3d->createObject3d(scene_id, rp_id).value();
+	render_3d->setObject3dPosition(scene_id, teapot_id, 0.f, -1.5f, 0.f);
 
-	RenderCamera3dId camera_id = render->createCamera3d().take().value();
+	RenderCamera3dId camera_id = render_3d->createCamera3d().value();
 	float aspect = 600.f / 400.f;
-	float zoom = 10.f;
+	float fov = 0.8f;
 
 	float near = 0.1f;
-	float far = 50.f;
+	// Far plane at infinity with reversed depth
+	render_3d->setCamera3dPerspective(camera_id, fov, aspect, near, 0.f, true);
+	render_3d->setCamera3dPosition(camera_id, 0.f, 0.f, 10.f);
+
+	RenderViewportId viewport_id = render->createViewport().value();
 
 	RenderStage3dId stage_id =
-		render->createStage(program_id, win_id, scene_id, camera_id)
-			.take()
+		render_3d
+			->createStage3d(win_id, viewport_id, scene_id, camera_id,
+							program_id)
 			.value();
 
-	auto old_time = std::chrono::steady_clock::now();
+	auto events =
+		render->listenToWindowEvents(win_id)
+			.then([&](RenderEvent::Events &&event) {
+				std::visit(
+					[&](auto &&arg) {
+						using T = std::decay_t<decltype(arg)>;
+						if constexpr (std::is_same_v<T, RenderEvent::Resize>) {
+							aspect = static_cast<float>(arg.width) /
+									 static_cast<float>(arg.height);
+							render_3d->setCamera3dPerspective(
+								camera_id, fov, aspect, near, 0.f, true);
+						} else if constexpr (std::is_same_v<
+												 T, RenderEvent::Keyboard>) {
+							if (arg.key_code == 9 && !arg.pressed) {
+								running = false;
+							}
+						}
+					},
+					event);
+			})
+			.sink();
+
+	render->flush();
+
+	auto next_phys_time = std::chrono::steady_clock::now();
+	float phys_time_delta = 1.f / 10.f;
+	float angle = 0.f;
+
 	while (running) {
 		auto time = std::chrono::steady_clock::now();
 
+		if (time >= next_phys_time) {
+			next_phys_time +=
+				std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<float>{phys_time_delta});
+			render->updateTime(
+				time, next_phys_time +
+						  std::chrono::duration_cast<
+							  std::chrono::steady_clock::duration>(
+							  std::chrono::duration<float>{phys_time_delta}));
+
+			angle += phys_time_delta;
+			render_3d->setObject3dRotation(scene_id, teapot_id, 0.3f, angle,
+										   0.f);
+		}
+
 		render->step(time);
 
 		render->flush();
-		wait_scope.wait(std::chrono::milliseconds{5});
-		old_time = time;
+		wait_scope.wait(std::chrono::milliseconds{1});
 	}
 
+	render_3d->destroyStage3d(stage_id);
+	render_3d->destroyScene3d(scene_id);
+	render_3d->destroyMesh3d(mesh_id);
+	render_3d->destroyProgram3d(program_id);
 	render->destroyWindow(win_id);
-	*/
 
 	return 0;
 }
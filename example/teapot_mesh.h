@@ -0,0 +1,193 @@
+#pragma once
+
+#include "render/render.h"
+
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace teapot {
+using Vec3 = std::array<float, 3>;
+
+inline Vec3 sub(const Vec3 &a, const Vec3 &b) {
+	return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) {
+	return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+			a[0] * b[1] - a[1] * b[0]};
+}
+
+inline float dot(const Vec3 &a, const Vec3 &b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline Vec3 normalize(const Vec3 &a) {
+	float len = std::sqrt(dot(a, a));
+	if (len <= 0.f) {
+		return {0.f, 1.f, 0.f};
+	}
+	return {a[0] / len, a[1] / len, a[2] / len};
+}
+
+/**
+ * Appends a closed ring strip. Every row has ring_size vertices around the
+ * given centre. Triangles face away from the centre of their row.
+ */
+inline void addRings(gin::Mesh3dData &mesh, const std::vector<Vec3> &centres,
+					 const std::vector<Vec3> &positions, size_t ring_size) {
+	unsigned int base = static_cast<unsigned int>(mesh.vertices.size());
+	size_t rows = centres.size();
+
+	for (size_t r = 0; r < rows; ++r) {
+		for (size_t s = 0; s < ring_size; ++s) {
+			mesh.vertices.push_back(
+				{positions[r * ring_size + s],
+				 {0.f, 0.f, 0.f},
+				 {static_cast<float>(s) / ring_size,
+				  static_cast<float>(r) / (rows - 1)}});
+		}
+	}
+
+	auto addTriangle = [&](size_t row, unsigned int a, unsigned int b,
+						   unsigned int c) {
+		const Vec3 &pa = mesh.vertices[a].position;
+		const Vec3 &pb = mesh.vertices[b].position;
+		const Vec3 &pc = mesh.vertices[c].position;
+		Vec3 normal = cross(sub(pb, pa), sub(pc, pa));
+		if (dot(normal, sub(pa, centres[row])) < 0.f) {
+			std::swap(b, c);
+		}
+		mesh.indices.insert(mesh.indices.end(), {a, b, c});
+	};
+
+	for (size_t r = 0; r + 1 < rows; ++r) {
+		for (size_t s = 0; s < ring_size; ++s) {
+			unsigned int a = base + r * ring_size + s;
+			unsigned int b = base + r * ring_size + (s + 1) % ring_size;
+			unsigned int c = base + (r + 1) * ring_size + s;
+			unsigned int d = base + (r + 1) * ring_size + (s + 1) % ring_size;
+			addTriangle(r, a, c, b);
+			addTriangle(r, b, c, d);
+		}
+	}
+}
+
+/// Rotates a (radius, height) profile around the y axis
+inline void addLathe(gin::Mesh3dData &mesh,
+					 const std::vector<std::array<float, 2>> &profile,
+					 size_t segments) {
+	// The middle of the axis, so flat caps face away from it as well
+	float centre = (profile.front()[1] + profile.back()[1]) * 0.5f;
+
+	std::vector<Vec3> centres;
+	std::vector<Vec3> positions;
+	for (auto &point : profile) {
+		centres.push_back({0.f, centre, 0.f});
+		for (size_t s = 0; s < segments; ++s) {
+			float angle = 6.2831853f * s / segments;
+			positions.push_back({point[0] * std::cos(angle), point[1],
+								 point[0] * std::sin(angle)});
+		}
+	}
+	addRings(mesh, centres, positions, segments);
+}
+
+/// Sweeps a circle along a cubic bezier in the xy plane
+inline void addTube(gin::Mesh3dData &mesh, const std::array<Vec3, 4> &curve,
+					float radius_begin, float radius_end, size_t steps,
+					size_t segments) {
+	std::vector<Vec3> centres;
+	std::vector<Vec3> positions;
+	for (size_t i = 0; i <= steps; ++i) {
+		float t = static_cast<float>(i) / steps;
+		float u = 1.f - t;
+		float w[4] = {u * u * u, 3.f * u * u * t, 3.f * u * t * t, t * t * t};
+		float dw[4] = {-3.f * u * u, 3.f * u * u - 6.f * u * t,
+					   6.f * u * t - 3.f * t * t, 3.f * t * t};
+
+		Vec3 centre{0.f, 0.f, 0.f};
+		Vec3 tangent{0.f, 0.f, 0.f};
+		for (size_t k = 0; k < 4; ++k) {
+			for (size_t c = 0; c < 3; ++c) {
+				centre[c] += curve[k][c] * w[k];
+				tangent[c] += curve[k][c] * dw[k];
+			}
+		}
+		Vec3 side = normalize(cross(normalize(tangent), {0.f, 0.f, 1.f}));
+		float radius = radius_begin + (radius_end - radius_begin) * t;
+
+		centres.push_back(centre);
+		for (size_t s = 0; s < segments; ++s) {
+			float angle = 6.2831853f * s / segments;
+			float cs = std::cos(angle) * radius;
+			float sn = std::sin(angle) * radius;
+			positions.push_back({centre[0] + side[0] * cs,
+								 centre[1] + side[1] * cs,
+								 centre[2] + side[2] * cs + sn});
+		}
+	}
+	addRings(mesh, centres, positions, segments);
+}
+
+inline void computeNormals(gin::Mesh3dData &mesh) {
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		auto &a = mesh.vertices[mesh.indices[i]];
+		auto &b = mesh.vertices[mesh.indices[i + 1]];
+		auto &c = mesh.vertices[mesh.indices[i + 2]];
+		Vec3 normal =
+			cross(sub(b.position, a.position), sub(c.position, a.position));
+		for (auto *v : {&a, &b, &c}) {
+			for (size_t k = 0; k < 3; ++k) {
+				v->normals[k] += normal[k];
+			}
+		}
+	}
+	for (auto &v : mesh.vertices) {
+		v.normals = normalize(v.normals);
+	}
+}
+} // namespace teapot
+
+/**
+ * A teapot built from a lathed body and lid, a spout and a handle.
+ * The mesh is about 6 units wide and 3 units high, standing on y = 0.
+ */
+inline gin::Mesh3dData createTeapotMesh(size_t segments = 24) {
+	gin::Mesh3dData mesh;
+
+	teapot::addLathe(mesh,
+					 {{0.f, 0.f},
+					  {1.4f, 0.f},
+					  {1.5f, 0.1f},
+					  {1.9f, 0.6f},
+					  {2.f, 1.2f},
+					  {1.85f, 1.8f},
+					  {1.5f, 2.25f},
+					  {1.3f, 2.4f},
+					  {1.f, 2.5f},
+					  {0.6f, 2.65f},
+					  {0.2f, 2.75f},
+					  {0.25f, 2.95f},
+					  {0.15f, 3.1f},
+					  {0.f, 3.15f}},
+					 segments);
+
+	teapot::addTube(mesh,
+					{{{1.7f, 0.8f, 0.f},
+					  {2.6f, 0.9f, 0.f},
+					  {2.7f, 1.8f, 0.f},
+					  {3.1f, 2.3f, 0.f}}},
+					0.4f, 0.15f, 8, segments / 2);
+
+	teapot::addTube(mesh,
+					{{{-1.8f, 2.f, 0.f},
+					  {-2.9f, 2.1f, 0.f},
+					  {-2.9f, 0.7f, 0.f},
+					  {-1.9f, 0.8f, 0.f}}},
+					0.12f, 0.12f, 10, segments / 3);
+
+	teapot::computeNormals(mesh);
+	return mesh;
+}
@@ -0,0 +1,62 @@
+#include "ogl33_animation.h"
+
+#include <algorithm>
+
+namespace gin {
+namespace {
+template<typename T>
+float lastKeyTime(const std::vector<RenderAnimationData::Key<T>>& keys){
+	return keys.empty() ? 0.f : keys.back().time;
+}
+}
+
+Ogl33Animation::Ogl33Animation(const RenderAnimationData& d):
+	data{d},
+	duration{std::max({
+		lastKeyTime(d.position),
+		lastKeyTime(d.rotation),
+		lastKeyTime(d.layer),
+		lastKeyTime(d.visibility),
+		lastKeyTime(d.property)
+	})}
+{}
+
+void Ogl33AnimationSampler::clear(){
+	time.clear();
+	key_time.clear();
+	inv_span.clear();
+	from.clear();
+	delta.clear();
+}
+
+size_t Ogl33AnimationSampler::add(float t, float time_0, float value_0, float time_1, float value_1){
+	size_t index = time.size();
+	time.push_back(t);
+	key_time.push_back(time_0);
+	// Before the first or after the last key both keys are the same, so the factor doesn't matter
+	inv_span.push_back(time_1 > time_0 ? 1.f / (time_1 - time_0) : 0.f);
+	from.push_back(value_0);
+	delta.push_back(value_1 - value_0);
+	return index;
+}
+
+void Ogl33AnimationSampler::sample(){
+	size_t n = time.size();
+	values.resize(n);
+
+	const float* t = time.data();
+	const float* t_0 = key_time.data();
+	const float* inv = inv_span.data();
+	const float* a = from.data();
+	const float* d = delta.data();
+	float* out = values.data();
+	for(size_t i = 0; i < n; ++i){
+		float f = std::min(std::max((t[i] - t_0[i]) * inv[i], 0.f), 1.f);
+		out[i] = a[i] + d[i] * f;
+	}
+}
+
+float Ogl33AnimationSampler::value(size_t i) const {
+	return values[i];
+}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "render/render.h"
+
+#include <array>
+#include <vector>
+
+namespace gin {
+class Ogl33Animation {
+public:
+	RenderAnimationData data;
+	// Time of the last key over all tracks
+	float duration = 0.f;
+
+	Ogl33Animation(const RenderAnimationData& data);
+};
+
+/**
+* Index of the last key at or before t. Times before the first key use the first one.
+* Keys have to be sorted and non empty.
+*/
+template<typename T>
+size_t findAnimationKey(const std::vector<RenderAnimationData::Key<T>>& keys, float t){
+	size_t begin = 0;
+	size_t end = keys.size();
+	while(end - begin > 1){
+		size_t mid = begin + (end - begin) / 2;
+		if(keys[mid].time <= t){
+			begin = mid;
+		}else{
+			end = mid;
+		}
+	}
+	return begin;
+}
+
+/**
+* Linear interpolations of all animated channels, collected first and computed in one pass.
+* Every channel is a plain float, so the pass is a straight loop over contiguous arrays
+* which the compiler vectorizes.
+*/
+class Ogl33AnimationSampler {
+private:
+	std::vector<float> time;
+	std::vector<float> key_time;
+	std::vector<float> inv_span;
+	std::vector<float> from;
+	std::vector<float> delta;
+	std::vector<float> values;
+public:
+	void clear();
+
+	/// Returns the index of the channel's value after sample()
+	size_t add(float t, float time_0, float value_0, float time_1, float value_1);
+	template<typename T>
+	size_t add(const std::vector<RenderAnimationData::Key<T>>& keys, float t, size_t component);
+
+	void sample();
+
+	float value(size_t i) const;
+};
+
+namespace impl {
+inline float animationComponent(float value, size_t){
+	return value;
+}
+
+inline float animationComponent(const std::array<float, 2>& value, size_t component){
+	return value[component];
+}
+}
+
+template<typename T>
+size_t Ogl33AnimationSampler::add(const std::vector<RenderAnimationData::Key<T>>& keys, float t, size_t component){
+	size_t k = findAnimationKey(keys, t);
+	size_t next = k + 1 < keys.size() ? k + 1 : k;
+	return add(t, keys[k].time, impl::animationComponent(keys[k].value, component), keys[next].time, impl::animationComponent(keys[next].value, component));
+}
+}
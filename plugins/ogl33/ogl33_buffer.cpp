@@ -0,0 +1,228 @@
+#include "ogl33_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace gin {
+void Ogl33FrameData::setViewProjection(const Matrix<float, 3, 3>& vp){
+	view_projection = {
+		vp(0,0), vp(1,0), 0.f, vp(2,0),
+		vp(0,1), vp(1,1), 0.f, vp(2,1),
+		0.f, 0.f, 1.f, 0.f,
+		vp(0,2), vp(1,2), 0.f, vp(2,2)
+	};
+}
+
+void Ogl33FrameData::setViewProjection(const Matrix<float, 4, 4>& vp){
+	for(size_t i = 0; i < 4; ++i){
+		for(size_t j = 0; j < 4; ++j){
+			view_projection[i * 4 + j] = vp(j, i);
+		}
+	}
+}
+
+Ogl33FrameBuffer::~Ogl33FrameBuffer(){
+	if(buffer_id > 0){
+		glDeleteBuffers(1, &buffer_id);
+	}
+}
+
+void Ogl33FrameBuffer::upload(const Ogl33FrameData& frame){
+	if(buffer_id == 0){
+		glGenBuffers(1, &buffer_id);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Ogl33FrameData), nullptr, GL_STREAM_DRAW);
+	}else{
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+	}
+
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Ogl33FrameData), &frame);
+	glBindBufferBase(GL_UNIFORM_BUFFER, ogl33_frame_data_binding, buffer_id);
+}
+
+Ogl33ObjectBuffer::~Ogl33ObjectBuffer(){
+	if(texture_id > 0){
+		glDeleteTextures(1, &texture_id);
+	}
+	if(buffer_id > 0){
+		glDeleteBuffers(1, &buffer_id);
+	}
+}
+
+std::vector<Ogl33ObjectBuffer::Texel>& Ogl33ObjectBuffer::data(){
+	return texels;
+}
+
+void Ogl33ObjectBuffer::upload(){
+	if(buffer_id == 0){
+		glGenBuffers(1, &buffer_id);
+		glGenTextures(1, &texture_id);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+
+	if(texels.size() > capacity){
+		capacity = std::max(texels.size(), capacity * 2);
+	}
+	glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(Texel), nullptr, GL_STREAM_DRAW);
+	if(!texels.empty()){
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, texels.size() * sizeof(Texel), texels.data());
+	}
+
+	glActiveTexture(GL_TEXTURE0 + ogl33_object_data_unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_id);
+	glActiveTexture(GL_TEXTURE0);
+
+	texels.clear();
+}
+
+void Ogl33ObjectBuffer::bind(){
+	glActiveTexture(GL_TEXTURE0 + ogl33_object_data_unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+Ogl33PersistentObjectBuffer::Ogl33PersistentObjectBuffer(size_t tpo):
+	texels_per_object{tpo}
+{}
+
+Ogl33PersistentObjectBuffer::~Ogl33PersistentObjectBuffer(){
+	if(texture_id > 0){
+		glDeleteTextures(1, &texture_id);
+	}
+	if(buffer_id > 0){
+		glDeleteBuffers(1, &buffer_id);
+	}
+}
+
+Ogl33PersistentObjectBuffer::Ogl33PersistentObjectBuffer(Ogl33PersistentObjectBuffer&& rhs):
+	buffer_id{rhs.buffer_id},
+	texture_id{rhs.texture_id},
+	capacity{rhs.capacity},
+	texels_per_object{rhs.texels_per_object},
+	data{std::move(rhs.data)},
+	dirty_flags{std::move(rhs.dirty_flags)},
+	dirty_objects{std::move(rhs.dirty_objects)}
+{
+	rhs.buffer_id = 0;
+	rhs.texture_id = 0;
+	rhs.capacity = 0;
+}
+
+void Ogl33PersistentObjectBuffer::resize(size_t objects){
+	data.resize(objects * texels_per_object, Texel{0.f, 0.f, 0.f, 0.f});
+	dirty_flags.resize(objects, 0);
+}
+
+size_t Ogl33PersistentObjectBuffer::size() const {
+	return dirty_flags.size();
+}
+
+Ogl33PersistentObjectBuffer::Texel* Ogl33PersistentObjectBuffer::write(size_t object){
+	markDirty(object);
+	return texels(object);
+}
+
+Ogl33PersistentObjectBuffer::Texel* Ogl33PersistentObjectBuffer::texels(size_t object){
+	assert(object < dirty_flags.size());
+	return &data[object * texels_per_object];
+}
+
+void Ogl33PersistentObjectBuffer::markDirty(size_t object){
+	assert(object < dirty_flags.size());
+	if(!dirty_flags[object]){
+		dirty_flags[object] = 1;
+		dirty_objects.push_back(object);
+	}
+}
+
+size_t Ogl33PersistentObjectBuffer::dirtyCount() const {
+	return dirty_objects.size();
+}
+
+void Ogl33PersistentObjectBuffer::upload(){
+	if(buffer_id == 0){
+		glGenBuffers(1, &buffer_id);
+		glGenTextures(1, &texture_id);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+
+	if(data.size() > capacity){
+		// Reallocating loses the old storage, so everything is sent again
+		capacity = std::max(data.size(), capacity * 2);
+		glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(Texel), nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(Texel), data.data());
+
+		glActiveTexture(GL_TEXTURE0 + ogl33_object_data_unit);
+		glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_id);
+		glActiveTexture(GL_TEXTURE0);
+	}else if(!dirty_objects.empty()){
+		std::sort(dirty_objects.begin(), dirty_objects.end());
+
+		size_t object_bytes = texels_per_object * sizeof(Texel);
+		for(size_t begin = 0; begin < dirty_objects.size();){
+			size_t end = begin + 1;
+			while(end < dirty_objects.size() && dirty_objects[end] == dirty_objects[end-1] + 1){
+				++end;
+			}
+
+			size_t first = dirty_objects[begin];
+			glBufferSubData(GL_TEXTURE_BUFFER, first * object_bytes, (end - begin) * object_bytes, &data[first * texels_per_object]);
+
+			begin = end;
+		}
+	}
+
+	for(auto& iter : dirty_objects){
+		dirty_flags[iter] = 0;
+	}
+	dirty_objects.clear();
+}
+
+void Ogl33PersistentObjectBuffer::bind(){
+	glActiveTexture(GL_TEXTURE0 + ogl33_object_data_unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+Ogl33InstanceBuffer::~Ogl33InstanceBuffer(){
+	if(texture_id > 0){
+		glDeleteTextures(1, &texture_id);
+	}
+	if(buffer_id > 0){
+		glDeleteBuffers(1, &buffer_id);
+	}
+}
+
+Ogl33InstanceBuffer::Ogl33InstanceBuffer(Ogl33InstanceBuffer&& rhs):
+	buffer_id{rhs.buffer_id},
+	texture_id{rhs.texture_id}
+{
+	rhs.buffer_id = 0;
+	rhs.texture_id = 0;
+}
+
+void Ogl33InstanceBuffer::upload(const std::vector<uint32_t>& slots){
+	if(buffer_id == 0){
+		glGenBuffers(1, &buffer_id);
+		glGenTextures(1, &texture_id);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+	glBufferData(GL_TEXTURE_BUFFER, slots.size() * sizeof(uint32_t), slots.data(), GL_STATIC_DRAW);
+
+	glActiveTexture(GL_TEXTURE0 + ogl33_object_slots_unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffer_id);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void Ogl33InstanceBuffer::bind(){
+	glActiveTexture(GL_TEXTURE0 + ogl33_object_slots_unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glActiveTexture(GL_TEXTURE0);
+}
+}
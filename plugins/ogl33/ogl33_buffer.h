@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ogl33_bindings.h"
+
+#include "common/math.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace gin {
+/// Binding point of the FrameData uniform block
+constexpr GLuint ogl33_frame_data_binding = 0;
+/// Texture unit of the object_data samplerBuffer
+constexpr GLuint ogl33_object_data_unit = 1;
+/// Texture unit of the object_slots usamplerBuffer
+constexpr GLuint ogl33_object_slots_unit = 2;
+/// Length of the flipbook_rects uniform array
+constexpr size_t ogl33_max_flipbook_frames = 64;
+
+/**
+* std140 mirror of the FrameData block shared by the 2D and 3D programs
+*
+* layout (std140) uniform FrameData {
+* 	mat4 view_projection;
+* 	vec2 viewport_size;
+* 	float time;
+* 	float interpolation;
+* };
+*/
+struct Ogl33FrameData {
+	// Column major
+	std::array<float, 16> view_projection{};
+	std::array<float, 2> viewport_size = {{0.f, 0.f}};
+	float time = 0.f;
+	float interpolation = 0.f;
+
+	/// 2D transforms are applied to (x, y, 0, 1)
+	void setViewProjection(const Matrix<float, 3, 3>&);
+	void setViewProjection(const Matrix<float, 4, 4>&);
+};
+static_assert(sizeof(Ogl33FrameData) == sizeof(float) * 20, "Ogl33FrameData doesn't match the std140 layout");
+
+class Ogl33FrameBuffer {
+private:
+	GLuint buffer_id = 0;
+public:
+	Ogl33FrameBuffer() = default;
+	~Ogl33FrameBuffer();
+
+	Ogl33FrameBuffer(const Ogl33FrameBuffer&) = delete;
+	Ogl33FrameBuffer& operator=(const Ogl33FrameBuffer&) = delete;
+
+	/// Uploads and binds the data to ogl33_frame_data_binding
+	void upload(const Ogl33FrameData&);
+};
+
+/**
+* Per object data streamed into a buffer texture each time it's used.
+* Programs read it with texelFetch on a samplerBuffer, indexed by object_offset + gl_InstanceID.
+*/
+class Ogl33ObjectBuffer {
+public:
+	using Texel = std::array<float, 4>;
+private:
+	GLuint buffer_id = 0;
+	GLuint texture_id = 0;
+	size_t capacity = 0;
+
+	std::vector<Texel> texels;
+public:
+	Ogl33ObjectBuffer() = default;
+	~Ogl33ObjectBuffer();
+
+	Ogl33ObjectBuffer(const Ogl33ObjectBuffer&) = delete;
+	Ogl33ObjectBuffer& operator=(const Ogl33ObjectBuffer&) = delete;
+
+	/// Cleared by upload
+	std::vector<Texel>& data();
+
+	/// Orphans the previous storage, so draws still reading it don't stall the upload
+	void upload();
+	void bind();
+};
+
+/**
+* Per object data which stays on the GPU between frames. Objects own a fixed amount of
+* texels, and only objects which were written since the last upload are sent again.
+*/
+class Ogl33PersistentObjectBuffer {
+public:
+	using Texel = std::array<float, 4>;
+private:
+	GLuint buffer_id = 0;
+	GLuint texture_id = 0;
+	size_t capacity = 0;
+
+	size_t texels_per_object;
+	std::vector<Texel> data;
+
+	std::vector<uint8_t> dirty_flags;
+	std::vector<size_t> dirty_objects;
+public:
+	Ogl33PersistentObjectBuffer(size_t texels_per_object);
+	~Ogl33PersistentObjectBuffer();
+
+	Ogl33PersistentObjectBuffer(Ogl33PersistentObjectBuffer&&);
+	Ogl33PersistentObjectBuffer& operator=(Ogl33PersistentObjectBuffer&&) = delete;
+
+	void resize(size_t objects);
+	size_t size() const;
+
+	/// Marks the object for the next upload
+	Texel* write(size_t object);
+	/**
+	* Doesn't mark the object, so different objects can be written from several threads.
+	* markDirty has to be called afterwards.
+	*/
+	Texel* texels(size_t object);
+	void markDirty(size_t object);
+
+	size_t dirtyCount() const;
+
+	/// Merges neighbouring dirty objects into single uploads
+	void upload();
+	void bind();
+};
+
+/**
+* List of object slots per instance, read through an usamplerBuffer.
+* Only uploaded when the list changes.
+*/
+class Ogl33InstanceBuffer {
+private:
+	GLuint buffer_id = 0;
+	GLuint texture_id = 0;
+public:
+	Ogl33InstanceBuffer() = default;
+	~Ogl33InstanceBuffer();
+
+	Ogl33InstanceBuffer(Ogl33InstanceBuffer&&);
+	Ogl33InstanceBuffer& operator=(Ogl33InstanceBuffer&&) = delete;
+
+	void upload(const std::vector<uint32_t>& slots);
+	void bind();
+};
+}
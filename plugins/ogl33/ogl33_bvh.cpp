@@ -0,0 +1,444 @@
+#include "ogl33_bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace gin {
+namespace {
+/// Leaves are enlarged by this fraction of their largest extent
+constexpr float fat_margin = 0.1f;
+/// Leaves are shrunk again once their box is this much larger than needed
+constexpr float shrink_ratio = 1.5f;
+
+Ogl33Aabb fatten(const Ogl33Aabb& box){
+	std::array<float, 3> extent = box.extent();
+	float margin = fat_margin * std::max({extent[0], extent[1], extent[2]});
+	Ogl33Aabb fat = box;
+	for(size_t i = 0; i < 3; ++i){
+		fat.min[i] -= margin;
+		fat.max[i] += margin;
+	}
+	return fat;
+}
+
+/**
+* Tests eight boxes given as centres and extents against all planes.
+* A set bit in outside means the box is fully outside of one plane,
+* a set bit in crossing means it isn't fully inside of all of them.
+*/
+void classifyBoxes(const Ogl33Frustum& frustum,
+	const float* cx, const float* cy, const float* cz,
+	const float* ex, const float* ey, const float* ez,
+	uint32_t& outside, uint32_t& crossing)
+{
+#ifdef __AVX__
+	__m256 c_x = _mm256_load_ps(cx);
+	__m256 c_y = _mm256_load_ps(cy);
+	__m256 c_z = _mm256_load_ps(cz);
+	__m256 e_x = _mm256_load_ps(ex);
+	__m256 e_y = _mm256_load_ps(ey);
+	__m256 e_z = _mm256_load_ps(ez);
+
+	__m256 out = _mm256_setzero_ps();
+	__m256 cross = _mm256_setzero_ps();
+	for(auto& plane : frustum.planes){
+		__m256 dist = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), c_x), _mm256_mul_ps(_mm256_set1_ps(plane[1]), c_y)),
+			_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[2]), c_z), _mm256_set1_ps(plane[3])));
+		__m256 radius = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane[0])), e_x), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane[1])), e_y)),
+			_mm256_mul_ps(_mm256_set1_ps(std::abs(plane[2])), e_z));
+
+		out = _mm256_or_ps(out, _mm256_cmp_ps(dist, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_LT_OQ));
+		cross = _mm256_or_ps(cross, _mm256_cmp_ps(dist, radius, _CMP_LT_OQ));
+	}
+	outside = static_cast<uint32_t>(_mm256_movemask_ps(out));
+	crossing = static_cast<uint32_t>(_mm256_movemask_ps(cross));
+#elif defined(__SSE2__)
+	outside = 0;
+	crossing = 0;
+	for(size_t half = 0; half < 8; half += 4){
+		__m128 c_x = _mm_load_ps(cx + half);
+		__m128 c_y = _mm_load_ps(cy + half);
+		__m128 c_z = _mm_load_ps(cz + half);
+		__m128 e_x = _mm_load_ps(ex + half);
+		__m128 e_y = _mm_load_ps(ey + half);
+		__m128 e_z = _mm_load_ps(ez + half);
+
+		__m128 out = _mm_setzero_ps();
+		__m128 cross = _mm_setzero_ps();
+		for(auto& plane : frustum.planes){
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), c_x), _mm_mul_ps(_mm_set1_ps(plane[1]), c_y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), c_z), _mm_set1_ps(plane[3])));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane[0])), e_x), _mm_mul_ps(_mm_set1_ps(std::abs(plane[1])), e_y)),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane[2])), e_z));
+
+			out = _mm_or_ps(out, _mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), radius)));
+			cross = _mm_or_ps(cross, _mm_cmplt_ps(dist, radius));
+		}
+		outside |= static_cast<uint32_t>(_mm_movemask_ps(out)) << half;
+		crossing |= static_cast<uint32_t>(_mm_movemask_ps(cross)) << half;
+	}
+#else
+	outside = 0;
+	crossing = 0;
+	for(size_t i = 0; i < 8; ++i){
+		for(auto& plane : frustum.planes){
+			float dist = plane[0] * cx[i] + plane[1] * cy[i] + plane[2] * cz[i] + plane[3];
+			float radius = std::abs(plane[0]) * ex[i] + std::abs(plane[1]) * ey[i] + std::abs(plane[2]) * ez[i];
+			if(dist < -radius){
+				outside |= 1u << i;
+			}
+			if(dist < radius){
+				crossing |= 1u << i;
+			}
+		}
+	}
+#endif
+}
+}
+
+std::array<float, 3> Ogl33Aabb::centre() const {
+	return {{(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f}};
+}
+
+std::array<float, 3> Ogl33Aabb::extent() const {
+	return {{(max[0] - min[0]) * 0.5f, (max[1] - min[1]) * 0.5f, (max[2] - min[2]) * 0.5f}};
+}
+
+bool Ogl33Aabb::contains(const Ogl33Aabb& box) const {
+	for(size_t i = 0; i < 3; ++i){
+		if(box.min[i] < min[i] || box.max[i] > max[i]){
+			return false;
+		}
+	}
+	return true;
+}
+
+float Ogl33Aabb::perimeter() const {
+	return (max[0] - min[0]) + (max[1] - min[1]) + (max[2] - min[2]);
+}
+
+Ogl33Aabb Ogl33Aabb::merge(const Ogl33Aabb& a, const Ogl33Aabb& b){
+	Ogl33Aabb box;
+	for(size_t i = 0; i < 3; ++i){
+		box.min[i] = std::min(a.min[i], b.min[i]);
+		box.max[i] = std::max(a.max[i], b.max[i]);
+	}
+	return box;
+}
+
+Ogl33Aabb Ogl33Aabb::fromCentre(const std::array<float, 3>& centre, const std::array<float, 3>& extent){
+	Ogl33Aabb box;
+	for(size_t i = 0; i < 3; ++i){
+		box.min[i] = centre[i] - extent[i];
+		box.max[i] = centre[i] + extent[i];
+	}
+	return box;
+}
+
+Ogl33Frustum Ogl33Frustum::fromMatrix(const Matrix<float, 4, 4>& m, bool reversed_depth){
+	Ogl33Frustum frustum;
+	// Left, right, bottom, top, near and far from the rows of the clip space transform
+	for(size_t i = 0; i < 3; ++i){
+		for(size_t j = 0; j < 4; ++j){
+			frustum.planes[i * 2][j] = m(3, j) + m(i, j);
+			frustum.planes[i * 2 + 1][j] = m(3, j) - m(i, j);
+		}
+	}
+	if(reversed_depth){
+		// The far plane is z >= 0. At infinity it degenerates to a plane everything is inside of.
+		for(size_t j = 0; j < 4; ++j){
+			frustum.planes[4][j] = m(2, j);
+		}
+	}
+
+	for(auto& plane : frustum.planes){
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if(length > 0.f){
+			for(auto& value : plane){
+				value /= length;
+			}
+		}
+	}
+	return frustum;
+}
+
+uint32_t Ogl33Bvh::allocateNode(){
+	if(!free_nodes.empty()){
+		uint32_t node = free_nodes.back();
+		free_nodes.pop_back();
+		nodes[node] = Node{};
+		return node;
+	}
+	// Freeing a node never allocates, so reinserting in update can't fail halfway
+	free_nodes.reserve(nodes.size() + 1);
+	nodes.emplace_back();
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void Ogl33Bvh::freeNode(uint32_t node){
+	free_nodes.push_back(node);
+}
+
+uint32_t Ogl33Bvh::insert(const Ogl33Aabb& box, uint32_t user){
+	uint32_t leaf = allocateNode();
+	nodes[leaf].box = fatten(box);
+	nodes[leaf].user = user;
+	insertLeaf(leaf);
+	++leaves;
+	return leaf;
+}
+
+void Ogl33Bvh::remove(uint32_t leaf){
+	assert(leaf < nodes.size() && nodes[leaf].isLeaf());
+	removeLeaf(leaf);
+	freeNode(leaf);
+	--leaves;
+}
+
+bool Ogl33Bvh::update(uint32_t leaf, const Ogl33Aabb& box){
+	assert(leaf < nodes.size() && nodes[leaf].isLeaf());
+	Ogl33Aabb fat = fatten(box);
+	const Ogl33Aabb& current = nodes[leaf].box;
+	if(current.contains(box) && current.perimeter() <= fat.perimeter() * shrink_ratio){
+		return false;
+	}
+
+	removeLeaf(leaf);
+	nodes[leaf].box = fat;
+	insertLeaf(leaf);
+	return true;
+}
+
+void Ogl33Bvh::insertLeaf(uint32_t leaf){
+	if(root == null_node){
+		root = leaf;
+		nodes[leaf].parent = null_node;
+		return;
+	}
+
+	// Descend towards the sibling with the smallest increase of the summed perimeters
+	const Ogl33Aabb box = nodes[leaf].box;
+	uint32_t index = root;
+	while(!nodes[index].isLeaf()){
+		const Node& node = nodes[index];
+		float combined = Ogl33Aabb::merge(node.box, box).perimeter();
+		float cost = 2.f * combined;
+		float inheritance = 2.f * (combined - node.box.perimeter());
+
+		auto childCost = [&](uint32_t child){
+			float merged = Ogl33Aabb::merge(nodes[child].box, box).perimeter();
+			if(nodes[child].isLeaf()){
+				return merged + inheritance;
+			}
+			return merged - nodes[child].box.perimeter() + inheritance;
+		};
+		float cost_left = childCost(node.left);
+		float cost_right = childCost(node.right);
+
+		if(cost < cost_left && cost < cost_right){
+			break;
+		}
+		index = cost_left < cost_right ? node.left : node.right;
+	}
+
+	uint32_t sibling = index;
+	uint32_t old_parent = nodes[sibling].parent;
+	uint32_t new_parent = allocateNode();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = Ogl33Aabb::merge(box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	if(old_parent != null_node){
+		if(nodes[old_parent].left == sibling){
+			nodes[old_parent].left = new_parent;
+		}else{
+			nodes[old_parent].right = new_parent;
+		}
+	}else{
+		root = new_parent;
+	}
+
+	refit(new_parent);
+}
+
+void Ogl33Bvh::removeLeaf(uint32_t leaf){
+	if(leaf == root){
+		root = null_node;
+		return;
+	}
+
+	uint32_t parent = nodes[leaf].parent;
+	uint32_t grand_parent = nodes[parent].parent;
+	uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	if(grand_parent != null_node){
+		if(nodes[grand_parent].left == parent){
+			nodes[grand_parent].left = sibling;
+		}else{
+			nodes[grand_parent].right = sibling;
+		}
+		nodes[sibling].parent = grand_parent;
+		freeNode(parent);
+		refit(grand_parent);
+	}else{
+		root = sibling;
+		nodes[sibling].parent = null_node;
+		freeNode(parent);
+	}
+	nodes[leaf].parent = null_node;
+}
+
+void Ogl33Bvh::refit(uint32_t index){
+	while(index != null_node){
+		index = balance(index);
+
+		Node& node = nodes[index];
+		node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+		node.box = Ogl33Aabb::merge(nodes[node.left].box, nodes[node.right].box);
+
+		index = node.parent;
+	}
+}
+
+uint32_t Ogl33Bvh::balance(uint32_t a){
+	if(nodes[a].isLeaf() || nodes[a].height < 2){
+		return a;
+	}
+
+	uint32_t b = nodes[a].left;
+	uint32_t c = nodes[a].right;
+	int32_t difference = nodes[c].height - nodes[b].height;
+	if(difference >= -1 && difference <= 1){
+		return a;
+	}
+
+	// The higher child takes the place of a, a takes the lower of its children
+	bool right_heavy = difference > 1;
+	uint32_t up = right_heavy ? c : b;
+	uint32_t other = right_heavy ? b : c;
+	uint32_t f = nodes[up].left;
+	uint32_t g = nodes[up].right;
+
+	nodes[up].left = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+
+	if(nodes[up].parent != null_node){
+		Node& parent = nodes[nodes[up].parent];
+		if(parent.left == a){
+			parent.left = up;
+		}else{
+			parent.right = up;
+		}
+	}else{
+		root = up;
+	}
+
+	uint32_t keep = nodes[f].height > nodes[g].height ? f : g;
+	uint32_t moved = keep == f ? g : f;
+
+	nodes[up].right = keep;
+	if(right_heavy){
+		nodes[a].right = moved;
+	}else{
+		nodes[a].left = moved;
+	}
+	nodes[moved].parent = a;
+
+	nodes[a].box = Ogl33Aabb::merge(nodes[other].box, nodes[moved].box);
+	nodes[a].height = 1 + std::max(nodes[other].height, nodes[moved].height);
+	nodes[up].box = Ogl33Aabb::merge(nodes[a].box, nodes[keep].box);
+	nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+
+	return up;
+}
+
+void Ogl33Bvh::collectLeaves(uint32_t index, std::vector<uint32_t>& users) const {
+	const Node& node = nodes[index];
+	if(node.isLeaf()){
+		users.push_back(node.user);
+		return;
+	}
+	collectLeaves(node.left, users);
+	collectLeaves(node.right, users);
+}
+
+void Ogl33Bvh::cull(const Ogl33Frustum& frustum, std::vector<uint32_t>& users){
+	if(root == null_node){
+		return;
+	}
+
+	alignas(32) std::array<float, 8> cx;
+	alignas(32) std::array<float, 8> cy;
+	alignas(32) std::array<float, 8> cz;
+	alignas(32) std::array<float, 8> ex;
+	alignas(32) std::array<float, 8> ey;
+	alignas(32) std::array<float, 8> ez;
+
+	frontier.clear();
+	frontier.push_back(root);
+	while(!frontier.empty()){
+		next_frontier.clear();
+		for(size_t begin = 0; begin < frontier.size(); begin += 8){
+			size_t count = std::min<size_t>(8, frontier.size() - begin);
+			for(size_t i = 0; i < 8; ++i){
+				// Unused lanes repeat the first node, their results are ignored
+				const Ogl33Aabb& box = nodes[frontier[begin + (i < count ? i : 0)]].box;
+				std::array<float, 3> centre = box.centre();
+				std::array<float, 3> extent = box.extent();
+				cx[i] = centre[0];
+				cy[i] = centre[1];
+				cz[i] = centre[2];
+				ex[i] = extent[0];
+				ey[i] = extent[1];
+				ez[i] = extent[2];
+			}
+
+			uint32_t outside;
+			uint32_t crossing;
+			classifyBoxes(frustum, cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data(), outside, crossing);
+
+			for(size_t i = 0; i < count; ++i){
+				if(outside & (1u << i)){
+					continue;
+				}
+
+				uint32_t index = frontier[begin + i];
+				const Node& node = nodes[index];
+				if(!(crossing & (1u << i))){
+					collectLeaves(index, users);
+				}else if(node.isLeaf()){
+					users.push_back(node.user);
+				}else{
+					next_frontier.push_back(node.left);
+					next_frontier.push_back(node.right);
+				}
+			}
+		}
+		std::swap(frontier, next_frontier);
+	}
+}
+
+size_t Ogl33Bvh::height() const {
+	return root == null_node ? 0 : static_cast<size_t>(nodes[root].height);
+}
+
+size_t Ogl33Bvh::leafCount() const {
+	return leaves;
+}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common/math.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace gin {
+class Ogl33Aabb {
+public:
+	std::array<float, 3> min{{0.f, 0.f, 0.f}};
+	std::array<float, 3> max{{0.f, 0.f, 0.f}};
+
+	std::array<float, 3> centre() const;
+	std::array<float, 3> extent() const;
+
+	bool contains(const Ogl33Aabb&) const;
+	/// Sum of the edge lengths, the insertion cost of the tree
+	float perimeter() const;
+
+	static Ogl33Aabb merge(const Ogl33Aabb&, const Ogl33Aabb&);
+	static Ogl33Aabb fromCentre(const std::array<float, 3>& centre, const std::array<float, 3>& extent);
+};
+
+/// Planes as a x + b y + c z + d >= 0 for everything inside
+class Ogl33Frustum {
+public:
+	std::array<std::array<float, 4>, 6> planes;
+
+	/**
+	* Extracts the planes of a view projection matrix. Reversed depth projections
+	* map the frustum to a clip space depth of 0 to w instead of -w to w.
+	*/
+	static Ogl33Frustum fromMatrix(const Matrix<float, 4, 4>& view_projection, bool reversed_depth = false);
+};
+
+/**
+* Dynamic bounding volume hierarchy. Leaves keep an enlarged box, so small movements
+* don't touch the tree. Larger ones, or boxes that became much smaller, only reinsert the leaf. The tree stays balanced
+* by rotations on the path of every insertion and removal.
+*/
+class Ogl33Bvh {
+public:
+	static constexpr uint32_t null_node = UINT32_MAX;
+private:
+	struct Node {
+		Ogl33Aabb box;
+		uint32_t parent = null_node;
+		uint32_t left = null_node;
+		uint32_t right = null_node;
+		// Leaves are 0
+		int32_t height = 0;
+		uint32_t user = 0;
+
+		bool isLeaf() const {
+			return left == null_node;
+		}
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> free_nodes;
+	uint32_t root = null_node;
+	size_t leaves = 0;
+
+	// Reused between culls
+	std::vector<uint32_t> frontier;
+	std::vector<uint32_t> next_frontier;
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t);
+
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	/// Recomputes boxes and heights from the node up to the root
+	void refit(uint32_t node);
+	uint32_t balance(uint32_t node);
+
+	void collectLeaves(uint32_t node, std::vector<uint32_t>& users) const;
+public:
+	/// Returns the leaf, which stays the same until it's removed
+	uint32_t insert(const Ogl33Aabb& box, uint32_t user);
+	void remove(uint32_t leaf);
+	/// Returns true if the leaf had to be reinserted
+	bool update(uint32_t leaf, const Ogl33Aabb& box);
+
+	/**
+	* Appends the users of all leaves intersecting the frustum. Nodes are tested
+	* eight at a time, subtrees fully inside are taken without further tests.
+	*/
+	void cull(const Ogl33Frustum&, std::vector<uint32_t>& users);
+
+	size_t height() const;
+	size_t leafCount() const;
+};
+}
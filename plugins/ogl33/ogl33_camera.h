@@ -4,6 +4,8 @@
 
 #include "common/math.h"
 
+#include "ogl33_bvh.h"
+
 #include <array>
 #include <complex>
 
@@ -42,20 +44,48 @@ public:
 
 	Matrix<float, 3,3> view(float relative_tp) const;
 	const Matrix<float, 3,3>& projection() const;
+
+	/// Axis aligned bounds of the visible area as min x, min y, max x, max y
+	std::array<float, 4> visibleBounds(float relative_tp) const;
 };
 
 class Ogl33Camera3d {
 private:
 	Matrix<float, 4, 4> projection_matrix;
 	Matrix<float, 4, 4> view_matrix;
+
+	// Only recomputed if the camera changes, so static cameras cost nothing per frame
+	Matrix<float, 4, 4> view_projection_matrix;
+	Ogl33Frustum frustum_planes;
+
+	bool reversed_depth = false;
+	bool perspective = false;
+
+	std::array<float, 3> position = {{0.f, 0.f, 0.f}};
+	Quaternion<float> orientation;
+
+	void updateView();
+	void updateViewProjection();
 public:
 	Ogl33Camera3d();
 
 	void setOrtho(float left, float right, float top, float bottom, float near, float far);
+	/// A far plane of 0 or less lies at infinity
+	void setPerspective(float fov_y, float aspect, float near, float far, bool reverse_depth);
 	void setViewPosition(float x, float y, float z);
+	/// Rotates around x, then y, then z
 	void setViewRotation(float alpha, float beta, float gamma);
+	void setViewOrientation(float x, float y, float z, float w);
 
 	const Matrix<float, 4, 4>& projection() const;
 	const Matrix<float, 4, 4>& view() const;
+	const Matrix<float, 4, 4>& viewProjection() const;
+
+	const Ogl33Frustum& frustum() const;
+
+	/// Depth has to be cleared to 0 and compared with GL_GREATER
+	bool reversedDepth() const;
+	/// Otherwise orthographic, which the identity projection is as well
+	bool isPerspective() const;
 };
-}
\ No newline at end of file
+}
@@ -1,5 +1,8 @@
 #include "ogl33_render.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace gin {
 
 Ogl33Mesh::Ogl33Mesh():
@@ -19,17 +22,46 @@ Ogl33Mesh::~Ogl33Mesh(){
 	if(ids[0] > 0){
 		glDeleteBuffers(2, &ids[0]);
 	}
+	if(vao > 0){
+		glDeleteVertexArrays(1, &vao);
+	}
 }
 
 Ogl33Mesh::Ogl33Mesh(Ogl33Mesh&& rhs):
 	vao{rhs.vao},
 	ids{std::move(rhs.ids)},
-	indices{rhs.indices}
+	indices{rhs.indices},
+	mesh_data{std::move(rhs.mesh_data)},
+	keeps_data{rhs.keeps_data}
 {
 	rhs.vao = 0;
 	rhs.ids = {0,0};
 	rhs.indices = 0;
 }
+
+Ogl33Mesh& Ogl33Mesh::operator=(Ogl33Mesh&& rhs){
+	if(this == &rhs){
+		return *this;
+	}
+	if(ids[0] > 0){
+		glDeleteBuffers(2, &ids[0]);
+	}
+	if(vao > 0){
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	vao = rhs.vao;
+	ids = rhs.ids;
+	indices = rhs.indices;
+	mesh_data = std::move(rhs.mesh_data);
+	keeps_data = rhs.keeps_data;
+
+	rhs.vao = 0;
+	rhs.ids = {0,0};
+	rhs.indices = 0;
+	return *this;
+}
+
 void Ogl33Mesh::bindVertexArray() const{
 	glBindVertexArray(vao);
 }
@@ -43,7 +75,23 @@ void Ogl33Mesh::bindIndex() const{
 }
 
 void Ogl33Mesh::setData(const MeshData& data){
+	upload(data);
+	if(keeps_data){
+		mesh_data = data;
+	}
+}
+
+void Ogl33Mesh::setData(MeshData&& data){
+	upload(data);
+	if(keeps_data){
+		mesh_data = std::move(data);
+	}
+}
+
+void Ogl33Mesh::upload(const MeshData& data){
 	bindVertexArray();
+	bindAttribute();
+	bindIndex();
 	glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(MeshData::Vertex), data.vertices.data(), GL_DYNAMIC_DRAW);
 
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_DYNAMIC_DRAW);
@@ -61,6 +109,42 @@ void Ogl33Mesh::setData(const MeshData& data){
 	indices = data.indices.size();
 }
 
+const MeshData& Ogl33Mesh::data() {
+	if(keeps_data){
+		return mesh_data;
+	}
+
+	GLint vertex_bytes = 0;
+	bindAttribute();
+	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertex_bytes);
+
+	mesh_data.vertices.resize(static_cast<size_t>(vertex_bytes) / sizeof(MeshData::Vertex));
+	mesh_data.indices.resize(indices);
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, mesh_data.vertices.size() * sizeof(MeshData::Vertex), mesh_data.vertices.data());
+	// The element buffer is part of the vertex array state
+	bindVertexArray();
+	bindIndex();
+	glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh_data.indices.size() * sizeof(unsigned int), mesh_data.indices.data());
+	#ifndef NDEBUG
+		glBindVertexArray(0);
+	#endif
+
+	keeps_data = true;
+	return mesh_data;
+}
+
+Ogl33Mesh createOgl33Mesh(const MeshData& data){
+	GLuint vao;
+	std::array<GLuint,2> ids;
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(2, &ids[0]);
+
+	Ogl33Mesh mesh{vao, std::move(ids), 0};
+	mesh.setData(data);
+	return mesh;
+}
+
 size_t Ogl33Mesh::indexCount() const {
 	return indices;
 }
@@ -89,13 +173,20 @@ Ogl33Mesh3d::~Ogl33Mesh3d(){
 Ogl33Mesh3d::Ogl33Mesh3d(Ogl33Mesh3d&& rhs):
 	vao{rhs.vao},
 	ids{std::move(rhs.ids)},
-	indices{rhs.indices}
+	indices{rhs.indices},
+	bounds{rhs.bounds},
+	radius{rhs.radius},
+	lods{std::move(rhs.lods)}
 {
 	rhs.vao = 0;
 	rhs.ids = {0,0};
 	rhs.indices = 0;
 }
 
+void Ogl33Mesh3d::bindVertexArray() const {
+	glBindVertexArray(vao);
+}
+
 void Ogl33Mesh3d::bindAttribute() const {
 	glBindBuffer(GL_ARRAY_BUFFER, ids[0]);
 }
@@ -128,9 +219,75 @@ void Ogl33Mesh3d::setData(const Mesh3dData& data){
 	#endif
 
 	indices = data.indices.size();
+
+	if(data.lods.empty()){
+		lods = {Mesh3dData::Lod{0, indices, 0.f}};
+	}else{
+		lods = data.lods;
+	}
+
+	bounds = Ogl33Aabb{};
+	if(!data.vertices.empty()){
+		bounds.min = data.vertices.front().position;
+		bounds.max = data.vertices.front().position;
+	}
+	for(auto& iter : data.vertices){
+		for(size_t i = 0; i < 3; ++i){
+			bounds.min[i] = std::min(bounds.min[i], iter.position[i]);
+			bounds.max[i] = std::max(bounds.max[i], iter.position[i]);
+		}
+	}
+
+	std::array<float, 3> centre = bounds.centre();
+	float radius_sq = 0.f;
+	for(auto& iter : data.vertices){
+		float dx = iter.position[0] - centre[0];
+		float dy = iter.position[1] - centre[1];
+		float dz = iter.position[2] - centre[2];
+		radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+	}
+	radius = std::sqrt(radius_sq);
+}
+
+Ogl33Mesh3d createOgl33Mesh3d(const Mesh3dData& data){
+	GLuint vao;
+	std::array<GLuint,2> ids;
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(2, &ids[0]);
+
+	Ogl33Mesh3d mesh{vao, std::move(ids), 0};
+	mesh.setData(data);
+	return mesh;
 }
 
 size_t Ogl33Mesh3d::indexCount() const {
 	return indices;
 }
-}
\ No newline at end of file
+
+const Ogl33Aabb& Ogl33Mesh3d::boundingBox() const {
+	return bounds;
+}
+
+float Ogl33Mesh3d::boundingRadius() const {
+	return radius;
+}
+
+const std::vector<Mesh3dData::Lod>& Ogl33Mesh3d::levels() const {
+	return lods;
+}
+
+size_t Ogl33Mesh3d::selectLevel(float screen_size, size_t current, float hysteresis) const {
+	if(lods.empty()){
+		return 0;
+	}
+	size_t level = std::min(current, lods.size() - 1);
+	while(level + 1 < lods.size() && screen_size < lods[level].screen_size * (1.f - hysteresis)){
+		++level;
+	}
+	while(level > 0 && screen_size >= lods[level - 1].screen_size * (1.f + hysteresis)){
+		--level;
+	}
+	return level;
+}
+}
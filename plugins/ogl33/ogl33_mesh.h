@@ -2,7 +2,12 @@
 
 #include "ogl33_bindings.h"
 
+#include "render/render.h"
+
+#include "ogl33_bvh.h"
+
 #include <array>
+#include <vector>
 
 namespace gin {
 class Ogl33Mesh {
@@ -10,12 +15,16 @@ private:
 	GLuint vao;
 	std::array<GLuint,2> ids;
 	size_t indices;
-	
+
+	// Kept for baking static geometry on the CPU, only once a static object used the mesh
+	MeshData mesh_data;
+	bool keeps_data = false;
 public:
 	Ogl33Mesh();
 	Ogl33Mesh(GLuint vao, std::array<GLuint,2>&& id, size_t ind);
 	~Ogl33Mesh();
 	Ogl33Mesh(Ogl33Mesh&&);
+	Ogl33Mesh& operator=(Ogl33Mesh&&);
 
 	void bindVertexArray() const;
 
@@ -23,27 +32,58 @@ public:
 	void bindIndex() const;
 
 	void setData(const MeshData& data);
+	void setData(MeshData&& data);
+	/// Like setData, but never keeps a copy for data()
+	void upload(const MeshData& data);
+	/// Reads the mesh back from the GPU on the first call and keeps a copy from then on
+	const MeshData& data();
 
 	size_t indexCount() const;
 };
 
+/// Generates the vertex array and buffers
+Ogl33Mesh createOgl33Mesh(const MeshData& data);
+
 class Ogl33Mesh3d {
 private:
 	GLuint vao;
 	std::array<GLuint, 2> ids;
 	size_t indices;
 
+	// Local bounds, the sphere is centred on the box
+	Ogl33Aabb bounds;
+	float radius = 0.f;
+
+	// Always at least one level
+	std::vector<Mesh3dData::Lod> lods;
+
 public:
 	Ogl33Mesh3d();
 	Ogl33Mesh3d(GLuint v, std::array<GLuint, 2>&& id, size_t ind);
 	~Ogl33Mesh3d();
 	Ogl33Mesh3d(Ogl33Mesh3d&&);
 
+	void bindVertexArray() const;
+
 	void bindAttribute() const;
 	void bindIndex() const;
 
 	void setData(const Mesh3dData& data);
 
 	size_t indexCount() const;
+
+	const Ogl33Aabb& boundingBox() const;
+	float boundingRadius() const;
+
+	const std::vector<Mesh3dData::Lod>& levels() const;
+	/**
+	* Picks the level for a bounding sphere covering screen_size of half the viewport
+	* height. Starting from the current level, a change needs the size to pass the
+	* threshold by the hysteresis fraction, so objects close to it don't switch every frame.
+	*/
+	size_t selectLevel(float screen_size, size_t current, float hysteresis) const;
 };
+
+/// Generates the vertex array and buffers
+Ogl33Mesh3d createOgl33Mesh3d(const Mesh3dData& data);
 }
\ No newline at end of file
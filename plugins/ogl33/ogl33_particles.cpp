@@ -0,0 +1,211 @@
+#include "ogl33_particles.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace gin {
+namespace {
+constexpr size_t particle_padding = 8;
+
+size_t padParticles(size_t n){
+	return (n + particle_padding - 1) / particle_padding * particle_padding;
+}
+
+float randomRange(std::minstd_rand& random, float min, float max){
+	std::uniform_real_distribution<float> dist{std::min(min, max), std::max(min, max)};
+	return dist(random);
+}
+}
+
+Ogl33ParticleEmitter::Ogl33ParticleEmitter(const TextureId& texture, const ParticleEmitterParameters& params, uint32_t seed):
+	parameters{params},
+	texture_id{texture},
+	random{seed}
+{
+	reserve(padParticles(parameters.max_particles));
+}
+
+void Ogl33ParticleEmitter::reserve(size_t capacity){
+	for(auto* iter : {&pos_x, &pos_y, &vel_x, &vel_y, &age, &inv_lifetime, &life, &size, &colour_r, &colour_g, &colour_b, &colour_a}){
+		iter->resize(capacity, 0.f);
+	}
+}
+
+void Ogl33ParticleEmitter::setParameters(const ParticleEmitterParameters& params){
+	reserve(padParticles(params.max_particles));
+	parameters = params;
+	count = std::min(count, parameters.max_particles);
+}
+
+const TextureId& Ogl33ParticleEmitter::texture() const {
+	return texture_id;
+}
+
+void Ogl33ParticleEmitter::spawn(size_t n){
+	n = std::min(n, parameters.max_particles - count);
+	for(size_t i = count; i < count + n; ++i){
+		pos_x[i] = position[0];
+		pos_y[i] = position[1];
+		vel_x[i] = randomRange(random, parameters.velocity_min[0], parameters.velocity_max[0]);
+		vel_y[i] = randomRange(random, parameters.velocity_min[1], parameters.velocity_max[1]);
+		age[i] = 0.f;
+		float lifetime = randomRange(random, parameters.lifetime_min, parameters.lifetime_max);
+		inv_lifetime[i] = lifetime > 0.f ? 1.f / lifetime : 1e30f;
+		life[i] = 0.f;
+		size[i] = parameters.size_begin;
+	}
+	count += n;
+}
+
+void Ogl33ParticleEmitter::integrate(float dt){
+	const float damping = std::max(0.f, 1.f - parameters.drag * dt);
+	const float gravity_x = parameters.gravity[0] * dt;
+	const float gravity_y = parameters.gravity[1] * dt;
+	const float size_begin = parameters.size_begin;
+	const float size_delta = parameters.size_end - parameters.size_begin;
+
+	const size_t n = padParticles(count);
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256 v_damping = _mm256_set1_ps(damping);
+	const __m256 v_gravity_x = _mm256_set1_ps(gravity_x);
+	const __m256 v_gravity_y = _mm256_set1_ps(gravity_y);
+	const __m256 v_dt = _mm256_set1_ps(dt);
+	const __m256 v_size_begin = _mm256_set1_ps(size_begin);
+	const __m256 v_size_delta = _mm256_set1_ps(size_delta);
+	for(; i < n; i += 8){
+		__m256 vx = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&vel_x[i]), v_damping), v_gravity_x);
+		__m256 vy = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&vel_y[i]), v_damping), v_gravity_y);
+		_mm256_storeu_ps(&vel_x[i], vx);
+		_mm256_storeu_ps(&vel_y[i], vy);
+		_mm256_storeu_ps(&pos_x[i], _mm256_add_ps(_mm256_loadu_ps(&pos_x[i]), _mm256_mul_ps(vx, v_dt)));
+		_mm256_storeu_ps(&pos_y[i], _mm256_add_ps(_mm256_loadu_ps(&pos_y[i]), _mm256_mul_ps(vy, v_dt)));
+
+		__m256 a = _mm256_add_ps(_mm256_loadu_ps(&age[i]), v_dt);
+		__m256 l = _mm256_mul_ps(a, _mm256_loadu_ps(&inv_lifetime[i]));
+		_mm256_storeu_ps(&age[i], a);
+		_mm256_storeu_ps(&life[i], l);
+		_mm256_storeu_ps(&size[i], _mm256_add_ps(v_size_begin, _mm256_mul_ps(v_size_delta, l)));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	const __m128 v_damping = _mm_set1_ps(damping);
+	const __m128 v_gravity_x = _mm_set1_ps(gravity_x);
+	const __m128 v_gravity_y = _mm_set1_ps(gravity_y);
+	const __m128 v_dt = _mm_set1_ps(dt);
+	const __m128 v_size_begin = _mm_set1_ps(size_begin);
+	const __m128 v_size_delta = _mm_set1_ps(size_delta);
+	for(; i < n; i += 4){
+		__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&vel_x[i]), v_damping), v_gravity_x);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&vel_y[i]), v_damping), v_gravity_y);
+		_mm_storeu_ps(&vel_x[i], vx);
+		_mm_storeu_ps(&vel_y[i], vy);
+		_mm_storeu_ps(&pos_x[i], _mm_add_ps(_mm_loadu_ps(&pos_x[i]), _mm_mul_ps(vx, v_dt)));
+		_mm_storeu_ps(&pos_y[i], _mm_add_ps(_mm_loadu_ps(&pos_y[i]), _mm_mul_ps(vy, v_dt)));
+
+		__m128 a = _mm_add_ps(_mm_loadu_ps(&age[i]), v_dt);
+		__m128 l = _mm_mul_ps(a, _mm_loadu_ps(&inv_lifetime[i]));
+		_mm_storeu_ps(&age[i], a);
+		_mm_storeu_ps(&life[i], l);
+		_mm_storeu_ps(&size[i], _mm_add_ps(v_size_begin, _mm_mul_ps(v_size_delta, l)));
+	}
+#endif
+	for(; i < n; ++i){
+		vel_x[i] = vel_x[i] * damping + gravity_x;
+		vel_y[i] = vel_y[i] * damping + gravity_y;
+		pos_x[i] += vel_x[i] * dt;
+		pos_y[i] += vel_y[i] * dt;
+		age[i] += dt;
+		life[i] = age[i] * inv_lifetime[i];
+		size[i] = size_begin + size_delta * life[i];
+	}
+}
+
+void Ogl33ParticleEmitter::removeDead(){
+	// Order doesn't matter, so the last particle fills the gap
+	for(size_t i = 0; i < count;){
+		if(life[i] < 1.f){
+			++i;
+			continue;
+		}
+		--count;
+		for(auto* iter : {&pos_x, &pos_y, &vel_x, &vel_y, &age, &inv_lifetime, &life, &size}){
+			(*iter)[i] = (*iter)[count];
+		}
+	}
+}
+
+void Ogl33ParticleEmitter::evaluateColours(){
+	const auto& keys = parameters.colour_over_life;
+	if(keys.empty()){
+		std::fill(colour_r.begin(), colour_r.begin() + count, 1.f);
+		std::fill(colour_g.begin(), colour_g.begin() + count, 1.f);
+		std::fill(colour_b.begin(), colour_b.begin() + count, 1.f);
+		std::fill(colour_a.begin(), colour_a.begin() + count, 1.f);
+		return;
+	}
+
+	for(size_t i = 0; i < count; ++i){
+		float t = life[i];
+		std::array<float, 4> colour;
+		if(t <= keys.front().time){
+			colour = keys.front().colour;
+		}else if(t >= keys.back().time){
+			colour = keys.back().colour;
+		}else{
+			// Curves only have a handful of keys
+			size_t k = 1;
+			while(keys[k].time < t){
+				++k;
+			}
+			const auto& from = keys[k-1];
+			const auto& to = keys[k];
+			float span = to.time - from.time;
+			float f = span > 0.f ? (t - from.time) / span : 1.f;
+			for(size_t c = 0; c < 4; ++c){
+				colour[c] = from.colour[c] + (to.colour[c] - from.colour[c]) * f;
+			}
+		}
+		colour_r[i] = colour[0];
+		colour_g[i] = colour[1];
+		colour_b[i] = colour[2];
+		colour_a[i] = colour[3];
+	}
+}
+
+void Ogl33ParticleEmitter::simulate(float dt){
+	if(dt <= 0.f){
+		return;
+	}
+
+	integrate(dt);
+	removeDead();
+
+	if(active && parameters.rate > 0.f){
+		spawn_accumulator += parameters.rate * dt;
+		size_t n = static_cast<size_t>(spawn_accumulator);
+		spawn_accumulator -= static_cast<float>(n);
+		spawn(n);
+	}else{
+		spawn_accumulator = 0.f;
+	}
+
+	evaluateColours();
+}
+
+size_t Ogl33ParticleEmitter::particleCount() const {
+	return count;
+}
+
+void Ogl33ParticleEmitter::write(std::vector<Ogl33ObjectBuffer::Texel>& texels) const {
+	for(size_t i = 0; i < count; ++i){
+		texels.push_back({pos_x[i], pos_y[i], size[i], layer});
+		texels.push_back({colour_r[i], colour_g[i], colour_b[i], colour_a[i]});
+	}
+}
+}
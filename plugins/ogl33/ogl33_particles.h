@@ -0,0 +1,66 @@
+#pragma once
+
+#include "render/render.h"
+
+#include "ogl33_buffer.h"
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace gin {
+/**
+* Particles of one emitter, stored as separate arrays per attribute so the simulation can
+* process eight (AVX2) or four (SSE) particles at once. The arrays are padded to a multiple
+* of eight, so the vector loops never need a scalar tail.
+*
+* Simulation only touches the emitter itself, so different emitters can be simulated in parallel.
+*/
+class Ogl33ParticleEmitter {
+private:
+	ParticleEmitterParameters parameters;
+	TextureId texture_id;
+
+	std::minstd_rand random;
+	float spawn_accumulator = 0.f;
+
+	size_t count = 0;
+	std::vector<float> pos_x;
+	std::vector<float> pos_y;
+	std::vector<float> vel_x;
+	std::vector<float> vel_y;
+	std::vector<float> age;
+	std::vector<float> inv_lifetime;
+	// Normalized life, age * inv_lifetime
+	std::vector<float> life;
+	std::vector<float> size;
+	std::vector<float> colour_r;
+	std::vector<float> colour_g;
+	std::vector<float> colour_b;
+	std::vector<float> colour_a;
+
+	void reserve(size_t capacity);
+	void spawn(size_t n);
+	void integrate(float dt);
+	void removeDead();
+	void evaluateColours();
+public:
+	Ogl33ParticleEmitter(const TextureId& texture, const ParticleEmitterParameters& parameters, uint32_t seed);
+
+	std::array<float, 2> position = {{0.f, 0.f}};
+	float layer = 0.f;
+	// Inactive emitters don't spawn, but existing particles live on
+	bool active = true;
+
+	/// Particles beyond the new maximum are dropped
+	void setParameters(const ParticleEmitterParameters&);
+	const TextureId& texture() const;
+
+	void simulate(float dt);
+
+	size_t particleCount() const;
+	/// Two texels per particle: position, size and layer, then the colour
+	void write(std::vector<Ogl33ObjectBuffer::Texel>& texels) const;
+};
+}
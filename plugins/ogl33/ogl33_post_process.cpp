@@ -0,0 +1,234 @@
+#include "ogl33_render.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gin {
+namespace {
+size_t scaledSize(size_t size, float scale){
+	return std::max<size_t>(1, static_cast<size_t>(std::lround(size * scale)));
+}
+}
+
+Ogl33PostProgram::Ogl33PostProgram(GLuint p_id):
+	program_id{p_id},
+	source_uniform{-1},
+	texel_size_uniform{-1},
+	direction_uniform{-1}
+{
+	if(program_id == 0){
+		return;
+	}
+
+	source_uniform = glGetUniformLocation(program_id, "source");
+	texel_size_uniform = glGetUniformLocation(program_id, "texel_size");
+	direction_uniform = glGetUniformLocation(program_id, "direction");
+}
+
+Ogl33PostProgram::~Ogl33PostProgram(){
+	if(program_id > 0){
+		glDeleteProgram(program_id);
+	}
+}
+
+Ogl33PostProgram::Ogl33PostProgram(Ogl33PostProgram&& rhs):
+	program_id{rhs.program_id},
+	source_uniform{rhs.source_uniform},
+	texel_size_uniform{rhs.texel_size_uniform},
+	direction_uniform{rhs.direction_uniform}
+{
+	rhs.program_id = 0;
+	rhs.source_uniform = -1;
+	rhs.texel_size_uniform = -1;
+	rhs.direction_uniform = -1;
+}
+
+void Ogl33PostProgram::use(){
+	glUseProgram(program_id);
+}
+
+void Ogl33PostProgram::setSource(GLuint texture, size_t width, size_t height){
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glUniform1i(source_uniform, 0);
+	glUniform2f(texel_size_uniform, 1.f / static_cast<float>(width), 1.f / static_cast<float>(height));
+}
+
+void Ogl33PostProgram::setDirection(const std::array<float, 2>& direction){
+	glUniform2f(direction_uniform, direction[0], direction[1]);
+}
+
+Ogl33PostStage::Ogl33PostStage(const RenderTextureId& input, const RenderTargetId& output):
+	input_id{input},
+	target_id{output}
+{}
+
+Ogl33PostStage::~Ogl33PostStage(){
+	if(!queries.empty()){
+		glDeleteQueries(queries.size(), queries.data());
+	}
+	if(vertex_array > 0){
+		glDeleteVertexArrays(1, &vertex_array);
+	}
+}
+
+Ogl33PostStage::Ogl33PostStage(Ogl33PostStage&& rhs):
+	images{std::move(rhs.images)},
+	images_width{rhs.images_width},
+	images_height{rhs.images_height},
+	vertex_array{rhs.vertex_array},
+	queries{std::move(rhs.queries)},
+	pending_queries{std::move(rhs.pending_queries)},
+	input_id{rhs.input_id},
+	target_id{rhs.target_id},
+	passes{std::move(rhs.passes)},
+	statistics{std::move(rhs.statistics)}
+{
+	rhs.vertex_array = 0;
+	rhs.queries.clear();
+}
+
+size_t Ogl33PostStage::acquireImage(size_t width, size_t height, size_t avoid){
+	for(size_t i = 0; i < images.size(); ++i){
+		if(i != avoid && images[i].width() == width && images[i].height() == height){
+			return i;
+		}
+	}
+
+	ErrorOr<Ogl33RenderImage> image = createOgl33RenderImage(width, height, false);
+	if(image.isError()){
+		return SIZE_MAX;
+	}
+
+	try{
+		images.push_back(std::move(image.value()));
+	}catch(const std::bad_alloc&){
+		return SIZE_MAX;
+	}
+	return images.size() - 1;
+}
+
+bool Ogl33PostStage::beginQuery(size_t pass){
+	if(pass >= queries.size() || queries[pass] == 0){
+		return false;
+	}
+
+	if(pending_queries[pass]){
+		GLint available = 0;
+		glGetQueryObjectiv(queries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+		// Waiting for it would stall until the GPU caught up
+		if(!available){
+			return false;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[pass], GL_QUERY_RESULT, &elapsed);
+		if(pass < statistics.pass_milliseconds.size()){
+			statistics.pass_milliseconds[pass] = static_cast<float>(elapsed) / 1e6f;
+		}
+		pending_queries[pass] = 0;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[pass]);
+	pending_queries[pass] = 1;
+	return true;
+}
+
+void Ogl33PostStage::render(Ogl33Render& render){
+	Ogl33Resources& resources = render.getResources();
+	if(passes.empty() || !resources.render_targets.exists(target_id)){
+		return;
+	}
+	Ogl33RenderTarget* target = resources.render_targets[target_id];
+
+	Ogl33RenderTexture* input = resources.render_targets.getRenderTexture(input_id);
+	if(!input || !input->currentImage()){
+		return;
+	}
+
+	size_t output_width = target->width();
+	size_t output_height = target->height();
+	if(output_width != images_width || output_height != images_height){
+		images.clear();
+		images_width = output_width;
+		images_height = output_height;
+	}
+
+	if(queries.size() < passes.size()){
+		size_t old_size = queries.size();
+		try{
+			pending_queries.resize(passes.size(), 0);
+			queries.resize(passes.size(), 0);
+		}catch(const std::bad_alloc&){
+			return;
+		}
+		glGenQueries(passes.size() - old_size, &queries[old_size]);
+	}
+
+	if(vertex_array == 0){
+		glGenVertexArrays(1, &vertex_array);
+	}
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glBindVertexArray(vertex_array);
+
+	GLuint source = input->currentImage()->colourTexture();
+	size_t source_width = input->width();
+	size_t source_height = input->height();
+	size_t source_image = SIZE_MAX;
+	bool output_bound = false;
+
+	for(size_t i = 0; i < passes.size(); ++i){
+		Ogl33PostProgram* program = render.getPostProgram(passes[i].program);
+		if(!program){
+			continue;
+		}
+
+		size_t width = output_width;
+		size_t height = output_height;
+		size_t image = SIZE_MAX;
+		if(i + 1 == passes.size()){
+			target->bind();
+			output_bound = true;
+		}else{
+			width = scaledSize(output_width, passes[i].scale);
+			height = scaledSize(output_height, passes[i].scale);
+			// Never the one which is read
+			image = acquireImage(width, height, source_image);
+			if(image == SIZE_MAX){
+				break;
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, images[image].framebufferId());
+		}
+		glViewport(0, 0, width, height);
+
+		bool timed = beginQuery(i);
+
+		program->use();
+		program->setSource(source, source_width, source_height);
+		program->setDirection(passes[i].direction);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		if(timed){
+			glEndQuery(GL_TIME_ELAPSED);
+		}
+
+		if(image != SIZE_MAX){
+			source = images[image].colourTexture();
+			source_width = width;
+			source_height = height;
+			source_image = image;
+		}
+	}
+
+	if(!output_bound){
+		target->bind();
+		glViewport(0, 0, output_width, output_height);
+	}
+
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+}
+}
@@ -3,6 +3,11 @@
 #include "ogl33_bindings.h"
 
 #include "common/math.h"
+#include "render/render.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
 
 namespace gin {
 class Ogl33Texture;
@@ -11,40 +16,83 @@ class Ogl33Program3d {
 private:
 	GLuint program_id;
 
-	GLuint texture_uniform;
-	GLuint mvp_uniform;
+	GLint texture_uniform;
+	GLint object_data_uniform;
+	GLint object_offset_uniform;
 public:
 	Ogl33Program3d();
-	Ogl33Program3d(GLuint program, GLuint texture, GLuint mvp);
+	/// Looks up the uniforms and binds the FrameData block
+	Ogl33Program3d(GLuint program);
 	~Ogl33Program3d();
 
+	Ogl33Program3d(Ogl33Program3d&&);
+
 	void setTexture(const Ogl33Texture& texture_id);
-	void setMvp(const Matrix<float, 4, 4>& mvp);
 	void setMesh(const Ogl33Mesh3d& mesh_id);
+	/// Index of the first object in the object buffer for the next draw
+	void setObjectOffset(GLint);
 
 	void use();
 };
 
+/**
+* Program which was handed to the driver for compiling and linking, but whose status
+* wasn't queried yet. Querying it earlier would block until the driver is done.
+*/
+class Ogl33PendingProgram {
+public:
+	GLuint program_id = 0;
+	GLuint vertex_shader = 0;
+	GLuint fragment_shader = 0;
+
+	uint64_t cache_key = 0;
+	std::chrono::steady_clock::time_point begin;
+
+	Ogl33PendingProgram() = default;
+	~Ogl33PendingProgram();
+
+	Ogl33PendingProgram(Ogl33PendingProgram&&);
+	Ogl33PendingProgram& operator=(Ogl33PendingProgram&&) = delete;
+
+	/// Always true without GL_KHR_parallel_shader_compile
+	bool isReady() const;
+};
+
 class Ogl33Mesh;
 class Ogl33Program {
 private:
 	GLuint program_id;
 
-	GLuint texture_uniform;
-	GLuint mvp_uniform;
-	GLuint layer_uniform;
+	GLint texture_uniform;
+	GLint object_data_uniform;
+	GLint object_slots_uniform;
+	GLint object_offset_uniform;
+	GLint tint_uniform;
+	GLint flipbook_frames_uniform;
+	GLint flipbook_fps_uniform;
+	GLint flipbook_loop_uniform;
+	GLint flipbook_rects_uniform;
+
+	std::array<float, 4> tint;
+
+	ProgramFeatures program_features;
 public:
 	Ogl33Program();
-	Ogl33Program(GLuint, GLuint, GLuint, GLuint);
+	/// Looks up the uniforms and binds the FrameData block
+	Ogl33Program(GLuint, ProgramFeatures features = 0);
 	~Ogl33Program();
 
 	Ogl33Program(Ogl33Program&&);
 
 	void setTexture(const Ogl33Texture&);
-	void setMvp(const Matrix<float,3,3>&);
 	void setMesh(const Ogl33Mesh&);
-	void setLayer(float);
-	void setLayer(int16_t);
+	/// Index of the first object in the object buffer for the next draw
+	void setObjectOffset(GLint);
+	void setTint(const std::array<float, 4>&);
+	/// Frames of the next draws, nullptr for plain objects
+	void setFlipbook(const FlipbookData*);
+
+	ProgramFeatures features() const;
 
 	void use();
 };
@@ -0,0 +1,240 @@
+#include "ogl33_program_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace gin {
+namespace {
+const char program_cache_magic[4] = {'K','G','P','B'};
+
+struct ProgramCacheHeader {
+	char magic[4];
+	uint32_t format;
+	uint64_t key;
+	uint64_t length;
+};
+
+uint64_t fnv1a(uint64_t hash, const std::string& data){
+	for(unsigned char c : data){
+		hash ^= c;
+		hash *= 0x100000001b3ull;
+	}
+	// Separate the inputs, so "ab"+"c" and "a"+"bc" differ
+	hash ^= 0xff;
+	hash *= 0x100000001b3ull;
+	return hash;
+}
+
+std::string glString(GLenum name){
+	const GLubyte* str = glGetString(name);
+	if(!str){
+		return {};
+	}
+	return std::string{reinterpret_cast<const char*>(str)};
+}
+
+std::filesystem::path defaultCacheDirectory(){
+	const char* xdg = std::getenv("XDG_CACHE_HOME");
+	if(xdg && xdg[0] != '\0'){
+		return std::filesystem::path{xdg} / "kelgin-graphics";
+	}
+	const char* home = std::getenv("HOME");
+	if(home && home[0] != '\0'){
+		return std::filesystem::path{home} / ".cache" / "kelgin-graphics";
+	}
+	return {};
+}
+
+float milliseconds(const std::chrono::steady_clock::duration& d){
+	return std::chrono::duration<float, std::milli>(d).count();
+}
+}
+
+Ogl33ProgramCache::Ogl33ProgramCache():
+	directory{defaultCacheDirectory()}
+{}
+
+void Ogl33ProgramCache::setDirectory(const std::filesystem::path& dir){
+	directory = dir;
+}
+
+bool Ogl33ProgramCache::enabled() const {
+	if(directory.empty() || !GLAD_GL_ARB_get_program_binary){
+		return false;
+	}
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+std::filesystem::path Ogl33ProgramCache::entryPath(uint64_t key) const {
+	std::stringstream name;
+	name<<std::hex<<key<<".bin";
+	return directory / name.str();
+}
+
+uint64_t Ogl33ProgramCache::key(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	if(driver.empty()){
+		try{
+			driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+		}catch(const std::bad_alloc&){
+			// Without the driver a binary could be handed to another driver
+			return no_key;
+		}
+	}
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = fnv1a(hash, vertex_src);
+	hash = fnv1a(hash, fragment_src);
+	hash = fnv1a(hash, driver);
+	return hash;
+}
+
+GLuint Ogl33ProgramCache::load(uint64_t key) noexcept {
+	try{
+		return loadEntry(key);
+	}catch(const std::bad_alloc&){
+		return 0;
+	}
+}
+
+GLuint Ogl33ProgramCache::loadEntry(uint64_t key){
+	if(key == no_key || !enabled()){
+		return 0;
+	}
+
+	std::filesystem::path path = entryPath(key);
+	std::ifstream file{path, std::ios::binary};
+	if(!file){
+		return 0;
+	}
+
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	if(file.read(reinterpret_cast<char*>(&header), sizeof(header))
+		&& std::memcmp(header.magic, program_cache_magic, sizeof(header.magic)) == 0
+		&& header.key == key
+		&& header.length > 0 && header.length < (1u << 30)){
+		binary.resize(header.length);
+		if(!file.read(binary.data(), binary.size())){
+			binary.clear();
+		}
+	}
+	file.close();
+
+	std::error_code ec;
+	if(binary.empty()){
+		std::filesystem::remove(path, ec);
+		return 0;
+	}
+
+	GLuint p_id = glCreateProgram();
+	if(p_id == 0){
+		return 0;
+	}
+
+	glProgramBinary(p_id, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	GLint result = GL_FALSE;
+	glGetProgramiv(p_id, GL_LINK_STATUS, &result);
+	if(result == GL_FALSE){
+		// Usually a driver update. The entry will be rewritten after compiling.
+		glDeleteProgram(p_id);
+		std::filesystem::remove(path, ec);
+		return 0;
+	}
+
+	return p_id;
+}
+
+void Ogl33ProgramCache::store(uint64_t key, GLuint program) noexcept {
+	try{
+		storeEntry(key, program);
+	}catch(const std::bad_alloc&){
+		// The next run compiles again
+	}
+}
+
+void Ogl33ProgramCache::storeEntry(uint64_t key, GLuint program){
+	if(key == no_key || !enabled()){
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0){
+		return;
+	}
+
+	std::vector<char> binary;
+	binary.resize(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	if(written <= 0){
+		return;
+	}
+
+	ProgramCacheHeader header;
+	std::memcpy(header.magic, program_cache_magic, sizeof(header.magic));
+	header.format = format;
+	header.key = key;
+	header.length = static_cast<uint64_t>(written);
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if(ec){
+		return;
+	}
+
+	/**
+	* Write next to the final entry and rename it afterwards, so concurrently started
+	* processes never see a partially written file.
+	*/
+	std::filesystem::path path = entryPath(key);
+	std::filesystem::path tmp_path = path;
+	tmp_path += ".tmp" + std::to_string(std::random_device{}());
+	{
+		std::ofstream file{tmp_path, std::ios::binary | std::ios::trunc};
+		if(!file){
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), written);
+		if(!file){
+			file.close();
+			std::filesystem::remove(tmp_path, ec);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tmp_path, path, ec);
+	if(ec){
+		std::filesystem::remove(tmp_path, ec);
+	}
+}
+
+void Ogl33ProgramCache::recordCompile(const std::chrono::steady_clock::duration& d){
+	++compiled_programs;
+	compile_time += d;
+}
+
+void Ogl33ProgramCache::recordCacheHit(const std::chrono::steady_clock::duration& d){
+	++cached_programs;
+	cache_time += d;
+}
+
+RenderProgramStatistics Ogl33ProgramCache::statistics() const {
+	RenderProgramStatistics stats;
+	stats.compiled_programs = compiled_programs;
+	stats.compile_milliseconds = milliseconds(compile_time);
+	stats.cached_programs = cached_programs;
+	stats.cache_milliseconds = milliseconds(cache_time);
+	return stats;
+}
+}
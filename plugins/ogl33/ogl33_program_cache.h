@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ogl33_bindings.h"
+
+#include "render/render.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace gin {
+/**
+* Stores linked program binaries on disk, so that later runs can skip compiling and linking.
+* Entries are keyed by a hash of the shader sources and the driver's vendor, renderer and version strings.
+* Drivers are free to reject a binary anyway, in which case the caller compiles from source again.
+*/
+class Ogl33ProgramCache {
+private:
+	std::filesystem::path directory;
+	std::string driver;
+
+	size_t compiled_programs = 0;
+	size_t cached_programs = 0;
+	std::chrono::steady_clock::duration compile_time{0};
+	std::chrono::steady_clock::duration cache_time{0};
+
+	std::filesystem::path entryPath(uint64_t key) const;
+	GLuint loadEntry(uint64_t key);
+	void storeEntry(uint64_t key, GLuint program);
+public:
+	Ogl33ProgramCache();
+
+	void setDirectory(const std::filesystem::path& dir);
+
+	/// Requires GL_ARB_get_program_binary and a configured directory
+	bool enabled() const;
+
+	/// Never caches programs under this key
+	static constexpr uint64_t no_key = 0;
+	uint64_t key(const std::string& vertex_src, const std::string& fragment_src) noexcept;
+
+	/**
+	* Returns a linked program or 0 if there is no usable entry.
+	* Rejected entries are removed.
+	*/
+	GLuint load(uint64_t key) noexcept;
+	/// Failing to store only costs a compile in the next run
+	void store(uint64_t key, GLuint program) noexcept;
+
+	void recordCompile(const std::chrono::steady_clock::duration&);
+	void recordCacheHit(const std::chrono::steady_clock::duration&);
+
+	RenderProgramStatistics statistics() const;
+};
+}
@@ -1,7 +1,11 @@
 #include "ogl33_render.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cassert>
+#include <limits>
+#include <tuple>
 
 namespace gin {
 namespace {
@@ -44,6 +48,16 @@ void Ogl33Camera::setOrtho(float left, float right, float bottom, float top){
 }
 
 void Ogl33Camera::updateState(float relative_tp){
+	if(old_position == position && old_angle == angle){
+		return;
+	}
+
+	if(relative_tp >= 1.f){
+		old_position = position;
+		old_angle = angle;
+		return;
+	}
+
 	old_position[0] = position[0] * relative_tp + old_position[0] * ( 1.f - relative_tp);
 	old_position[1] = position[1] * relative_tp + old_position[1] * ( 1.f - relative_tp);
 
@@ -84,25 +98,112 @@ const Matrix<float, 3,3>& Ogl33Camera::projection() const {
 	return projection_matrix;
 }
 
+std::array<float, 4> Ogl33Camera::visibleBounds(float interpol) const {
+	Matrix<float, 3, 3> vp = projection_matrix * view(interpol);
+
+	// Maps the corners of normalized device coordinates back into the scene
+	float det = vp(0,0) * vp(1,1) - vp(0,1) * vp(1,0);
+	if(std::abs(det) < 1e-12f){
+		return {{0.f, 0.f, 0.f, 0.f}};
+	}
+
+	std::array<float, 4> bounds = {{
+		std::numeric_limits<float>::max(),
+		std::numeric_limits<float>::max(),
+		std::numeric_limits<float>::lowest(),
+		std::numeric_limits<float>::lowest()
+	}};
+	for(float x : {-1.f, 1.f}){
+		for(float y : {-1.f, 1.f}){
+			float dx = x - vp(0,2);
+			float dy = y - vp(1,2);
+			float wx = ( vp(1,1) * dx - vp(0,1) * dy) / det;
+			float wy = (-vp(1,0) * dx + vp(0,0) * dy) / det;
+
+			bounds[0] = std::min(bounds[0], wx);
+			bounds[1] = std::min(bounds[1], wy);
+			bounds[2] = std::max(bounds[2], wx);
+			bounds[3] = std::max(bounds[3], wy);
+		}
+	}
+	return bounds;
+}
+
 Ogl33Camera3d::Ogl33Camera3d(){
 	for(size_t i = 0; i < 4; ++i){
 		projection_matrix(i,i) = 1.0f;
 		view_matrix(i,i) = 1.0f;
 	}
+	updateViewProjection();
+}
+
+void Ogl33Camera3d::updateView(){
+	// Inverse of the camera transform, so the transposed rotation applied to the negated position
+	Matrix<float, 3, 3> rot = orientation.toMatrix3();
+	for(size_t i = 0; i < 3; ++i){
+		float translation = 0.f;
+		for(size_t j = 0; j < 3; ++j){
+			view_matrix(i,j) = rot(j,i);
+			translation -= rot(j,i) * position[j];
+		}
+		view_matrix(i,3) = translation;
+	}
+	updateViewProjection();
+}
+
+void Ogl33Camera3d::updateViewProjection(){
+	view_projection_matrix = projection_matrix * view_matrix;
+	frustum_planes = Ogl33Frustum::fromMatrix(view_projection_matrix, reversed_depth);
 }
 
 void Ogl33Camera3d::setOrtho(float left, float right, float top, float bottom, float near, float far){
-	/// @todo set orthographic projection
+	projection_matrix = Matrix<float, 4, 4>{};
+	projection_matrix(0,0) = 2.f / (right - left);
+	projection_matrix(1,1) = 2.f / (top - bottom);
+	projection_matrix(2,2) = -2.f / (far - near);
+	projection_matrix(0,3) = -(right + left) / (right - left);
+	projection_matrix(1,3) = -(top + bottom) / (top - bottom);
+	projection_matrix(2,3) = -(far + near) / (far - near);
+	projection_matrix(3,3) = 1.f;
+	reversed_depth = false;
+	perspective = false;
+	updateViewProjection();
+}
+
+void Ogl33Camera3d::setPerspective(float fov_y, float aspect, float near, float far, bool reverse_depth){
+	float f = 1.f / std::tan(fov_y * 0.5f);
+	bool infinite = !(far > 0.f) || std::isinf(far);
+
+	projection_matrix = Matrix<float, 4, 4>{};
+	projection_matrix(0,0) = f / aspect;
+	projection_matrix(1,1) = f;
+	projection_matrix(3,2) = -1.f;
+	if(reverse_depth){
+		// Clip depth n at the near plane and 0 at the far plane, divided by w = -z
+		projection_matrix(2,2) = infinite ? 0.f : near / (far - near);
+		projection_matrix(2,3) = infinite ? near : far * near / (far - near);
+	}else{
+		projection_matrix(2,2) = infinite ? -1.f : -(far + near) / (far - near);
+		projection_matrix(2,3) = infinite ? -2.f * near : -2.f * far * near / (far - near);
+	}
+	reversed_depth = reverse_depth;
+	perspective = true;
+	updateViewProjection();
 }
 
 void Ogl33Camera3d::setViewPosition(float x, float y, float z){
-	view_matrix(0, 3) = -x;
-	view_matrix(1, 3) = -y;
-	view_matrix(2, 3) = -z;
+	position = {{x, y, z}};
+	updateView();
 }
 
 void Ogl33Camera3d::setViewRotation(float alpha, float beta, float gamma){
-	/// @todo set rotation matrix in [0-2]x[0-2]
+	orientation = Quaternion<float>::fromEuler(alpha, beta, gamma);
+	updateView();
+}
+
+void Ogl33Camera3d::setViewOrientation(float x, float y, float z, float w){
+	orientation = Quaternion<float>{x, y, z, w}.normalized();
+	updateView();
 }
 
 const Matrix<float, 4, 4>& Ogl33Camera3d::projection() const {
@@ -113,6 +214,22 @@ const Matrix<float, 4, 4>& Ogl33Camera3d::view() const {
 	return view_matrix;
 }
 
+const Matrix<float, 4, 4>& Ogl33Camera3d::viewProjection() const {
+	return view_projection_matrix;
+}
+
+const Ogl33Frustum& Ogl33Camera3d::frustum() const {
+	return frustum_planes;
+}
+
+bool Ogl33Camera3d::reversedDepth() const {
+	return reversed_depth;
+}
+
+bool Ogl33Camera3d::isPerspective() const {
+	return perspective;
+}
+
 Ogl33Viewport::Ogl33Viewport(float x, float y, float width, float height):
 	x{x},
 	y{y},
@@ -128,18 +245,20 @@ Ogl33Texture::Ogl33Texture():
 	Ogl33Texture(0)
 {}
 
-Ogl33Texture::Ogl33Texture(GLuint tex_id):
-	tex_id{tex_id}
+Ogl33Texture::Ogl33Texture(GLuint tex_id, bool owned):
+	tex_id{tex_id},
+	owned{owned}
 {}
 
 Ogl33Texture::~Ogl33Texture(){
-	if(tex_id > 0){
+	if(owned && tex_id > 0){
 		glDeleteTextures(1, &tex_id);
 	}
 }
 
 Ogl33Texture::Ogl33Texture(Ogl33Texture&& rhs):
-	tex_id{rhs.tex_id}
+	tex_id{rhs.tex_id},
+	owned{rhs.owned}
 {
 	rhs.tex_id = 0;
 }
@@ -148,16 +267,82 @@ void Ogl33Texture::bind() const{
 	glBindTexture(GL_TEXTURE_2D, tex_id);
 }
 
-Ogl33Program::Ogl33Program(GLuint p_id, GLuint tex_id, GLuint mvp_id, GLuint layer_id):
+void Ogl33Texture::alias(GLuint id){
+	assert(!owned);
+	if(!owned){
+		tex_id = id;
+	}
+}
+
+Ogl33PendingProgram::~Ogl33PendingProgram(){
+	if(vertex_shader > 0){
+		glDeleteShader(vertex_shader);
+	}
+	if(fragment_shader > 0){
+		glDeleteShader(fragment_shader);
+	}
+	if(program_id > 0){
+		glDeleteProgram(program_id);
+	}
+}
+
+Ogl33PendingProgram::Ogl33PendingProgram(Ogl33PendingProgram&& rhs):
+	program_id{rhs.program_id},
+	vertex_shader{rhs.vertex_shader},
+	fragment_shader{rhs.fragment_shader},
+	cache_key{rhs.cache_key},
+	begin{rhs.begin}
+{
+	rhs.program_id = 0;
+	rhs.vertex_shader = 0;
+	rhs.fragment_shader = 0;
+}
+
+bool Ogl33PendingProgram::isReady() const {
+	if(!GLAD_GL_KHR_parallel_shader_compile){
+		return true;
+	}
+	GLint done = GL_FALSE;
+	glGetProgramiv(program_id, GL_COMPLETION_STATUS_KHR, &done);
+	return done != GL_FALSE;
+}
+
+Ogl33Program::Ogl33Program(GLuint p_id, ProgramFeatures features):
 	program_id{p_id},
-	texture_uniform{tex_id},
-	mvp_uniform{mvp_id},
-	layer_uniform{layer_id}
+	texture_uniform{-1},
+	object_data_uniform{-1},
+	object_slots_uniform{-1},
+	object_offset_uniform{-1},
+	tint_uniform{-1},
+	flipbook_frames_uniform{-1},
+	flipbook_fps_uniform{-1},
+	flipbook_loop_uniform{-1},
+	flipbook_rects_uniform{-1},
+	tint{1.f, 1.f, 1.f, 1.f},
+	program_features{features}
 {
+	if(program_id == 0){
+		return;
+	}
+
+	texture_uniform = glGetUniformLocation(program_id, "texture_sampler");
+	object_data_uniform = glGetUniformLocation(program_id, "object_data");
+	object_slots_uniform = glGetUniformLocation(program_id, "object_slots");
+	object_offset_uniform = glGetUniformLocation(program_id, "object_offset");
+	tint_uniform = glGetUniformLocation(program_id, "tint");
+	flipbook_frames_uniform = glGetUniformLocation(program_id, "flipbook_frames");
+	flipbook_fps_uniform = glGetUniformLocation(program_id, "flipbook_fps");
+	flipbook_loop_uniform = glGetUniformLocation(program_id, "flipbook_loop");
+	flipbook_rects_uniform = glGetUniformLocation(program_id, "flipbook_rects");
+
+	GLuint frame_index = glGetUniformBlockIndex(program_id, "FrameData");
+	if(frame_index != GL_INVALID_INDEX){
+		glUniformBlockBinding(program_id, frame_index, ogl33_frame_data_binding);
+	}
 }
 
 Ogl33Program::Ogl33Program():
-	Ogl33Program(0,0,0,0)
+	Ogl33Program(0)
 {}
 
 Ogl33Program::~Ogl33Program(){
@@ -169,49 +354,223 @@ Ogl33Program::~Ogl33Program(){
 Ogl33Program::Ogl33Program(Ogl33Program&& rhs):
 	program_id{rhs.program_id},
 	texture_uniform{rhs.texture_uniform},
-	mvp_uniform{rhs.mvp_uniform},
-	layer_uniform{rhs.layer_uniform}
+	object_data_uniform{rhs.object_data_uniform},
+	object_slots_uniform{rhs.object_slots_uniform},
+	object_offset_uniform{rhs.object_offset_uniform},
+	tint_uniform{rhs.tint_uniform},
+	flipbook_frames_uniform{rhs.flipbook_frames_uniform},
+	flipbook_fps_uniform{rhs.flipbook_fps_uniform},
+	flipbook_loop_uniform{rhs.flipbook_loop_uniform},
+	flipbook_rects_uniform{rhs.flipbook_rects_uniform},
+	tint{rhs.tint},
+	program_features{rhs.program_features}
 {
 	rhs.program_id = 0;
-	rhs.texture_uniform = 0;
-	rhs.mvp_uniform = 0;
-	rhs.layer_uniform = 0;
+	rhs.texture_uniform = -1;
+	rhs.object_data_uniform = -1;
+	rhs.object_slots_uniform = -1;
+	rhs.object_offset_uniform = -1;
+	rhs.tint_uniform = -1;
+	rhs.flipbook_frames_uniform = -1;
+	rhs.flipbook_fps_uniform = -1;
+	rhs.flipbook_loop_uniform = -1;
+	rhs.flipbook_rects_uniform = -1;
 }
 
 void Ogl33Program::setTexture(const Ogl33Texture& tex){
 	tex.bind();
 }
 
-void Ogl33Program::setMvp(const Matrix<float,3,3>& mvp){
-	glUniformMatrix3fv(mvp_uniform, 1, GL_TRUE, &mvp(0, 0));
-}
-
 void Ogl33Program::setMesh(const Ogl33Mesh& mesh){
 	mesh.bindVertexArray();
 }
 
-void Ogl33Program::setLayer(float layer){
-	glUniform1f(layer_uniform, layer);
+void Ogl33Program::setObjectOffset(GLint offset){
+	glUniform1i(object_offset_uniform, offset);
+}
+
+void Ogl33Program::setTint(const std::array<float, 4>& colour){
+	tint = colour;
+}
+
+void Ogl33Program::setFlipbook(const FlipbookData* flipbook){
+	if(flipbook_frames_uniform < 0){
+		return;
+	}
+	if(!flipbook || flipbook->frames.empty()){
+		glUniform1i(flipbook_frames_uniform, 0);
+		return;
+	}
+
+	GLsizei frames = static_cast<GLsizei>(std::min(flipbook->frames.size(), ogl33_max_flipbook_frames));
+	glUniform1i(flipbook_frames_uniform, frames);
+	glUniform1f(flipbook_fps_uniform, flipbook->fps);
+	glUniform1i(flipbook_loop_uniform, flipbook->loop ? 1 : 0);
+	glUniform4fv(flipbook_rects_uniform, frames, flipbook->frames.front().data());
 }
 
-void Ogl33Program::setLayer(int16_t layer){
-	setLayer(static_cast<float>(layer) / INT16_MAX);
+ProgramFeatures Ogl33Program::features() const {
+	return program_features;
 }
 
 void Ogl33Program::use(){
 	glUseProgram(program_id);
 	glActiveTexture(GL_TEXTURE0);
 	glUniform1i(texture_uniform, 0);
+	glUniform1i(object_data_uniform, ogl33_object_data_unit);
+	if(object_slots_uniform >= 0){
+		glUniform1i(object_slots_uniform, ogl33_object_slots_unit);
+	}
+	if(tint_uniform >= 0){
+		glUniform4fv(tint_uniform, 1, tint.data());
+	}
+	if(flipbook_frames_uniform >= 0){
+		glUniform1i(flipbook_frames_uniform, 0);
+	}
+}
+
+Ogl33Program3d::Ogl33Program3d(GLuint p_id):
+	program_id{p_id},
+	texture_uniform{-1},
+	object_data_uniform{-1},
+	object_offset_uniform{-1}
+{
+	if(program_id == 0){
+		return;
+	}
+
+	texture_uniform = glGetUniformLocation(program_id, "texture_sampler");
+	object_data_uniform = glGetUniformLocation(program_id, "object_data");
+	object_offset_uniform = glGetUniformLocation(program_id, "object_offset");
+
+	GLuint frame_index = glGetUniformBlockIndex(program_id, "FrameData");
+	if(frame_index != GL_INVALID_INDEX){
+		glUniformBlockBinding(program_id, frame_index, ogl33_frame_data_binding);
+	}
+}
+
+Ogl33Program3d::Ogl33Program3d():
+	Ogl33Program3d(0)
+{}
+
+Ogl33Program3d::~Ogl33Program3d(){
+	if(program_id > 0){
+		glDeleteProgram(program_id);
+	}
+}
+
+Ogl33Program3d::Ogl33Program3d(Ogl33Program3d&& rhs):
+	program_id{rhs.program_id},
+	texture_uniform{rhs.texture_uniform},
+	object_data_uniform{rhs.object_data_uniform},
+	object_offset_uniform{rhs.object_offset_uniform}
+{
+	rhs.program_id = 0;
+	rhs.texture_uniform = -1;
+	rhs.object_data_uniform = -1;
+	rhs.object_offset_uniform = -1;
+}
+
+void Ogl33Program3d::setTexture(const Ogl33Texture& tex){
+	tex.bind();
+}
+
+void Ogl33Program3d::setMesh(const Ogl33Mesh3d& mesh){
+	mesh.bindVertexArray();
+}
+
+void Ogl33Program3d::setObjectOffset(GLint offset){
+	glUniform1i(object_offset_uniform, offset);
+}
+
+void Ogl33Program3d::use(){
+	glUseProgram(program_id);
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(texture_uniform, 0);
+	glUniform1i(object_data_uniform, ogl33_object_data_unit);
 }
 
 void Ogl33RenderTarget::setClearColour(const std::array<float,4>& colour){
 	clear_colour = colour;
 }
 
+void Ogl33RenderTarget::clear(bool reverse_depth){
+	glClearColor(clear_colour[0], clear_colour[1], clear_colour[2], clear_colour[3]);
+	glClearDepth(reverse_depth ? 0.0 : 1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1.0);
+	reversed_depth = reverse_depth;
+}
+
+void Ogl33RenderTarget::useReversedDepth(bool reverse_depth){
+	if(reversed_depth == reverse_depth){
+		return;
+	}
+	// Depth of the earlier stages can't be compared in the other convention anyway
+	glClearDepth(reverse_depth ? 0.0 : 1.0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1.0);
+	reversed_depth = reverse_depth;
+}
+
+namespace {
+/// State every target starts its stages with
+void beginOgl33Target(GLuint framebuffer, size_t width, size_t height){
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	glFrontFace(GL_CCW);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+}
+
 Ogl33Window::Ogl33Window(Own<GlWindow>&& win):
 	window{std::move(win)}
 {}
 
+Ogl33Window::~Ogl33Window(){
+	if(frame_fence){
+		glDeleteSync(frame_fence);
+	}
+}
+
+Ogl33Window::Ogl33Window(Ogl33Window&& rhs):
+	Ogl33RenderTarget{std::move(rhs)},
+	window{std::move(rhs.window)},
+	independent_present{rhs.independent_present},
+	frame_fence{rhs.frame_fence}
+{
+	rhs.frame_fence = nullptr;
+}
+
+void Ogl33Window::setIndependentPresent(bool independent){
+	independent_present = independent;
+	if(!independent && frame_fence){
+		glDeleteSync(frame_fence);
+		frame_fence = nullptr;
+	}
+}
+
+bool Ogl33Window::framePending(){
+	if(!frame_fence){
+		return false;
+	}
+
+	// Never waits, only asks
+	GLenum status = glClientWaitSync(frame_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if(status == GL_TIMEOUT_EXPIRED){
+		return true;
+	}
+
+	glDeleteSync(frame_fence);
+	frame_fence = nullptr;
+	return false;
+}
+
 void Ogl33Window::show(){
 	if(window){
 		window->bind();
@@ -267,17 +626,7 @@ void Ogl33Window::beginRender(){
 	}
 	window->bind();
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CCW);
-
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0,0,width(),height());
-	glClearColor(clear_colour[0], clear_colour[1], clear_colour[2], clear_colour[3]);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	beginOgl33Target(0, width(), height());
 }
 
 void Ogl33Window::endRender(){
@@ -287,6 +636,13 @@ void Ogl33Window::endRender(){
 	}
 
 	window->swap();
+
+	if(independent_present){
+		if(frame_fence){
+			glDeleteSync(frame_fence);
+		}
+		frame_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
 }
 
 void Ogl33Window::bindAsMain(){
@@ -320,27 +676,120 @@ size_t Ogl33Window::height() const {
 	return mode.height;
 }
 
+Ogl33RenderImage::Ogl33RenderImage(GLuint framebuffer, GLuint colour, GLuint depth, size_t width, size_t height):
+	framebuffer{framebuffer},
+	colour{colour},
+	depth{depth},
+	image_width{width},
+	image_height{height}
+{}
+
+Ogl33RenderImage::~Ogl33RenderImage(){
+	if(framebuffer > 0){
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+	if(colour > 0){
+		glDeleteTextures(1, &colour);
+	}
+	if(depth > 0){
+		glDeleteRenderbuffers(1, &depth);
+	}
+}
+
+Ogl33RenderImage::Ogl33RenderImage(Ogl33RenderImage&& rhs):
+	framebuffer{rhs.framebuffer},
+	colour{rhs.colour},
+	depth{rhs.depth},
+	image_width{rhs.image_width},
+	image_height{rhs.image_height}
+{
+	rhs.framebuffer = 0;
+	rhs.colour = 0;
+	rhs.depth = 0;
+}
+
+Ogl33RenderImage& Ogl33RenderImage::operator=(Ogl33RenderImage&& rhs){
+	std::swap(framebuffer, rhs.framebuffer);
+	std::swap(colour, rhs.colour);
+	std::swap(depth, rhs.depth);
+	std::swap(image_width, rhs.image_width);
+	std::swap(image_height, rhs.image_height);
+	return *this;
+}
+
+GLuint Ogl33RenderImage::framebufferId() const {
+	return framebuffer;
+}
+
+GLuint Ogl33RenderImage::colourTexture() const {
+	return colour;
+}
+
+size_t Ogl33RenderImage::width() const {
+	return image_width;
+}
+
+size_t Ogl33RenderImage::height() const {
+	return image_height;
+}
+
+Ogl33RenderTexture::Ogl33RenderTexture(size_t width, size_t height):
+	texture_width{width},
+	texture_height{height},
+	transient{true}
+{}
+
+Ogl33RenderTexture::Ogl33RenderTexture(Ogl33RenderImage&& img):
+	texture_width{img.width()},
+	texture_height{img.height()},
+	transient{false},
+	image{std::move(img)}
+{}
+
 Ogl33RenderTexture::~Ogl33RenderTexture(){
 }
 
+bool Ogl33RenderTexture::isTransient() const {
+	return transient;
+}
+
+void Ogl33RenderTexture::setAlias(const Ogl33RenderImage* img){
+	alias = img;
+}
+
+const Ogl33RenderImage* Ogl33RenderTexture::currentImage() const {
+	if(transient){
+		return alias;
+	}
+	return &image;
+}
+
 void Ogl33RenderTexture::beginRender(){
+	const Ogl33RenderImage* img = currentImage();
+	assert(img);
+	if(!img){
+		return;
+	}
 
+	beginOgl33Target(img->framebufferId(), texture_width, texture_height);
 }
 
 void Ogl33RenderTexture::endRender(){
-
 }
 
 void Ogl33RenderTexture::bind(){
-
+	const Ogl33RenderImage* img = currentImage();
+	if(img){
+		glBindFramebuffer(GL_FRAMEBUFFER, img->framebufferId());
+	}
 }
 
 size_t Ogl33RenderTexture::width() const {
-	return 0;
+	return texture_width;
 }
 
 size_t Ogl33RenderTexture::height() const {
-	return 0;
+	return texture_height;
 }
 
 RenderTextureId Ogl33RenderTargetStorage::insert(Ogl33RenderTexture&& rt){
@@ -385,10 +834,10 @@ void Ogl33RenderTargetStorage::erase(const RenderTargetId& id){
 
 	auto rw_find = windows.find(id);
 	if(rw_find != windows.end()){
-		if(( rt_find->first+1) == max_free_id){
+		if(( rw_find->first+1) == max_free_id){
 			--max_free_id;
 		}else{
-			free_ids.push(rt_find->first);
+			free_ids.push(rw_find->first);
 		}
 		windows.erase(rw_find);
 	}
@@ -451,740 +900,3110 @@ Ogl33RenderTexture* Ogl33RenderTargetStorage::getRenderTexture(const RenderTextu
 	return nullptr;
 }
 
-ErrorOr<RenderObjectId> Ogl33Scene::createObject(const RenderPropertyId& rp_id)noexcept{
-	RenderObjectId id = searchForFreeId(objects);
+/// Doesn't mark the slot dirty, so it's safe to call for different objects in parallel
+void Ogl33Scene::writeObject(const RenderObject& object){
+	Ogl33PersistentObjectBuffer::Texel* texels = gpu_objects.texels(object.slot);
+	texels[0] = {object.old_world_pos[0], object.old_world_pos[1], std::real(object.old_world_angle), std::imag(object.old_world_angle)};
+	texels[1] = {object.world_pos[0], object.world_pos[1], std::real(object.world_angle), std::imag(object.world_angle)};
+	texels[2] = {object.layer, object.flipbook_start, 0.f, 0.f};
+}
 
+void Ogl33Scene::markDirty(const RenderObjectId& id, RenderObject& object){
+	if(object.transform_dirty){
+		return;
+	}
 	try{
-		objects.insert(std::make_pair(id, RenderObject{rp_id}));
+		transform_dirty.push_back(id);
 	}catch(const std::bad_alloc&){
-		return criticalError("Out of memory");
+		// Falls back to recomputing everything
+		hierarchy_dirty = true;
+		return;
 	}
-	return id;
-}
-
-void Ogl33Scene::destroyObject(const RenderObjectId& id)noexcept{
-	objects.erase(id);
+	object.transform_dirty = true;
 }
 
-Error Ogl33Scene::setObjectPosition(const RenderObjectId& id, float x, float y, bool interpolate )noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
-	}
+void Ogl33Scene::rebuildHierarchy(){
+	hierarchy.clear();
+	hierarchy.reserve(objects.size());
 
-	find->second.pos = {{x,y}};
+	std::vector<HierarchyNode> stack;
+	for(auto& root : objects){
+		if(root.second.parent != 0){
+			continue;
+		}
 
-	if(!interpolate){
-		find->second.old_pos = find->second.pos;
-	}
+		stack.push_back(HierarchyNode{root.first, &root.second, HierarchyNode::no_parent, 0});
+		while(!stack.empty()){
+			HierarchyNode node = stack.back();
+			stack.pop_back();
 
-	return noError();
-}
+			node.object->hierarchy_index = static_cast<uint32_t>(hierarchy.size());
+			hierarchy.push_back(node);
 
-Error Ogl33Scene::setObjectRotation(const RenderObjectId& id, float angle, bool interpolate)noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
+			for(auto& child : node.object->children){
+				auto find = objects.find(child);
+				assert(find != objects.end());
+				if(find != objects.end()){
+					stack.push_back(HierarchyNode{child, &find->second, node.object->hierarchy_index, 0});
+				}
+			}
+		}
 	}
-	find->second.angle = std::polar(1.f, angle);
 
-	if(!interpolate){
-		 find->second.old_angle = find->second.angle;
+	// Children follow their parent, so the subtree ends are known after one backwards pass
+	for(size_t i = hierarchy.size(); i > 0; --i){
+		HierarchyNode& node = hierarchy[i-1];
+		if(node.subtree_end == 0){
+			node.subtree_end = static_cast<uint32_t>(i);
+		}
+		if(node.parent != HierarchyNode::no_parent){
+			HierarchyNode& parent = hierarchy[node.parent];
+			parent.subtree_end = std::max(parent.subtree_end, node.subtree_end);
+		}
 	}
 
-	return noError();
+	hierarchy_dirty = false;
 }
 
-Error Ogl33Scene::setObjectVisibility(const RenderObjectId& id, bool visible)noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
-	}
-	
-	find->second.visible = visible;
-	return noError();
-}
+void Ogl33Scene::computeWorldTransforms(size_t begin, size_t end){
+	for(size_t i = begin; i < end; ++i){
+		HierarchyNode& node = hierarchy[i];
+		RenderObject& object = *node.object;
 
-Error Ogl33Scene::setObjectLayer(const RenderObjectId& id, float l) noexcept {
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
-	}
+		std::array<float,2> world_pos = object.pos;
+		std::complex<float> world_angle = object.angle;
+		if(node.parent == HierarchyNode::no_parent){
+			object.old_world_pos = object.old_pos;
+			object.old_world_angle = object.old_angle;
+		}else{
+			const RenderObject& parent = *hierarchy[node.parent].object;
 
-	find->second.layer = l;
-	return noError();
-}
+			std::complex<float> pos = parent.world_angle * std::complex<float>{object.pos[0], object.pos[1]};
+			world_pos = {{parent.world_pos[0] + std::real(pos), parent.world_pos[1] + std::imag(pos)}};
+			world_angle = parent.world_angle * object.angle;
 
-Error Ogl33Scene::setObjectProperty(const RenderObjectId& id, const RenderPropertyId& property) noexcept {
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
-	}
+			std::complex<float> old_pos = parent.old_world_angle * std::complex<float>{object.old_pos[0], object.old_pos[1]};
+			object.old_world_pos = {{parent.old_world_pos[0] + std::real(old_pos), parent.old_world_pos[1] + std::imag(old_pos)}};
+			object.old_world_angle = parent.old_world_angle * object.old_angle;
+		}
 
-	find->second.id = property;
-	return noError();
+		// Baked objects only need a rebake if they actually moved
+		object.world_changed = world_pos != object.world_pos || world_angle != object.world_angle;
+		object.world_pos = world_pos;
+		object.world_angle = world_angle;
+
+		writeObject(object);
+	}
 }
 
-/**
-* @todo design better interface and check occlusion
-*/
-void Ogl33Scene::visit(const Ogl33Camera&, std::vector<RenderObject*>& render_queue){
-	render_queue.reserve(objects.size());
-	for(auto& iter: objects){
-		if(iter.second.visible){
-			render_queue.push_back(&iter.second);
+void Ogl33Scene::updateWorldTransforms(JobSystem* job_system){
+	std::vector<std::pair<size_t, size_t>> ranges;
+
+	if(hierarchy_dirty){
+		rebuildHierarchy();
+		ranges.push_back(std::make_pair(0, hierarchy.size()));
+	}else{
+		if(transform_dirty.empty()){
+			return;
 		}
-	}
-}
 
-void Ogl33Scene::updateState(float interval){
-	for(auto& iter : objects){
-		iter.second.old_pos[0] = iter.second.pos[0] * interval + iter.second.old_pos[0] * (1.f - interval);
-		iter.second.old_pos[1] = iter.second.pos[1] * interval + iter.second.old_pos[1] * (1.f - interval);
+		ranges.reserve(transform_dirty.size());
+		for(auto& iter : transform_dirty){
+			auto find = objects.find(iter);
+			if(find == objects.end()){
+				continue;
+			}
+			const HierarchyNode& node = hierarchy[find->second.hierarchy_index];
+			ranges.push_back(std::make_pair(find->second.hierarchy_index, node.subtree_end));
+		}
 
-		iter.second.old_angle = slerp2D<float>(iter.second.old_angle, iter.second.angle, interval);
-		iter.second.old_angle /= std::abs(iter.second.old_angle);
+		// Subtrees either nest or don't overlap at all, so nested ones are dropped
+		std::sort(ranges.begin(), ranges.end());
+		size_t kept = 0;
+		for(size_t i = 0; i < ranges.size(); ++i){
+			if(kept > 0 && ranges[i].first < ranges[kept-1].second){
+				continue;
+			}
+			ranges[kept++] = ranges[i];
+		}
+		ranges.resize(kept);
 	}
-}
 
-ErrorOr<RenderObject3dId> Ogl33Scene3d::createObject(const RenderProperty3dId& id) noexcept {
-	RenderObject3dId o_id = searchForFreeId(objects);
+	for(auto& iter : transform_dirty){
+		auto find = objects.find(iter);
+		if(find != objects.end()){
+			find->second.transform_dirty = false;
+		}
+	}
+	transform_dirty.clear();
 
-	try{
-		objects.insert(std::make_pair(o_id, Ogl33Scene3d::RenderObject{id}));
-	}catch(const std::bad_alloc&){
-		return criticalError("Out of memory");
+	size_t work = 0;
+	for(auto& iter : ranges){
+		work += iter.second - iter.first;
 	}
 
-	return o_id;
-}
+	// The ranges are independent subtrees
+	if(job_system && ranges.size() > 1 && work >= 4096){
+		job_system->parallelFor(ranges.size(), [this, &ranges](size_t begin, size_t end){
+			for(size_t i = begin; i < end; ++i){
+				computeWorldTransforms(ranges[i].first, ranges[i].second);
+			}
+		}, 1);
+	}else{
+		for(auto& iter : ranges){
+			computeWorldTransforms(iter.first, iter.second);
+		}
+	}
 
-void Ogl33Scene3d::destroyObject(const RenderObject3dId& id) noexcept{
-	objects.erase(id);
-	return;
+	for(auto& iter : ranges){
+		for(size_t i = iter.first; i < iter.second; ++i){
+			HierarchyNode& node = hierarchy[i];
+			gpu_objects.markDirty(node.object->slot);
+			if(node.object->world_changed && node.object->static_chunk != RenderObject::no_chunk){
+				refreshStatic(node.id, *node.object);
+			}
+		}
+	}
 }
 
-Error Ogl33Scene3d::setObjectPosition(const RenderObject3dId& id, float x, float y, float z)noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
+bool Ogl33Scene::shouldBake(const RenderObject& object) const {
+	if(!object.visible){
+		return false;
 	}
-
-	find->second.pos = {{x,y,z}};
-
-	return noError();
+	return object.is_static || std::find(static_layers.begin(), static_layers.end(), object.layer) != static_layers.end();
 }
 
-Error Ogl33Scene3d::setObjectRotation(const RenderObject3dId& id, float a, float b, float g)noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
+void Ogl33Scene::unbake(const RenderObjectId& id, RenderObject& object){
+	if(object.static_chunk == RenderObject::no_chunk){
+		return;
 	}
 
-	find->second.rot = {{a,b,g}};
+	StaticChunk& chunk = static_chunks[object.static_chunk];
+	chunk.objects.erase(std::remove(chunk.objects.begin(), chunk.objects.end(), id), chunk.objects.end());
+	chunk.dirty = true;
+	chunks_dirty = true;
 
-	return noError();
+	object.static_chunk = RenderObject::no_chunk;
+	--baked_objects;
+	++structure_version;
 }
 
-Error Ogl33Scene3d::setObjectVisibility(const RenderObject3dId& id, bool visible) noexcept{
-	auto find = objects.find(id);
-	if(find == objects.end()){
-		return criticalError("Couldn't find object");
+void Ogl33Scene::refreshStatic(const RenderObjectId& id, RenderObject& object){
+	unbake(id, object);
+	if(object.static_pending || !shouldBake(object)){
+		return;
 	}
 
-	find->second.visible = visible;
-
-	return noError();
-}
-
-void Ogl33Scene3d::updateState(){
-	for(auto& iter : objects){
-		iter.second.old_pos = iter.second.pos;
-		iter.second.old_rot = iter.second.rot;
+	try{
+		static_pending.push_back(id);
+	}catch(const std::bad_alloc&){
+		// Stays unbaked and is drawn on its own
+		return;
 	}
+	object.static_pending = true;
 }
 
-void Ogl33RenderStage::renderOne(Ogl33Program& program, Ogl33RenderProperty& property, Ogl33Scene::RenderObject& object, Ogl33Mesh& mesh, Ogl33Texture& texture, Matrix<float, 3, 3>& vp, float time_interval){
-	program.setTexture(texture);
-	program.setLayer(object.layer);
-	Matrix<float, 3, 3> mvp;
-
-	std::complex<float> interpol_angle = slerp2D<float>(object.old_angle, object.angle, time_interval);
-
-	mvp(0,0) = std::real(interpol_angle);
-	mvp(0,1) = -std::imag(interpol_angle);
-	mvp(1,0) = std::imag(interpol_angle);
-	mvp(1,1) = std::real(interpol_angle);
-
-	mvp(0,2) = object.pos[0] * ( time_interval ) + object.old_pos[0] * ( 1.f - time_interval );
-	mvp(1,2) = object.pos[1] * ( time_interval ) + object.old_pos[1] * ( 1.f - time_interval );
-	mvp(2,2) = 1.f;
-
-	mvp = vp * mvp;
+namespace {
+struct Ogl33BakeJob {
+	const Ogl33Scene::RenderObject* object;
+	const MeshData* mesh;
+	MeshData* target;
+	size_t vertex_offset;
+	size_t index_offset;
+};
 
-	program.setMvp(mvp);
+void bakeOgl33Objects(const std::vector<Ogl33BakeJob>& jobs, size_t begin, size_t end){
+	for(size_t i = begin; i < end; ++i){
+		const Ogl33BakeJob& job = jobs[i];
+		const Ogl33Scene::RenderObject& object = *job.object;
+
+		for(size_t j = 0; j < job.mesh->vertices.size(); ++j){
+			const MeshData::Vertex& vertex = job.mesh->vertices[j];
+			std::complex<float> pos = object.world_angle * std::complex<float>{vertex.position[0], vertex.position[1]};
+			job.target->vertices[job.vertex_offset + j] = MeshData::Vertex{
+				{{std::real(pos) + object.world_pos[0], std::imag(pos) + object.world_pos[1]}},
+				vertex.uvs
+			};
+		}
 
-	program.setMesh(mesh);
-	glDrawElements(GL_TRIANGLES, mesh.indexCount(), GL_UNSIGNED_INT, 0L);
+		for(size_t j = 0; j < job.mesh->indices.size(); ++j){
+			job.target->indices[job.index_offset + j] = job.mesh->indices[j] + static_cast<unsigned int>(job.vertex_offset);
+		}
+	}
+}
 }
 
-void Ogl33RenderStage::render(Ogl33Render& render, float time_interval){
-	std::vector<Ogl33Scene::RenderObject*> draw_queue;
-
-	Ogl33Scene* scene = render.getScene(scene_id);
-	assert(scene);
-	if(!scene){
-		return;
-	}
-	Ogl33Camera* camera = render.getCamera(camera_id);
-	assert(camera);
-	if(!camera){
-		return;
-	}
-	Ogl33Program* program = render.getProgram(program_id);
-	assert(program);
-	if(!program){
-		return;
+void Ogl33Scene::bakeStaticChunks(Ogl33Render& render, JobSystem* job_system){
+	uint64_t property_version = render.getRender2D().getResources().property_version;
+	if(property_version != baked_property_version){
+		// Any property might have changed its mesh or texture, so everything is sorted in again
+		for(auto& iter : objects){
+			if(iter.second.static_chunk != RenderObject::no_chunk){
+				refreshStatic(iter.first, iter.second);
+			}
+		}
+		baked_property_version = property_version;
 	}
 
-	scene->visit(*camera, draw_queue);
-
-	program->use();
-	glActiveTexture(GL_TEXTURE0);
-
-	Matrix<float, 3, 3> vp = camera->projection()*camera->view(time_interval);
-
-	for(auto& iter : draw_queue){
-		Ogl33RenderProperty* property = render.getProperty(iter->id);
-		assert(property);
-		if(!property){
+	for(auto& id : static_pending){
+		auto find = objects.find(id);
+		// Destroyed or queued twice
+		if(find == objects.end() || !find->second.static_pending){
 			continue;
 		}
-		Ogl33Mesh* mesh = render.getMesh(property->mesh_id);
-		assert(mesh);
-		if(!mesh){
+		RenderObject& object = find->second;
+		object.static_pending = false;
+
+		if(!shouldBake(object)){
 			continue;
 		}
-		Ogl33Texture* texture = render.getTexture(property->texture_id);
-		assert(texture);
-		if(!texture){
+		Ogl33RenderProperty* property = render.getProperty(object.id);
+		// Flipbooks change their uvs every frame, so they stay separate
+		if(!property || !property->flipbook.frames.empty()){
 			continue;
 		}
-		
-		renderOne(*program, *property, *iter, *mesh, *texture, vp, time_interval);		
-	}
-}
 
-void Ogl33RenderStage3d::renderOne(Ogl33Program3d& program, Ogl33RenderProperty3d& property, Ogl33Scene3d::RenderObject& object, Ogl33Mesh3d& mesh, Ogl33Texture& texture, Matrix<float, 4, 4>& vp){
+		std::array<int32_t, 2> cell{{
+			static_cast<int32_t>(std::floor(object.world_pos[0] / static_chunk_size)),
+			static_cast<int32_t>(std::floor(object.world_pos[1] / static_chunk_size))
+		}};
+		auto key = std::make_tuple(property->texture_id, object.layer, cell[0], cell[1]);
 
-}
+		uint32_t chunk_id;
+		try{
+			auto chunk_find = static_chunk_ids.find(key);
+			if(chunk_find == static_chunk_ids.end()){
+				chunk_id = static_cast<uint32_t>(static_chunks.size());
 
-void Ogl33RenderStage3d::render(Ogl33Render& render){
-	std::vector<Ogl33Scene3d::RenderObject> draw_queue;
-	Ogl33Scene3d* scene = render.getScene3d(scene_id);
-	assert(scene);
-	if(!scene){
-		return;
-	}
+				uint32_t slot = allocateSlot();
 
-	Ogl33Camera3d* camera = render.getCamera3d(camera_id);
-	assert(camera);
-	if(!camera){
-		return;
+				// The vertices are already in world space
+				Ogl33PersistentObjectBuffer::Texel* texels = gpu_objects.write(slot);
+				texels[0] = {0.f, 0.f, 1.f, 0.f};
+				texels[1] = {0.f, 0.f, 1.f, 0.f};
+				texels[2] = {object.layer, 0.f, 0.f, 0.f};
+
+				static_chunks.push_back(StaticChunk{property->texture_id, object.layer, cell, {}, false, createOgl33Mesh(MeshData{}), 0, {}, slot});
+				static_chunk_ids.insert(std::make_pair(key, chunk_id));
+			}else{
+				chunk_id = chunk_find->second;
+			}
+			static_chunks[chunk_id].objects.push_back(id);
+		}catch(const std::bad_alloc&){
+			continue;
+		}
+
+		object.static_chunk = chunk_id;
+		static_chunks[chunk_id].dirty = true;
+		chunks_dirty = true;
+		++baked_objects;
+		++structure_version;
 	}
+	static_pending.clear();
 
-	Ogl33Program3d* program = render.getProgram3d(program_id);
-	assert(program);
-	if(!program){
+	if(!chunks_dirty){
 		return;
 	}
 
-	scene->visit(*camera, draw_queue);
+	// From the back, so every chunk moved into a released index was checked already
+	for(uint32_t i = static_cast<uint32_t>(static_chunks.size()); i-- > 0;){
+		if(static_chunks[i].objects.empty()){
+			releaseStaticChunk(i);
+		}
+	}
 
-	program->use();
+	std::vector<uint32_t> rebake;
+	std::vector<MeshData> baked;
+	std::vector<Ogl33BakeJob> jobs;
+	size_t total_vertices = 0;
+	try{
+		for(uint32_t i = 0; i < static_chunks.size(); ++i){
+			if(static_chunks[i].dirty){
+				rebake.push_back(i);
+			}
+		}
+		baked.resize(rebake.size());
+
+		for(size_t i = 0; i < rebake.size(); ++i){
+			size_t vertex_count = 0;
+			size_t index_count = 0;
+			for(auto& id : static_chunks[rebake[i]].objects){
+				auto find = objects.find(id);
+				assert(find != objects.end());
+				if(find == objects.end()){
+					continue;
+				}
+				Ogl33RenderProperty* property = render.getProperty(find->second.id);
+				if(!property){
+					continue;
+				}
+				Ogl33Mesh* mesh = render.getMesh(property->mesh_id);
+				if(!mesh){
+					continue;
+				}
+
+				jobs.push_back(Ogl33BakeJob{&find->second, &mesh->data(), &baked[i], vertex_count, index_count});
+				vertex_count += mesh->data().vertices.size();
+				index_count += mesh->data().indices.size();
+			}
+			baked[i].vertices.resize(vertex_count);
+			baked[i].indices.resize(index_count);
+			total_vertices += vertex_count;
+		}
+	}catch(const std::bad_alloc&){
+		// The chunks stay dirty and are tried again on the next step
+		return;
+	}
 
-	Matrix<float, 4, 4> vp = camera->projection()*camera->view();
+	if(job_system && jobs.size() > 1 && total_vertices >= 4096){
+		job_system->parallelFor(jobs.size(), [&jobs](size_t begin, size_t end){
+			bakeOgl33Objects(jobs, begin, end);
+		}, 1);
+	}else{
+		bakeOgl33Objects(jobs, 0, jobs.size());
+	}
 
-	for(auto& iter: draw_queue){
-		// renderOne();
+	for(size_t i = 0; i < rebake.size(); ++i){
+		StaticChunk& chunk = static_chunks[rebake[i]];
+		// Nothing reads the baked data on the CPU again
+		chunk.mesh.upload(baked[i]);
+		chunk.index_count = chunk.mesh.indexCount();
+		chunk.dirty = false;
+
+		chunk.bounds = {{
+			std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+			std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()
+		}};
+		for(auto& vertex : baked[i].vertices){
+			chunk.bounds[0] = std::min(chunk.bounds[0], vertex.position[0]);
+			chunk.bounds[1] = std::min(chunk.bounds[1], vertex.position[1]);
+			chunk.bounds[2] = std::max(chunk.bounds[2], vertex.position[0]);
+			chunk.bounds[3] = std::max(chunk.bounds[3], vertex.position[1]);
+		}
 	}
+	chunks_dirty = false;
 }
 
-Ogl33Render2D::Ogl33Render2D(Ogl33Render& r):resources{r.getResources()},render{&r}{}
+void Ogl33Scene::releaseStaticChunk(uint32_t chunk_id){
+	StaticChunk& chunk = static_chunks[chunk_id];
+	static_chunk_ids.erase(std::make_tuple(chunk.texture_id, chunk.layer, chunk.cell[0], chunk.cell[1]));
+	freeSlot(chunk.slot);
 
-Ogl33Render::Ogl33Render(Own<GlContext>&& ctx):
-	context{std::move(ctx)},
-	render_2d{*this},
-	old_time_point{std::chrono::steady_clock::now()},
-	time_point{old_time_point}
-{
+	uint32_t last = static_cast<uint32_t>(static_chunks.size() - 1);
+	if(chunk_id != last){
+		chunk = std::move(static_chunks[last]);
+		for(auto& id : chunk.objects){
+			auto find = objects.find(id);
+			if(find != objects.end()){
+				find->second.static_chunk = chunk_id;
+			}
+		}
+		auto find = static_chunk_ids.find(std::make_tuple(chunk.texture_id, chunk.layer, chunk.cell[0], chunk.cell[1]));
+		if(find != static_chunk_ids.end()){
+			find->second = chunk_id;
+		}
+	}
+	// Destroying the mesh frees its buffers
+	static_chunks.pop_back();
+	++structure_version;
 }
 
-Ogl33Render::~Ogl33Render(){
-	if(loaded_glad){
-	}
+void Ogl33Scene::writeTilemap(Ogl33Tilemap& tilemap){
+	Ogl33PersistentObjectBuffer::Texel* texels = gpu_objects.write(tilemap.slot);
+	texels[0] = {tilemap.position[0], tilemap.position[1], 1.f, 0.f};
+	texels[1] = {tilemap.position[0], tilemap.position[1], 1.f, 0.f};
+	texels[2] = {tilemap.layer, 0.f, 0.f, 0.f};
 }
 
-namespace {
-template<typename K, typename T>
-struct Ogl33RenderContainerReturnHelper;
+ErrorOr<RenderTilemapId> Ogl33Scene::createTilemap(const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, size_t width, size_t height, float tile_size) noexcept {
+	RenderTilemapId id = searchForFreeId(tilemaps);
 
-template<typename K, typename T>
-struct Ogl33RenderContainerReturnHelper {
-	static T* getElement(std::unordered_map<K, T>& ctr, const K& id){
-		auto iter = ctr.find(id);
-		if(iter != ctr.end()){
-			return &iter->second;
-		}
-		return nullptr;
+	try{
+		Ogl33Tilemap tilemap{width, height, atlas, atlas_columns, atlas_rows, tile_size};
+		tilemap.slot = allocateSlot();
+		auto insert = tilemaps.insert(std::make_pair(id, std::move(tilemap)));
+		writeTilemap(insert.first->second);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
 	}
-};
+	++structure_version;
+	return id;
+}
 
-template<typename K, typename T>
-struct Ogl33RenderContainerReturnHelper<K, Own<T>> {
-	static T* getElement(std::unordered_map<K, Own<T>>& ctr, const K& id){
-		auto iter = ctr.find(id);
-		if(iter != ctr.end()){
-			return iter->second.get();
-		}
-		return nullptr;
+Error Ogl33Scene::destroyTilemap(const RenderTilemapId& id) noexcept {
+	auto find = tilemaps.find(id);
+	if(find == tilemaps.end()){
+		return criticalError("Couldn't find tilemap");
 	}
-};
+
+	freeSlot(find->second.slot);
+	tilemaps.erase(find);
+	++structure_version;
+	return noError();
 }
 
-Ogl33Scene* Ogl33Render::getScene(const RenderSceneId& id) noexcept {
-	auto iter = render_2d.getResources().scenes.find(id);
-	if(iter != render_2d.getResources().scenes.end()){
-		return &iter->second;
+Error Ogl33Scene::setTilemapTile(const RenderTilemapId& id, size_t x, size_t y, TileIndex tile) noexcept {
+	auto find = tilemaps.find(id);
+	if(find == tilemaps.end()){
+		return criticalError("Couldn't find tilemap");
 	}
-	return nullptr;
+	return find->second.setTile(x, y, tile);
 }
 
-Ogl33Camera* Ogl33Render::getCamera(const RenderCameraId& id) noexcept {
-	auto iter = render_2d.getResources().cameras.find(id);
-	if(iter != render_2d.getResources().cameras.end()){
-		return &iter->second;
+Error Ogl33Scene::setTilemapTiles(const RenderTilemapId& id, size_t x, size_t y, size_t w, size_t h, const std::vector<TileIndex>& tiles) noexcept {
+	auto find = tilemaps.find(id);
+	if(find == tilemaps.end()){
+		return criticalError("Couldn't find tilemap");
 	}
-	return nullptr;
+	return find->second.setTiles(x, y, w, h, tiles);
 }
 
-Ogl33Program* Ogl33Render::getProgram(const ProgramId& id) noexcept {
-	auto iter = render_2d.getResources().programs.find(id);
-	if(iter != render_2d.getResources().programs.end()){
-		return &iter->second;
+Error Ogl33Scene::setTilemapPosition(const RenderTilemapId& id, float x, float y) noexcept {
+	auto find = tilemaps.find(id);
+	if(find == tilemaps.end()){
+		return criticalError("Couldn't find tilemap");
 	}
-	return nullptr;
+	find->second.position = {{x, y}};
+	writeTilemap(find->second);
+	return noError();
 }
 
-Ogl33RenderProperty* Ogl33Render::getProperty(const RenderPropertyId& id) noexcept {
-	auto iter = render_2d.getResources().render_properties.find(id);
-	if(iter != render_2d.getResources().render_properties.end()){
-		return &iter->second;
+Error Ogl33Scene::setTilemapLayer(const RenderTilemapId& id, float layer) noexcept {
+	auto find = tilemaps.find(id);
+	if(find == tilemaps.end()){
+		return criticalError("Couldn't find tilemap");
 	}
-	return nullptr;
+	find->second.layer = layer;
+	writeTilemap(find->second);
+	return noError();
 }
 
-Ogl33Mesh* Ogl33Render::getMesh(const MeshId& id) noexcept {
-	auto iter = render_2d.getResources().meshes.find(id);
-	if(iter != render_2d.getResources().meshes.end()){
-		return &iter->second;
-	}
-	return nullptr;
+std::unordered_map<RenderTilemapId, Ogl33Tilemap>& Ogl33Scene::getTilemaps(){
+	return tilemaps;
 }
 
-Ogl33Texture* Ogl33Render::getTexture(const TextureId& id) noexcept {
-	auto iter = resources.textures.find(id);
-	if(iter != resources.textures.end()){
-		return &iter->second;
+ErrorOr<RenderEmitterId> Ogl33Scene::createEmitter(const TextureId& texture, const ParticleEmitterParameters& parameters) noexcept {
+	RenderEmitterId id = searchForFreeId(emitters);
+
+	try{
+		// Seeded by the id, so emitters don't spawn in lockstep
+		emitters.insert(std::make_pair(id, Ogl33ParticleEmitter{texture, parameters, static_cast<uint32_t>(id) * 2654435761u + 1u}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
 	}
-	return nullptr;
+	return id;
 }
 
-Ogl33Scene3d* Ogl33Render::getScene3d(const RenderScene3dId& id) noexcept {
-	return nullptr;
+Error Ogl33Scene::destroyEmitter(const RenderEmitterId& id) noexcept {
+	if(emitters.erase(id) == 0){
+		return criticalError("Couldn't find emitter");
+	}
+	return noError();
 }
 
-Ogl33Camera3d* Ogl33Render::getCamera3d(const RenderCamera3dId& id) noexcept {
-	return nullptr;
+Ogl33ParticleEmitter* Ogl33Scene::getEmitter(const RenderEmitterId& id) noexcept {
+	auto find = emitters.find(id);
+	if(find == emitters.end()){
+		return nullptr;
+	}
+	return &find->second;
 }
 
-Ogl33Program3d* Ogl33Render::getProgram3d(const Program3dId& id) noexcept {
-	return nullptr;
+std::unordered_map<RenderEmitterId, Ogl33ParticleEmitter>& Ogl33Scene::getEmitters(){
+	return emitters;
 }
 
-Ogl33RenderProperty3d* Ogl33Render::getRenderProperty3d(const RenderProperty3dId& id) noexcept {
-	return nullptr;
+const std::vector<Ogl33Scene::StaticChunk>& Ogl33Scene::staticChunks() const {
+	return static_chunks;
 }
 
-Ogl33Mesh3d* Ogl33Render::getMesh3d(const Mesh3dId& id) noexcept {
-	return nullptr;
+size_t Ogl33Scene::bakedObjectCount() const {
+	return baked_objects;
 }
 
-/*
-Ogl33Scene3d* Ogl33Render::getScene3d(const RenderScene3dId& id) noexcept {
-	return Ogl33RenderContainerReturnHelper<RenderScene3dId, Ogl33Scene3d>::getElement(scenes_3d, id);
+void Ogl33Scene::activate(const RenderObjectId& id, RenderObject& object){
+	if(object.active_index != RenderObject::inactive){
+		return;
+	}
+	try{
+		active_objects.push_back(id);
+	}catch(const std::bad_alloc&){
+		// Without tracking it the object just stops interpolating
+		object.old_pos = object.pos;
+		object.old_angle = object.angle;
+		return;
+	}
+	object.active_index = static_cast<uint32_t>(active_objects.size() - 1);
 }
 
-Ogl33Camera3d* Ogl33Render::getCamera3d(const RenderCamera3dId& id) noexcept {
-	return Ogl33RenderContainerReturnHelper<RenderCamera3dId, Ogl33Camera3d>::getElement(cameras_3d, id);
-}
+void Ogl33Scene::deactivate(RenderObject& object){
+	if(object.active_index == RenderObject::inactive){
+		return;
+	}
 
-Ogl33Program3d* Ogl33Render::getProgram3d(const Program3dId& id) noexcept {
-	return Ogl33RenderContainerReturnHelper<Program3dId, Ogl33Program3d>::getElement(programs_3d, id);
+	RenderObjectId moved = active_objects.back();
+	active_objects[object.active_index] = moved;
+	active_objects.pop_back();
+	if(object.active_index < active_objects.size()){
+		auto find = objects.find(moved);
+		assert(find != objects.end());
+		if(find != objects.end()){
+			find->second.active_index = object.active_index;
+		}
+	}
+	object.active_index = RenderObject::inactive;
 }
 
-Ogl33RenderProperty3d* Ogl33Render::getRenderProperty3d(const RenderProperty3dId& id) noexcept {
-	return Ogl33RenderContainerReturnHelper<RenderProperty3dId, Ogl33RenderProperty3d>::getElement(render_properties_3d, id);
+uint32_t Ogl33Scene::allocateSlot(){
+	if(free_slots.empty()){
+		uint32_t slot = static_cast<uint32_t>(gpu_objects.size());
+		gpu_objects.resize(gpu_objects.size() + 1);
+		return slot;
+	}
+	uint32_t slot = free_slots.back();
+	free_slots.pop_back();
+	return slot;
 }
 
-Ogl33Mesh3d* Ogl33Render::getMesh3d(const Mesh3dId& id) noexcept {
-	return Ogl33RenderContainerReturnHelper<Mesh3dId, Ogl33Mesh3d>::getElement(meshes_3d, id);
+void Ogl33Scene::freeSlot(uint32_t slot){
+	try{
+		free_slots.push_back(slot);
+	}catch(const std::bad_alloc&){
+		// The slot is lost, but stays valid
+	}
 }
-*/
-
-ErrorOr<MeshId> Ogl33Render2D::createMesh(const MeshData& data) noexcept {
-	Mesh3dId id = searchForFreeId(resources.meshes);
-	std::array<GLuint,2> ids;
 
-	/// @todo ensure that the current render context is bound
+ErrorOr<RenderObjectId> Ogl33Scene::createObject(const RenderPropertyId& rp_id)noexcept{
+	RenderObjectId id = searchForFreeId(objects);
 
-	GLuint vao;
+	try{
+		RenderObject object{rp_id};
+		object.flipbook_start = current_time;
+		object.slot = allocateSlot();
+		auto insert = objects.insert(std::make_pair(id, object));
+		refreshStatic(id, insert.first->second);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	// A snapshot may have listed the id before it existed
+	snapshots.forget();
+	hierarchy_dirty = true;
+	++structure_version;
+	return id;
+}
+
+void Ogl33Scene::destroyObject(const RenderObjectId& id)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return;
+	}
+	snapshots.forget();
+
+	deactivate(find->second);
+	unbake(id, find->second);
+	freeSlot(find->second.slot);
+
+	for(auto& iter : find->second.children){
+		auto child = objects.find(iter);
+		if(child != objects.end()){
+			child->second.parent = 0;
+		}
+	}
+	if(find->second.parent != 0){
+		auto parent = objects.find(find->second.parent);
+		if(parent != objects.end()){
+			auto& siblings = parent->second.children;
+			siblings.erase(std::remove(siblings.begin(), siblings.end(), id), siblings.end());
+		}
+	}
+
+	objects.erase(find);
+	hierarchy_dirty = true;
+	++structure_version;
+}
+
+bool Ogl33Scene::hasObject(const RenderObjectId& id) const noexcept {
+	return objects.find(id) != objects.end();
+}
+
+Error Ogl33Scene::setObjectPosition(const RenderObjectId& id, float x, float y, bool interpolate )noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.pos = {{x,y}};
+
+	if(!interpolate){
+		find->second.old_pos = find->second.pos;
+	}else{
+		activate(id, find->second);
+	}
+	markDirty(id, find->second);
+
+	return noError();
+}
+
+Error Ogl33Scene::setObjectRotation(const RenderObjectId& id, float angle, bool interpolate)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+	find->second.angle = std::polar(1.f, angle);
+
+	if(!interpolate){
+		 find->second.old_angle = find->second.angle;
+	}else{
+		activate(id, find->second);
+	}
+	markDirty(id, find->second);
+
+	return noError();
+}
+
+Error Ogl33Scene::setObjectVisibility(const RenderObjectId& id, bool visible)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+	
+	if(find->second.visible != visible){
+		find->second.visible = visible;
+		refreshStatic(id, find->second);
+		++structure_version;
+	}
+	return noError();
+}
+
+Error Ogl33Scene::setObjectLayer(const RenderObjectId& id, float l) noexcept {
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	if(find->second.layer != l){
+		find->second.layer = l;
+		refreshStatic(id, find->second);
+	}
+	markDirty(id, find->second);
+	return noError();
+}
+
+Error Ogl33Scene::setObjectProperty(const RenderObjectId& id, const RenderPropertyId& property) noexcept {
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	if(find->second.id != property){
+		find->second.flipbook_start = current_time;
+		markDirty(id, find->second);
+	}
+	find->second.id = property;
+	refreshStatic(id, find->second);
+	++structure_version;
+	return noError();
+}
+
+Error Ogl33Scene::restartFlipbook(const RenderObjectId& id) noexcept {
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.flipbook_start = current_time;
+	markDirty(id, find->second);
+	return noError();
+}
+
+void Ogl33Scene::setCurrentTime(float time){
+	current_time = time;
+}
+
+Error Ogl33Scene::setObjectStatic(const RenderObjectId& id, bool s) noexcept {
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	if(find->second.is_static != s){
+		find->second.is_static = s;
+		refreshStatic(id, find->second);
+	}
+	return noError();
+}
+
+Error Ogl33Scene::setLayerStatic(float layer, bool s) noexcept {
+	auto find = std::find(static_layers.begin(), static_layers.end(), layer);
+	if((find != static_layers.end()) == s){
+		return noError();
+	}
+
+	if(s){
+		try{
+			static_layers.push_back(layer);
+		}catch(const std::bad_alloc&){
+			return criticalError("Out of memory");
+		}
+	}else{
+		static_layers.erase(find);
+	}
+
+	for(auto& iter : objects){
+		if(iter.second.layer == layer){
+			refreshStatic(iter.first, iter.second);
+		}
+	}
+	return noError();
+}
+
+Error Ogl33Scene::setObjectParent(const RenderObjectId& id, const RenderObjectId& parent_id) noexcept {
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+	RenderObject& object = find->second;
+	if(object.parent == parent_id){
+		return noError();
+	}
+
+	RenderObject* parent = nullptr;
+	if(parent_id != 0){
+		auto parent_find = objects.find(parent_id);
+		if(parent_find == objects.end()){
+			return criticalError("Couldn't find parent object");
+		}
+		parent = &parent_find->second;
+
+		// Walking up from the new parent must not reach the object itself
+		for(RenderObjectId ancestor = parent_id; ancestor != 0;){
+			if(ancestor == id){
+				return criticalError("Parent would create a cycle");
+			}
+			auto ancestor_find = objects.find(ancestor);
+			ancestor = ancestor_find != objects.end() ? ancestor_find->second.parent : 0;
+		}
+
+		try{
+			parent->children.push_back(id);
+		}catch(const std::bad_alloc&){
+			return criticalError("Out of memory");
+		}
+	}
+
+	if(object.parent != 0){
+		auto old_parent = objects.find(object.parent);
+		if(old_parent != objects.end()){
+			auto& siblings = old_parent->second.children;
+			siblings.erase(std::remove(siblings.begin(), siblings.end(), id), siblings.end());
+		}
+	}
+
+	object.parent = parent_id;
+	hierarchy_dirty = true;
+	return noError();
+}
+
+/**
+* @todo design better interface and check occlusion
+*/
+void Ogl33Scene::visit(const Ogl33Camera&, std::vector<RenderObject*>& render_queue){
+	render_queue.reserve(objects.size());
+	for(auto& iter: objects){
+		if(iter.second.visible && iter.second.static_chunk == RenderObject::no_chunk){
+			render_queue.push_back(&iter.second);
+		}
+	}
+}
+
+void Ogl33Scene::updateState(float interval){
+	// Backwards, so deactivating only moves already visited objects
+	for(size_t i = active_objects.size(); i > 0; --i){
+		auto find = objects.find(active_objects[i-1]);
+		assert(find != objects.end());
+		if(find == objects.end()){
+			continue;
+		}
+		RenderObject& object = find->second;
+
+		if(interval >= 1.f){
+			// Snap instead of converging on the rounding error of slerp2D
+			object.old_pos = object.pos;
+			object.old_angle = object.angle;
+		}else{
+			object.old_pos[0] = object.pos[0] * interval + object.old_pos[0] * (1.f - interval);
+			object.old_pos[1] = object.pos[1] * interval + object.old_pos[1] * (1.f - interval);
+
+			object.old_angle = slerp2D<float>(object.old_angle, object.angle, interval);
+			object.old_angle /= std::abs(object.old_angle);
+		}
+		markDirty(active_objects[i-1], object);
+
+		if(object.old_pos == object.pos && object.old_angle == object.angle){
+			deactivate(object);
+		}
+	}
+}
+
+ErrorOr<RenderSceneSnapshots*> Ogl33Scene::createSnapshots() noexcept {
+	return snapshots.create();
+}
+
+void Ogl33Scene::applySnapshots(const std::chrono::steady_clock::time_point& tp){
+	snapshots.update(objects, tp, [this](const RenderObjectId& id, RenderObject& object, const RenderSceneSnapshot& snapshot, size_t i, bool listed_before){
+		if(i >= snapshot.x.size() || i >= snapshot.y.size() || i >= snapshot.angle.size()){
+			return;
+		}
+		// Interpolated between snapshots from now on instead of by updateState
+		deactivate(object);
+
+		object.old_pos = object.pos;
+		object.old_angle = object.angle;
+		object.pos = {{snapshot.x[i], snapshot.y[i]}};
+		object.angle = std::polar(1.f, snapshot.angle[i]);
+		if(!listed_before){
+			object.old_pos = object.pos;
+			object.old_angle = object.angle;
+		}
+		markDirty(id, object);
+	});
+}
+
+float Ogl33Scene::interpolation(float frame_interpolation) const {
+	return snapshots.interpolationOr(frame_interpolation);
+}
+
+size_t Ogl33Scene::activeObjectCount() const {
+	return active_objects.size();
+}
+
+size_t Ogl33Scene::staticObjectCount() const {
+	return objects.size() - active_objects.size();
+}
+
+uint64_t Ogl33Scene::structureVersion() const {
+	return structure_version;
+}
+
+Ogl33PersistentObjectBuffer& Ogl33Scene::gpuObjects(){
+	return gpu_objects;
+}
+
+namespace {
+/// Box around the mesh after transforming it, but never wider than its bounding sphere
+Ogl33Aabb worldBounds(const Ogl33Mesh3d& mesh, const Transform3<float>& transform){
+	Matrix<float, 4, 4> model = transform.toMatrix();
+	std::array<float, 3> centre = mesh.boundingBox().centre();
+	std::array<float, 3> extent = mesh.boundingBox().extent();
+	float scale = std::max({std::abs(transform.scale(0)), std::abs(transform.scale(1)), std::abs(transform.scale(2))});
+
+	std::array<float, 3> world_centre;
+	std::array<float, 3> world_extent;
+	for(size_t i = 0; i < 3; ++i){
+		world_centre[i] = model(i,3);
+		world_extent[i] = 0.f;
+		for(size_t j = 0; j < 3; ++j){
+			world_centre[i] += model(i,j) * centre[j];
+			world_extent[i] += std::abs(model(i,j)) * extent[j];
+		}
+		world_extent[i] = std::min(world_extent[i], mesh.boundingRadius() * scale);
+	}
+	return Ogl33Aabb::fromCentre(world_centre, world_extent);
+}
+}
+
+ErrorOr<RenderObject3dId> Ogl33Scene3d::createObject(const RenderProperty3dId& id) noexcept {
+	RenderObject3dId o_id = searchForFreeId(objects);
+
+	try{
+		uint32_t slot;
+		if(free_slots.empty()){
+			slot = static_cast<uint32_t>(slot_objects.size());
+			slot_objects.push_back(nullptr);
+		}else{
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+
+		RenderObject object{id};
+		object.slot = slot;
+		auto iter = objects.insert(std::make_pair(o_id, object)).first;
+		slot_objects[slot] = &iter->second;
+		markBoundsDirty(o_id, iter->second);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	// A snapshot may have listed the id before it existed
+	snapshots.forget();
+
+	return o_id;
+}
+
+void Ogl33Scene3d::destroyObject(const RenderObject3dId& id) noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return;
+	}
+	snapshots.forget();
+
+	RenderObject& object = find->second;
+	if(object.leaf != Ogl33Bvh::null_node){
+		bvh.remove(object.leaf);
+	}
+	slot_objects[object.slot] = nullptr;
+	try{
+		free_slots.push_back(object.slot);
+	}catch(const std::bad_alloc&){
+		// The slot is lost, but stays valid
+	}
+
+	objects.erase(find);
+}
+
+void Ogl33Scene3d::markBoundsDirty(const RenderObject3dId& id, RenderObject& object){
+	if(object.bounds_dirty){
+		return;
+	}
+	try{
+		bounds_dirty.push_back(id);
+	}catch(const std::bad_alloc&){
+		// Keeps the old bounds until the object moves again
+		return;
+	}
+	object.bounds_dirty = true;
+}
+
+Error Ogl33Scene3d::setObjectPosition(const RenderObject3dId& id, float x, float y, float z)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.transform.position = {x, y, z};
+	markBoundsDirty(id, find->second);
+
+	return noError();
+}
+
+Error Ogl33Scene3d::setObjectRotation(const RenderObject3dId& id, float a, float b, float g)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.transform.rotation = Quaternion<float>::fromEuler(a, b, g);
+	markBoundsDirty(id, find->second);
+
+	return noError();
+}
+
+Error Ogl33Scene3d::setObjectOrientation(const RenderObject3dId& id, float x, float y, float z, float w)noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.transform.rotation = Quaternion<float>{x, y, z, w}.normalized();
+	markBoundsDirty(id, find->second);
+
+	return noError();
+}
+
+Error Ogl33Scene3d::setObjectVisibility(const RenderObject3dId& id, bool visible) noexcept{
+	auto find = objects.find(id);
+	if(find == objects.end()){
+		return criticalError("Couldn't find object");
+	}
+
+	find->second.visible = visible;
+
+	return noError();
+}
+
+void Ogl33Scene3d::updateBounds(Ogl33Render& render) noexcept {
+	size_t kept = 0;
+	for(size_t i = 0; i < bounds_dirty.size(); ++i){
+		auto find = objects.find(bounds_dirty[i]);
+		if(find == objects.end() || !find->second.bounds_dirty){
+			continue;
+		}
+		RenderObject& object = find->second;
+
+		Ogl33RenderProperty3d* property = render.getRenderProperty3d(object.id);
+		Ogl33Mesh3d* mesh = property ? render.getMesh3d(property->mesh_id) : nullptr;
+		if(!mesh){
+			bounds_dirty[kept++] = bounds_dirty[i];
+			continue;
+		}
+
+		Ogl33Aabb box = Ogl33Aabb::merge(worldBounds(*mesh, object.old_transform), worldBounds(*mesh, object.transform));
+		try{
+			if(object.leaf == Ogl33Bvh::null_node){
+				object.leaf = bvh.insert(box, object.slot);
+			}else{
+				bvh.update(object.leaf, box);
+			}
+		}catch(const std::bad_alloc&){
+			bounds_dirty[kept++] = bounds_dirty[i];
+			continue;
+		}
+		object.bounds_dirty = false;
+	}
+	bounds_dirty.resize(kept);
+}
+
+void Ogl33Scene3d::visit(const Ogl33Camera3d& camera, std::vector<RenderObject*>& render_queue){
+	visible_slots.clear();
+	bvh.cull(camera.frustum(), visible_slots);
+
+	render_queue.reserve(render_queue.size() + visible_slots.size());
+	for(auto& slot : visible_slots){
+		RenderObject* object = slot_objects[slot];
+		if(object && object->visible){
+			render_queue.push_back(object);
+		}
+	}
+}
+
+void Ogl33Scene3d::updateState(){
+	for(auto& iter : objects){
+		RenderObject& object = iter.second;
+		if(snapshots.isListed(object)){
+			continue;
+		}
+		if(object.old_transform != object.transform){
+			// The bounds shrink back to the current transform
+			markBoundsDirty(iter.first, object);
+		}
+		object.old_transform = object.transform;
+	}
+}
+
+ErrorOr<RenderScene3dSnapshots*> Ogl33Scene3d::createSnapshots() noexcept {
+	return snapshots.create();
+}
+
+void Ogl33Scene3d::applySnapshots(const std::chrono::steady_clock::time_point& tp){
+	snapshots.update(objects, tp, [this](const RenderObject3dId& id, RenderObject& object, const RenderScene3dSnapshot& snapshot, size_t i, bool listed_before){
+		if(i >= snapshot.transforms.size()){
+			return;
+		}
+		object.old_transform = object.transform;
+		object.transform = snapshot.transforms.get(i);
+		if(!listed_before){
+			object.old_transform = object.transform;
+		}
+		markBoundsDirty(id, object);
+	});
+}
+
+float Ogl33Scene3d::interpolation(float frame_interpolation) const {
+	return snapshots.interpolationOr(frame_interpolation);
+}
+
+const Ogl33Bvh& Ogl33Scene3d::boundingVolumes() const {
+	return bvh;
+}
+
+Ogl33RenderStage::Ogl33RenderStage(const RenderTargetId& target, const RenderViewportId& viewport, const RenderSceneId& scene, const RenderCameraId& camera, const ProgramId& program):
+	target_id{target},
+	viewport_id{viewport},
+	scene_id{scene},
+	camera_id{camera},
+	program_id{program}
+{}
+
+namespace {
+struct Ogl33DrawItem {
+	Ogl33Scene::RenderObject* object;
+	MeshId mesh_id;
+	TextureId texture_id;
+	Ogl33Mesh* mesh;
+	Ogl33Texture* texture;
+	// Only set for flipbooks. Objects of different flipbooks can't share a draw.
+	const Ogl33RenderProperty* flipbook;
+	RenderPropertyId property_id;
+};
+
+bool sameDrawRun(const Ogl33DrawItem& a, const Ogl33DrawItem& b){
+	return a.texture_id == b.texture_id && a.mesh_id == b.mesh_id && a.flipbook == b.flipbook;
+}
+
+/**
+* Collects the visible objects sorted by texture, mesh and flipbook, so objects sharing
+* them end up next to each other and can be drawn instanced
+*/
+void collectDrawItems(Ogl33Render& render, Ogl33Scene& scene, Ogl33Camera& camera, std::vector<Ogl33DrawItem>& draw_items){
+	std::vector<Ogl33Scene::RenderObject*> draw_queue;
+	scene.visit(camera, draw_queue);
+
+	draw_items.reserve(draw_queue.size());
+	for(auto& iter : draw_queue){
+		Ogl33RenderProperty* property = render.getProperty(iter->id);
+		assert(property);
+		if(!property){
+			continue;
+		}
+		Ogl33Mesh* mesh = render.getMesh(property->mesh_id);
+		assert(mesh);
+		if(!mesh){
+			continue;
+		}
+		Ogl33Texture* texture = render.getTexture(property->texture_id);
+		assert(texture);
+		if(!texture){
+			continue;
+		}
+		const Ogl33RenderProperty* flipbook = property->flipbook.frames.empty() ? nullptr : property;
+		draw_items.push_back(Ogl33DrawItem{iter, property->mesh_id, property->texture_id, mesh, texture, flipbook, iter->id});
+	}
+
+	std::sort(draw_items.begin(), draw_items.end(), [](const Ogl33DrawItem& a, const Ogl33DrawItem& b){
+		if(a.texture_id != b.texture_id){
+			return a.texture_id < b.texture_id;
+		}
+		if(a.mesh_id != b.mesh_id){
+			return a.mesh_id < b.mesh_id;
+		}
+		if(!a.flipbook || !b.flipbook){
+			return !a.flipbook && b.flipbook;
+		}
+		return a.property_id < b.property_id;
+	});
+}
+
+/// Chunk i reads its identity transform at offset + i. Chunks outside of view are skipped.
+void drawStaticChunks(Ogl33Render& render, const Ogl33Scene& scene, Ogl33Program& program, GLint offset, size_t count, const Ogl33Tilemap::Bounds& view){
+	const std::vector<Ogl33Scene::StaticChunk>& chunks = scene.staticChunks();
+	count = std::min(count, chunks.size());
+	for(size_t i = 0; i < count; ++i){
+		const Ogl33Scene::StaticChunk& chunk = chunks[i];
+		if(chunk.index_count == 0){
+			continue;
+		}
+		if(chunk.bounds[2] < view[0] || chunk.bounds[0] > view[2] || chunk.bounds[3] < view[1] || chunk.bounds[1] > view[3]){
+			continue;
+		}
+		Ogl33Texture* texture = render.getTexture(chunk.texture_id);
+		if(!texture){
+			continue;
+		}
+
+		program.setTexture(*texture);
+		program.setMesh(chunk.mesh);
+		program.setObjectOffset(offset + static_cast<GLint>(i));
+		glDrawElementsInstanced(GL_TRIANGLES, chunk.index_count, GL_UNSIGNED_INT, 0L, 1);
+	}
+}
+
+void drawTilemap(Ogl33Render& render, Ogl33Tilemap& tilemap, Ogl33Program& program, GLint offset, const Ogl33Tilemap::Bounds& view){
+	Ogl33Texture* texture = render.getTexture(tilemap.atlas());
+	if(!texture){
+		return;
+	}
+
+	program.setTexture(*texture);
+	program.setObjectOffset(offset);
+	tilemap.draw(view);
+}
+
+template<typename Func>
+void forEachDrawRun(const std::vector<Ogl33DrawItem>& draw_items, Func&& func){
+	for(size_t begin = 0; begin < draw_items.size();){
+		size_t end = begin + 1;
+		while(end < draw_items.size() && sameDrawRun(draw_items[begin], draw_items[end])){
+			++end;
+		}
+		func(begin, end);
+		begin = end;
+	}
+}
+}
+
+void Ogl33RenderStage::renderStreamed(Ogl33Render& render, Ogl33Scene& scene, Ogl33Camera& camera, Ogl33Program& program, float time_interval){
+	std::vector<Ogl33DrawItem> draw_items;
+	collectDrawItems(render, scene, camera, draw_items);
+
+	// Two texels per object holding the rows of its 2x3 transform. The layer and flipbook start are stored in w.
+	const std::vector<Ogl33Scene::StaticChunk>& chunks = scene.staticChunks();
+	std::vector<Ogl33ObjectBuffer::Texel>& texels = render.getResources().object_buffer.data();
+	std::unordered_map<RenderTilemapId, Ogl33Tilemap>& tilemaps = scene.getTilemaps();
+	texels.reserve((draw_items.size() + chunks.size() + tilemaps.size()) * 2);
+	for(auto& iter : draw_items){
+		const Ogl33Scene::RenderObject& object = *iter.object;
+		std::complex<float> interpol_angle = slerp2D<float>(object.old_world_angle, object.world_angle, time_interval);
+
+		float x = object.world_pos[0] * ( time_interval ) + object.old_world_pos[0] * ( 1.f - time_interval );
+		float y = object.world_pos[1] * ( time_interval ) + object.old_world_pos[1] * ( 1.f - time_interval );
+
+		texels.push_back({std::real(interpol_angle), -std::imag(interpol_angle), x, object.layer});
+		texels.push_back({std::imag(interpol_angle), std::real(interpol_angle), y, object.flipbook_start});
+	}
+	// Baked vertices are already in world space
+	for(auto& iter : chunks){
+		texels.push_back({1.f, 0.f, 0.f, iter.layer});
+		texels.push_back({0.f, 1.f, 0.f, 0.f});
+	}
+	for(auto& iter : tilemaps){
+		texels.push_back({1.f, 0.f, iter.second.position[0], iter.second.layer});
+		texels.push_back({0.f, 1.f, iter.second.position[1], 0.f});
+	}
+	render.getResources().object_buffer.upload();
+
+	program.use();
+
+	forEachDrawRun(draw_items, [&](size_t begin, size_t end){
+		const Ogl33RenderProperty* flipbook = draw_items[begin].flipbook;
+		program.setTexture(*draw_items[begin].texture);
+		program.setMesh(*draw_items[begin].mesh);
+		program.setFlipbook(flipbook ? &flipbook->flipbook : nullptr);
+		program.setObjectOffset(static_cast<GLint>(begin));
+		glDrawElementsInstanced(GL_TRIANGLES, draw_items[begin].mesh->indexCount(), GL_UNSIGNED_INT, 0L, static_cast<GLsizei>(end - begin));
+	});
+	program.setFlipbook(nullptr);
+
+	Ogl33Tilemap::Bounds view = camera.visibleBounds(time_interval);
+	drawStaticChunks(render, scene, program, static_cast<GLint>(draw_items.size()), chunks.size(), view);
+
+	GLint tilemap_offset = static_cast<GLint>(draw_items.size() + chunks.size());
+	for(auto& iter : tilemaps){
+		drawTilemap(render, iter.second, program, tilemap_offset++, view);
+	}
+}
+
+void Ogl33RenderStage::renderPersistent(Ogl33Render& render, Ogl33Scene& scene, Ogl33Camera& camera, Ogl33Program& program, float time_interval){
+	uint64_t property_version = render.getRender2D().getResources().property_version;
+
+	// The batches only depend on which objects are visible and how they look, not where they are
+	if(cached_scene != &scene || cached_scene_version != scene.structureVersion() || cached_property_version != property_version){
+		std::vector<Ogl33DrawItem> draw_items;
+		collectDrawItems(render, scene, camera, draw_items);
+
+		const std::vector<Ogl33Scene::StaticChunk>& chunks = scene.staticChunks();
+		std::vector<uint32_t> slots;
+		slots.reserve(draw_items.size() + chunks.size());
+		for(auto& iter : draw_items){
+			slots.push_back(iter.object->slot);
+		}
+		for(auto& iter : chunks){
+			slots.push_back(iter.slot);
+		}
+		tilemap_offsets.clear();
+		for(auto& iter : scene.getTilemaps()){
+			tilemap_offsets.push_back(std::make_pair(iter.first, static_cast<GLint>(slots.size())));
+			slots.push_back(iter.second.slot);
+		}
+		instance_slots.upload(slots);
+		static_chunk_offset = static_cast<GLint>(draw_items.size());
+		static_chunk_count = chunks.size();
+
+		batches.clear();
+		forEachDrawRun(draw_items, [&](size_t begin, size_t end){
+			const Ogl33DrawItem& item = draw_items[begin];
+			batches.push_back(Batch{item.mesh_id, item.texture_id, item.flipbook != nullptr, item.property_id, static_cast<GLint>(begin), static_cast<GLsizei>(end - begin)});
+		});
+
+		cached_scene = &scene;
+		cached_scene_version = scene.structureVersion();
+		cached_property_version = property_version;
+	}
+
+	// Only objects changed since the last upload are sent
+	scene.gpuObjects().upload();
+	scene.gpuObjects().bind();
+	instance_slots.bind();
+
+	program.use();
+
+	for(auto& iter : batches){
+		Ogl33Mesh* mesh = render.getMesh(iter.mesh_id);
+		Ogl33Texture* texture = render.getTexture(iter.texture_id);
+		if(!mesh || !texture){
+			continue;
+		}
+
+		const Ogl33RenderProperty* property = iter.flipbook ? render.getProperty(iter.property_id) : nullptr;
+
+		program.setTexture(*texture);
+		program.setMesh(*mesh);
+		program.setFlipbook(property ? &property->flipbook : nullptr);
+		program.setObjectOffset(iter.offset);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount(), GL_UNSIGNED_INT, 0L, iter.count);
+	}
+	program.setFlipbook(nullptr);
+
+	Ogl33Tilemap::Bounds view = camera.visibleBounds(time_interval);
+	drawStaticChunks(render, scene, program, static_chunk_offset, static_chunk_count, view);
+
+	for(auto& iter : tilemap_offsets){
+		auto find = scene.getTilemaps().find(iter.first);
+		if(find != scene.getTilemaps().end()){
+			drawTilemap(render, find->second, program, iter.second, view);
+		}
+	}
+}
+
+void Ogl33RenderStage::renderParticles(Ogl33Render& render, Ogl33Scene& scene){
+	std::unordered_map<RenderEmitterId, Ogl33ParticleEmitter>& emitters = scene.getEmitters();
+	if(emitters.empty()){
+		return;
+	}
+
+	Ogl33Resources2D& resources_2d = render.getRender2D().getResources();
+	Ogl33Program* program = render.getProgram(resources_2d.particle_program);
+	Ogl33Mesh* mesh = render.getMesh(resources_2d.particle_mesh);
+	if(!program || !mesh){
+		return;
+	}
+
+	// All emitters share one upload, each one is a single instanced draw
+	std::vector<Ogl33ObjectBuffer::Texel>& texels = render.getResources().object_buffer.data();
+	size_t particles = 0;
+	for(auto& iter : emitters){
+		particles += iter.second.particleCount();
+	}
+	if(particles == 0){
+		return;
+	}
+	try{
+		texels.reserve(particles * 2);
+	}catch(const std::bad_alloc&){
+		return;
+	}
+	for(auto& iter : emitters){
+		iter.second.write(texels);
+	}
+	render.getResources().object_buffer.upload();
+
+	program->use();
+	program->setMesh(*mesh);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	GLint offset = 0;
+	for(auto& iter : emitters){
+		GLsizei count = static_cast<GLsizei>(iter.second.particleCount());
+		Ogl33Texture* texture = render.getTexture(iter.second.texture());
+		if(count > 0 && texture){
+			program->setTexture(*texture);
+			program->setObjectOffset(offset);
+			glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount(), GL_UNSIGNED_INT, 0L, count);
+		}
+		offset += count;
+	}
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
+
+void Ogl33RenderStage::render(Ogl33Render& render, Ogl33FrameData frame){
+	Ogl33Scene* scene = render.getScene(scene_id);
+	assert(scene);
+	if(!scene){
+		return;
+	}
+	Ogl33Camera* camera = render.getCamera(camera_id);
+	assert(camera);
+	if(!camera){
+		return;
+	}
+	Ogl33Program* program = render.getProgram(program_id);
+	assert(program);
+	if(!program){
+		return;
+	}
+	Ogl33RenderTarget* target = render.getResources().render_targets[target_id];
+	assert(target);
+	if(!target){
+		return;
+	}
+
+	target->useReversedDepth(false);
+
+	frame.setViewProjection(camera->projection()*camera->view(frame.interpolation));
+	frame.viewport_size = {static_cast<float>(target->width()), static_cast<float>(target->height())};
+	// Scenes fed by snapshots keep their own pace, only the camera follows the frame
+	frame.interpolation = scene->interpolation(frame.interpolation);
+	render.getResources().frame_buffer.upload(frame);
+
+	if(program->features() & ProgramFeature::GpuInterpolation){
+		renderPersistent(render, *scene, *camera, *program, frame.interpolation);
+	}else{
+		renderStreamed(render, *scene, *camera, *program, frame.interpolation);
+	}
+
+	renderParticles(render, *scene);
+}
+
+Ogl33RenderStage3d::Ogl33RenderStage3d(const RenderTargetId& target, const RenderViewportId& viewport, const RenderScene3dId& scene, const RenderCamera3dId& camera, const Program3dId& program):
+	target_id{target},
+	viewport_id{viewport},
+	scene_id{scene},
+	camera_id{camera},
+	program_id{program}
+{}
+
+namespace {
+struct Ogl33DrawItem3d {
+	Ogl33Scene3d::RenderObject* object;
+	Mesh3dId mesh_id;
+	TextureId texture_id;
+	Ogl33Mesh3d* mesh;
+	Ogl33Texture* texture;
+	uint32_t lod;
+
+	float depth;
+	uint16_t key;
+	uint32_t batch;
+};
+
+/**
+* Radius of the transformed bounding sphere over half the viewport height. Cameras
+* inside the sphere see it at full size.
+*/
+float screenSize(const Ogl33Mesh3d& mesh, const Transform3<float>& transform, const Ogl33Camera3d& camera){
+	std::array<float, 3> local = mesh.boundingBox().centre();
+	Vector<float, 3> centre = transform.apply({local[0], local[1], local[2]});
+	float scale = std::max({std::abs(transform.scale(0)), std::abs(transform.scale(1)), std::abs(transform.scale(2))});
+	float radius = mesh.boundingRadius() * scale;
+
+	float scale_y = std::abs(camera.projection()(1,1));
+	// The size doesn't shrink with the distance
+	if(!camera.isPerspective()){
+		return radius * scale_y;
+	}
+
+	const Matrix<float, 4, 4>& view = camera.view();
+	std::array<float, 3> eye;
+	for(size_t i = 0; i < 3; ++i){
+		eye[i] = view(i,3);
+		for(size_t j = 0; j < 3; ++j){
+			eye[i] += view(i,j) * centre(j);
+		}
+	}
+	float distance = std::sqrt(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]);
+	// Inside the sphere or its centre behind the camera
+	if(distance <= radius || eye[2] >= 0.f){
+		return std::numeric_limits<float>::infinity();
+	}
+	return radius * scale_y / -eye[2];
+}
+
+/// Distance of the object's origin in front of the camera
+float viewDepth(const Transform3<float>& transform, const Ogl33Camera3d& camera){
+	const Matrix<float, 4, 4>& view = camera.view();
+	float z = view(2,3);
+	for(size_t i = 0; i < 3; ++i){
+		z += view(2,i) * transform.position(i);
+	}
+	return -z;
+}
+
+bool sameBatch(const Ogl33DrawItem3d& a, const Ogl33DrawItem3d& b){
+	return a.mesh_id == b.mesh_id && a.texture_id == b.texture_id && a.lod == b.lod;
+}
+
+/**
+* Stable LSD radix sort on the depths quantised to 16 bits over their range, two passes
+* of eight bits each.
+*/
+void sortByDepth(std::vector<Ogl33DrawItem3d>& items, bool back_to_front, std::vector<Ogl33DrawItem3d>& scratch){
+	if(items.size() < 2){
+		return;
+	}
+
+	auto range = std::minmax_element(items.begin(), items.end(), [](const Ogl33DrawItem3d& a, const Ogl33DrawItem3d& b){
+		return a.depth < b.depth;
+	});
+	float min = range.first->depth;
+	float max = range.second->depth;
+	float scale = max > min ? 65535.f / (max - min) : 0.f;
+	for(auto& iter : items){
+		iter.key = static_cast<uint16_t>((iter.depth - min) * scale);
+		if(back_to_front){
+			iter.key = static_cast<uint16_t>(65535 - iter.key);
+		}
+	}
+
+	scratch.resize(items.size());
+	for(uint32_t shift = 0; shift < 16; shift += 8){
+		std::array<size_t, 257> offsets{};
+		for(auto& iter : items){
+			++offsets[((iter.key >> shift) & 0xff) + 1];
+		}
+		for(size_t i = 1; i < offsets.size(); ++i){
+			offsets[i] += offsets[i - 1];
+		}
+		for(auto& iter : items){
+			scratch[offsets[(iter.key >> shift) & 0xff]++] = iter;
+		}
+		items.swap(scratch);
+	}
+}
+
+/**
+* Regroups depth sorted items into instanced batches. Batches are ordered by their
+* nearest object and keep their objects front to back, so most of the early depth
+* rejection stays while every batch is still one draw call.
+*/
+void groupBatches(std::vector<Ogl33DrawItem3d>& items, std::vector<Ogl33DrawItem3d>& scratch){
+	struct Key {
+		uint64_t ids;
+		uint32_t lod;
+
+		bool operator==(const Key& rhs) const {
+			return ids == rhs.ids && lod == rhs.lod;
+		}
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			return std::hash<uint64_t>{}(key.ids * 31 + key.lod);
+		}
+	};
+
+	std::unordered_map<Key, uint32_t, KeyHash> ranks;
+	std::vector<size_t> offsets;
+	for(auto& iter : items){
+		Key key{(static_cast<uint64_t>(iter.texture_id) << 32) | iter.mesh_id, iter.lod};
+		uint32_t rank = ranks.emplace(key, static_cast<uint32_t>(ranks.size())).first->second;
+		if(rank == offsets.size()){
+			offsets.push_back(0);
+		}
+		iter.batch = rank;
+		++offsets[rank];
+	}
+
+	size_t begin = 0;
+	for(auto& iter : offsets){
+		size_t count = iter;
+		iter = begin;
+		begin += count;
+	}
+
+	scratch.resize(items.size());
+	for(auto& iter : items){
+		scratch[offsets[iter.batch]++] = iter;
+	}
+	items.swap(scratch);
+}
+}
+
+void Ogl33RenderStage3d::render(Ogl33Render& render, Ogl33FrameData frame){
+	Ogl33Scene3d* scene = render.getScene3d(scene_id);
+	assert(scene);
+	if(!scene){
+		return;
+	}
+
+	Ogl33Camera3d* camera = render.getCamera3d(camera_id);
+	assert(camera);
+	if(!camera){
+		return;
+	}
+
+	Ogl33Program3d* program = render.getProgram3d(program_id);
+	assert(program);
+	if(!program){
+		return;
+	}
+
+	Ogl33RenderTarget* target = render.getResources().render_targets[target_id];
+	assert(target);
+	if(!target){
+		return;
+	}
+
+	// Missing if it couldn't be compiled, then the pre-pass is skipped
+	Ogl33Program3d* depth_program = nullptr;
+	if(passes.depth_prepass){
+		depth_program = render.getRender3D().getDepthProgram3d(program_id);
+	}
+
+	std::vector<Ogl33Scene3d::RenderObject*> draw_queue;
+	std::vector<Ogl33DrawItem3d> draw_items;
+	std::vector<Ogl33DrawItem3d> transparent_items;
+	try{
+		scene->visit(*camera, draw_queue);
+
+		draw_items.reserve(draw_queue.size());
+		for(auto& iter : draw_queue){
+			Ogl33RenderProperty3d* property = render.getRenderProperty3d(iter->id);
+			if(!property){
+				continue;
+			}
+			Ogl33Mesh3d* mesh = render.getMesh3d(property->mesh_id);
+			if(!mesh){
+				continue;
+			}
+			Ogl33Texture* texture = render.getTexture(property->texture_id);
+			if(!texture){
+				continue;
+			}
+
+			if(iter->slot >= object_lods.size()){
+				object_lods.resize(iter->slot + 1, 0);
+			}
+			uint32_t& last_lod = object_lods[iter->slot];
+			last_lod = static_cast<uint32_t>(mesh->selectLevel(screenSize(*mesh, iter->transform, *camera), last_lod, lod_hysteresis));
+
+			Ogl33DrawItem3d item{iter, property->mesh_id, property->texture_id, mesh, texture, last_lod, viewDepth(iter->transform, *camera), 0, 0};
+			if(property->transparent && passes.transparent_pass){
+				transparent_items.push_back(item);
+			}else{
+				draw_items.push_back(item);
+			}
+		}
+
+		std::vector<Ogl33DrawItem3d> scratch;
+		if(passes.sort_opaque){
+			sortByDepth(draw_items, false, scratch);
+			groupBatches(draw_items, scratch);
+		}else{
+			// Texture binds are the more expensive switch, so they are changed least
+			std::sort(draw_items.begin(), draw_items.end(), [](const Ogl33DrawItem3d& a, const Ogl33DrawItem3d& b){
+				if(a.texture_id != b.texture_id){
+					return a.texture_id < b.texture_id;
+				}
+				return a.mesh_id != b.mesh_id ? a.mesh_id < b.mesh_id : a.lod < b.lod;
+			});
+		}
+		sortByDepth(transparent_items, true, scratch);
+	}catch(const std::bad_alloc&){
+		return;
+	}
+	size_t opaque_count = draw_items.size();
+
+	frame.setViewProjection(camera->viewProjection());
+	frame.viewport_size = {static_cast<float>(target->width()), static_cast<float>(target->height())};
+	render.getResources().frame_buffer.upload(frame);
+
+	std::vector<Ogl33ObjectBuffer::Texel>& texels = render.getResources().object_buffer.data();
+	try{
+		draw_items.insert(draw_items.end(), transparent_items.begin(), transparent_items.end());
+		from_transforms.clear();
+		to_transforms.clear();
+		from_transforms.reserve(draw_items.size());
+		to_transforms.reserve(draw_items.size());
+		texels.resize(draw_items.size() * 4);
+	}catch(const std::bad_alloc&){
+		return;
+	}
+	for(auto& iter : draw_items){
+		from_transforms.push_back(iter.object->old_transform);
+		to_transforms.push_back(iter.object->transform);
+	}
+	// Four texels per object are the columns of its model matrix
+	float interpolation = scene->interpolation(frame.interpolation);
+	float* matrices = texels.empty() ? nullptr : texels.front().data();
+	if(draw_items.size() >= 8192){
+		render.jobSystem().parallelFor(draw_items.size(), [this, interpolation, matrices](size_t begin, size_t end){
+			buildModelMatrices(from_transforms, to_transforms, interpolation, matrices, begin, end);
+		}, 1024);
+	}else if(matrices){
+		buildModelMatrices(from_transforms, to_transforms, interpolation, matrices);
+	}
+	render.getResources().object_buffer.upload();
+
+	target->useReversedDepth(camera->reversedDepth());
+	GLenum depth_less = GL_LESS;
+	GLenum depth_equal = GL_LEQUAL;
+	if(camera->reversedDepth()){
+		// Without clip control the depth still works, but only uses half of the range
+		if(GLAD_GL_ARB_clip_control){
+			glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+		}
+		depth_less = GL_GREATER;
+		depth_equal = GL_GEQUAL;
+	}
+	glDepthFunc(depth_less);
+
+	statistics = RenderStage3dStatistics{};
+	statistics.drawn_objects = draw_items.size();
+	statistics.transparent_objects = transparent_items.size();
+
+	// The texture is bound in the pre-pass as well, fragment shaders may discard by its alpha
+	auto drawBatches = [&](Ogl33Program3d& prog, size_t begin, size_t end, bool shaded){
+		while(begin < end){
+			const Ogl33DrawItem3d& item = draw_items[begin];
+			size_t batch_end = begin + 1;
+			while(batch_end < end && sameBatch(draw_items[batch_end], item)){
+				++batch_end;
+			}
+
+			const Mesh3dData::Lod& lod = item.mesh->levels()[item.lod];
+			size_t instances = batch_end - begin;
+			prog.setTexture(*item.texture);
+			if(shaded){
+				++statistics.draw_calls;
+				statistics.drawn_triangles += lod.index_count / 3 * instances;
+				statistics.saved_triangles += (item.mesh->levels().front().index_count - lod.index_count) / 3 * instances;
+			}
+			prog.setMesh(*item.mesh);
+			prog.setObjectOffset(static_cast<GLint>(begin));
+			glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(lod.index_count), GL_UNSIGNED_INT, reinterpret_cast<const void*>(lod.first_index * sizeof(GLuint)), static_cast<GLsizei>(instances));
+
+			begin = batch_end;
+		}
+	};
+
+	if(depth_program && opaque_count > 0){
+		depth_program->use();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		drawBatches(*depth_program, 0, opaque_count, false);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		// The depth is final, so only the visible fragments pass
+		glDepthMask(GL_FALSE);
+		glDepthFunc(depth_equal);
+	}
+
+	program->use();
+	drawBatches(*program, 0, opaque_count, true);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(depth_less);
+
+	if(opaque_count < draw_items.size()){
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_FALSE);
+		drawBatches(*program, opaque_count, draw_items.size(), true);
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+
+	if(camera->reversedDepth()){
+		if(GLAD_GL_ARB_clip_control){
+			glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+		}
+	}
+	glDepthFunc(GL_LESS);
+}
+
+Ogl33Render2D::Ogl33Render2D(Ogl33Render& r):resources{r.getResources()},render{&r}{}
+
+Ogl33Render::Ogl33Render(Own<GlContext>&& ctx):
+	context{std::move(ctx)},
+	render_2d{*this},
+	render_3d{*this},
+	start_time_point{std::chrono::steady_clock::now()},
+	old_time_point{start_time_point},
+	time_point{old_time_point}
+{
+}
+
+Ogl33Render::~Ogl33Render(){
+	if(loaded_glad){
+	}
+}
+
+namespace {
+template<typename K, typename T>
+struct Ogl33RenderContainerReturnHelper;
+
+template<typename K, typename T>
+struct Ogl33RenderContainerReturnHelper {
+	static T* getElement(std::unordered_map<K, T>& ctr, const K& id){
+		auto iter = ctr.find(id);
+		if(iter != ctr.end()){
+			return &iter->second;
+		}
+		return nullptr;
+	}
+};
+
+template<typename K, typename T>
+struct Ogl33RenderContainerReturnHelper<K, Own<T>> {
+	static T* getElement(std::unordered_map<K, Own<T>>& ctr, const K& id){
+		auto iter = ctr.find(id);
+		if(iter != ctr.end()){
+			return iter->second.get();
+		}
+		return nullptr;
+	}
+};
+}
+
+Ogl33Scene* Ogl33Render::getScene(const RenderSceneId& id) noexcept {
+	auto iter = render_2d.getResources().scenes.find(id);
+	if(iter != render_2d.getResources().scenes.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Camera* Ogl33Render::getCamera(const RenderCameraId& id) noexcept {
+	auto iter = render_2d.getResources().cameras.find(id);
+	if(iter != render_2d.getResources().cameras.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Program* Ogl33Render::getProgram(const ProgramId& id) noexcept {
+	return render_2d.getCompiledProgram(id);
+}
+
+Ogl33RenderProperty* Ogl33Render::getProperty(const RenderPropertyId& id) noexcept {
+	auto iter = render_2d.getResources().render_properties.find(id);
+	if(iter != render_2d.getResources().render_properties.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Mesh* Ogl33Render::getMesh(const MeshId& id) noexcept {
+	auto iter = render_2d.getResources().meshes.find(id);
+	if(iter != render_2d.getResources().meshes.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Texture* Ogl33Render::getTexture(const TextureId& id) noexcept {
+	auto iter = resources.textures.find(id);
+	if(iter != resources.textures.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33PostProgram* Ogl33Render::getPostProgram(const PostProgramId& id) noexcept {
+	auto iter = resources.post_programs.find(id);
+	if(iter != resources.post_programs.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Scene3d* Ogl33Render::getScene3d(const RenderScene3dId& id) noexcept {
+	auto iter = render_3d.getResources().scenes_3d.find(id);
+	if(iter != render_3d.getResources().scenes_3d.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Camera3d* Ogl33Render::getCamera3d(const RenderCamera3dId& id) noexcept {
+	auto iter = render_3d.getResources().cameras_3d.find(id);
+	if(iter != render_3d.getResources().cameras_3d.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Program3d* Ogl33Render::getProgram3d(const Program3dId& id) noexcept {
+	auto iter = render_3d.getResources().programs_3d.find(id);
+	if(iter != render_3d.getResources().programs_3d.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33RenderProperty3d* Ogl33Render::getRenderProperty3d(const RenderProperty3dId& id) noexcept {
+	auto iter = render_3d.getResources().render_properties_3d.find(id);
+	if(iter != render_3d.getResources().render_properties_3d.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+Ogl33Mesh3d* Ogl33Render::getMesh3d(const Mesh3dId& id) noexcept {
+	auto iter = render_3d.getResources().meshes_3d.find(id);
+	if(iter != render_3d.getResources().meshes_3d.end()){
+		return &iter->second;
+	}
+	return nullptr;
+}
+
+ErrorOr<MeshId> Ogl33Render2D::createMesh(const MeshData& data) noexcept {
+	MeshId id = searchForFreeId(resources.meshes);
+
+	/// @todo ensure that the current render context is bound
+	try{
+		resources.meshes.insert(std::make_pair(id, createOgl33Mesh(data)));
+	}catch(const std::bad_alloc& ){
+		return criticalError("Out of memory");
+	}
+	return id;
+}
+
+Error Ogl33Render2D::setMeshData(const MeshId& id, const MeshData& data) noexcept {
+	auto find = resources.meshes.find(id);
+	if(find == resources.meshes.end()){
+		return recoverableError("Couldn't find mesh");
+	}
+
+	try{
+		find->second.setData(data);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	// Baked static geometry uses the mesh data as well
+	++resources.property_version;
+	return noError();
+}
+
+/// @todo check if an error might be necessary
+Error Ogl33Render2D::destroyMesh(const MeshId& id) noexcept {
+
+	resources.meshes.erase(id);
+
+	return noError();
+}
+
+namespace {
+/// @todo get correct type. Not sure if it's GLint or GLuint
+GLint translateImageChannel(uint8_t channels){
+	std::array<GLint, 4> data{GL_RED, GL_RG, GL_RGB, GL_RGBA};
+	if(channels > 4 || channels == 0){
+		return GL_RGBA;
+	}
+	return data[channels-1];
+}
+}
+
+namespace {
+GLuint createOgl33Texture(){
+	GLuint texture_id;
+	glGenTextures(1, &texture_id);
+	glBindTexture(GL_TEXTURE_2D, texture_id);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	return texture_id;
+}
+
+GLenum translateCompressedFormat(TextureFormat format){
+	switch(format){
+		case TextureFormat::BC1:
+			return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TextureFormat::BC3:
+			return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case TextureFormat::BC7:
+			return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+		case TextureFormat::RGBA8:
+			break;
+	}
+	return GL_RGBA;
+}
+}
+
+ErrorOr<TextureId> Ogl33Render::createTexture(const Image& image) noexcept {
+	GLuint texture_id = createOgl33Texture();
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	
+	TextureId t_id = searchForFreeId(resources.textures);
+
+	try{
+		resources.textures.insert(std::make_pair(t_id, Ogl33Texture{texture_id}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	return t_id;
+}
+
+ErrorOr<TextureId> Ogl33Render::createTexture(const CompressedImage& image) noexcept {
+	if(!supportsTextureFormat(image.format) || image.format == TextureFormat::RGBA8){
+		return criticalError("Compressed texture format not supported");
+	}
+
+	GLuint texture_id = createOgl33Texture();
+
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, translateCompressedFormat(image.format), image.width, image.height, 0, image.blocks.size(), image.blocks.data());
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	TextureId t_id = searchForFreeId(resources.textures);
+
+	try{
+		resources.textures.insert(std::make_pair(t_id, Ogl33Texture{texture_id}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	return t_id;
+}
+
+/**
+* Extension flags are only valid after glad has been loaded,
+* which happens with the first window
+*/
+bool Ogl33Render::supportsTextureFormat(TextureFormat format) const noexcept {
+	switch(format){
+		case TextureFormat::RGBA8:
+			return true;
+		case TextureFormat::BC1:
+		case TextureFormat::BC3:
+			return loaded_glad && GLAD_GL_EXT_texture_compression_s3tc;
+		case TextureFormat::BC7:
+			return loaded_glad && GLAD_GL_ARB_texture_compression_bptc;
+	}
+	return false;
+}
+
+/// @todo check if an error might be necessary
+Error Ogl33Render::destroyTexture(const TextureId& id) noexcept {
+	resources.textures.erase(id);
+
+	return noError();
+}
+
+ErrorOr<RenderWindowId> Ogl33Render::createWindow(const RenderVideoMode& mode, const std::string& title) noexcept {
+	auto gl_win = context->createWindow(VideoMode{mode.width,mode.height}, title);
+	if(!gl_win){
+		return criticalError("Couldn't create window");
+	}
+
+	gl_win->bind();
+	if(!loaded_glad){
+		if(!gladLoadGL()){
+			std::cout<<"Failed to load glad"<<std::endl;
+			return 0;
+		}
+		loaded_glad = true;
+
+		if(GLAD_GL_KHR_parallel_shader_compile){
+			// Let the driver pick the amount of compiler threads
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		}
+	}
+
+	try{
+		auto id = resources.render_targets.insert(Ogl33Window{std::move(gl_win)});
+		return static_cast<RenderWindowId>(id);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	} 
+}
+
+Error Ogl33Render::setWindowDesiredFPS(const RenderWindowId& id, float fps) noexcept {
+	Ogl33Window* window = resources.render_targets.getWindow(id);
+	if(!window){
+		return criticalError("Couldn't create Window");
+	}
+
+	auto& update = resources.render_target_times[static_cast<RenderTargetId>(id)];
+
+	std::chrono::duration<float, std::ratio<1,1>> fps_chrono{1.0f / fps};
+	update.next_update = std::chrono::steady_clock::now();
+	update.seconds_per_frame = std::chrono::duration_cast<std::chrono::steady_clock::duration>(fps_chrono);
+
+	return noError();
+}
+
+Error Ogl33Render::destroyWindow(const RenderWindowId& id) noexcept {
+	resources.render_targets.erase(static_cast<RenderTargetId>(id));
+
+	render_2d.getResources().render_target_stages.erase(static_cast<RenderTargetId>(id));
+	render_3d.getResources().render_target_stages_3d.erase(static_cast<RenderTargetId>(id));
+	resources.render_target_post_stages.erase(static_cast<RenderTargetId>(id));
+	
+	resources.render_target_times.erase(static_cast<RenderTargetId>(id));
+	resources.render_graph.invalidate();
+
+	return noError();
+}
+
+Conveyor<RenderEvent::Events> Ogl33Render::listenToWindowEvents(const RenderWindowId& id) noexcept {
+	Ogl33Window* window = resources.render_targets.getWindow(id);
+	if(!window){
+		return Conveyor<RenderEvent::Events>{nullptr, nullptr};
+	}
+
+	return window->listenToWindowEvents();
+}
+
+Error Ogl33Render::setWindowIndependentPresent(const RenderWindowId& id, bool independent) noexcept {
+	Ogl33Window* window = resources.render_targets.getWindow(id);
+	if(!window){
+		return criticalError("No window found");
+	}
+
+	window->setIndependentPresent(independent);
+
+	return noError();
+}
+
+Error Ogl33Render::setWindowVisibility(const RenderWindowId& id, bool show) noexcept {
+	Ogl33Window* window = resources.render_targets.getWindow(id);
+	if(!window){
+		return criticalError("No window found");
+	}
+
+	if(show){
+		window->show();
+	}else{
+		window->hide();
+	}
+
+	return noError();
+}
+
+ErrorOr<Ogl33RenderImage> createOgl33RenderImage(size_t width, size_t height, bool depth_buffer) noexcept {
+	GLuint colour = createOgl33Texture();
+	// Composited render textures are usually scaled
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLuint depth = 0;
+	if(depth_buffer){
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+	if(depth_buffer){
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	Ogl33RenderImage image{framebuffer, colour, depth, width, height};
+	if(status != GL_FRAMEBUFFER_COMPLETE){
+		return criticalError("Incomplete framebuffer");
+	}
+
+	return image;
+}
+
+ErrorOr<RenderTextureId> Ogl33Render::createRenderTexture(size_t width, size_t height, bool transient) noexcept {
+	if(width == 0 || height == 0){
+		return criticalError("Invalid render texture size");
+	}
+
+	TextureId t_id = searchForFreeId(resources.textures);
+	try{
+		resources.textures.insert(std::make_pair(t_id, Ogl33Texture{0, false}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+
+	RenderTextureId id;
+	try{
+		if(transient){
+			// The image is handed out by the render graph
+			id = resources.render_targets.insert(Ogl33RenderTexture{width, height});
+		}else{
+			ErrorOr<Ogl33RenderImage> image = createOgl33RenderImage(width, height);
+			if(image.isError()){
+				resources.textures.erase(t_id);
+				return image.error().copyError();
+			}
+			id = resources.render_targets.insert(Ogl33RenderTexture{std::move(image.value())});
+		}
+	}catch(const std::bad_alloc&){
+		resources.textures.erase(t_id);
+		return criticalError("Out of memory");
+	}
+
+	Ogl33RenderTexture* texture = resources.render_targets.getRenderTexture(id);
+	assert(texture);
+	texture->texture_id = t_id;
+	if(!transient){
+		resources.textures.find(t_id)->second.alias(texture->currentImage()->colourTexture());
+	}
+
+	resources.render_graph.invalidate();
+
+	return id;
+}
+
+ErrorOr<TextureId> Ogl33Render::getRenderTextureTexture(const RenderTextureId& id) noexcept {
+	Ogl33RenderTexture* texture = resources.render_targets.getRenderTexture(id);
+	if(!texture){
+		return criticalError("No render texture found");
+	}
+
+	return texture->texture_id;
+}
+
+Error Ogl33Render::setRenderTargetClearColour(const RenderTargetId& id, float r, float g, float b, float a) noexcept {
+	if(!resources.render_targets.exists(id)){
+		return criticalError("No render target found");
+	}
+
+	resources.render_targets[id]->setClearColour({r, g, b, a});
+
+	return noError();
+}
+
+Error Ogl33Render::destroyRenderTexture(const RenderTextureId& id) noexcept {
+	Ogl33RenderTexture* texture = resources.render_targets.getRenderTexture(id);
+	if(!texture){
+		return criticalError("No render texture found");
+	}
+
+	resources.textures.erase(texture->texture_id);
+	resources.render_targets.erase(id);
+
+	render_2d.getResources().render_target_stages.erase(id);
+	render_3d.getResources().render_target_stages_3d.erase(id);
+	resources.render_target_post_stages.erase(id);
+
+	resources.render_graph.invalidate();
+
+	return noError();
+}
+
+namespace {
+/**
+* Only submits the source. The compile status is checked once the program is finished,
+* so drivers with parallel compilation don't block here.
+*/
+GLuint createShader(const std::string &source, GLenum type) noexcept {
+	GLuint id = glCreateShader(type);
+	if (id == 0) {
+		std::cerr<<"Failed to create shader"<<std::endl;
+		//log_error("Failed to create shader");
+		return id;
+	}
+
+	const char *source_data = source.c_str();
+	glShaderSource(id, 1, &source_data, nullptr);
+	glCompileShader(id);
+
+	return id;
+}
+
+void logShaderErrors(GLuint id) noexcept {
+	GLint result = GL_FALSE;
+	int info_length;
+
+	glGetShaderiv(id, GL_COMPILE_STATUS, &result);
+	glGetShaderiv(id, GL_INFO_LOG_LENGTH, &info_length);
+	if (info_length > 1 || result == GL_FALSE) {
+		std::string error_msg;
+		error_msg.resize(info_length);
+		glGetShaderInfoLog(id, info_length, nullptr, &error_msg[0]);
+
+		std::cerr<<"Failed to compile "<<error_msg<<std::endl;
+		// log_error(std::string{"Failed to compile "} + error_msg);
+	}
+}
+
+ErrorOr<Ogl33PendingProgram> beginOgl33Program(const std::string& vertex_src, const std::string& fragment_src, bool retrievable) noexcept {
+	Ogl33PendingProgram pending;
+	pending.begin = std::chrono::steady_clock::now();
+
+	pending.vertex_shader =
+		createShader(vertex_src, GL_VERTEX_SHADER);
+	pending.fragment_shader =
+		createShader(fragment_src, GL_FRAGMENT_SHADER);
+
+	if (pending.vertex_shader == 0 || pending.fragment_shader == 0) {
+		return criticalError("Couldn't create shader");
+	}
+
+	pending.program_id = glCreateProgram();
+
+	if (pending.program_id == 0) {
+		return criticalError("Couldn't create program");
+	}
+
+	glAttachShader(pending.program_id, pending.vertex_shader);
+	glAttachShader(pending.program_id, pending.fragment_shader);
+	if(retrievable){
+		glProgramParameteri(pending.program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(pending.program_id);
+
+	return pending;
+}
+
+ErrorOr<GLuint> finishOgl33Program(Ogl33PendingProgram& pending) noexcept {
+	GLuint p_id = pending.program_id;
+
+	GLint result = GL_FALSE;
+	int info_length;
+	glGetProgramiv(p_id, GL_LINK_STATUS, &result);
+	glGetProgramiv(p_id, GL_INFO_LOG_LENGTH, &info_length);
+	if (info_length > 1 || result == GL_FALSE) {
+		logShaderErrors(pending.vertex_shader);
+		logShaderErrors(pending.fragment_shader);
+
+		std::string error_msg;
+		error_msg.resize(info_length);
+		glGetProgramInfoLog(p_id, info_length, nullptr, &error_msg[0]);
+
+		std::cerr<<"Failed to link "<<error_msg<<std::endl;
+		// log_error(std::string{"Failed to compile "} + error_msg);
+	}
+
+	if(result == GL_FALSE){
+		return criticalError("Failed to compile program");
+	}
+
+	glDetachShader(p_id, pending.vertex_shader);
+	glDetachShader(p_id, pending.fragment_shader);
+	glDeleteShader(pending.vertex_shader);
+	glDeleteShader(pending.fragment_shader);
+
+	pending.program_id = 0;
+	pending.vertex_shader = 0;
+	pending.fragment_shader = 0;
+
+	return p_id;
+}
+
+/// Compiles and links in one go, going through the program cache
+ErrorOr<GLuint> compileOgl33Program(Ogl33ProgramCache& cache, const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	auto begin = std::chrono::steady_clock::now();
+	uint64_t cache_key = cache.key(vertex_src, fragment_src);
+	GLuint cached_id = cache.load(cache_key);
+	if(cached_id != 0){
+		cache.recordCacheHit(std::chrono::steady_clock::now() - begin);
+		return cached_id;
+	}
+
+	ErrorOr<Ogl33PendingProgram> pending = beginOgl33Program(vertex_src, fragment_src, cache.enabled());
+	if(pending.isError()){
+		return pending.error().copyError();
+	}
+
+	ErrorOr<GLuint> error_p_id = finishOgl33Program(pending.value());
+	if(error_p_id.isValue()){
+		cache.store(cache_key, error_p_id.value());
+		cache.recordCompile(std::chrono::steady_clock::now() - begin);
+	}
+	return error_p_id;
+}
+}
+
+namespace {
+const std::array<std::string, 3> program_feature_names = {
+	"FEATURE_TINT",
+	"FEATURE_ALPHA_TEST",
+	"FEATURE_GPU_INTERPOLATION"
+};
+
+/// Inserts the defines right after #version
+std::string insertDefines(const std::string& src, const std::string& defines){
+	// #version has to stay in front of everything else
+	size_t offset = 0;
+	if(src.compare(0, 8, "#version") == 0){
+		offset = src.find('\n');
+		offset = (offset == std::string::npos) ? src.size() : offset + 1;
+	}
+
+	std::string result = src.substr(0, offset);
+	if(!result.empty() && result.back() != '\n'){
+		result += '\n';
+	}
+	result += defines;
+	result += src.substr(offset);
+	return result;
+}
+
+std::string applyProgramFeatures(const std::string& src, ProgramFeatures features){
+	std::string defines;
+	for(uint32_t i = 0; i < 32; ++i){
+		if(!(features & (1u << i))){
+			continue;
+		}
+		if(i < program_feature_names.size()){
+			defines += "#define " + program_feature_names[i] + "\n";
+		}else{
+			defines += "#define FEATURE_BIT_" + std::to_string(i) + "\n";
+		}
+	}
+
+	if(defines.empty()){
+		return src;
+	}
+	return insertDefines(src, defines);
+}
+
+uint64_t programVariantKey(const ProgramId& base, ProgramFeatures features){
+	return (static_cast<uint64_t>(base) << 32) | features;
+}
+}
 
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(2,&ids[0]);
+Error Ogl33Render2D::beginProgram(const ProgramId& id) noexcept {
+	if(resources.programs.find(id) != resources.programs.end() || resources.pending_programs.find(id) != resources.pending_programs.end()){
+		return noError();
+	}
+
+	auto variant = resources.program_variants.find(id);
+	if(variant == resources.program_variants.end()){
+		return criticalError("Couldn't find program");
+	}
+	auto source = resources.program_sources.find(variant->second.base);
+	if(source == resources.program_sources.end()){
+		return criticalError("Couldn't find program source");
+	}
+
+	std::string vertex_src;
+	std::string fragment_src;
+	try{
+		vertex_src = applyProgramFeatures(source->second.vertex, variant->second.features);
+		fragment_src = applyProgramFeatures(source->second.fragment, variant->second.features);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+
+	Ogl33ProgramCache& cache = resources.res->program_cache;
+	auto begin = std::chrono::steady_clock::now();
+	uint64_t cache_key = cache.key(vertex_src, fragment_src);
+	GLuint cached_id = cache.load(cache_key);
+	if(cached_id != 0){
+		cache.recordCacheHit(std::chrono::steady_clock::now() - begin);
+		return insertProgram(id, cached_id);
+	}
+
+	ErrorOr<Ogl33PendingProgram> pending = beginOgl33Program(vertex_src, fragment_src, cache.enabled());
+	if(pending.isError()){
+		return pending.error().copyError();
+	}
+	pending.value().cache_key = cache_key;
+	pending.value().begin = begin;
+
+	try{
+		resources.pending_programs.insert(std::make_pair(id, Ogl33Resources2D::PendingProgram{std::move(pending.value()), nullptr}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+
+	return noError();
+}
+
+Error Ogl33Render2D::finishProgram(const ProgramId& id) noexcept {
+	auto iter = resources.pending_programs.find(id);
+	if(iter == resources.pending_programs.end()){
+		return noError();
+	}
+
+	Ogl33Resources2D::PendingProgram pending = std::move(iter->second);
+	resources.pending_programs.erase(iter);
+
+	Error error = noError();
+	ErrorOr<GLuint> error_p_id = finishOgl33Program(pending.program);
+	if(error_p_id.isValue()){
+		Ogl33ProgramCache& cache = resources.res->program_cache;
+		cache.store(pending.program.cache_key, error_p_id.value());
+		cache.recordCompile(std::chrono::steady_clock::now() - pending.program.begin);
+
+		error = insertProgram(id, error_p_id.value());
+	}else{
+		error = error_p_id.error().copyError();
+	}
+
+	if(pending.feeder){
+		if(error.failed()){
+			// Nobody received the id, so nobody could destroy it
+			destroyProgram(id);
+			pending.feeder->fail(error.copyError());
+		}else{
+			pending.feeder->feed(ProgramId{id});
+		}
+	}else if(error.failed()){
+		markProgramFailed(id);
+	}
+
+	return error;
+}
+
+Error Ogl33Render2D::insertProgram(const ProgramId& id, GLuint p_id) noexcept {
+	try{
+		auto variant = resources.program_variants.find(id);
+		ProgramFeatures features = variant != resources.program_variants.end() ? variant->second.features : 0;
+		resources.programs.insert(std::make_pair(id, Ogl33Program{p_id, features}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+
+	return noError();
+}
+
+Error Ogl33Render2D::compileProgram(const ProgramId& id) noexcept {
+	Error error = beginProgram(id);
+	if(error.failed()){
+		return error;
+	}
+	return finishProgram(id);
+}
+
+void Ogl33Render2D::pollPrograms() noexcept {
+	if(resources.pending_programs.empty()){
+		return;
+	}
+
+	std::vector<ProgramId> ready;
+	for(auto& iter : resources.pending_programs){
+		if(iter.second.program.isReady()){
+			ready.push_back(iter.first);
+		}
+	}
+
+	for(auto& iter : ready){
+		finishProgram(iter);
+	}
+}
+
+void Ogl33Render2D::markProgramFailed(const ProgramId& id) noexcept {
+	try{
+		resources.failed_programs.insert(id);
+	}catch(const std::bad_alloc&){
+		// Only costs another compile attempt on the next draw
+	}
+}
+
+Ogl33Program* Ogl33Render2D::getCompiledProgram(const ProgramId& id) noexcept {
+	auto iter = resources.programs.find(id);
+	if(iter != resources.programs.end()){
+		return &iter->second;
+	}
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, ids[0]);
-	glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(MeshData::Vertex), data.vertices.data(), GL_STATIC_DRAW);
+	if(resources.failed_programs.find(id) != resources.failed_programs.end()){
+		return nullptr;
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ids[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+	// Either prewarming hasn't finished yet or the variant is used for the first time
+	Error error = compileProgram(id);
+	if(error.failed()){
+		markProgramFailed(id);
+		return nullptr;
+	}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MeshData::Vertex), nullptr);
+	iter = resources.programs.find(id);
+	return iter != resources.programs.end() ? &iter->second : nullptr;
+}
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MeshData::Vertex), reinterpret_cast<void*>(offsetof(MeshData::Vertex, uvs)));
+ErrorOr<ProgramId> Ogl33Render2D::registerProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	ProgramId program_id = searchForFreeId(resources.program_variants);
 
-	#ifndef NDEBUG
-		glBindVertexArray(0);
-	#endif
 	try{
-		resources.meshes.insert(std::make_pair(id, Ogl33Mesh{vao, std::move(ids), data.indices.size()}));
-	}catch(const std::bad_alloc& ){
+		resources.program_sources.insert(std::make_pair(program_id, Ogl33Resources2D::ProgramSource{vertex_src, fragment_src}));
+		resources.program_variants.insert(std::make_pair(program_id, Ogl33Resources2D::ProgramVariant{program_id, 0}));
+		resources.program_variant_ids.insert(std::make_pair(programVariantKey(program_id, 0), program_id));
+	}catch(const std::bad_alloc&){
+		resources.program_sources.erase(program_id);
+		resources.program_variants.erase(program_id);
 		return criticalError("Out of memory");
 	}
-	return id;
+
+	return program_id;
 }
 
-Error Ogl33Render2D::setMeshData(const MeshId& id, const MeshData& data) noexcept {
-	auto find = resources.meshes.find(id);
-	if(find == resources.meshes.end()){
-		return recoverableError("Couldn't find mesh");
+ErrorOr<ProgramId> Ogl33Render2D::createProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	ErrorOr<ProgramId> program_id = registerProgram(vertex_src, fragment_src);
+	if(program_id.isError()){
+		return program_id.error().copyError();
 	}
 
-	find->second.setData(data);
-	return noError();
+	// The base program is compiled right away, so broken sources are reported here
+	Error error = compileProgram(program_id.value());
+	if(error.failed()){
+		destroyProgram(program_id.value());
+		return error;
+	}
+
+	return program_id.value();
 }
 
-/// @todo check if an error might be necessary
-Error Ogl33Render2D::destroyMesh(const MeshId& id) noexcept {
+Conveyor<ProgramId> Ogl33Render2D::createProgramAsync(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	ErrorOr<ProgramId> error_id = registerProgram(vertex_src, fragment_src);
+	if(error_id.isError()){
+		return Conveyor<ProgramId>{error_id.error().copyError()};
+	}
+	ProgramId program_id = error_id.value();
 
-	resources.meshes.erase(id);
+	Error error = beginProgram(program_id);
+	if(error.failed()){
+		destroyProgram(program_id);
+		return Conveyor<ProgramId>{std::move(error)};
+	}
 
-	return noError();
-}
+	auto pending = resources.pending_programs.find(program_id);
+	if(pending == resources.pending_programs.end()){
+		// Loaded from the program cache
+		return Conveyor<ProgramId>{ProgramId{program_id}};
+	}
 
-namespace {
-/// @todo get correct type. Not sure if it's GLint or GLuint
-GLint translateImageChannel(uint8_t channels){
-	std::array<GLint, 4> data{GL_RED, GL_RG, GL_RGB, GL_RGBA};
-	if(channels > 4 || channels == 0){
-		return GL_RGBA;
+	try{
+		auto caf = newConveyorAndFeeder<ProgramId>();
+		pending->second.feeder = std::move(caf.feeder);
+		return std::move(caf.conveyor);
+	}catch(const std::bad_alloc&){
+		destroyProgram(program_id);
+		return Conveyor<ProgramId>{criticalError("Out of memory")};
 	}
-	return data[channels-1];
-}
 }
 
-ErrorOr<TextureId> Ogl33Render::createTexture(const Image& image) noexcept {
-	GLuint texture_id;
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+ErrorOr<ProgramId> Ogl33Render2D::getProgramVariant(const ProgramId& base, ProgramFeatures features) noexcept {
+	auto base_variant = resources.program_variants.find(base);
+	if(base_variant == resources.program_variants.end()){
+		return criticalError("Couldn't find program");
+	}
+	// Variants of variants share the base program's sources
+	ProgramId base_id = base_variant->second.base;
+	features |= base_variant->second.features;
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-	
-	TextureId t_id = searchForFreeId(resources.textures);
+	auto iter = resources.program_variant_ids.find(programVariantKey(base_id, features));
+	if(iter != resources.program_variant_ids.end()){
+		return iter->second;
+	}
 
+	ProgramId id = searchForFreeId(resources.program_variants);
 	try{
-		resources.textures.insert(std::make_pair(t_id, Ogl33Texture{texture_id}));
+		resources.program_variants.insert(std::make_pair(id, Ogl33Resources2D::ProgramVariant{base_id, features}));
+		resources.program_variant_ids.insert(std::make_pair(programVariantKey(base_id, features), id));
 	}catch(const std::bad_alloc&){
+		resources.program_variants.erase(id);
 		return criticalError("Out of memory");
 	}
-	return t_id;
-}
 
-/// @todo check if an error might be necessary
-Error Ogl33Render::destroyTexture(const TextureId& id) noexcept {
-	resources.textures.erase(id);
+	return id;
+}
 
+Error Ogl33Render2D::prewarmProgramVariants(const ProgramId& base, const std::vector<ProgramFeatures>& features) noexcept {
+	for(auto& iter : features){
+		ErrorOr<ProgramId> variant = getProgramVariant(base, iter);
+		if(variant.isError()){
+			return variant.error().copyError();
+		}
+		// Finished by pollPrograms() in a later step, or on first use at the latest
+		Error error = beginProgram(variant.value());
+		if(error.failed()){
+			return error;
+		}
+	}
 	return noError();
 }
 
-ErrorOr<RenderWindowId> Ogl33Render::createWindow(const RenderVideoMode& mode, const std::string& title) noexcept {
-	auto gl_win = context->createWindow(VideoMode{mode.width,mode.height}, title);
-	if(!gl_win){
-		return criticalError("Couldn't create window");
+Error Ogl33Render2D::setProgramTint(const ProgramId& id, float r, float g, float b, float a) noexcept {
+	Ogl33Program* program = getCompiledProgram(id);
+	if(!program){
+		return criticalError("Couldn't find program");
 	}
+	program->setTint({r, g, b, a});
+	return noError();
+}
 
-	gl_win->bind();
-	if(!loaded_glad){
-		if(!gladLoadGL()){
-			std::cout<<"Failed to load glad"<<std::endl;
-			return 0;
-		}
-		loaded_glad = true;
+namespace {
+const std::string frame_data_block = R"(
+layout (std140) uniform FrameData {
+	mat4 view_projection;
+	vec2 viewport_size;
+	float time;
+	float interpolation;
+};
+)";
+
+const std::string default_vertex_shader_program = R"(#version 330 core
+
+layout (location = 0) in vec2 vertices;
+layout (location = 1) in vec2 uvs;
+)" + frame_data_block + R"(
+#ifdef FEATURE_GPU_INTERPOLATION
+// Three texels per scene object, the previous and current position and rotation, then the layer and flipbook start
+uniform samplerBuffer object_data;
+uniform usamplerBuffer object_slots;
+#else
+// Two texels per object, the rows of its transform, the layer and the flipbook start
+uniform samplerBuffer object_data;
+#endif
+uniform int object_offset;
+
+// Set for flipbook properties, the frame follows from the time since the object's flipbook start
+uniform int flipbook_frames;
+uniform float flipbook_fps;
+uniform bool flipbook_loop;
+uniform vec4 flipbook_rects[)" + std::to_string(ogl33_max_flipbook_frames) + R"(];
+
+out vec2 tex_coord;
+
+vec2 flipbookCoord(float start){
+	if(flipbook_frames == 0){
+		return uvs;
 	}
+	int frame = int(max(time - start, 0.0) * flipbook_fps);
+	frame = flipbook_loop ? frame % flipbook_frames : min(frame, flipbook_frames - 1);
+	vec4 rect = flipbook_rects[frame];
+	return rect.xy + uvs * rect.zw;
+}
 
-	try{
-		auto id = resources.render_targets.insert(Ogl33Window{std::move(gl_win)});
-		return static_cast<RenderWindowId>(id);
-	}catch(const std::bad_alloc&){
-		return criticalError("Out of memory");
-	} 
+void main(){
+#ifdef FEATURE_GPU_INTERPOLATION
+	int index = int(texelFetch(object_slots, object_offset + gl_InstanceID).r) * 3;
+	vec4 old_state = texelFetch(object_data, index);
+	vec4 state = texelFetch(object_data, index + 1);
+	vec4 extra = texelFetch(object_data, index + 2);
+	float layer = extra.x;
+	float flipbook_start = extra.y;
+
+	// Rotates along the shorter arc like slerp2D
+	float old_angle = atan(old_state.w, old_state.z);
+	float delta = atan(old_state.z * state.w - old_state.w * state.z, dot(old_state.zw, state.zw));
+	float angle = old_angle + delta * interpolation;
+	vec2 rotation = vec2(cos(angle), sin(angle));
+
+	vec2 world = vec2(
+		rotation.x * vertices.x - rotation.y * vertices.y,
+		rotation.y * vertices.x + rotation.x * vertices.y
+	) + mix(old_state.xy, state.xy, interpolation);
+#else
+	int index = (object_offset + gl_InstanceID) * 2;
+	vec4 row_0 = texelFetch(object_data, index);
+	vec4 row_1 = texelFetch(object_data, index + 1);
+	float layer = row_0.w;
+	float flipbook_start = row_1.w;
+
+	vec3 position = vec3(vertices, 1.0);
+	vec2 world = vec2(dot(row_0.xyz, position), dot(row_1.xyz, position));
+#endif
+
+	vec4 transformed = view_projection * vec4(world, 0.0, 1.0);
+	gl_Position = vec4(transformed.xy, layer, transformed.w);
+	tex_coord = flipbookCoord(flipbook_start);
 }
+)";
+const std::string default_fragment_shader_program = R"(#version 330 core
 
-Error Ogl33Render::setWindowDesiredFPS(const RenderWindowId& id, float fps) noexcept {
-	Ogl33Window* window = resources.render_targets.getWindow(id);
-	if(!window){
-		return criticalError("Couldn't create Window");
-	}
+in vec2 tex_coord;
 
-	auto& update = resources.render_target_times[static_cast<RenderTargetId>(id)];
+out vec4 colour;
 
-	std::chrono::duration<float, std::ratio<1,1>> fps_chrono{1.0f / fps};
-	update.next_update = std::chrono::steady_clock::now();
-	update.seconds_per_frame = std::chrono::duration_cast<std::chrono::steady_clock::duration>(fps_chrono);
+uniform sampler2D texture_sampler;
+#ifdef FEATURE_TINT
+uniform vec4 tint;
+#endif
 
-	return noError();
+void main(){
+	vec4 tex_colour = texture(texture_sampler, tex_coord);
+#ifdef FEATURE_ALPHA_TEST
+	if(tex_colour.a < 0.5){
+		discard;
+	}
+#endif
+#ifdef FEATURE_TINT
+	tex_colour *= tint;
+#endif
+	colour = tex_colour;
 }
+)";
 
-Error Ogl33Render::destroyWindow(const RenderWindowId& id) noexcept {
-	resources.render_targets.erase(static_cast<RenderTargetId>(id));
+const std::string particle_vertex_shader_program = R"(#version 330 core
 
-	render_2d.getResources().render_target_stages.erase(static_cast<RenderTargetId>(id));
-	
-	resources.render_target_times.erase(static_cast<RenderTargetId>(id));
+layout (location = 0) in vec2 vertices;
+layout (location = 1) in vec2 uvs;
+)" + frame_data_block + R"(
+// Two texels per particle, the position, size and layer and the colour
+uniform samplerBuffer object_data;
+uniform int object_offset;
 
-	return noError();
+out vec2 tex_coord;
+out vec4 particle_colour;
+
+void main(){
+	int index = (object_offset + gl_InstanceID) * 2;
+	vec4 state = texelFetch(object_data, index);
+	particle_colour = texelFetch(object_data, index + 1);
+
+	vec4 transformed = view_projection * vec4(state.xy + vertices * state.z, 0.0, 1.0);
+	gl_Position = vec4(transformed.xy, state.w, transformed.w);
+	tex_coord = uvs;
 }
+)";
 
-Conveyor<RenderEvent::Events> Ogl33Render::listenToWindowEvents(const RenderWindowId& id) noexcept {
-	Ogl33Window* window = resources.render_targets.getWindow(id);
-	if(!window){
-		return Conveyor<RenderEvent::Events>{nullptr, nullptr};
-	}
+const std::string particle_fragment_shader_program = R"(#version 330 core
 
-	return window->listenToWindowEvents();
+in vec2 tex_coord;
+in vec4 particle_colour;
+
+out vec4 colour;
+
+uniform sampler2D texture_sampler;
+
+void main(){
+	colour = texture(texture_sampler, tex_coord) * particle_colour;
 }
+)";
 
-Error Ogl33Render::setWindowVisibility(const RenderWindowId& id, bool show) noexcept {
-	Ogl33Window* window = resources.render_targets.getWindow(id);
-	if(!window){
-		return criticalError("No window found");
-	}
+// Unit sized, so the particle size is its width
+const MeshData particle_quad = {
+	{
+		{{0.5f, 0.5f}, {1.f, 0.f}},
+		{{0.5f, -0.5f}, {1.f, 1.f}},
+		{{-0.5f, -0.5f}, {0.f, 1.f}},
+		{{-0.5f, 0.5f}, {0.f, 0.f}}
+	},
+	{2, 1, 0, 2, 0, 3}
+};
 
-	if(show){
-		window->show();
-	}else{
-		window->hide();
-	}
+const std::string default_vertex_shader_program_3d = R"(#version 330 core
 
-	return noError();
+layout (location = 0) in vec3 vertices;
+layout (location = 1) in vec3 normals;
+layout (location = 2) in vec2 uvs;
+)" + frame_data_block + R"(
+// Four texels per object, the columns of its model matrix
+uniform samplerBuffer object_data;
+uniform int object_offset;
+
+out vec2 tex_coord;
+
+// Must match the depth pre-pass variant bit for bit, or GL_LEQUAL rejects visible fragments
+invariant gl_Position;
+
+void main(){
+	int index = (object_offset + gl_InstanceID) * 4;
+	mat4 model = mat4(
+		texelFetch(object_data, index),
+		texelFetch(object_data, index + 1),
+		texelFetch(object_data, index + 2),
+		texelFetch(object_data, index + 3)
+	);
+
+	gl_Position = view_projection * model * vec4(vertices, 1.0);
+	tex_coord = uvs;
 }
+)";
 
-namespace {
-GLuint createShader(const std::string &source, GLenum type) noexcept {
-	GLuint id = glCreateShader(type);
-	if (id == 0) {
-		std::cerr<<"Failed to create shader"<<std::endl;
-		//log_error("Failed to create shader");
-		return id;
-	}
+const std::string default_fragment_shader_program_3d = R"(#version 330 core
+in vec2 tex_coord;
 
-	GLint result = GL_FALSE;
-	int info_length;
+out vec4 colour;
 
-	const char *source_data = source.c_str();
-	glShaderSource(id, 1, &source_data, nullptr);
-	glCompileShader(id);
+uniform sampler2D texture_sampler;
 
-	glGetShaderiv(id, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(id, GL_INFO_LOG_LENGTH, &info_length);
-	if (info_length > 1 || result == GL_FALSE) {
-		std::string error_msg;
-		error_msg.resize(info_length);
-		glGetShaderInfoLog(id, info_length, nullptr, &error_msg[0]);
+void main(){
+// The colour is masked in the depth pre-pass
+#ifndef DEPTH_PREPASS
+	vec4 tex_colour = texture(texture_sampler, tex_coord);
+	colour = tex_colour;
+#endif
+}
+)";
 
-		std::cerr<<"Failed to compile "<<error_msg<<std::endl;
-		// log_error(std::string{"Failed to compile "} + error_msg);
-	}
+const std::string post_vertex_shader_program = R"(#version 330 core
 
-	return id;
+out vec2 uv;
+
+void main(){
+	// One triangle twice the size of the screen, the clipped part covers it exactly
+	uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
 }
+)";
 
-ErrorOr<GLuint> createOgl33Program(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+const std::string post_copy_fragment_shader_program = R"(#version 330 core
 
-	GLuint vertex_shader_id =
-		createShader(vertex_src, GL_VERTEX_SHADER);
-	GLuint fragment_shader_id =
-		createShader(fragment_src, GL_FRAGMENT_SHADER);
+in vec2 uv;
 
-	if (vertex_shader_id == 0 || fragment_shader_id == 0) {
-		if(vertex_shader_id != 0){
-			glDeleteShader(vertex_shader_id);
-		}
-		if(fragment_shader_id != 0){
-			glDeleteShader(fragment_shader_id);
-		}
-		return criticalError("Couldn't create shader");
-	}
+out vec4 colour;
 
-	GLuint p_id = glCreateProgram();
+uniform sampler2D source;
 
-	if (p_id == 0) {
-		glDeleteShader(vertex_shader_id);
-		glDeleteShader(fragment_shader_id);
-		return criticalError("Couldn't create program");
-	}
+void main(){
+	colour = texture(source, uv);
+}
+)";
 
-	glAttachShader(p_id, vertex_shader_id);
-	glAttachShader(p_id, fragment_shader_id);
-	glLinkProgram(p_id);
+const std::string post_blur_fragment_shader_program = R"(#version 330 core
 
-	GLint result = GL_FALSE;
-	int info_length;
-	glGetProgramiv(p_id, GL_LINK_STATUS, &result);
-	glGetProgramiv(p_id, GL_INFO_LOG_LENGTH, &info_length);
-	if (info_length > 1 || result == GL_FALSE) {
-		std::string error_msg;
-		error_msg.resize(info_length);
-		glGetProgramInfoLog(p_id, info_length, nullptr, &error_msg[0]);
+in vec2 uv;
 
-		std::cerr<<"Failed to link "<<error_msg<<std::endl;
-		// log_error(std::string{"Failed to compile "} + error_msg);
-		
+out vec4 colour;
 
-		return criticalError("Failed to compile program");
-	}
+uniform sampler2D source;
+uniform vec2 texel_size;
+uniform vec2 direction;
 
-	glDetachShader(p_id, vertex_shader_id);
-	glDetachShader(p_id, fragment_shader_id);
-	glDeleteShader(vertex_shader_id);
-	glDeleteShader(fragment_shader_id);
+// Nine texel Gaussian, pairs of texels are read with one linear sample between them
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
 
-	return p_id;
+void main(){
+	vec2 texel_step = direction * texel_size;
+	vec4 sum = texture(source, uv) * weights[0];
+	for(int i = 1; i < 3; ++i){
+		sum += texture(source, uv + texel_step * offsets[i]) * weights[i];
+		sum += texture(source, uv - texel_step * offsets[i]) * weights[i];
+	}
+	colour = sum;
 }
+)";
 }
 
-ErrorOr<ProgramId> Ogl33Render2D::createProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept {
-	ErrorOr<GLuint> error_p_id = createOgl33Program(vertex_src, fragment_src);
-
+ErrorOr<PostProgramId> Ogl33Render::createPostProgram(const std::string& fragment_src) noexcept {
+	ErrorOr<GLuint> error_p_id = compileOgl33Program(resources.program_cache, post_vertex_shader_program, fragment_src);
 	if(error_p_id.isError()){
 		return error_p_id.error().copyError();
 	}
 
-	GLuint& p_id = error_p_id.value();
-
-	GLuint mvp_id = glGetUniformLocation(p_id, "mvp");
-	GLuint texture_sampler_id = glGetUniformLocation(p_id, "texture_sampler");
-	GLuint layer_id = glGetUniformLocation(p_id, "layer");
-
-	ProgramId program_id = searchForFreeId(resources.programs);
-
+	PostProgramId id = searchForFreeId(resources.post_programs);
 	try{
-		resources.programs.insert(std::make_pair(program_id, Ogl33Program{p_id, texture_sampler_id, mvp_id, layer_id}));
+		resources.post_programs.insert(std::make_pair(id, Ogl33PostProgram{error_p_id.value()}));
 	}catch(const std::bad_alloc&){
+		glDeleteProgram(error_p_id.value());
 		return criticalError("Out of memory");
 	}
-
-	return program_id;
+	return id;
 }
 
-namespace {
-const std::string default_vertex_shader_program = R"(#version 330 core
-
-layout (location = 0) in vec2 vertices;
-layout (location = 1) in vec2 uvs;
-
-out vec2 tex_coord;
-
-uniform float layer;
-uniform mat3 mvp;
+ErrorOr<PostProgramId> Ogl33Render::createPostProgram() noexcept {
+	return createPostProgram(post_copy_fragment_shader_program);
+}
 
-void main(){
-	vec3 transformed = mvp * vec3(vertices, 1.0);
-	gl_Position.xyz = vec3(transformed.x, transformed.y, layer);
-	gl_Position.w = transformed.z;
-	tex_coord = uvs;
+ErrorOr<PostProgramId> Ogl33Render::createPostBlurProgram() noexcept {
+	return createPostProgram(post_blur_fragment_shader_program);
 }
-)";
-const std::string default_fragment_shader_program = R"(#version 330 core
 
-in vec2 tex_coord;
+Error Ogl33Render::destroyPostProgram(const PostProgramId& id) noexcept {
+	resources.post_programs.erase(id);
+	return noError();
+}
 
-out vec4 colour;
+ErrorOr<RenderPostStageId> Ogl33Render::createPostStage(const RenderTextureId& input, const RenderTargetId& output) noexcept {
+	if(!resources.render_targets.getRenderTexture(input)){
+		return criticalError("No render texture found");
+	}
+	if(!resources.render_targets.exists(output)){
+		return criticalError("No render target found");
+	}
+	if(input == output){
+		return criticalError("Stage can't read its own target");
+	}
 
-uniform sampler2D texture_sampler;
+	RenderPostStageId id = searchForFreeId(resources.post_stages);
+	try{
+		resources.post_stages.insert(std::make_pair(id, Ogl33PostStage{input, output}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
 
-void main(){
-	vec4 tex_colour = texture(texture_sampler, tex_coord);
-	colour = tex_colour;
+	try{
+		resources.render_target_post_stages.insert(std::make_pair(output, id));
+	}catch(const std::bad_alloc&){
+		resources.post_stages.erase(id);
+		return criticalError("Out of memory");
+	}
+	resources.render_graph.invalidate();
+	return id;
 }
-)";
-
-const std::string default_vertex_shader_program_3d = R"(#version 330 core
 
-layout (location = 0) in vec3 vertices;
-layout (location = 1) in vec2 uvs;
-layout (location = 2) in vec3 normals;
+Error Ogl33Render::setPostStagePasses(const RenderPostStageId& id, const std::vector<RenderPostPass>& passes) noexcept {
+	auto find = resources.post_stages.find(id);
+	if(find == resources.post_stages.end()){
+		return criticalError("No RenderPostStage found");
+	}
 
-out vec2 tex_coord;
+	for(auto& pass : passes){
+		if(!getPostProgram(pass.program)){
+			return criticalError("No post program found");
+		}
+		if(!(pass.scale > 0.f)){
+			return criticalError("Invalid post pass scale");
+		}
+	}
 
-uniform mat4 mvp;
+	try{
+		find->second.passes = passes;
+		find->second.statistics.pass_milliseconds.assign(passes.size(), 0.f);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
 
-void main(){
-	tex_coord = uvs;
+	return noError();
 }
 
-)";
+ErrorOr<RenderPostStageStatistics> Ogl33Render::getPostStageStatistics(const RenderPostStageId& id) noexcept {
+	auto find = resources.post_stages.find(id);
+	if(find == resources.post_stages.end()){
+		return criticalError("No RenderPostStage found");
+	}
 
-const std::string default_fragment_shader_program_3d = R"(#version 330 core
-in vec2 tex_coord;
+	try{
+		return find->second.statistics;
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+}
 
-out vec4 colour;
+Error Ogl33Render::destroyPostStage(const RenderPostStageId& id) noexcept {
+	auto find = resources.post_stages.find(id);
+	if(find != resources.post_stages.end()){
+		auto range = resources.render_target_post_stages.equal_range(find->second.target_id);
+		for(auto iter = range.first; iter != range.second; ){
+			if(iter->second == id){
+				iter = resources.render_target_post_stages.erase(iter);
+			}else{
+				++iter;
+			}
+		}
 
-uniform sampler2D texture_sampler;
+		resources.post_stages.erase(find);
+		resources.render_graph.invalidate();
 
-void main(){
-	vec4 tex_colour = texture(texture_sampler, tex_coord);
-	colour = tex_colour;
-}
-)";
+		return noError();
+	}
+
+	return criticalError("No RenderPostStage found");
 }
 
 ErrorOr<ProgramId> Ogl33Render2D::createProgram() noexcept {
 	return createProgram(default_vertex_shader_program, default_fragment_shader_program);
 }
 
+Error Ogl33Render2D::createParticleResources() noexcept {
+	if(resources.particle_program == 0){
+		ErrorOr<ProgramId> program = createProgram(particle_vertex_shader_program, particle_fragment_shader_program);
+		if(program.isError()){
+			return program.error().copyError();
+		}
+		resources.particle_program = program.value();
+	}
+	if(resources.particle_mesh == 0){
+		ErrorOr<MeshId> mesh = createMesh(particle_quad);
+		if(mesh.isError()){
+			return mesh.error().copyError();
+		}
+		resources.particle_mesh = mesh.value();
+	}
+	return noError();
+}
+
 Error Ogl33Render2D::destroyProgram(const ProgramId& id) noexcept {
-	resources.programs.erase(id);
+	auto variant = resources.program_variants.find(id);
+	if(variant == resources.program_variants.end()){
+		return noError();
+	}
+
+	// Destroying the base program takes all of its variants with it
+	if(variant->second.base == id){
+		for(auto iter = resources.program_variants.begin(); iter != resources.program_variants.end();){
+			if(iter->second.base == id){
+				resources.program_variant_ids.erase(programVariantKey(id, iter->second.features));
+				resources.programs.erase(iter->first);
+				resources.pending_programs.erase(iter->first);
+				resources.failed_programs.erase(iter->first);
+				iter = resources.program_variants.erase(iter);
+			}else{
+				++iter;
+			}
+		}
+		resources.program_sources.erase(id);
+	}else{
+		resources.program_variant_ids.erase(programVariantKey(variant->second.base, variant->second.features));
+		resources.programs.erase(id);
+		resources.pending_programs.erase(id);
+		resources.failed_programs.erase(id);
+		resources.program_variants.erase(variant);
+	}
 	return noError();
 }
 
@@ -1247,6 +4066,7 @@ ErrorOr<RenderStageId> Ogl33Render2D::createStage(const RenderTargetId& target_i
 		resources.render_stages.erase(id);
 		return criticalError("Out of memory");
 	}
+	resources.res->render_graph.invalidate();
 	return id;
 }
 
@@ -1263,6 +4083,7 @@ Error Ogl33Render2D::destroyStage(const RenderStageId& id) noexcept {
 		}
 
 		resources.render_stages.erase(find);
+		resources.res->render_graph.invalidate();
 
 		return noError();
 	}
@@ -1270,6 +4091,31 @@ Error Ogl33Render2D::destroyStage(const RenderStageId& id) noexcept {
 	return criticalError("No RenderStage found");
 }
 
+Error Ogl33Render2D::setStageInputs(const RenderStageId& id, const std::vector<RenderTextureId>& inputs) noexcept {
+	auto find = resources.render_stages.find(id);
+	if(find == resources.render_stages.end()){
+		return criticalError("No RenderStage found");
+	}
+
+	for(auto& input : inputs){
+		if(!resources.res->render_targets.getRenderTexture(input)){
+			return criticalError("No render texture found");
+		}
+		if(input == find->second.target_id){
+			return criticalError("Stage can't read its own target");
+		}
+	}
+
+	try{
+		find->second.inputs = inputs;
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	resources.res->render_graph.invalidate();
+
+	return noError();
+}
+
 ErrorOr<RenderViewportId> Ogl33Render::createViewport() noexcept {
 	RenderViewportId id = searchForFreeId(resources.viewports);
 	try{
@@ -1294,10 +4140,23 @@ Error Ogl33Render::destroyViewport(const RenderViewportId& id) noexcept {
 	return noError();
 }
 
+Error Ogl33Render::setProgramCacheDirectory(const std::filesystem::path& dir) noexcept {
+	try{
+		resources.program_cache.setDirectory(dir);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	return noError();
+}
+
+RenderProgramStatistics Ogl33Render::getProgramStatistics() noexcept {
+	return resources.program_cache.statistics();
+}
+
 ErrorOr<RenderPropertyId> Ogl33Render2D::createProperty(const MeshId& mesh, const TextureId& texture) noexcept {
 	RenderPropertyId id = searchForFreeId(resources.render_properties);
 	try{
-		resources.render_properties.insert(std::make_pair(id, Ogl33RenderProperty{mesh, texture}));
+		resources.render_properties.insert(std::make_pair(id, Ogl33RenderProperty{mesh, texture, FlipbookData{}}));
 	}catch(const std::bad_alloc&){
 		return criticalError("Out of memory");
 	}
@@ -1308,6 +4167,7 @@ Error Ogl33Render2D::setPropertyMesh(const RenderPropertyId& id, const MeshId& m
 	auto find = resources.render_properties.find(id);
 	if(find != resources.render_properties.end()){
 		find->second.mesh_id = mesh_id;
+		++resources.property_version;
 		return noError();
 	}
 	return criticalError("No Property found");
@@ -1317,6 +4177,37 @@ Error Ogl33Render2D::setPropertyTexture(const RenderPropertyId& id, const Textur
 	auto find = resources.render_properties.find(id);
 	if(find != resources.render_properties.end()){
 		find->second.texture_id = texture_id;
+		++resources.property_version;
+		return noError();
+	}
+	return criticalError("No Property found");
+}
+
+ErrorOr<RenderPropertyId> Ogl33Render2D::createFlipbookProperty(const MeshId& mesh, const TextureId& atlas, const FlipbookData& flipbook) noexcept {
+	if(flipbook.frames.size() > ogl33_max_flipbook_frames){
+		return criticalError("Flipbook has too many frames");
+	}
+	RenderPropertyId id = searchForFreeId(resources.render_properties);
+	try{
+		resources.render_properties.insert(std::make_pair(id, Ogl33RenderProperty{mesh, atlas, flipbook}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	return id;
+}
+
+Error Ogl33Render2D::setPropertyFlipbook(const RenderPropertyId& id, const FlipbookData& flipbook) noexcept {
+	if(flipbook.frames.size() > ogl33_max_flipbook_frames){
+		return criticalError("Flipbook has too many frames");
+	}
+	auto find = resources.render_properties.find(id);
+	if(find != resources.render_properties.end()){
+		try{
+			find->second.flipbook = flipbook;
+		}catch(const std::bad_alloc&){
+			return criticalError("Out of memory");
+		}
+		++resources.property_version;
 		return noError();
 	}
 	return criticalError("No Property found");
@@ -1324,6 +4215,7 @@ Error Ogl33Render2D::setPropertyTexture(const RenderPropertyId& id, const Textur
 
 Error Ogl33Render2D::destroyProperty(const RenderPropertyId& id) noexcept {
 	resources.render_properties.erase(id);
+	++resources.property_version;
 	return noError();
 }
 
@@ -1353,10 +4245,30 @@ ErrorOr<RenderObjectId> Ogl33Render2D::createObject(const RenderSceneId& scene,
 	}
 }
 
+namespace {
+/// Fails and removes every binding matching pred
+template<typename Pred>
+void failAnimationBindings(std::vector<Ogl33Resources2D::AnimationBinding>& bindings, Pred&& pred, const Error& error){
+	for(size_t i = 0; i < bindings.size();){
+		if(!pred(bindings[i])){
+			++i;
+			continue;
+		}
+		bindings[i].feeder->fail(error.copyError());
+		bindings[i] = std::move(bindings.back());
+		bindings.pop_back();
+	}
+}
+}
+
 Error Ogl33Render2D::destroyObject(const RenderSceneId& scene, const RenderObjectId& obj) noexcept {
 	auto find = resources.scenes.find(scene);
 	if(find != resources.scenes.end()){
 		find->second.destroyObject(obj);
+		// The id may be reused, so the bindings can't wait for the next update
+		failAnimationBindings(resources.animation_bindings, [&](const Ogl33Resources2D::AnimationBinding& binding){
+			return binding.scene == scene && binding.object == obj;
+		}, criticalError("Object destroyed"));
 		return noError();
 	}
 	return criticalError("Couldn't find scene");
@@ -1372,229 +4284,740 @@ Error Ogl33Render2D::setObjectProperty(const RenderSceneId& scene, const RenderO
 	return criticalError("Couldn't find scene");
 }
 
+Error Ogl33Render2D::restartObjectFlipbook(const RenderSceneId& scene, const RenderObjectId& obj) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.restartFlipbook(obj);
+	}
+	return criticalError("Couldn't find scene");
+}
+
 Error Ogl33Render2D::setObjectPosition(const RenderSceneId& scene, const RenderObjectId& obj, float x, float y, bool interpolate) noexcept {
 	auto find = resources.scenes.find(scene);
 	if(find != resources.scenes.end()){
 		find->second.setObjectPosition(obj, x, y, interpolate);
 		return noError();
 	}
-	return criticalError("Couldn't find scene");
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setObjectRotation(const RenderSceneId& scene, const RenderObjectId& obj, float angle, bool interpolate) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		find->second.setObjectRotation(obj, angle, interpolate);
+		return noError();
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setObjectParent(const RenderSceneId& scene, const RenderObjectId& obj, const RenderObjectId& parent) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setObjectParent(obj, parent);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setObjectStatic(const RenderSceneId& scene, const RenderObjectId& obj, bool s) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setObjectStatic(obj, s);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setLayerStatic(const RenderSceneId& scene, float layer, bool s) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setLayerStatic(layer, s);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setObjectVisibility(const RenderSceneId& scene, const RenderObjectId& obj, bool visible) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		find->second.setObjectVisibility(obj, visible);
+		return noError();
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setObjectLayer(const RenderSceneId& scene, const RenderObjectId& obj, float layer) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		find->second.setObjectLayer(obj, layer);
+		return noError();
+	}
+	return criticalError("Couldn't find scene");
+}
+
+ErrorOr<RenderSceneStatistics> Ogl33Render2D::getSceneStatistics(const RenderSceneId& id) noexcept {
+	auto find = resources.scenes.find(id);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+
+	RenderSceneStatistics stats;
+	stats.active_objects = find->second.activeObjectCount();
+	stats.static_objects = find->second.staticObjectCount();
+	stats.baked_objects = find->second.bakedObjectCount();
+	stats.static_chunks = find->second.staticChunks().size();
+	return stats;
+}
+
+ErrorOr<RenderSceneSnapshots*> Ogl33Render2D::createSceneSnapshots(const RenderSceneId& id) noexcept {
+	auto find = resources.scenes.find(id);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	return find->second.createSnapshots();
+}
+
+ErrorOr<RenderTilemapId> Ogl33Render2D::createTilemap(const RenderSceneId& scene, const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, size_t width, size_t height, float tile_size) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	return find->second.createTilemap(atlas, atlas_columns, atlas_rows, width, height, tile_size);
+}
+
+Error Ogl33Render2D::setTilemapTile(const RenderSceneId& scene, const RenderTilemapId& id, size_t x, size_t y, TileIndex tile) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setTilemapTile(id, x, y, tile);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setTilemapTiles(const RenderSceneId& scene, const RenderTilemapId& id, size_t x, size_t y, size_t width, size_t height, const std::vector<TileIndex>& tiles) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setTilemapTiles(id, x, y, width, height, tiles);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setTilemapPosition(const RenderSceneId& scene, const RenderTilemapId& id, float x, float y) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setTilemapPosition(id, x, y);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::setTilemapLayer(const RenderSceneId& scene, const RenderTilemapId& id, float layer) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.setTilemapLayer(id, layer);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render2D::destroyTilemap(const RenderSceneId& scene, const RenderTilemapId& id) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find != resources.scenes.end()){
+		return find->second.destroyTilemap(id);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+ErrorOr<RenderEmitterId> Ogl33Render2D::createEmitter(const RenderSceneId& scene, const TextureId& texture, const ParticleEmitterParameters& parameters) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+
+	Error error = createParticleResources();
+	if(error.failed()){
+		return error;
+	}
+	return find->second.createEmitter(texture, parameters);
+}
+
+Error Ogl33Render2D::setEmitterParameters(const RenderSceneId& scene, const RenderEmitterId& id, const ParticleEmitterParameters& parameters) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	Ogl33ParticleEmitter* emitter = find->second.getEmitter(id);
+	if(!emitter){
+		return criticalError("Couldn't find emitter");
+	}
+
+	try{
+		emitter->setParameters(parameters);
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+	return noError();
+}
+
+Error Ogl33Render2D::setEmitterPosition(const RenderSceneId& scene, const RenderEmitterId& id, float x, float y) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	Ogl33ParticleEmitter* emitter = find->second.getEmitter(id);
+	if(!emitter){
+		return criticalError("Couldn't find emitter");
+	}
+	emitter->position = {{x, y}};
+	return noError();
+}
+
+Error Ogl33Render2D::setEmitterLayer(const RenderSceneId& scene, const RenderEmitterId& id, float layer) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	Ogl33ParticleEmitter* emitter = find->second.getEmitter(id);
+	if(!emitter){
+		return criticalError("Couldn't find emitter");
+	}
+	emitter->layer = layer;
+	return noError();
+}
+
+Error Ogl33Render2D::setEmitterActive(const RenderSceneId& scene, const RenderEmitterId& id, bool active) noexcept {
+	auto find = resources.scenes.find(scene);
+	if(find == resources.scenes.end()){
+		return criticalError("Couldn't find scene");
+	}
+	Ogl33ParticleEmitter* emitter = find->second.getEmitter(id);
+	if(!emitter){
+		return criticalError("Couldn't find emitter");
+	}
+	emitter->active = active;
+	return noError();
 }
 
-Error Ogl33Render2D::setObjectRotation(const RenderSceneId& scene, const RenderObjectId& obj, float angle, bool interpolate) noexcept {
+Error Ogl33Render2D::destroyEmitter(const RenderSceneId& scene, const RenderEmitterId& id) noexcept {
 	auto find = resources.scenes.find(scene);
 	if(find != resources.scenes.end()){
-		find->second.setObjectRotation(obj, angle, interpolate);
-		return noError();
+		return find->second.destroyEmitter(id);
 	}
 	return criticalError("Couldn't find scene");
 }
 
-Error Ogl33Render2D::setObjectVisibility(const RenderSceneId& scene, const RenderObjectId& obj, bool visible) noexcept {
-	auto find = resources.scenes.find(scene);
-	if(find != resources.scenes.end()){
-		find->second.setObjectVisibility(obj, visible);
-		return noError();
+ErrorOr<RenderAnimationId> Ogl33Render2D::createAnimation(const RenderAnimationData& data) noexcept {
+	try{
+		RenderAnimationId id = searchForFreeId(resources.animations);
+		resources.animations.emplace(std::make_pair(id, Ogl33Animation{data}));
+		return id;
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
 	}
-	return criticalError("Couldn't find scene");
 }
 
-Error Ogl33Render2D::setObjectLayer(const RenderSceneId& scene, const RenderObjectId& obj, float layer) noexcept {
+Error Ogl33Render2D::destroyAnimation(const RenderAnimationId& id) noexcept {
+	failAnimationBindings(resources.animation_bindings, [&id](const Ogl33Resources2D::AnimationBinding& binding){
+		return binding.animation == id;
+	}, criticalError("Animation destroyed"));
+	resources.animations.erase(id);
+	return noError();
+}
+
+Conveyor<void> Ogl33Render2D::playAnimation(const RenderSceneId& scene, const RenderObjectId& obj, const RenderAnimationId& id, bool loop) noexcept {
 	auto find = resources.scenes.find(scene);
-	if(find != resources.scenes.end()){
-		find->second.setObjectLayer(obj, layer);
-		return noError();
+	if(find == resources.scenes.end()){
+		return Conveyor<void>{criticalError("Couldn't find scene")};
+	}
+	if(!find->second.hasObject(obj)){
+		return Conveyor<void>{criticalError("Couldn't find object")};
+	}
+	if(resources.animations.find(id) == resources.animations.end()){
+		return Conveyor<void>{criticalError("Couldn't find animation")};
+	}
+
+	try{
+		auto caf = newConveyorAndFeeder<void>();
+		resources.animation_bindings.push_back(Ogl33Resources2D::AnimationBinding{scene, obj, id, resources.animation_time, loop, std::move(caf.feeder)});
+		return std::move(caf.conveyor);
+	}catch(const std::bad_alloc&){
+		return Conveyor<void>{criticalError("Out of memory")};
 	}
-	return criticalError("Couldn't find scene");
 }
 
-Error Ogl33Render2D::destroyScene(const RenderSceneId& id) noexcept {
-	resources.scenes.erase(id);
+Error Ogl33Render2D::stopAnimations(const RenderSceneId& scene, const RenderObjectId& obj) noexcept {
+	failAnimationBindings(resources.animation_bindings, [&](const Ogl33Resources2D::AnimationBinding& binding){
+		return binding.scene == scene && binding.object == obj;
+	}, recoverableError("Animation stopped"));
 	return noError();
 }
 
-/*
-Conveyor<Mesh3dId> Ogl33Render::createMesh3d(const Mesh3dData& data) noexcept {
-	Mesh3dId id = searchForFreeId(meshes_3d);
-	std::array<GLuint,2> ids;
+void Ogl33Render2D::updateAnimations(const std::chrono::steady_clock::time_point& now) noexcept {
+	resources.animation_time = now;
 
-	/// @todo ensure that the current render context is bound
+	auto& bindings = resources.animation_bindings;
+	if(bindings.empty()){
+		return;
+	}
 
-	GLuint vao;
+	// Channels of one binding, SIZE_MAX if the track is empty
+	struct Channels {
+		float t;
+		bool done;
+		std::array<size_t, 4> index;
+	};
+	auto& sampler = resources.animation_sampler;
 
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	try{
+		std::vector<Channels> channels;
+		channels.reserve(bindings.size());
+		sampler.clear();
+
+		// Locate the key segments of every track
+		for(auto& iter : bindings){
+			Channels c{0.f, false, {{SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX}}};
+			auto find = resources.animations.find(iter.animation);
+			if(find != resources.animations.end()){
+				const Ogl33Animation& anim = find->second;
+				c.t = std::chrono::duration<float>(now - iter.start).count();
+				if(iter.loop && anim.duration > 0.f){
+					c.t = std::fmod(c.t, anim.duration);
+				}else if(c.t >= anim.duration){
+					c.t = anim.duration;
+					c.done = !iter.loop;
+				}
+
+				const auto& data = anim.data;
+				if(!data.position.empty()){
+					c.index[0] = sampler.add(data.position, c.t, 0);
+					c.index[1] = sampler.add(data.position, c.t, 1);
+				}
+				if(!data.rotation.empty()){
+					c.index[2] = sampler.add(data.rotation, c.t, 0);
+				}
+				if(!data.layer.empty()){
+					c.index[3] = sampler.add(data.layer, c.t, 0);
+				}
+			}
+			channels.push_back(c);
+		}
 
-	glGenBuffers(2,&ids[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, ids[0]);
-	glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(Mesh3dData::Vertex), data.vertices.data(), GL_STATIC_DRAW);
+		sampler.sample();
+
+		// Write the results back, dropping finished and orphaned bindings
+		size_t kept = 0;
+		for(size_t i = 0; i < bindings.size(); ++i){
+			auto& binding = bindings[i];
+			const Channels& c = channels[i];
+
+			auto anim = resources.animations.find(binding.animation);
+			auto scene = resources.scenes.find(binding.scene);
+			Error error = noError();
+			if(anim == resources.animations.end()){
+				error = criticalError("Couldn't find animation");
+			}else if(scene == resources.scenes.end()){
+				error = criticalError("Couldn't find scene");
+			}else{
+				const auto& data = anim->second.data;
+				if(c.index[0] != SIZE_MAX){
+					error = scene->second.setObjectPosition(binding.object, sampler.value(c.index[0]), sampler.value(c.index[1]), true);
+				}
+				if(!error.failed() && c.index[2] != SIZE_MAX){
+					error = scene->second.setObjectRotation(binding.object, sampler.value(c.index[2]), true);
+				}
+				if(!error.failed() && c.index[3] != SIZE_MAX){
+					error = scene->second.setObjectLayer(binding.object, sampler.value(c.index[3]));
+				}
+				if(!error.failed() && !data.visibility.empty()){
+					size_t key = findAnimationKey(data.visibility, c.t);
+					if(key != binding.visibility_key){
+						binding.visibility_key = key;
+						error = scene->second.setObjectVisibility(binding.object, data.visibility[key].value);
+					}
+				}
+				if(!error.failed() && !data.property.empty()){
+					size_t key = findAnimationKey(data.property, c.t);
+					if(key != binding.property_key){
+						binding.property_key = key;
+						error = scene->second.setObjectProperty(binding.object, data.property[key].value);
+					}
+				}
+			}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ids[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+			if(error.failed()){
+				binding.feeder->fail(std::move(error));
+			}else if(c.done){
+				binding.feeder->feed();
+			}else{
+				if(kept != i){
+					bindings[kept] = std::move(binding);
+				}
+				++kept;
+			}
+		}
+		bindings.erase(bindings.begin() + kept, bindings.end());
+	}catch(const std::bad_alloc&){
+		// Retried with the next update
+	}
+}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh3dData::Vertex), nullptr);
+Error Ogl33Render2D::destroyScene(const RenderSceneId& id) noexcept {
+	failAnimationBindings(resources.animation_bindings, [&id](const Ogl33Resources2D::AnimationBinding& binding){
+		return binding.scene == id;
+	}, criticalError("Scene destroyed"));
+	resources.scenes.erase(id);
+	return noError();
+}
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh3dData::Vertex), reinterpret_cast<void*>(offsetof(Mesh3dData::Vertex, normals)));
+Ogl33Render3D::Ogl33Render3D(Ogl33Render& r):resources{r.getResources()},render{&r}{}
 
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Mesh3dData::Vertex), reinterpret_cast<void*>(offsetof(Mesh3dData::Vertex, uvs)));
+ErrorOr<Mesh3dId> Ogl33Render3D::createMesh3d(const Mesh3dData& data) noexcept {
+	for(size_t i = 0; i < data.lods.size(); ++i){
+		const Mesh3dData::Lod& lod = data.lods[i];
+		if(lod.first_index + lod.index_count > data.indices.size() || lod.index_count % 3 != 0){
+			return criticalError("Invalid lod range");
+		}
+		/// The statistics count the saved triangles against the first level
+		if(i > 0 && lod.index_count > data.lods[i-1].index_count){
+			return criticalError("Lods have to get coarser");
+		}
+	}
 
-	#ifndef NDEBUG
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-	#endif
+	Mesh3dId id = searchForFreeId(resources.meshes_3d);
 	try{
-		meshes_3d.insert(std::make_pair(id, Ogl33Mesh3d{vao, std::move(ids), data.indices.size()}));
-	}catch(const std::bad_alloc& ){
-		return Conveyor<Mesh3dId>{criticalError("Out of memory")};
+		resources.meshes_3d.insert(std::make_pair(id, createOgl33Mesh3d(data)));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
 	}
-	return Conveyor<Mesh3dId>{id};
+	return id;
 }
 
-Error Ogl33Render::destroyMesh3d(const Mesh3dId& id) noexcept {
-	meshes_3d.erase(id);
+Error Ogl33Render3D::destroyMesh3d(const Mesh3dId& id) noexcept {
+	resources.meshes_3d.erase(id);
 	return noError();
 }
 
-Conveyor<RenderProperty3dId> Ogl33Render::createProperty3d(const Mesh3dId& mesh, const TextureId& texture) noexcept {
-	RenderProperty3dId id = searchForFreeId(render_properties_3d);
+ErrorOr<RenderProperty3dId> Ogl33Render3D::createProperty3d(const Mesh3dId& mesh, const TextureId& texture) noexcept {
+	RenderProperty3dId id = searchForFreeId(resources.render_properties_3d);
 	try{
-		render_properties_3d.insert(std::make_pair(id, Ogl33RenderProperty3d{mesh, texture}));
-	}catch(const std::bad_alloc& ){
-		return Conveyor<RenderProperty3dId>{criticalError("Out of memory")};
+		resources.render_properties_3d.insert(std::make_pair(id, Ogl33RenderProperty3d{mesh, texture}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
 	}
-	return Conveyor<RenderProperty3dId>{id};
+	return id;
 }
 
-Error Ogl33Render::destroyProperty3d(const RenderProperty3dId& id) noexcept {
-	render_properties_3d.erase(id);
+Error Ogl33Render3D::destroyProperty3d(const RenderProperty3dId& id) noexcept {
+	resources.render_properties_3d.erase(id);
 	return noError();
 }
 
-Conveyor<Program3dId> Ogl33Render::createProgram3d(const std::string& vertex_src, const std::string& fragment_src) noexcept {
-	ErrorOr<GLuint> error_p_id = createOgl33Program(vertex_src, fragment_src);
+Error Ogl33Render3D::setProperty3dTransparent(const RenderProperty3dId& id, bool transparent) noexcept {
+	auto find = resources.render_properties_3d.find(id);
+	if(find == resources.render_properties_3d.end()){
+		return criticalError("Couldn't find render property");
+	}
+	find->second.transparent = transparent;
+	return noError();
+}
 
+ErrorOr<Program3dId> Ogl33Render3D::createProgram3d(const std::string& vertex_src, const std::string& fragment_src) noexcept {
+	ErrorOr<GLuint> error_p_id = compileOgl33Program(resources.res->program_cache, vertex_src, fragment_src);
 	if(error_p_id.isError()){
-		return Conveyor<Program3dId>{error_p_id.error().copyError()};
+		return error_p_id.error().copyError();
 	}
 
-	GLuint& p_id = error_p_id.value();
-
-	GLuint mvp_id = glGetUniformLocation(p_id, "mvp");
-	GLuint texture_sampler_id = glGetUniformLocation(p_id, "texture_sampler");
-
-	Program3dId id = searchForFreeId(programs_3d);
+	Program3dId id = searchForFreeId(resources.programs_3d);
 	try{
-		programs_3d.insert(std::make_pair(id, Ogl33Program3d{p_id, texture_sampler_id, mvp_id}));
+		resources.program_sources_3d.insert(std::make_pair(id, Ogl33Resources3D::Program3dSource{vertex_src, fragment_src}));
+		resources.programs_3d.insert(std::make_pair(id, Ogl33Program3d{error_p_id.value()}));
 	}catch(const std::bad_alloc&){
-		return Conveyor<Program3dId>{criticalError("Out of memory")};
+		resources.program_sources_3d.erase(id);
+		glDeleteProgram(error_p_id.value());
+		return criticalError("Out of memory");
 	}
-	return Conveyor<Program3dId>{id};
+	return id;
 }
 
-Conveyor<Program3dId> Ogl33Render::createProgram3d() noexcept {
+ErrorOr<Program3dId> Ogl33Render3D::createProgram3d() noexcept {
 	return createProgram3d(default_vertex_shader_program_3d, default_fragment_shader_program_3d);
 }
 
-Error Ogl33Render::destroyProgram3d(const Program3dId& id) noexcept {
-	programs_3d.erase(id);
+Error Ogl33Render3D::compileDepthProgram3d(const Program3dId& id) noexcept {
+	if(resources.depth_programs_3d.find(id) != resources.depth_programs_3d.end()){
+		return noError();
+	}
+	if(resources.failed_depth_programs_3d.find(id) != resources.failed_depth_programs_3d.end()){
+		return criticalError("Depth pre-pass program failed to compile");
+	}
+	auto source = resources.program_sources_3d.find(id);
+	if(source == resources.program_sources_3d.end()){
+		return criticalError("Couldn't find program");
+	}
+
+	// Same vertex shader, so the positions match the colour pass. Discards in the
+	// fragment shader still apply, everything else may be skipped under DEPTH_PREPASS.
+	std::string fragment_src;
+	try{
+		fragment_src = insertDefines(source->second.fragment, "#define DEPTH_PREPASS\n");
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
+
+	ErrorOr<GLuint> error_p_id = compileOgl33Program(resources.res->program_cache, source->second.vertex, fragment_src);
+	try{
+		if(error_p_id.isError()){
+			resources.failed_depth_programs_3d.insert(id);
+			return error_p_id.error().copyError();
+		}
+		resources.depth_programs_3d.insert(std::make_pair(id, Ogl33Program3d{error_p_id.value()}));
+	}catch(const std::bad_alloc&){
+		if(error_p_id.isValue()){
+			glDeleteProgram(error_p_id.value());
+		}
+		return criticalError("Out of memory");
+	}
 	return noError();
 }
 
-Conveyor<RenderScene3dId> Ogl33Render::createScene3d() noexcept {
-	RenderScene3dId id = searchForFreeId(scenes_3d);
+Ogl33Program3d* Ogl33Render3D::getDepthProgram3d(const Program3dId& id) noexcept {
+	if(compileDepthProgram3d(id).failed()){
+		return nullptr;
+	}
+	auto find = resources.depth_programs_3d.find(id);
+	return find != resources.depth_programs_3d.end() ? &find->second : nullptr;
+}
+
+Error Ogl33Render3D::destroyProgram3d(const Program3dId& id) noexcept {
+	resources.programs_3d.erase(id);
+	resources.program_sources_3d.erase(id);
+	resources.depth_programs_3d.erase(id);
+	resources.failed_depth_programs_3d.erase(id);
+	return noError();
+}
 
+ErrorOr<RenderScene3dId> Ogl33Render3D::createScene3d() noexcept {
+	RenderScene3dId id = searchForFreeId(resources.scenes_3d);
 	try{
-		scenes_3d.insert(std::make_pair(id, Ogl33Scene3d{}));
+		resources.scenes_3d.insert(std::make_pair(id, Ogl33Scene3d{}));
 	}catch(const std::bad_alloc&){
-		return Conveyor<RenderScene3dId>{criticalError("Out of memory")};
+		return criticalError("Out of memory");
+	}
+	return id;
+}
+
+ErrorOr<RenderObject3dId> Ogl33Render3D::createObject3d(const RenderScene3dId& scene, const RenderProperty3dId& prop) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		return find->second.createObject(prop);
+	}
+	return criticalError("Couldn't find scene");
+}
+
+Error Ogl33Render3D::destroyObject3d(const RenderScene3dId& scene, const RenderObject3dId& obj) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		find->second.destroyObject(obj);
+		return noError();
 	}
+	return criticalError("Couldn't find scene");
+}
 
-	return Conveyor<RenderScene3dId>{id};
+Error Ogl33Render3D::setObject3dPosition(const RenderScene3dId& scene, const RenderObject3dId& obj, float x, float y, float z) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		return find->second.setObjectPosition(obj, x, y, z);
+	}
+	return criticalError("Couldn't find scene");
 }
 
-Conveyor<RenderObject3dId> Ogl33Render::createObject3d(const RenderScene3dId& scene_id, const RenderProperty3dId& prop) noexcept {
-	auto scene = scenes_3d.find(scene_id);
-	if(scene == scenes_3d.end()){
-		return Conveyor<RenderObject3dId>{criticalError("Couldn't find scene")};
+Error Ogl33Render3D::setObject3dRotation(const RenderScene3dId& scene, const RenderObject3dId& obj, float alpha, float beta, float gamma) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		return find->second.setObjectRotation(obj, alpha, beta, gamma);
 	}
+	return criticalError("Couldn't find scene");
+}
 
-	ErrorOr<RenderObject3dId> err_id = scene->second.createObject(prop);
-	if(err_id.isError()){
-		return Conveyor<RenderObject3dId>{err_id.error().copyError()};
+Error Ogl33Render3D::setObject3dOrientation(const RenderScene3dId& scene, const RenderObject3dId& obj, float x, float y, float z, float w) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		return find->second.setObjectOrientation(obj, x, y, z, w);
 	}
-	return Conveyor<RenderObject3dId>{err_id.value()};
+	return criticalError("Couldn't find scene");
 }
 
-Error Ogl33Render::destroyObject3d(const RenderScene3dId& scene_id, const RenderObject3dId& obj) noexcept {
-	auto scene = scenes_3d.find(scene_id);
-	if(scene == scenes_3d.end()){
-		return Error{criticalError("Couldn't find Scene")};
+Error Ogl33Render3D::setObject3dVisibility(const RenderScene3dId& scene, const RenderObject3dId& obj, bool visible) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find != resources.scenes_3d.end()){
+		return find->second.setObjectVisibility(obj, visible);
 	}
+	return criticalError("Couldn't find scene");
+}
 
-	scene->second.destroyObject(obj);
+Error Ogl33Render3D::destroyScene3d(const RenderScene3dId& scene) noexcept {
+	resources.scenes_3d.erase(scene);
 	return noError();
 }
 
-Error Ogl33Render::destroyScene3d(const RenderScene3dId& scene) noexcept {
-	scenes_3d.erase(scene);
-	return noError();
+ErrorOr<RenderScene3dSnapshots*> Ogl33Render3D::createScene3dSnapshots(const RenderScene3dId& scene) noexcept {
+	auto find = resources.scenes_3d.find(scene);
+	if(find == resources.scenes_3d.end()){
+		return criticalError("Couldn't find scene");
+	}
+	return find->second.createSnapshots();
 }
 
-Conveyor<RenderCamera3dId> Ogl33Render::createCamera3d() noexcept {
-	RenderScene3dId id = searchForFreeId(cameras_3d);
+ErrorOr<RenderCamera3dId> Ogl33Render3D::createCamera3d() noexcept {
+	RenderCamera3dId id = searchForFreeId(resources.cameras_3d);
 	try{
-		cameras_3d.insert(std::make_pair(id, Ogl33Camera3d{}));
+		resources.cameras_3d.insert(std::make_pair(id, Ogl33Camera3d{}));
 	}catch(const std::bad_alloc&){
-		return Conveyor<RenderCamera3dId>{criticalError("Out of memory")};
+		return criticalError("Out of memory");
+	}
+	return id;
+}
+
+Error Ogl33Render3D::setCamera3dPosition(const RenderCamera3dId& id, float x, float y, float z) noexcept {
+	auto find = resources.cameras_3d.find(id);
+	if(find != resources.cameras_3d.end()){
+		find->second.setViewPosition(x, y, z);
+		return noError();
+	}
+	return criticalError("Couldn't find camera");
+}
+
+Error Ogl33Render3D::setCamera3dRotation(const RenderCamera3dId& id, float alpha, float beta, float gamma) noexcept {
+	auto find = resources.cameras_3d.find(id);
+	if(find != resources.cameras_3d.end()){
+		find->second.setViewRotation(alpha, beta, gamma);
+		return noError();
+	}
+	return criticalError("Couldn't find camera");
+}
+
+Error Ogl33Render3D::setCamera3dOrientation(const RenderCamera3dId& id, float x, float y, float z, float w) noexcept {
+	auto find = resources.cameras_3d.find(id);
+	if(find != resources.cameras_3d.end()){
+		find->second.setViewOrientation(x, y, z, w);
+		return noError();
 	}
-	return Conveyor<RenderCamera3dId>{id};
+	return criticalError("Couldn't find camera");
 }
-Error Ogl33Render::setCamera3dPosition(const RenderCamera3dId& id, float x, float y, float z) noexcept {
-	auto find = cameras_3d.find(id);
-	if(find != cameras_3d.end()){
-		find->second.setViewPosition(x,y,z);
+
+Error Ogl33Render3D::setCamera3dOrthographic(const RenderCamera3dId& id, float left, float right, float top, float bottom, float near, float far) noexcept {
+	auto find = resources.cameras_3d.find(id);
+	if(find != resources.cameras_3d.end()){
+		find->second.setOrtho(left, right, top, bottom, near, far);
 		return noError();
 	}
-	return Error{criticalError("Couldn't find Camera")};
+	return criticalError("Couldn't find camera");
 }
 
-Error Ogl33Render::setCamera3dOrthographic(const RenderCamera3dId& id, float, float, float, float, float, float)noexcept {
-	return Error{criticalError("Unimplemented")};
+Error Ogl33Render3D::setCamera3dPerspective(const RenderCamera3dId& id, float fov_y, float aspect, float near, float far, bool reverse_depth) noexcept {
+	if(!(fov_y > 0.f) || !(aspect > 0.f) || !(near > 0.f)){
+		return criticalError("Invalid perspective");
+	}
+	if(far > 0.f && far <= near){
+		return criticalError("Far plane has to lie behind the near plane");
+	}
+
+	auto find = resources.cameras_3d.find(id);
+	if(find != resources.cameras_3d.end()){
+		find->second.setPerspective(fov_y, aspect, near, far, reverse_depth);
+		return noError();
+	}
+	return criticalError("Couldn't find camera");
 }
 
-Error Ogl33Render::destroyCamera3d(const RenderCamera3dId& id) noexcept {
-	cameras_3d.erase(id);
+Error Ogl33Render3D::destroyCamera3d(const RenderCamera3dId& id) noexcept {
+	resources.cameras_3d.erase(id);
 	return noError();
 }
 
-Conveyor<RenderStage3dId> Ogl33Render::createStage3d(const RenderTargetId& target, const RenderViewportId& viewport_id, const RenderScene3dId& scene, const RenderCamera3dId& camera, const Program3dId& program) noexcept {
-	RenderStage3dId id = searchForFreeId(render_stages_3d);
+ErrorOr<RenderStage3dId> Ogl33Render3D::createStage3d(const RenderTargetId& target, const RenderViewportId& viewport, const RenderScene3dId& scene, const RenderCamera3dId& camera, const Program3dId& program) noexcept {
+	RenderStage3dId id = searchForFreeId(resources.render_stages_3d);
+	try{
+		resources.render_stages_3d.insert(std::make_pair(id, Ogl33RenderStage3d{target, viewport, scene, camera, program}));
+	}catch(const std::bad_alloc&){
+		return criticalError("Out of memory");
+	}
 
 	try{
-		render_stages_3d.insert(std::make_pair(id, Ogl33RenderStage3d{target, viewport_id, scene, camera, program}));
+		resources.render_target_stages_3d.insert(std::make_pair(target, id));
 	}catch(const std::bad_alloc&){
-		return Conveyor<RenderStage3dId>{criticalError("Out of memory")};
+		resources.render_stages_3d.erase(id);
+		return criticalError("Out of memory");
+	}
+	resources.res->render_graph.invalidate();
+	return id;
+}
+
+Error Ogl33Render3D::destroyStage3d(const RenderStage3dId& id) noexcept {
+	auto find = resources.render_stages_3d.find(id);
+	if(find != resources.render_stages_3d.end()){
+		auto range = resources.render_target_stages_3d.equal_range(find->second.target_id);
+		for(auto iter = range.first; iter != range.second; ){
+			if(iter->second == id){
+				iter = resources.render_target_stages_3d.erase(iter);
+			}else{
+				++iter;
+			}
+		}
+
+		resources.render_stages_3d.erase(find);
+		resources.res->render_graph.invalidate();
+
+		return noError();
+	}
+
+	return criticalError("No RenderStage3d found");
+}
+
+Error Ogl33Render3D::setStage3dInputs(const RenderStage3dId& id, const std::vector<RenderTextureId>& inputs) noexcept {
+	auto find = resources.render_stages_3d.find(id);
+	if(find == resources.render_stages_3d.end()){
+		return criticalError("No RenderStage3d found");
+	}
+
+	for(auto& input : inputs){
+		if(!resources.res->render_targets.getRenderTexture(input)){
+			return criticalError("No render texture found");
+		}
+		if(input == find->second.target_id){
+			return criticalError("Stage can't read its own target");
+		}
 	}
 
 	try{
-		render_target_stages_3d.insert(std::make_pair(target, id));
+		find->second.inputs = inputs;
 	}catch(const std::bad_alloc&){
-		render_stages_3d.erase(id);
-		return Conveyor<RenderStage3dId>{criticalError("Out of memory")};
+		return criticalError("Out of memory");
 	}
+	resources.res->render_graph.invalidate();
 
-	return Conveyor<RenderStage3dId>{id};
+	return noError();
 }
 
-Error Ogl33Render::destroyStage3d(const RenderStage3dId& id) noexcept {
-	render_stages_3d.erase(id);
+Error Ogl33Render3D::setStage3dPasses(const RenderStage3dId& id, const RenderStage3dPasses& passes) noexcept {
+	auto find = resources.render_stages_3d.find(id);
+	if(find == resources.render_stages_3d.end()){
+		return criticalError("No RenderStage3d found");
+	}
+
+	if(passes.depth_prepass){
+		// Compiled here, so a broken variant is reported instead of silently skipping the pre-pass
+		Error error = compileDepthProgram3d(find->second.program_id);
+		if(error.failed()){
+			return error;
+		}
+	}
+	find->second.passes = passes;
 	return noError();
 }
-*/
+
+ErrorOr<RenderStage3dStatistics> Ogl33Render3D::getStage3dStatistics(const RenderStage3dId& id) noexcept {
+	auto find = resources.render_stages_3d.find(id);
+	if(find == resources.render_stages_3d.end()){
+		return criticalError("No RenderStage3d found");
+	}
+	return find->second.statistics;
+}
+
 void Ogl33Render::stepRenderTargetTimes(const std::chrono::steady_clock::time_point& tp){
 	for(auto& iter : resources.render_target_times){
 		if(iter.second.next_update <= tp){
@@ -1625,29 +5048,265 @@ void Ogl33Render::step(const std::chrono::steady_clock::time_point& tp) noexcept
 
 	float relative_tp = std::max(0.f, std::min(1.0f, interval.count() / range.count()));
 
+	render_2d.pollPrograms();
+	// Resolves the conveyors of JobSystem::whenDone on the thread owning the renderer
+	jobs.poll();
+
+	for(auto& iter : render_2d.getResources().scenes){
+		iter.second.applySnapshots(tp);
+		iter.second.updateWorldTransforms(&jobs);
+		iter.second.bakeStaticChunks(*this, &jobs);
+	}
+
+	for(auto& iter : render_3d.getResources().scenes_3d){
+		iter.second.applySnapshots(tp);
+		iter.second.updateBounds(*this);
+	}
+
+	Ogl33FrameData frame;
+	frame.time = std::chrono::duration<float>(tp - start_time_point).count();
+	frame.interpolation = relative_tp;
+
 	stepRenderTargetTimes(tp);
 
-	for(;!resources.render_target_draw_tasks.empty(); resources.render_target_draw_tasks.pop()){
-		auto front = resources.render_target_draw_tasks.front();
+	if(resources.render_graph.isDirty()){
+		compileRenderGraph();
+	}
+
+	due_targets.clear();
+	deferred_targets.clear();
+	render_steps.clear();
+	try{
+		for(;!resources.render_target_draw_tasks.empty(); resources.render_target_draw_tasks.pop()){
+			RenderTargetId id = resources.render_target_draw_tasks.front();
+			// A window still busy with its last frame is tried again next step, the others go ahead
+			Ogl33Window* window = resources.render_targets.getWindow(id);
+			if(window && window->framePending()){
+				deferred_targets.push_back(id);
+			}else{
+				due_targets.push_back(id);
+			}
+		}
+		std::sort(due_targets.begin(), due_targets.end());
+		due_targets.erase(std::unique(due_targets.begin(), due_targets.end()), due_targets.end());
+
+		std::sort(deferred_targets.begin(), deferred_targets.end());
+		deferred_targets.erase(std::unique(deferred_targets.begin(), deferred_targets.end()), deferred_targets.end());
+		for(auto& id : deferred_targets){
+			resources.render_target_draw_tasks.push(id);
+		}
+
+		resources.render_graph.plan(due_targets, render_steps);
+	}catch(const std::bad_alloc&){
+		return;
+	}
+
+	const std::vector<Ogl33RenderGraph::Pass>& passes = resources.render_graph.passes();
+	for(size_t i = 0; i < render_steps.size(); ++i){
+		const Ogl33RenderGraph::Step& step = render_steps[i];
+		if(!resources.render_targets.exists(step.target)){
+			continue;
+		}
+		Ogl33RenderTarget* target = resources.render_targets[step.target];
+
+		// Transient ones without an image would draw into whatever is bound
+		Ogl33RenderTexture* texture = resources.render_targets.getRenderTexture(step.target);
+		if(texture && !texture->currentImage()){
+			continue;
+		}
+
+		if(step.bind){
+			target->beginRender();
+		}
+		if(step.clear){
+			// Cleared for the first stage right away, so it doesn't clear the depth again
+			target->clear(startsReversed(i));
+		}
+
+		if(step.pass != Ogl33RenderGraph::no_pass){
+			const Ogl33RenderGraph::Pass& pass = passes[step.pass];
+			switch(pass.type){
+				case Ogl33RenderGraph::PassType::Stage3d:{
+					auto stage_iter = render_3d.getResources().render_stages_3d.find(pass.stage);
+					if(stage_iter != render_3d.getResources().render_stages_3d.end()){
+						stage_iter->second.render(*this, frame);
+					}
+				}
+				break;
+				case Ogl33RenderGraph::PassType::PostProcess:{
+					auto stage_iter = resources.post_stages.find(pass.stage);
+					if(stage_iter != resources.post_stages.end()){
+						stage_iter->second.render(*this);
+					}
+				}
+				break;
+				case Ogl33RenderGraph::PassType::Stage:{
+					auto stage_iter = render_2d.getResources().render_stages.find(pass.stage);
+					if(stage_iter != render_2d.getResources().render_stages.end()){
+						stage_iter->second.render(*this, frame);
+					}
+				}
+				break;
+			}
+		}
+
+		if(step.finish){
+			target->endRender();
+		}
+	}
+}
 
-		Ogl33RenderTarget* target = resources.render_targets[front];
-		assert(target);
-		if(!target){
+bool Ogl33Render::startsReversed(size_t index) noexcept {
+	const std::vector<Ogl33RenderGraph::Pass>& passes = resources.render_graph.passes();
+	RenderTargetId target = render_steps[index].target;
+	for(size_t i = index; i < render_steps.size() && render_steps[i].target == target; ++i){
+		const Ogl33RenderGraph::Step& step = render_steps[i];
+		if(i != index && step.clear){
+			break;
+		}
+		if(step.pass == Ogl33RenderGraph::no_pass){
 			continue;
 		}
 
-		target->beginRender();
+		const Ogl33RenderGraph::Pass& pass = passes[step.pass];
+		switch(pass.type){
+			case Ogl33RenderGraph::PassType::Stage3d:{
+				auto stage_iter = render_3d.getResources().render_stages_3d.find(pass.stage);
+				if(stage_iter == render_3d.getResources().render_stages_3d.end()){
+					continue;
+				}
+				Ogl33Camera3d* camera = getCamera3d(stage_iter->second.camera_id);
+				return camera && camera->reversedDepth();
+			}
+			case Ogl33RenderGraph::PassType::Stage:
+				return false;
+			case Ogl33RenderGraph::PassType::PostProcess:
+				// Draws without depth
+				continue;
+		}
+	}
+	return false;
+}
+
+void Ogl33Render::compileRenderGraph() noexcept {
+	std::vector<Ogl33RenderGraph::Pass> passes;
+	std::vector<Ogl33RenderGraph::Transient> transients;
+	std::vector<Own<Ogl33RenderImage>> old_images = std::move(resources.render_images);
+	resources.render_images.clear();
+
+	try{
+		for(auto& iter : render_3d.getResources().render_target_stages_3d){
+			auto stage_iter = render_3d.getResources().render_stages_3d.find(iter.second);
+			if(stage_iter == render_3d.getResources().render_stages_3d.end() || !resources.render_targets.exists(iter.first)){
+				continue;
+			}
+			passes.push_back(Ogl33RenderGraph::Pass{Ogl33RenderGraph::PassType::Stage3d, iter.second, iter.first, stage_iter->second.inputs});
+		}
+
+		for(auto& iter : render_2d.getResources().render_target_stages){
+			auto stage_iter = render_2d.getResources().render_stages.find(iter.second);
+			if(stage_iter == render_2d.getResources().render_stages.end() || !resources.render_targets.exists(iter.first)){
+				continue;
+			}
+			passes.push_back(Ogl33RenderGraph::Pass{Ogl33RenderGraph::PassType::Stage, iter.second, iter.first, stage_iter->second.inputs});
+		}
+
+		for(auto& iter : resources.render_target_post_stages){
+			auto stage_iter = resources.post_stages.find(iter.second);
+			if(stage_iter == resources.post_stages.end() || !resources.render_targets.exists(iter.first)){
+				continue;
+			}
+			passes.push_back(Ogl33RenderGraph::Pass{Ogl33RenderGraph::PassType::PostProcess, iter.second, iter.first, {stage_iter->second.input_id}});
+		}
+
+		// 3D stages go first, so 2D stages on the same target are drawn on top
+		std::sort(passes.begin(), passes.end(), [](const Ogl33RenderGraph::Pass& a, const Ogl33RenderGraph::Pass& b){
+			return std::tie(a.target, a.type, a.stage) < std::tie(b.target, b.type, b.stage);
+		});
+
+		for(auto& iter : resources.render_targets.renderTextures()){
+			if(iter.second.isTransient()){
+				transients.push_back(Ogl33RenderGraph::Transient{iter.first, iter.second.width(), iter.second.height()});
+			}
+		}
+
+		resources.render_graph.compile(std::move(passes), transients);
+
+		// Images of the last compile are kept if they still fit
+		for(auto& image : resources.render_graph.imagePool()){
+			auto find = std::find_if(old_images.begin(), old_images.end(), [&](const Own<Ogl33RenderImage>& old){
+				return old && old->width() == image.width && old->height() == image.height;
+			});
+			if(find != old_images.end()){
+				resources.render_images.push_back(std::move(*find));
+				continue;
+			}
+
+			ErrorOr<Ogl33RenderImage> created = createOgl33RenderImage(image.width, image.height);
+			if(created.isError()){
+				// Its render textures are skipped
+				resources.render_images.push_back(nullptr);
+				continue;
+			}
+			resources.render_images.push_back(heap<Ogl33RenderImage>(std::move(created.value())));
+		}
+	}catch(const std::bad_alloc&){
+		// Tried again next step
+		resources.render_graph.invalidate();
+	}
+
+	for(auto& iter : resources.render_targets.renderTextures()){
+		if(iter.second.isTransient()){
+			iter.second.setAlias(nullptr);
+			auto find = resources.textures.find(iter.second.texture_id);
+			if(find != resources.textures.end()){
+				find->second.alias(0);
+			}
+		}
+	}
+
+	if(resources.render_graph.isDirty()){
+		return;
+	}
+
+	for(auto& alias : resources.render_graph.imageAliases()){
+		Ogl33RenderTexture* texture = resources.render_targets.getRenderTexture(alias.first);
+		const Ogl33RenderImage* image = resources.render_images[alias.second].get();
+		if(!texture || !image){
+			continue;
+		}
 
-		auto range = render_2d.getResources().render_target_stages.equal_range(front);
+		texture->setAlias(image);
+		auto find = resources.textures.find(texture->texture_id);
+		if(find != resources.textures.end()){
+			find->second.alias(image->colourTexture());
+		}
+	}
+}
 
-		for(auto iter = range.first; iter != range.second; ++iter){
-			auto stage_iter = render_2d.getResources().render_stages.find(iter->second);
-			if(stage_iter != render_2d.getResources().render_stages.end()){
-				stage_iter->second.render(*this, relative_tp);
+void Ogl33Render::simulateParticles(float dt) noexcept {
+	particle_emitters.clear();
+	try{
+		for(auto& scene : render_2d.getResources().scenes){
+			for(auto& iter : scene.second.getEmitters()){
+				particle_emitters.push_back(&iter.second);
 			}
 		}
+	}catch(const std::bad_alloc&){
+		return;
+	}
 
-		target->endRender();
+	// Emitters don't share any state
+	if(particle_emitters.size() > 1){
+		jobs.parallelFor(particle_emitters.size(), [this, dt](size_t begin, size_t end){
+			for(size_t i = begin; i < end; ++i){
+				particle_emitters[i]->simulate(dt);
+			}
+		}, 1);
+	}else{
+		for(auto& iter : particle_emitters){
+			iter->simulate(dt);
+		}
 	}
 }
 
@@ -1658,14 +5317,23 @@ void Ogl33Render::updateTime(const std::chrono::steady_clock::time_point& new_ol
 
 	float relative_tp = std::max(0.f, std::min(1.0f, interval.count() / range.count()));
 
+	float scene_time = std::chrono::duration<float>(new_time_point - start_time_point).count();
 	for(auto& iter : render_2d.getResources().scenes){
 		iter.second.updateState(relative_tp);
+		iter.second.setCurrentTime(scene_time);
 	}
 
 	for(auto& iter : render_2d.getResources().cameras){
 		iter.second.updateState(relative_tp);
 	}
 
+	for(auto& iter : render_3d.getResources().scenes_3d){
+		iter.second.updateState();
+	}
+
+	simulateParticles(std::chrono::duration<float>(new_time_point - time_point).count());
+	render_2d.updateAnimations(new_time_point);
+
 	old_time_point = new_old_time_point;
 	time_point = new_time_point;
 }
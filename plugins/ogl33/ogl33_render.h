@@ -26,6 +26,10 @@
 #include "ogl33_program.h"
 #include "ogl33_scene.h"
 #include "ogl33_camera.h"
+#include "ogl33_program_cache.h"
+#include "ogl33_buffer.h"
+#include "ogl33_animation.h"
+#include "ogl33_render_graph.h"
 
 namespace gin {
 class Ogl33Render;
@@ -38,11 +42,21 @@ protected:
 	~Ogl33RenderTarget() = default;
 
 	std::array<float, 4> clear_colour = {0.f, 0.f, 0.f, 1.f};
+	// Whether the depth buffer holds reversed depth, cleared to 0 and tested with GL_GREATER
+	bool reversed_depth = false;
 public:
+	/// Binds the target for drawing, without clearing it
 	virtual void beginRender() = 0;
 	virtual void endRender() = 0;
 
 	void setClearColour(const std::array<float, 4>& colour);
+	/// Clears colour and depth of the bound target, the depth for the given convention
+	void clear(bool reverse_depth = false);
+	/**
+	* Called by stages before they draw. Only clears the depth if the convention changes,
+	* which is the case for stages with and without reversed depth sharing a target.
+	*/
+	void useReversedDepth(bool reverse_depth);
 
 	virtual void bind() = 0;
 
@@ -53,8 +67,18 @@ public:
 class Ogl33Window final : public Ogl33RenderTarget {
 private:
 	Own<GlWindow> window;
+
+	bool independent_present = false;
+	// Signaled once the GPU finished the last presented frame
+	GLsync frame_fence = nullptr;
 public:
 	Ogl33Window(Own<GlWindow>&&);
+	~Ogl33Window();
+	Ogl33Window(Ogl33Window&&);
+
+	void setIndependentPresent(bool);
+	/// True while an independently presenting window's last frame isn't done
+	bool framePending();
 
 	void show();
 	void hide();
@@ -79,10 +103,57 @@ public:
 	size_t height() const override;
 };
 
+/// Framebuffer with a colour texture, which can be sampled, and a depth buffer
+class Ogl33RenderImage {
+private:
+	GLuint framebuffer = 0;
+	GLuint colour = 0;
+	GLuint depth = 0;
+	size_t image_width = 0;
+	size_t image_height = 0;
+public:
+	Ogl33RenderImage() = default;
+	Ogl33RenderImage(GLuint framebuffer, GLuint colour, GLuint depth, size_t width, size_t height);
+	~Ogl33RenderImage();
+	Ogl33RenderImage(Ogl33RenderImage&&);
+	Ogl33RenderImage& operator=(Ogl33RenderImage&&);
+
+	GLuint framebufferId() const;
+	GLuint colourTexture() const;
+	size_t width() const;
+	size_t height() const;
+};
+
+/// Images without a depth buffer are only good for full-screen passes
+ErrorOr<Ogl33RenderImage> createOgl33RenderImage(size_t width, size_t height, bool depth_buffer = true) noexcept;
+
+/**
+* Persistent render textures own their image. Transient ones only keep their contents
+* within a frame and get an image from the render graph's pool, shared with other
+* transient ones whose lifetimes don't overlap.
+*/
 class Ogl33RenderTexture final : public Ogl33RenderTarget {
 private:
+	size_t texture_width;
+	size_t texture_height;
+	bool transient;
+
+	Ogl33RenderImage image;
+	const Ogl33RenderImage* alias = nullptr;
 public:
+	/// Transient render texture
+	Ogl33RenderTexture(size_t width, size_t height);
+	Ogl33RenderTexture(Ogl33RenderImage&& image);
 	~Ogl33RenderTexture();
+	Ogl33RenderTexture(Ogl33RenderTexture&&) = default;
+
+	/// Non owning texture sampling the current image
+	TextureId texture_id = 0;
+
+	bool isTransient() const;
+	void setAlias(const Ogl33RenderImage* alias);
+	/// Null for transient ones the graph didn't assign an image
+	const Ogl33RenderImage* currentImage() const;
 
 	void beginRender() override;
 	void endRender() override;
@@ -114,43 +185,152 @@ public:
 
 	Ogl33Window* getWindow(const RenderWindowId&);
 	Ogl33RenderTexture* getRenderTexture(const RenderTextureId&);
+
+	std::map<RenderTargetId, Ogl33RenderTexture>& renderTextures(){
+		return render_textures;
+	}
 };
 
 class Ogl33RenderProperty {
 public:
 	MeshId mesh_id;
 	TextureId texture_id;
+	// Plain property without frames
+	FlipbookData flipbook;
 };
 
 class Ogl33RenderProperty3d {
 public:
 	Mesh3dId mesh_id;
 	TextureId texture_id;
+	bool transparent = false;
 };
 
 class Ogl33RenderStage {
 private:
-	void renderOne(Ogl33Program& program, Ogl33RenderProperty& property, Ogl33Scene::RenderObject& object, Ogl33Mesh& mesh, Ogl33Texture&, Matrix<float, 3, 3>& vp, float time_interval);
+	// Instanced draws of the GpuInterpolation path, rebuilt when the scene's structure changes
+	struct Batch {
+		MeshId mesh_id;
+		TextureId texture_id;
+		// Looked up again when drawing, since its frames may change without a rebuild
+		bool flipbook;
+		RenderPropertyId property_id;
+		GLint offset;
+		GLsizei count;
+	};
+	std::vector<Batch> batches;
+	Ogl33InstanceBuffer instance_slots;
+	// Baked chunks follow the objects in instance_slots
+	GLint static_chunk_offset = 0;
+	size_t static_chunk_count = 0;
+	// Followed by one slot per tilemap
+	std::vector<std::pair<RenderTilemapId, GLint>> tilemap_offsets;
+
+	const Ogl33Scene* cached_scene = nullptr;
+	uint64_t cached_scene_version = 0;
+	uint64_t cached_property_version = 0;
+
+	void renderStreamed(Ogl33Render& render, Ogl33Scene& scene, Ogl33Camera& camera, Ogl33Program& program, float time_interval);
+	void renderPersistent(Ogl33Render& render, Ogl33Scene& scene, Ogl33Camera& camera, Ogl33Program& program, float time_interval);
+	void renderParticles(Ogl33Render& render, Ogl33Scene& scene);
 public:
+	Ogl33RenderStage(const RenderTargetId&, const RenderViewportId&, const RenderSceneId&, const RenderCameraId&, const ProgramId&);
+
 	RenderTargetId target_id;
 	RenderViewportId viewport_id;
 	RenderSceneId scene_id;
 	RenderCameraId camera_id;
 	ProgramId program_id;
+	/// Render textures drawn before this stage
+	std::vector<RenderTextureId> inputs;
 
-	void render(Ogl33Render& render, float time_interval);
+	/// frame only needs time and interpolation set, the rest is filled per stage
+	void render(Ogl33Render& render, Ogl33FrameData frame);
 };
 
 class Ogl33RenderStage3d {
-private:
-	void renderOne(Ogl33Program3d& program, Ogl33RenderProperty3d& property, Ogl33Scene3d::RenderObject& object, Ogl33Mesh3d& mesh, Ogl33Texture& texture, Matrix<float, 4, 4>& vp);
 public:
+	Ogl33RenderStage3d(const RenderTargetId&, const RenderViewportId&, const RenderScene3dId&, const RenderCamera3dId&, const Program3dId&);
+
 	RenderTargetId target_id;
 	RenderViewportId viewport_id;
 	RenderScene3dId scene_id;
 	RenderCamera3dId camera_id;
 	Program3dId program_id;
+	/// Render textures drawn before this stage
+	std::vector<RenderTextureId> inputs;
+
+	// Reused between frames to build the model matrices in one batch
+	Transform3Batch<float> from_transforms;
+	Transform3Batch<float> to_transforms;
+
+	/// Fraction a screen size has to pass a level's threshold by before the level changes
+	float lod_hysteresis = 0.1f;
+	/**
+	* Level of detail this stage drew last per object slot, where the hysteresis starts from.
+	* Kept per stage, since stages with other cameras on the same scene pick other levels.
+	*/
+	std::vector<uint32_t> object_lods;
+	RenderStage3dPasses passes;
+	RenderStage3dStatistics statistics;
+
+	/**
+	* Opaque objects sharing mesh, level of detail and texture are drawn with one
+	* instanced call, transparent ones only if they follow each other back to front.
+	*/
+	void render(Ogl33Render& render, Ogl33FrameData frame);
+};
+
+/// Full-screen program of post-process stages
+class Ogl33PostProgram {
+private:
+	GLuint program_id;
+
+	GLint source_uniform;
+	GLint texel_size_uniform;
+	GLint direction_uniform;
+public:
+	Ogl33PostProgram(GLuint program);
+	~Ogl33PostProgram();
+
+	Ogl33PostProgram(Ogl33PostProgram&&);
+
+	void use();
+	/// Samples the texture through texture unit 0
+	void setSource(GLuint texture, size_t width, size_t height);
+	void setDirection(const std::array<float, 2>& direction);
+};
+
+class Ogl33PostStage {
+private:
+	// Ping-pong images of the intermediate passes, at most two per size
+	std::vector<Ogl33RenderImage> images;
+	size_t images_width = 0;
+	size_t images_height = 0;
+
+	// Without any buffers, the triangle is made from gl_VertexID
+	GLuint vertex_array = 0;
+
+	// Timer query of every pass, pending until its result is read
+	std::vector<GLuint> queries;
+	std::vector<uint8_t> pending_queries;
+
+	/// Index of an image of that size, which isn't the one at avoid
+	size_t acquireImage(size_t width, size_t height, size_t avoid);
+	/// Reads the last result of the pass' query and begins the next one, if the driver has the result
+	bool beginQuery(size_t pass);
+public:
+	Ogl33PostStage(const RenderTextureId& input, const RenderTargetId& output);
+	~Ogl33PostStage();
 
+	Ogl33PostStage(Ogl33PostStage&&);
+
+	RenderTextureId input_id;
+	RenderTargetId target_id;
+	std::vector<RenderPostPass> passes;
+	RenderPostStageStatistics statistics;
+
+	/// Leaves the output bound
 	void render(Ogl33Render& render);
 };
 
@@ -169,6 +349,21 @@ public:
 	std::unordered_map<RenderTargetId, RenderTargetUpdate> render_target_times;	
 
 	std::queue<RenderTargetId> render_target_draw_tasks;
+
+	// Order of all stages, rebuilt when stages, their inputs or render textures change
+	Ogl33RenderGraph render_graph;
+	// Images shared by transient render textures
+	std::vector<Own<Ogl33RenderImage>> render_images;
+
+	std::unordered_map<PostProgramId, Ogl33PostProgram> post_programs;
+	std::unordered_map<RenderPostStageId, Ogl33PostStage> post_stages;
+	std::unordered_multimap<RenderTargetId, RenderPostStageId> render_target_post_stages;
+
+	Ogl33ProgramCache program_cache;
+
+	// Shared by all stages, refilled by each of them
+	Ogl33FrameBuffer frame_buffer;
+	Ogl33ObjectBuffer object_buffer;
 };
 
 class Ogl33Resources2D {
@@ -178,6 +373,30 @@ public:
 	// 2D Resource Storage
 	std::unordered_map<MeshId, Ogl33Mesh> meshes;
 	std::unordered_map<ProgramId, Ogl33Program> programs;
+
+	// Program variants. Every program id is a variant, the base program uses no features.
+	// Variants are only inserted into programs once they are compiled.
+	struct ProgramSource {
+		std::string vertex;
+		std::string fragment;
+	};
+	std::unordered_map<ProgramId, ProgramSource> program_sources;
+	struct ProgramVariant {
+		ProgramId base;
+		ProgramFeatures features;
+	};
+	std::unordered_map<ProgramId, ProgramVariant> program_variants;
+	// (base << 32 | features) -> variant
+	std::unordered_map<uint64_t, ProgramId> program_variant_ids;
+
+	// Programs which are still compiling. The feeder is only set for createProgramAsync
+	struct PendingProgram {
+		Ogl33PendingProgram program;
+		Own<ConveyorFeeder<ProgramId>> feeder;
+	};
+	std::unordered_map<ProgramId, PendingProgram> pending_programs;
+	// Variants which failed to compile, not retried until the program is destroyed
+	std::set<ProgramId> failed_programs;
 	std::unordered_map<RenderCameraId, Ogl33Camera> cameras;
 	std::unordered_map<RenderPropertyId, Ogl33RenderProperty> render_properties;
 	std::unordered_map<RenderSceneId, Ogl33Scene> scenes;
@@ -186,6 +405,31 @@ public:
 	// Stages listening  to RenderTarget changes
 	std::unordered_multimap<RenderTargetId, RenderStageId> render_target_stages;
 
+	// Changes whenever a property's mesh or texture changes
+	uint64_t property_version = 0;
+
+	// Created with the first emitter
+	ProgramId particle_program = 0;
+	MeshId particle_mesh = 0;
+
+	std::unordered_map<RenderAnimationId, Ogl33Animation> animations;
+	// Animations currently playing on objects
+	struct AnimationBinding {
+		RenderSceneId scene;
+		RenderObjectId object;
+		RenderAnimationId animation;
+		std::chrono::steady_clock::time_point start;
+		bool loop;
+		Own<ConveyorFeeder<void>> feeder;
+		// Step tracks are only applied when their key changes
+		size_t visibility_key = SIZE_MAX;
+		size_t property_key = SIZE_MAX;
+	};
+	std::vector<AnimationBinding> animation_bindings;
+	// Time of the last update, animations start from here
+	std::chrono::steady_clock::time_point animation_time = std::chrono::steady_clock::now();
+	Ogl33AnimationSampler animation_sampler;
+
 public:
 	Ogl33Resources2D(Ogl33Resources& resources):res{&resources}{}
 };
@@ -196,13 +440,32 @@ private:
 	Ogl33Resources2D resources;
 	Ogl33Render* render;
 
+	ErrorOr<ProgramId> registerProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept;
+	Error insertProgram(const ProgramId&, GLuint) noexcept;
+
+	/// Hands the program to the driver without waiting for it
+	Error beginProgram(const ProgramId&) noexcept;
+	/// Blocks until the driver is done with the program
+	Error finishProgram(const ProgramId&) noexcept;
+	Error compileProgram(const ProgramId&) noexcept;
+
+	Error createParticleResources() noexcept;
+	void markProgramFailed(const ProgramId&) noexcept;
 public:
 	Ogl33Render2D(Ogl33Render& r);
 
+	/// Evaluates all playing animations at the given time and writes them into the scenes
+	void updateAnimations(const std::chrono::steady_clock::time_point&) noexcept;
+
 	Ogl33Resources2D& getResources(){
 		return resources;
 	}
 
+	/// Compiles the variant if it isn't yet, nullptr if it failed to compile before
+	Ogl33Program* getCompiledProgram(const ProgramId&) noexcept;
+	/// Finishes programs the driver is done with
+	void pollPrograms() noexcept;
+
 	// 2D
 	ErrorOr<MeshId> createMesh(const MeshData&) noexcept override;
 	Error setMeshData(const MeshId&, const MeshData&) noexcept override;
@@ -210,7 +473,11 @@ public:
 
 	ErrorOr<ProgramId> createProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept override;
 	ErrorOr<ProgramId> createProgram() noexcept override;
+	Conveyor<ProgramId> createProgramAsync(const std::string& vertex_src, const std::string& fragment_src) noexcept override;
 	Error destroyProgram(const ProgramId&) noexcept override;
+	ErrorOr<ProgramId> getProgramVariant(const ProgramId& base, ProgramFeatures) noexcept override;
+	Error prewarmProgramVariants(const ProgramId& base, const std::vector<ProgramFeatures>&) noexcept override;
+	Error setProgramTint(const ProgramId&, float r, float g, float b, float a) noexcept override;
 
 	ErrorOr<RenderCameraId> createCamera() noexcept override;
 	Error setCameraPosition(const RenderCameraId&, float x, float y) noexcept override;
@@ -220,10 +487,13 @@ public:
 	
 	ErrorOr<RenderStageId> createStage(const RenderTargetId& id, const RenderViewportId&, const RenderSceneId&, const RenderCameraId&, const ProgramId&) noexcept override;
 	Error destroyStage(const RenderStageId&) noexcept override;
+	Error setStageInputs(const RenderStageId&, const std::vector<RenderTextureId>&) noexcept override;
 
 	ErrorOr<RenderPropertyId> createProperty(const MeshId&, const TextureId&) noexcept override;
 	Error setPropertyMesh(const RenderPropertyId&, const MeshId& id) noexcept override;
 	Error setPropertyTexture(const RenderPropertyId&, const TextureId& id) noexcept override;
+	ErrorOr<RenderPropertyId> createFlipbookProperty(const MeshId&, const TextureId& atlas, const FlipbookData&) noexcept override;
+	Error setPropertyFlipbook(const RenderPropertyId&, const FlipbookData&) noexcept override;
 	Error destroyProperty(const RenderPropertyId&) noexcept override;
 
 	ErrorOr<RenderSceneId> createScene() noexcept override;
@@ -231,10 +501,38 @@ public:
 	Error setObjectPosition(const RenderSceneId&, const RenderObjectId&, float, float, bool interpolate = true) noexcept override;
 	Error setObjectRotation(const RenderSceneId&, const RenderObjectId&, float, bool interpolate = true) noexcept override;
 	Error setObjectVisibility(const RenderSceneId&, const RenderObjectId&, bool) noexcept override;
+	Error setObjectParent(const RenderSceneId&, const RenderObjectId&, const RenderObjectId& parent) noexcept override;
+	Error setObjectStatic(const RenderSceneId&, const RenderObjectId&, bool) noexcept override;
+	Error setLayerStatic(const RenderSceneId&, float layer, bool) noexcept override;
 	Error setObjectLayer(const RenderSceneId& id, const RenderObjectId&, float) noexcept override;
 	Error setObjectProperty(const RenderSceneId& id, const RenderObjectId&, const RenderPropertyId&) noexcept override;
+	Error restartObjectFlipbook(const RenderSceneId&, const RenderObjectId&) noexcept override;
 	Error destroyObject(const RenderSceneId&, const RenderObjectId&) noexcept override;
 	Error destroyScene(const RenderSceneId&) noexcept override;
+	ErrorOr<RenderSceneStatistics> getSceneStatistics(const RenderSceneId&) noexcept override;
+	ErrorOr<RenderSceneSnapshots*> createSceneSnapshots(const RenderSceneId&) noexcept override;
+
+	// Tilemap Operations
+	ErrorOr<RenderTilemapId> createTilemap(const RenderSceneId&, const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, size_t width, size_t height, float tile_size) noexcept override;
+	Error setTilemapTile(const RenderSceneId&, const RenderTilemapId&, size_t x, size_t y, TileIndex) noexcept override;
+	Error setTilemapTiles(const RenderSceneId&, const RenderTilemapId&, size_t x, size_t y, size_t width, size_t height, const std::vector<TileIndex>&) noexcept override;
+	Error setTilemapPosition(const RenderSceneId&, const RenderTilemapId&, float x, float y) noexcept override;
+	Error setTilemapLayer(const RenderSceneId&, const RenderTilemapId&, float) noexcept override;
+	Error destroyTilemap(const RenderSceneId&, const RenderTilemapId&) noexcept override;
+
+	// Particle Emitter Operations
+	ErrorOr<RenderEmitterId> createEmitter(const RenderSceneId&, const TextureId&, const ParticleEmitterParameters&) noexcept override;
+	Error setEmitterParameters(const RenderSceneId&, const RenderEmitterId&, const ParticleEmitterParameters&) noexcept override;
+	Error setEmitterPosition(const RenderSceneId&, const RenderEmitterId&, float x, float y) noexcept override;
+	Error setEmitterLayer(const RenderSceneId&, const RenderEmitterId&, float) noexcept override;
+	Error setEmitterActive(const RenderSceneId&, const RenderEmitterId&, bool) noexcept override;
+	Error destroyEmitter(const RenderSceneId&, const RenderEmitterId&) noexcept override;
+
+	// Animation Operations
+	ErrorOr<RenderAnimationId> createAnimation(const RenderAnimationData&) noexcept override;
+	Error destroyAnimation(const RenderAnimationId&) noexcept override;
+	Conveyor<void> playAnimation(const RenderSceneId&, const RenderObjectId&, const RenderAnimationId&, bool loop = false) noexcept override;
+	Error stopAnimations(const RenderSceneId&, const RenderObjectId&) noexcept override;
 };
 
 class Ogl33Resources3D {
@@ -251,27 +549,44 @@ public:
 
 	// Stages listening  to RenderTarget changes
 	std::unordered_multimap<RenderTargetId, RenderStage3dId> render_target_stages_3d;
+
+	// Kept to build the depth pre-pass variant of a program
+	struct Program3dSource {
+		std::string vertex;
+		std::string fragment;
+	};
+	std::unordered_map<Program3dId, Program3dSource> program_sources_3d;
+	// Depth pre-pass variants, compiled for the first stage using one with its program
+	std::unordered_map<Program3dId, Ogl33Program3d> depth_programs_3d;
+	// Programs whose variant failed to compile, not retried until the program is destroyed
+	std::set<Program3dId> failed_depth_programs_3d;
 public:
 	Ogl33Resources3D(Ogl33Resources& resources):res{&resources}{}
 };
 
-/*
 class Ogl33Render3D final : public LowLevelRender3D {
 private:
-	Ogl33Resources2D resources;
+	Ogl33Resources3D resources;
 	Ogl33Render* render;
 
+	Error compileDepthProgram3d(const Program3dId&) noexcept;
 public:
-	Ogl33Render3D(Ogl33Render& r):resources_3d{r.getResources()}, render{&r}{}
+	Ogl33Render3D(Ogl33Render& r);
 
+	Ogl33Resources3D& getResources(){
+		return resources;
+	}
+
+	/// Depth pre-pass variant of the program, nullptr if it doesn't compile
+	Ogl33Program3d* getDepthProgram3d(const Program3dId&) noexcept;
 
 	// 3D
 	ErrorOr<Mesh3dId> createMesh3d(const Mesh3dData&) noexcept override;
 	Error destroyMesh3d(const Mesh3dId&) noexcept override;
 
-	/// @todo layout api ideas
 	ErrorOr<RenderProperty3dId> createProperty3d(const Mesh3dId&, const TextureId&) noexcept override;
 	Error destroyProperty3d(const RenderProperty3dId&) noexcept override;
+	Error setProperty3dTransparent(const RenderProperty3dId&, bool) noexcept override;
 
 	ErrorOr<Program3dId> createProgram3d(const std::string& vertex_src, const std::string& fragment_src) noexcept override;
 	ErrorOr<Program3dId> createProgram3d() noexcept override;
@@ -280,17 +595,27 @@ public:
 	ErrorOr<RenderScene3dId> createScene3d() noexcept override;
 	ErrorOr<RenderObject3dId> createObject3d(const RenderScene3dId&, const RenderProperty3dId&) noexcept override;
 	Error destroyObject3d(const RenderScene3dId&, const RenderObject3dId&) noexcept override;
+	Error setObject3dPosition(const RenderScene3dId&, const RenderObject3dId&, float x, float y, float z) noexcept override;
+	Error setObject3dRotation(const RenderScene3dId&, const RenderObject3dId&, float alpha, float beta, float gamma) noexcept override;
+	Error setObject3dOrientation(const RenderScene3dId&, const RenderObject3dId&, float x, float y, float z, float w) noexcept override;
+	Error setObject3dVisibility(const RenderScene3dId&, const RenderObject3dId&, bool) noexcept override;
 	Error destroyScene3d(const RenderScene3dId&) noexcept override;
+	ErrorOr<RenderScene3dSnapshots*> createScene3dSnapshots(const RenderScene3dId&) noexcept override;
 
 	ErrorOr<RenderCamera3dId> createCamera3d() noexcept override;
 	Error setCamera3dPosition(const RenderCamera3dId&, float, float, float) noexcept override;
+	Error setCamera3dRotation(const RenderCamera3dId&, float alpha, float beta, float gamma) noexcept override;
+	Error setCamera3dOrientation(const RenderCamera3dId&, float x, float y, float z, float w) noexcept override;
 	Error setCamera3dOrthographic(const RenderCamera3dId&, float, float, float, float, float, float) noexcept override;
+	Error setCamera3dPerspective(const RenderCamera3dId&, float fov_y, float aspect, float near, float far, bool reverse_depth) noexcept override;
 	Error destroyCamera3d(const RenderCamera3dId&) noexcept override;
 
 	ErrorOr<RenderStage3dId> createStage3d(const RenderTargetId&, const RenderViewportId&, const RenderScene3dId&, const RenderCamera3dId&, const Program3dId&) noexcept override;
 	Error destroyStage3d(const RenderStage3dId&) noexcept override;
+	Error setStage3dPasses(const RenderStage3dId&, const RenderStage3dPasses&) noexcept override;
+	Error setStage3dInputs(const RenderStage3dId&, const std::vector<RenderTextureId>&) noexcept override;
+	ErrorOr<RenderStage3dStatistics> getStage3dStatistics(const RenderStage3dId&) noexcept override;
 };
-*/
 
 class Ogl33Render final : public LowLevelRender {
 private:
@@ -301,12 +626,29 @@ private:
 	Ogl33Resources resources;
 
 	Ogl33Render2D render_2d;
-	//Ogl33Render3D render_3d;
+	Ogl33Render3D render_3d;
 
 	void stepRenderTargetTimes(const std::chrono::steady_clock::time_point&);
 
+	/// Sorts the stages and hands out the pooled images to transient render textures
+	void compileRenderGraph() noexcept;
+	/// Whether the first stage drawing into the target from step index on uses reversed depth
+	bool startsReversed(size_t index) noexcept;
+	// Reused between frames
+	std::vector<RenderTargetId> due_targets;
+	std::vector<RenderTargetId> deferred_targets;
+	std::vector<Ogl33RenderGraph::Step> render_steps;
+
+	std::chrono::steady_clock::time_point start_time_point;
 	std::chrono::steady_clock::time_point old_time_point;
 	std::chrono::steady_clock::time_point time_point;
+
+	/// Spreads the world transform updates, static baking, particle simulation and model matrices
+	JobSystem jobs;
+
+	// Reused between updates
+	std::vector<Ogl33ParticleEmitter*> particle_emitters;
+	void simulateParticles(float dt) noexcept;
 public:
 	Ogl33Render(Own<GlContext>&&);
 	~Ogl33Render();
@@ -317,6 +659,7 @@ public:
 	Ogl33RenderProperty* getProperty(const RenderPropertyId&) noexcept;
 	Ogl33Mesh* getMesh(const MeshId&) noexcept;
 	Ogl33Texture* getTexture(const TextureId&) noexcept;
+	Ogl33PostProgram* getPostProgram(const PostProgramId&) noexcept;
 
 	
 	Ogl33Scene3d* getScene3d(const RenderScene3dId&) noexcept;
@@ -330,23 +673,56 @@ public:
 		return resources;
 	}
 
+	Ogl33Render2D& getRender2D() noexcept {
+		return render_2d;
+	}
+
+	Ogl33Render3D& getRender3D() noexcept {
+		return render_3d;
+	}
+
+	JobSystem& jobSystem() noexcept {
+		return jobs;
+	}
+
 	LowLevelRender2D* interface2D() noexcept override {return &render_2d;}
-	LowLevelRender3D* interface3D() noexcept override {return nullptr;}
+	LowLevelRender3D* interface3D() noexcept override {return &render_3d;}
 
 	ErrorOr<TextureId> createTexture(const Image&) noexcept override;
+	ErrorOr<TextureId> createTexture(const CompressedImage&) noexcept override;
+	bool supportsTextureFormat(TextureFormat) const noexcept override;
 	Error destroyTexture(const TextureId&) noexcept override;
 
 	ErrorOr<RenderWindowId> createWindow(const RenderVideoMode&, const std::string& title) noexcept override;
 	Error setWindowDesiredFPS(const RenderWindowId&, float fps) noexcept override;
 	Error setWindowVisibility(const RenderWindowId& id, bool show) noexcept override;
+	Error setWindowIndependentPresent(const RenderWindowId&, bool) noexcept override;
 	Error destroyWindow(const RenderWindowId& id) noexcept override;
 
 	Conveyor<RenderEvent::Events> listenToWindowEvents(const RenderWindowId&) noexcept override;
 
+	ErrorOr<RenderTextureId> createRenderTexture(size_t width, size_t height, bool transient) noexcept override;
+	ErrorOr<TextureId> getRenderTextureTexture(const RenderTextureId&) noexcept override;
+	Error setRenderTargetClearColour(const RenderTargetId&, float r, float g, float b, float a) noexcept override;
+	Error destroyRenderTexture(const RenderTextureId&) noexcept override;
+
+	ErrorOr<PostProgramId> createPostProgram(const std::string& fragment_src) noexcept override;
+	ErrorOr<PostProgramId> createPostProgram() noexcept override;
+	ErrorOr<PostProgramId> createPostBlurProgram() noexcept override;
+	Error destroyPostProgram(const PostProgramId&) noexcept override;
+
+	ErrorOr<RenderPostStageId> createPostStage(const RenderTextureId& input, const RenderTargetId& output) noexcept override;
+	Error setPostStagePasses(const RenderPostStageId&, const std::vector<RenderPostPass>&) noexcept override;
+	ErrorOr<RenderPostStageStatistics> getPostStageStatistics(const RenderPostStageId&) noexcept override;
+	Error destroyPostStage(const RenderPostStageId&) noexcept override;
+
 	ErrorOr<RenderViewportId> createViewport() noexcept override;
 	Error setViewportRect(const RenderViewportId&, float, float, float, float) noexcept override;
 	Error destroyViewport(const RenderViewportId&) noexcept override;
 
+	Error setProgramCacheDirectory(const std::filesystem::path&) noexcept override;
+	RenderProgramStatistics getProgramStatistics() noexcept override;
+
 
 	void step(const std::chrono::steady_clock::time_point&) noexcept override;
 	void flush() noexcept override;
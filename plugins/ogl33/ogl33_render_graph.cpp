@@ -0,0 +1,223 @@
+#include "ogl33_render_graph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace gin {
+namespace {
+constexpr uint8_t pass_active = 1;
+constexpr uint8_t pass_finishes = 2;
+
+bool contains(const std::vector<RenderTargetId>& ids, const RenderTargetId& id){
+	return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+}
+
+void Ogl33RenderGraph::compile(std::vector<Pass>&& passes, const std::vector<Transient>& transients){
+	schedule.clear();
+	images.clear();
+	aliases.clear();
+
+	size_t count = passes.size();
+	std::vector<size_t> predecessors(count, 0);
+	std::vector<std::vector<size_t>> successors(count);
+
+	// Writers of one target are chained, so readers only wait for the last one
+	std::unordered_map<RenderTargetId, size_t> last_writer;
+	for(size_t i = 0; i < count; ++i){
+		auto find = last_writer.find(passes[i].target);
+		if(find != last_writer.end()){
+			successors[find->second].push_back(i);
+			++predecessors[i];
+			find->second = i;
+		}else{
+			last_writer.insert(std::make_pair(passes[i].target, i));
+		}
+	}
+
+	for(size_t i = 0; i < count; ++i){
+		for(auto& read : passes[i].reads){
+			auto find = last_writer.find(read);
+			if(find != last_writer.end() && find->second != i){
+				successors[find->second].push_back(i);
+				++predecessors[i];
+			}
+		}
+	}
+
+	std::vector<size_t> ready;
+	std::vector<size_t> order;
+	order.reserve(count);
+	for(size_t i = 0; i < count; ++i){
+		if(predecessors[i] == 0){
+			ready.push_back(i);
+		}
+	}
+
+	RenderTargetId current = 0;
+	while(!ready.empty()){
+		// Stay on the current target if possible, otherwise take the pass given first
+		size_t pick = 0;
+		for(size_t r = 0; r < ready.size(); ++r){
+			if(passes[ready[r]].target == current){
+				pick = r;
+				break;
+			}
+			if(ready[r] < ready[pick]){
+				pick = r;
+			}
+		}
+
+		size_t index = ready[pick];
+		ready[pick] = ready.back();
+		ready.pop_back();
+
+		current = passes[index].target;
+		order.push_back(index);
+
+		for(auto& successor : successors[index]){
+			if(--predecessors[successor] == 0){
+				ready.push_back(successor);
+			}
+		}
+	}
+
+	if(order.size() < count){
+		std::cerr<<"Render graph has a cycle, dropping "<<(count - order.size())<<" stages"<<std::endl;
+	}
+
+	schedule.reserve(order.size());
+	for(auto& index : order){
+		schedule.push_back(std::move(passes[index]));
+	}
+
+	allocateImages(transients);
+
+	dirty = false;
+}
+
+void Ogl33RenderGraph::allocateImages(const std::vector<Transient>& transients){
+	struct Lifetime {
+		size_t first = no_pass;
+		size_t last = 0;
+	};
+
+	std::unordered_map<RenderTextureId, size_t> transient_index;
+	for(size_t i = 0; i < transients.size(); ++i){
+		transient_index.insert(std::make_pair(transients[i].id, i));
+	}
+
+	std::vector<Lifetime> lifetimes(transients.size());
+	auto use = [&](const RenderTargetId& id, size_t pass){
+		auto find = transient_index.find(id);
+		if(find == transient_index.end()){
+			return;
+		}
+		Lifetime& lifetime = lifetimes[find->second];
+		lifetime.first = std::min(lifetime.first, pass);
+		lifetime.last = std::max(lifetime.last, pass);
+	};
+
+	for(size_t i = 0; i < schedule.size(); ++i){
+		use(schedule[i].target, i);
+		for(auto& read : schedule[i].reads){
+			use(read, i);
+		}
+	}
+
+	std::vector<size_t> by_first;
+	for(size_t i = 0; i < transients.size(); ++i){
+		// Unused ones don't need an image
+		if(lifetimes[i].first != no_pass){
+			by_first.push_back(i);
+		}
+	}
+	std::sort(by_first.begin(), by_first.end(), [&](size_t a, size_t b){
+		return lifetimes[a].first < lifetimes[b].first;
+	});
+
+	// Last pass using each image
+	std::vector<size_t> image_last;
+	for(auto& index : by_first){
+		const Transient& transient = transients[index];
+		const Lifetime& lifetime = lifetimes[index];
+
+		size_t image = images.size();
+		for(size_t i = 0; i < images.size(); ++i){
+			if(images[i].width == transient.width && images[i].height == transient.height && image_last[i] < lifetime.first){
+				image = i;
+				break;
+			}
+		}
+
+		if(image == images.size()){
+			images.push_back(Image{transient.width, transient.height});
+			image_last.push_back(lifetime.last);
+		}else{
+			image_last[image] = lifetime.last;
+		}
+
+		aliases.push_back(std::make_pair(transient.id, image));
+	}
+}
+
+void Ogl33RenderGraph::plan(const std::vector<RenderTargetId>& due, std::vector<Step>& steps){
+	active.assign(schedule.size(), 0);
+	needed.clear();
+
+	// Readers come after all writers, so walking backwards reaches a render texture's
+	// writers only after everything reading it
+	for(size_t i = schedule.size(); i-- > 0;){
+		const Pass& pass = schedule[i];
+		if(!std::binary_search(due.begin(), due.end(), pass.target) && !contains(needed, pass.target)){
+			continue;
+		}
+
+		active[i] = pass_active;
+		for(auto& read : pass.reads){
+			if(!contains(needed, read)){
+				needed.push_back(read);
+			}
+		}
+	}
+
+	visited.clear();
+	for(size_t i = schedule.size(); i-- > 0;){
+		if(active[i] && !contains(visited, schedule[i].target)){
+			active[i] |= pass_finishes;
+			visited.push_back(schedule[i].target);
+		}
+	}
+
+	visited.clear();
+	RenderTargetId bound = 0;
+	for(size_t i = 0; i < schedule.size(); ++i){
+		if(!active[i]){
+			continue;
+		}
+
+		const RenderTargetId& target = schedule[i].target;
+		Step step;
+		step.pass = i;
+		step.target = target;
+		step.bind = target != bound;
+		step.clear = !contains(visited, target);
+		step.finish = (active[i] & pass_finishes) != 0;
+		steps.push_back(step);
+
+		bound = target;
+		if(step.clear){
+			visited.push_back(target);
+		}
+	}
+
+	// Due targets without stages are still cleared and finished
+	for(auto& target : due){
+		if(!contains(visited, target)){
+			steps.push_back(Step{no_pass, target, target != bound, true, true});
+			bound = target;
+		}
+	}
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "render/render.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace gin {
+/**
+* Orders the stages of all render targets, so every stage runs after the ones writing
+* the render textures it reads. The order is only recomputed after invalidate, a frame
+* just picks the passes it needs out of it.
+*/
+class Ogl33RenderGraph {
+public:
+	/// Passes on the same target run in this order
+	enum class PassType : uint8_t {
+		Stage3d,
+		PostProcess,
+		Stage
+	};
+
+	struct Pass {
+		PassType type;
+		uint64_t stage;
+		RenderTargetId target;
+		std::vector<RenderTextureId> reads;
+	};
+
+	struct Transient {
+		RenderTextureId id;
+		size_t width;
+		size_t height;
+	};
+
+	/// Transient render textures with disjoint lifetimes share an image
+	struct Image {
+		size_t width;
+		size_t height;
+	};
+
+	static constexpr size_t no_pass = SIZE_MAX;
+
+	struct Step {
+		/// no_pass for due targets without any stage, which are only cleared
+		size_t pass;
+		RenderTargetId target;
+		bool bind;
+		bool clear;
+		bool finish;
+	};
+private:
+	bool dirty = true;
+
+	std::vector<Pass> schedule;
+	std::vector<Image> images;
+	// Transient render texture and its index in images
+	std::vector<std::pair<RenderTextureId, size_t>> aliases;
+
+	// Reused between frames
+	std::vector<RenderTargetId> needed;
+	std::vector<RenderTargetId> visited;
+	std::vector<uint8_t> active;
+
+	void allocateImages(const std::vector<Transient>& transients);
+public:
+	void invalidate(){
+		dirty = true;
+	}
+
+	bool isDirty() const {
+		return dirty;
+	}
+
+	/**
+	* Sorts the passes topologically. Passes on the same target keep the order they are
+	* given in, and the sort stays on the last target as long as it can, so runs of
+	* passes share a framebuffer bind. Passes in a cycle are dropped.
+	*/
+	void compile(std::vector<Pass>&& passes, const std::vector<Transient>& transients);
+
+	const std::vector<Pass>& passes() const {
+		return schedule;
+	}
+
+	const std::vector<Image>& imagePool() const {
+		return images;
+	}
+
+	const std::vector<std::pair<RenderTextureId, size_t>>& imageAliases() const {
+		return aliases;
+	}
+
+	/**
+	* Appends the steps drawing the due targets and the render textures they depend on.
+	* Targets are bound only when the previous step was on another one, cleared before
+	* their first pass and finished after their last.
+	*
+	* @param due sorted without duplicates
+	*/
+	void plan(const std::vector<RenderTargetId>& due, std::vector<Step>& steps);
+};
+}
@@ -3,12 +3,129 @@
 #include "ogl33_bindings.h"
 
 #include "render/render.h"
+#include "common/math.h"
 
+#include "ogl33_buffer.h"
+#include "ogl33_bvh.h"
+#include "ogl33_mesh.h"
+#include "ogl33_tilemap.h"
+#include "ogl33_particles.h"
+
+#include "job_system.h"
+
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <complex>
+#include <map>
+#include <tuple>
+#include <vector>
 
 namespace gin {
+/**
+* Reader side of a scene's snapshots, see createSceneSnapshots. The objects of the last
+* snapshot are kept, so snapshots listing the same objects don't look them up again.
+*/
+template<typename Snapshot, typename Object>
+class Ogl33SceneSnapshots {
+private:
+	Own<TripleBuffer<Snapshot>> buffer;
+
+	std::chrono::steady_clock::time_point time;
+	std::chrono::steady_clock::time_point previous_time;
+	float interpolation = 1.f;
+
+	std::vector<ResourceId> ids;
+	std::vector<Object*> objects;
+	// Counts the snapshots, objects remember the last one listing them. Starts above
+	// the objects' 0, so nothing counts as listed before the first one.
+	uint64_t serial = 1;
+public:
+	ErrorOr<TripleBuffer<Snapshot>*> create() noexcept {
+		if(!buffer){
+			try{
+				buffer = heap<TripleBuffer<Snapshot>>();
+			}catch(const std::bad_alloc&){
+				return criticalError("Out of memory");
+			}
+		}
+		return buffer.get();
+	}
+
+	bool isListed(const Object& object) const {
+		return buffer && object.snapshot_serial == serial;
+	}
+
+	/// The snapshots' interpolation once there are any, otherwise the frame's
+	float interpolationOr(float frame_interpolation) const {
+		return buffer ? interpolation : frame_interpolation;
+	}
+
+	/**
+	* Has to be called before listed objects are destroyed and after objects are created,
+	* since ids without an object are remembered as missing.
+	*/
+	void forget(){
+		ids.clear();
+		objects.clear();
+	}
+
+	/**
+	* Takes the latest snapshot if there is a new one and calls
+	* apply(id, object, snapshot, index, listed_before) for every listed object which exists.
+	* Afterwards the interpolation places tp between the two latest snapshots, so the
+	* drawn state trails the latest one by a tick.
+	*/
+	template<typename Map, typename Func>
+	void update(Map& map, const std::chrono::steady_clock::time_point& tp, Func&& apply){
+		if(!buffer){
+			return;
+		}
+
+		if(buffer->acquire()){
+			const Snapshot& snapshot = buffer->readSlot();
+			previous_time = serial == 1 ? snapshot.time : time;
+			time = snapshot.time;
+			++serial;
+
+			if(ids != snapshot.objects){
+				try{
+					ids = snapshot.objects;
+					objects.resize(ids.size());
+				}catch(const std::bad_alloc&){
+					// Skips the snapshot, the objects stay where they are
+					forget();
+				}
+				for(size_t i = 0; i < objects.size(); ++i){
+					auto find = map.find(ids[i]);
+					objects[i] = find != map.end() ? &find->second : nullptr;
+				}
+			}
+
+			for(size_t i = 0; i < objects.size(); ++i){
+				Object* object = objects[i];
+				if(!object){
+					continue;
+				}
+				bool listed_before = object->snapshot_serial + 1 == serial;
+				object->snapshot_serial = serial;
+				apply(ids[i], *object, snapshot, i, listed_before);
+			}
+		}
+
+		std::chrono::duration<float> tick = time - previous_time;
+		if(tick.count() <= 0.f){
+			interpolation = 1.f;
+			return;
+		}
+		std::chrono::duration<float> since = tp - time;
+		interpolation = std::max(0.f, std::min(1.f, since.count() / tick.count()));
+	}
+};
+
 class Ogl33Camera;
+class Ogl33Render;
 class Ogl33Scene {
 public:
 	struct RenderObject {
@@ -22,22 +139,199 @@ public:
 
 		float layer = 0.f;
 		bool visible = true;
+		// Frames of flipbook properties count from here, in seconds since the renderer started
+		float flipbook_start = 0.f;
+
+		// Transforms after applying all parents
+		std::array<float,2> world_pos{{0.f, 0.f}};
+		std::complex<float> world_angle = std::polar(1.f, 0.f);
+
+		std::array<float,2> old_world_pos{{0.f, 0.f}};
+		std::complex<float> old_world_angle = std::polar(1.f, 0.f);
+
+		RenderObjectId parent = 0;
+		std::vector<RenderObjectId> children;
+
+		// Index into the persistent object buffer
+		uint32_t slot = 0;
+
+		// Position in hierarchy
+		uint32_t hierarchy_index = 0;
+		bool transform_dirty = false;
+
+		// Position in active_objects while the object is interpolating
+		static constexpr uint32_t inactive = UINT32_MAX;
+		uint32_t active_index = inactive;
+
+		// Baked into static_chunks instead of being drawn on its own
+		bool is_static = false;
+		bool static_pending = false;
+		bool world_changed = false;
+		static constexpr uint32_t no_chunk = UINT32_MAX;
+		uint32_t static_chunk = no_chunk;
+
+		// Last snapshot listing the object
+		uint64_t snapshot_serial = 0;
+
+		RenderObject(const RenderPropertyId& p_id):id{p_id}{}
 	};
+
+	/**
+	* Static objects sharing a texture and layer within the same square of the scene,
+	* merged into one pretransformed mesh and drawn with a single call.
+	*/
+	struct StaticChunk {
+		TextureId texture_id;
+		float layer;
+		std::array<int32_t, 2> cell;
+
+		std::vector<RenderObjectId> objects;
+		bool dirty = false;
+
+		Ogl33Mesh mesh;
+		size_t index_count = 0;
+		// Covers the baked vertices as min x, min y, max x, max y
+		std::array<float, 4> bounds{{0.f, 0.f, 0.f, 0.f}};
+		// Identity transform for programs reading the persistent object buffer
+		uint32_t slot = 0;
+	};
+
+	static constexpr float static_chunk_size = 256.f;
 private:
 	std::unordered_map<RenderObjectId, RenderObject> objects;
+
+	/**
+	* Three texels per slot: the previous position and rotation, the current ones and the layer.
+	* Only written if an object changes, so static objects cost nothing per frame.
+	*/
+	Ogl33PersistentObjectBuffer gpu_objects{3};
+	std::vector<uint32_t> free_slots;
+
+	uint32_t allocateSlot();
+	void freeSlot(uint32_t slot);
+
+	// Changes whenever objects are added, removed, hidden or change their property
+	uint64_t structure_version = 0;
+
+	/**
+	* Objects whose previous transform differs from the current one. updateState only visits these,
+	* and they drop out once they converged.
+	*/
+	std::vector<RenderObjectId> active_objects;
+
+	/**
+	* Objects in depth first order, so every subtree is a contiguous range starting with its root
+	* and parents are always computed before their children.
+	*/
+	struct HierarchyNode {
+		RenderObjectId id;
+		RenderObject* object;
+		static constexpr uint32_t no_parent = UINT32_MAX;
+		uint32_t parent;
+		uint32_t subtree_end;
+	};
+	std::vector<HierarchyNode> hierarchy;
+	bool hierarchy_dirty = true;
+
+	// Objects whose local transform changed since the last updateWorldTransforms
+	std::vector<RenderObjectId> transform_dirty;
+
+	std::vector<StaticChunk> static_chunks;
+	std::map<std::tuple<TextureId, float, int32_t, int32_t>, uint32_t> static_chunk_ids;
+	std::vector<float> static_layers;
+	// Static objects which aren't baked yet. They are drawn like every other object until then.
+	std::vector<RenderObjectId> static_pending;
+	bool chunks_dirty = false;
+	uint64_t baked_property_version = 0;
+	size_t baked_objects = 0;
+
+	std::unordered_map<RenderTilemapId, Ogl33Tilemap> tilemaps;
+	void writeTilemap(Ogl33Tilemap&);
+
+	std::unordered_map<RenderEmitterId, Ogl33ParticleEmitter> emitters;
+
+	// Time of the last update, new flipbooks start here
+	float current_time = 0.f;
+
+	Ogl33SceneSnapshots<RenderSceneSnapshot, RenderObject> snapshots;
+
+	bool shouldBake(const RenderObject&) const;
+	/// Removes the object from its chunk and queues it again if it's still static
+	void refreshStatic(const RenderObjectId&, RenderObject&);
+	void unbake(const RenderObjectId&, RenderObject&);
+	/// Frees an empty chunk, the last chunk takes its index
+	void releaseStaticChunk(uint32_t chunk_id);
+
+	void markDirty(const RenderObjectId&, RenderObject&);
+	void rebuildHierarchy();
+	void computeWorldTransforms(size_t begin, size_t end);
+
+	void writeObject(const RenderObject&);
+	void activate(const RenderObjectId&, RenderObject&);
+	void deactivate(RenderObject&);
 public:
 
 	ErrorOr<RenderObjectId> createObject(const RenderPropertyId& id) noexcept;
 	void destroyObject(const RenderObjectId& id) noexcept;
+	bool hasObject(const RenderObjectId& id) const noexcept;
 	Error setObjectPosition(const RenderObjectId& id, float x, float y, bool interpolate) noexcept;
 	Error setObjectRotation(const RenderObjectId& id, float a, bool interpolate) noexcept;
 	Error setObjectVisibility(const RenderObjectId& id, bool v) noexcept;
 	Error setObjectLayer(const RenderObjectId& id, float l) noexcept;
 	Error setObjectProperty(const RenderObjectId& id, const RenderPropertyId& property) noexcept;
+	Error restartFlipbook(const RenderObjectId& id) noexcept;
+	void setCurrentTime(float time);
+	/**
+	* Position and rotation become relative to the parent. 0 detaches the object.
+	* Children of destroyed objects become roots.
+	*/
+	Error setObjectParent(const RenderObjectId& id, const RenderObjectId& parent) noexcept;
+	Error setObjectStatic(const RenderObjectId& id, bool s) noexcept;
+	Error setLayerStatic(float layer, bool s) noexcept;
+
+	ErrorOr<RenderTilemapId> createTilemap(const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, size_t width, size_t height, float tile_size) noexcept;
+	Error destroyTilemap(const RenderTilemapId& id) noexcept;
+	Error setTilemapTile(const RenderTilemapId& id, size_t x, size_t y, TileIndex tile) noexcept;
+	Error setTilemapTiles(const RenderTilemapId& id, size_t x, size_t y, size_t w, size_t h, const std::vector<TileIndex>& tiles) noexcept;
+	Error setTilemapPosition(const RenderTilemapId& id, float x, float y) noexcept;
+	Error setTilemapLayer(const RenderTilemapId& id, float layer) noexcept;
+	std::unordered_map<RenderTilemapId, Ogl33Tilemap>& getTilemaps();
+
+	ErrorOr<RenderEmitterId> createEmitter(const TextureId& texture, const ParticleEmitterParameters& parameters) noexcept;
+	Error destroyEmitter(const RenderEmitterId& id) noexcept;
+	Ogl33ParticleEmitter* getEmitter(const RenderEmitterId& id) noexcept;
+	std::unordered_map<RenderEmitterId, Ogl33ParticleEmitter>& getEmitters();
 
 	void visit(const Ogl33Camera&, std::vector<RenderObject*>&);
 
+	/// Objects listed in the latest snapshot are left to applySnapshots
 	void updateState(float interval);
+
+	ErrorOr<RenderSceneSnapshots*> createSnapshots() noexcept;
+	/// Moves the listed objects to the latest snapshot and interpolates towards it at tp
+	void applySnapshots(const std::chrono::steady_clock::time_point& tp);
+	/// Interpolation the scene is drawn with
+	float interpolation(float frame_interpolation) const;
+
+	/**
+	* Recomputes the world transforms of dirty subtrees. Independent subtrees are
+	* split across the job system if there is enough work.
+	*/
+	void updateWorldTransforms(JobSystem* job_system = nullptr);
+
+	/**
+	* Assigns pending static objects to their chunks, releases empty chunks and rebakes the dirty ones.
+	* The vertices are transformed across the job system, the uploads happen afterwards.
+	*/
+	void bakeStaticChunks(Ogl33Render& render, JobSystem* job_system = nullptr);
+	const std::vector<StaticChunk>& staticChunks() const;
+	size_t bakedObjectCount() const;
+
+	size_t activeObjectCount() const;
+	size_t staticObjectCount() const;
+
+	uint64_t structureVersion() const;
+	Ogl33PersistentObjectBuffer& gpuObjects();
 };
 
 class Ogl33Camera3d;
@@ -46,28 +340,64 @@ public:
 	struct RenderObject {
 		RenderProperty3dId id = 0;
 
-		std::array<float, 3> pos{{0.f, 0.f, 0.f}};
-		std::array<float, 3> rot{{0.f, 0.f, 0.f}};
-
-		std::array<float, 3> old_pos{{0.f, 0.f, 0.f}};
-		std::array<float, 3> old_rot{{0.f, 0.f, 0.f}};
+		Transform3<float> transform;
+		Transform3<float> old_transform;
 
 		bool visible = true;
 
+		// Leaf in the bvh, refit by updateBounds
+		uint32_t leaf = Ogl33Bvh::null_node;
+		uint32_t slot = 0;
+		bool bounds_dirty = false;
+
+		// Last snapshot listing the object
+		uint64_t snapshot_serial = 0;
+
 		RenderObject(const RenderProperty3dId& p_id):id{p_id}{}
 	};
 private:
 	std::unordered_map<RenderObject3dId, RenderObject> objects;
+
+	/**
+	* Covers the old and the current transform of every object, since the drawn
+	* transform lies in between.
+	*/
+	Ogl33Bvh bvh;
+	// Leaves refer to their objects through these slots
+	std::vector<RenderObject*> slot_objects;
+	std::vector<uint32_t> free_slots;
+
+	std::vector<RenderObject3dId> bounds_dirty;
+	std::vector<uint32_t> visible_slots;
+
+	Ogl33SceneSnapshots<RenderScene3dSnapshot, RenderObject> snapshots;
+
+	void markBoundsDirty(const RenderObject3dId&, RenderObject&);
 public:
 	ErrorOr<RenderObject3dId> createObject(const RenderProperty3dId&) noexcept;
 	void destroyObject(const RenderObject3dId&) noexcept;
 
 	Error setObjectPosition(const RenderObject3dId&, float, float, float) noexcept;
 	Error setObjectRotation(const RenderObject3dId&, float, float, float) noexcept;
+	Error setObjectOrientation(const RenderObject3dId&, float, float, float, float) noexcept;
 	Error setObjectVisibility(const RenderObject3dId&, bool) noexcept;
 
-	void visit(const Ogl33Camera3d&, std::vector<RenderObject>&);
+	/**
+	* Refits the bvh for objects which moved since the last call. Objects whose
+	* property or mesh doesn't exist yet are retried on the next call.
+	*/
+	void updateBounds(Ogl33Render& render) noexcept;
 
+	/// Visible objects intersecting the camera's frustum
+	void visit(const Ogl33Camera3d&, std::vector<RenderObject*>&);
+
+	/// The current transforms become the ones interpolated from, except for objects listed in the latest snapshot
 	void updateState();
+
+	ErrorOr<RenderScene3dSnapshots*> createSnapshots() noexcept;
+	void applySnapshots(const std::chrono::steady_clock::time_point& tp);
+	float interpolation(float frame_interpolation) const;
+
+	const Ogl33Bvh& boundingVolumes() const;
 };
-}
\ No newline at end of file
+}
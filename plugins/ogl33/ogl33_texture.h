@@ -10,12 +10,15 @@ namespace gin {
 class Ogl33Texture {
 private:
 	GLuint tex_id;
+	bool owned;
 public:
 	Ogl33Texture();
-	Ogl33Texture(GLuint tex_id);
+	Ogl33Texture(GLuint tex_id, bool owned = true);
 	~Ogl33Texture();
 	Ogl33Texture(Ogl33Texture&&);
 
 	void bind() const;
+	/// Points a texture, which doesn't own its id, at another one
+	void alias(GLuint tex_id);
 };
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "ogl33_tilemap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace gin {
+namespace {
+size_t chunkCount(size_t tiles){
+	return (tiles + Ogl33Tilemap::chunk_tiles - 1) / Ogl33Tilemap::chunk_tiles;
+}
+}
+
+Ogl33Tilemap::Ogl33Tilemap(size_t w, size_t h, const TextureId& atlas, size_t columns, size_t rows, float size):
+	width{w},
+	height{h},
+	tiles(w * h, 0),
+	atlas_id{atlas},
+	atlas_columns{std::max<size_t>(columns, 1)},
+	atlas_rows{std::max<size_t>(rows, 1)},
+	tile_size{size},
+	chunk_columns{chunkCount(w)},
+	chunk_rows{chunkCount(h)},
+	chunks(chunk_columns * chunk_rows)
+{}
+
+Error Ogl33Tilemap::setTile(size_t x, size_t y, TileIndex tile){
+	if(x >= width || y >= height){
+		return criticalError("Tile is outside of the tilemap");
+	}
+
+	TileIndex& current = tiles[y * width + x];
+	if(current != tile){
+		current = tile;
+		chunks[(y / chunk_tiles) * chunk_columns + x / chunk_tiles].dirty = true;
+	}
+	return noError();
+}
+
+Error Ogl33Tilemap::setTiles(size_t x, size_t y, size_t w, size_t h, const std::vector<TileIndex>& source){
+	if(x > width || y > height || w > width - x || h > height - y){
+		return criticalError("Tiles are outside of the tilemap");
+	}
+	if(source.size() < w * h){
+		return criticalError("Not enough tiles");
+	}
+	if(w == 0 || h == 0){
+		return noError();
+	}
+
+	for(size_t j = 0; j < h; ++j){
+		std::copy(source.begin() + j * w, source.begin() + (j + 1) * w, tiles.begin() + (y + j) * width + x);
+	}
+
+	for(size_t cy = y / chunk_tiles; cy <= (y + h - 1) / chunk_tiles; ++cy){
+		for(size_t cx = x / chunk_tiles; cx <= (x + w - 1) / chunk_tiles; ++cx){
+			chunks[cy * chunk_columns + cx].dirty = true;
+		}
+	}
+	return noError();
+}
+
+const TextureId& Ogl33Tilemap::atlas() const {
+	return atlas_id;
+}
+
+void Ogl33Tilemap::buildChunk(size_t cx, size_t cy){
+	Chunk& chunk = chunks[cy * chunk_columns + cx];
+
+	size_t x_begin = cx * chunk_tiles;
+	size_t y_begin = cy * chunk_tiles;
+	size_t x_end = std::min(x_begin + chunk_tiles, width);
+	size_t y_end = std::min(y_begin + chunk_tiles, height);
+
+	size_t tile_count = 0;
+	for(size_t y = y_begin; y < y_end; ++y){
+		for(size_t x = x_begin; x < x_end; ++x){
+			if(tiles[y * width + x] != 0){
+				++tile_count;
+			}
+		}
+	}
+
+	// Empty chunks don't need a mesh
+	if(tile_count == 0 && !chunk.resident){
+		chunk.index_count = 0;
+		chunk.dirty = false;
+		return;
+	}
+
+	MeshData data;
+	data.vertices.reserve(tile_count * 4);
+	data.indices.reserve(tile_count * 6);
+
+	float u_size = 1.f / atlas_columns;
+	float v_size = 1.f / atlas_rows;
+	for(size_t y = y_begin; y < y_end; ++y){
+		for(size_t x = x_begin; x < x_end; ++x){
+			TileIndex tile = tiles[y * width + x];
+			if(tile == 0){
+				continue;
+			}
+
+			size_t cell = static_cast<size_t>(tile - 1);
+			float u = (cell % atlas_columns) * u_size;
+			float v = ((cell / atlas_columns) % atlas_rows) * v_size;
+
+			float left = x * tile_size;
+			float bottom = y * tile_size;
+			float right = left + tile_size;
+			float top = bottom + tile_size;
+
+			// Same orientation as the other meshes, the top of the image is at v = 0
+			unsigned int base = static_cast<unsigned int>(data.vertices.size());
+			data.vertices.push_back(MeshData::Vertex{{{right, top}}, {{u + u_size, v}}});
+			data.vertices.push_back(MeshData::Vertex{{{right, bottom}}, {{u + u_size, v + v_size}}});
+			data.vertices.push_back(MeshData::Vertex{{{left, bottom}}, {{u, v + v_size}}});
+			data.vertices.push_back(MeshData::Vertex{{{left, top}}, {{u, v}}});
+
+			for(unsigned int index : {2u, 1u, 0u, 2u, 0u, 3u}){
+				data.indices.push_back(base + index);
+			}
+		}
+	}
+
+	if(!chunk.resident){
+		chunk.mesh = createOgl33Mesh(MeshData{});
+		chunk.resident = true;
+		++resident_chunks;
+	}
+	chunk.mesh.upload(data);
+	chunk.index_count = data.indices.size();
+	chunk.dirty = false;
+}
+
+void Ogl33Tilemap::evictChunks(){
+	// Chunks drawn during the last few draws stay, so several stages looking at different areas don't thrash
+	for(auto& iter : chunks){
+		if(resident_chunks <= max_resident_chunks){
+			break;
+		}
+		if(iter.resident && iter.last_drawn + 8 < draw_count){
+			iter.mesh = Ogl33Mesh{};
+			iter.index_count = 0;
+			iter.resident = false;
+			iter.dirty = true;
+			--resident_chunks;
+		}
+	}
+}
+
+void Ogl33Tilemap::draw(const Bounds& view){
+	++draw_count;
+
+	float chunk_size = chunk_tiles * tile_size;
+	if(chunk_columns == 0 || chunk_rows == 0 || chunk_size <= 0.f){
+		return;
+	}
+
+	// Chunk range intersecting the view, clamped to the map
+	std::array<float, 4> local = {{
+		(view[0] - position[0]) / chunk_size,
+		(view[1] - position[1]) / chunk_size,
+		(view[2] - position[0]) / chunk_size,
+		(view[3] - position[1]) / chunk_size
+	}};
+	if(local[2] < 0.f || local[3] < 0.f || local[0] >= chunk_columns || local[1] >= chunk_rows){
+		return;
+	}
+	size_t x_begin = static_cast<size_t>(std::max(local[0], 0.f));
+	size_t y_begin = static_cast<size_t>(std::max(local[1], 0.f));
+	size_t x_end = std::min(static_cast<size_t>(std::min(local[2], static_cast<float>(chunk_columns))) + 1, chunk_columns);
+	size_t y_end = std::min(static_cast<size_t>(std::min(local[3], static_cast<float>(chunk_rows))) + 1, chunk_rows);
+
+	for(size_t cy = y_begin; cy < y_end; ++cy){
+		for(size_t cx = x_begin; cx < x_end; ++cx){
+			Chunk& chunk = chunks[cy * chunk_columns + cx];
+			if(chunk.dirty){
+				try{
+					buildChunk(cx, cy);
+				}catch(const std::bad_alloc&){
+					continue;
+				}
+			}
+			chunk.last_drawn = draw_count;
+			if(chunk.index_count == 0){
+				continue;
+			}
+
+			chunk.mesh.bindVertexArray();
+			glDrawElementsInstanced(GL_TRIANGLES, chunk.index_count, GL_UNSIGNED_INT, 0L, 1);
+		}
+	}
+
+	if(resident_chunks > max_resident_chunks){
+		evictChunks();
+	}
+}
+
+size_t Ogl33Tilemap::residentChunks() const {
+	return resident_chunks;
+}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ogl33_bindings.h"
+
+#include "render/render.h"
+
+#include "ogl33_mesh.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace gin {
+/**
+* Tile grid split into square chunks. Chunk meshes are only built once a chunk is visible
+* and rebuilt after one of its tiles changed. Chunks which weren't drawn for a while lose
+* their mesh once too many are resident.
+*
+* Vertices are relative to the tilemap's position, tile (x, y) covers
+* [x * tile_size, (x+1) * tile_size] x [y * tile_size, (y+1) * tile_size].
+*/
+class Ogl33Tilemap {
+public:
+	static constexpr size_t chunk_tiles = 32;
+	static constexpr size_t max_resident_chunks = 1024;
+
+	/// Bounds are min x, min y, max x, max y in scene coordinates
+	using Bounds = std::array<float, 4>;
+private:
+	size_t width;
+	size_t height;
+	std::vector<TileIndex> tiles;
+
+	TextureId atlas_id;
+	size_t atlas_columns;
+	size_t atlas_rows;
+	float tile_size;
+
+	struct Chunk {
+		Ogl33Mesh mesh;
+		size_t index_count = 0;
+		bool resident = false;
+		bool dirty = true;
+		uint64_t last_drawn = 0;
+	};
+	size_t chunk_columns;
+	size_t chunk_rows;
+	std::vector<Chunk> chunks;
+	size_t resident_chunks = 0;
+	uint64_t draw_count = 0;
+
+	void buildChunk(size_t cx, size_t cy);
+	void evictChunks();
+public:
+	Ogl33Tilemap(size_t width, size_t height, const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, float tile_size);
+
+	std::array<float, 2> position = {{0.f, 0.f}};
+	float layer = 0.f;
+	// Translation to the tilemap's position in the persistent object buffer
+	uint32_t slot = 0;
+
+	Error setTile(size_t x, size_t y, TileIndex tile);
+	/// Row by row, starting at (x, y)
+	Error setTiles(size_t x, size_t y, size_t w, size_t h, const std::vector<TileIndex>& tiles);
+
+	const TextureId& atlas() const;
+
+	/**
+	* Draws the chunks intersecting the bounds, building their meshes if needed.
+	* The texture and object offset have to be set already.
+	*/
+	void draw(const Bounds& view);
+
+	size_t residentChunks() const;
+};
+}
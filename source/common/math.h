@@ -1,8 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <complex>
 #include <array>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace gin {
 template <typename T, size_t M, size_t N>
@@ -118,4 +127,507 @@ static std::complex<T> slerp2D(const std::complex<T>& from, const std::complex<T
 
 	return std::pow(to * std::conj<T>(from), frac) * from;
 }
+
+template<typename T, size_t N>
+class Vector {
+private:
+	std::array<T, N> data;
+public:
+	Vector(){
+		for(size_t i = 0; i < N; ++i){
+			data[i] = 0;
+		}
+	}
+
+	template<typename... Args, typename = std::enable_if_t<sizeof...(Args) == N && (std::is_arithmetic_v<Args> && ...)>>
+	Vector(Args... args):
+		data{{static_cast<T>(args)...}}
+	{}
+
+	Vector(const std::array<T, N>& arr):
+		data{arr}
+	{}
+
+	T& operator()(size_t i){
+		return data[i];
+	}
+
+	const T& operator()(size_t i) const {
+		return data[i];
+	}
+
+	const std::array<T, N>& array() const {
+		return data;
+	}
+
+	Vector<T, N> operator+(const Vector<T, N>& rhs) const {
+		Vector<T, N> vec;
+		for(size_t i = 0; i < N; ++i){
+			vec(i) = data[i] + rhs(i);
+		}
+		return vec;
+	}
+
+	Vector<T, N> operator-(const Vector<T, N>& rhs) const {
+		Vector<T, N> vec;
+		for(size_t i = 0; i < N; ++i){
+			vec(i) = data[i] - rhs(i);
+		}
+		return vec;
+	}
+
+	Vector<T, N> operator*(T factor) const {
+		Vector<T, N> vec;
+		for(size_t i = 0; i < N; ++i){
+			vec(i) = data[i] * factor;
+		}
+		return vec;
+	}
+
+	bool operator==(const Vector<T, N>& rhs) const {
+		return data == rhs.data;
+	}
+
+	bool operator!=(const Vector<T, N>& rhs) const {
+		return data != rhs.data;
+	}
+
+	T dot(const Vector<T, N>& rhs) const {
+		T sum = 0;
+		for(size_t i = 0; i < N; ++i){
+			sum += data[i] * rhs(i);
+		}
+		return sum;
+	}
+
+	T length() const {
+		return std::sqrt(dot(*this));
+	}
+
+	/// Zero vectors stay zero
+	Vector<T, N> normalized() const {
+		T len = length();
+		return len > 0 ? (*this) * (1 / len) : *this;
+	}
+};
+
+template<typename T, size_t N>
+Vector<T, N> lerp(const Vector<T, N>& from, const Vector<T, N>& to, T frac){
+	return from + (to - from) * frac;
+}
+
+template<typename T>
+Vector<T, 3> cross(const Vector<T, 3>& a, const Vector<T, 3>& b){
+	return {
+		a(1) * b(2) - a(2) * b(1),
+		a(2) * b(0) - a(0) * b(2),
+		a(0) * b(1) - a(1) * b(0)
+	};
+}
+
+/**
+* Rotation as x, y, z, w. Only unit quaternions describe rotations, the
+* constructors and factories keep that, arithmetic results may need normalized().
+*/
+template<typename T>
+class Quaternion {
+private:
+	std::array<T, 4> data;
+public:
+	Quaternion():
+		data{{0, 0, 0, 1}}
+	{}
+
+	Quaternion(T x, T y, T z, T w):
+		data{{x, y, z, w}}
+	{}
+
+	/// Rotates around x by alpha, then around y by beta and around z by gamma
+	static Quaternion<T> fromEuler(T alpha, T beta, T gamma){
+		T cx = std::cos(alpha / 2), sx = std::sin(alpha / 2);
+		T cy = std::cos(beta / 2), sy = std::sin(beta / 2);
+		T cz = std::cos(gamma / 2), sz = std::sin(gamma / 2);
+
+		return {
+			sx * cy * cz - cx * sy * sz,
+			cx * sy * cz + sx * cy * sz,
+			cx * cy * sz - sx * sy * cz,
+			cx * cy * cz + sx * sy * sz
+		};
+	}
+
+	static Quaternion<T> fromAxisAngle(const Vector<T, 3>& axis, T angle){
+		Vector<T, 3> unit = axis.normalized() * std::sin(angle / 2);
+		return {unit(0), unit(1), unit(2), std::cos(angle / 2)};
+	}
+
+	T x() const { return data[0]; }
+	T y() const { return data[1]; }
+	T z() const { return data[2]; }
+	T w() const { return data[3]; }
+
+	Quaternion<T> operator*(const Quaternion<T>& rhs) const {
+		return {
+			w() * rhs.x() + x() * rhs.w() + y() * rhs.z() - z() * rhs.y(),
+			w() * rhs.y() - x() * rhs.z() + y() * rhs.w() + z() * rhs.x(),
+			w() * rhs.z() + x() * rhs.y() - y() * rhs.x() + z() * rhs.w(),
+			w() * rhs.w() - x() * rhs.x() - y() * rhs.y() - z() * rhs.z()
+		};
+	}
+
+	bool operator==(const Quaternion<T>& rhs) const {
+		return data == rhs.data;
+	}
+
+	bool operator!=(const Quaternion<T>& rhs) const {
+		return data != rhs.data;
+	}
+
+	/// The inverse rotation of a unit quaternion
+	Quaternion<T> conjugate() const {
+		return {-x(), -y(), -z(), w()};
+	}
+
+	T dot(const Quaternion<T>& rhs) const {
+		return x() * rhs.x() + y() * rhs.y() + z() * rhs.z() + w() * rhs.w();
+	}
+
+	/// Falls back to the identity for a zero quaternion
+	Quaternion<T> normalized() const {
+		T len = std::sqrt(dot(*this));
+		if(!(len > 0)){
+			return {};
+		}
+		return {x() / len, y() / len, z() / len, w() / len};
+	}
+
+	Vector<T, 3> rotate(const Vector<T, 3>& v) const {
+		Vector<T, 3> u{x(), y(), z()};
+		Vector<T, 3> t = cross(u, v) * 2;
+		return v + t * w() + cross(u, t);
+	}
+
+	Matrix<T, 3, 3> toMatrix3() const {
+		T xx = x() * x(), yy = y() * y(), zz = z() * z();
+		T xy = x() * y(), xz = x() * z(), yz = y() * z();
+		T xw = x() * w(), yw = y() * w(), zw = z() * w();
+
+		Matrix<T, 3, 3> rot;
+		rot(0,0) = 1 - 2 * (yy + zz);
+		rot(0,1) = 2 * (xy - zw);
+		rot(0,2) = 2 * (xz + yw);
+		rot(1,0) = 2 * (xy + zw);
+		rot(1,1) = 1 - 2 * (xx + zz);
+		rot(1,2) = 2 * (yz - xw);
+		rot(2,0) = 2 * (xz - yw);
+		rot(2,1) = 2 * (yz + xw);
+		rot(2,2) = 1 - 2 * (xx + yy);
+		return rot;
+	}
+
+	Matrix<T, 4, 4> toMatrix4() const {
+		Matrix<T, 3, 3> rot = toMatrix3();
+		Matrix<T, 4, 4> matrix;
+		for(size_t i = 0; i < 3; ++i){
+			for(size_t j = 0; j < 3; ++j){
+				matrix(i,j) = rot(i,j);
+			}
+		}
+		matrix(3,3) = 1;
+		return matrix;
+	}
+};
+
+/**
+* Normalized linear interpolation along the shorter arc. It doesn't keep a
+* constant angular velocity, but the error is negligible for the small steps
+* between two physics ticks and it is much cheaper than slerp.
+*/
+template<typename T>
+Quaternion<T> nlerp(const Quaternion<T>& from, const Quaternion<T>& to, T frac){
+	T sign = from.dot(to) < 0 ? -1 : 1;
+	return Quaternion<T>{
+		from.x() + (sign * to.x() - from.x()) * frac,
+		from.y() + (sign * to.y() - from.y()) * frac,
+		from.z() + (sign * to.z() - from.z()) * frac,
+		from.w() + (sign * to.w() - from.w()) * frac
+	}.normalized();
+}
+
+/// Spherical interpolation along the shorter arc with constant angular velocity
+template<typename T>
+Quaternion<T> slerp(const Quaternion<T>& from, const Quaternion<T>& to, T frac){
+	T cos_theta = from.dot(to);
+	T sign = 1;
+	if(cos_theta < 0){
+		cos_theta = -cos_theta;
+		sign = -1;
+	}
+	// The sine gets too small to divide by for almost equal rotations
+	if(cos_theta > static_cast<T>(0.9995)){
+		return nlerp(from, to, frac);
+	}
+
+	T theta = std::acos(cos_theta);
+	T sin_theta = std::sin(theta);
+	T a = std::sin((1 - frac) * theta) / sin_theta;
+	T b = sign * std::sin(frac * theta) / sin_theta;
+	return {
+		a * from.x() + b * to.x(),
+		a * from.y() + b * to.y(),
+		a * from.z() + b * to.z(),
+		a * from.w() + b * to.w()
+	};
+}
+
+/// Scales first, then rotates and moves
+template<typename T>
+class Transform3 {
+public:
+	Vector<T, 3> position;
+	Quaternion<T> rotation;
+	Vector<T, 3> scale{1, 1, 1};
+
+	bool operator==(const Transform3<T>& rhs) const {
+		return position == rhs.position && rotation == rhs.rotation && scale == rhs.scale;
+	}
+
+	bool operator!=(const Transform3<T>& rhs) const {
+		return !(*this == rhs);
+	}
+
+	Vector<T, 3> apply(const Vector<T, 3>& point) const {
+		Vector<T, 3> scaled{point(0) * scale(0), point(1) * scale(1), point(2) * scale(2)};
+		return rotation.rotate(scaled) + position;
+	}
+
+	Matrix<T, 4, 4> toMatrix() const {
+		Matrix<T, 4, 4> matrix = rotation.toMatrix4();
+		for(size_t i = 0; i < 3; ++i){
+			for(size_t j = 0; j < 3; ++j){
+				matrix(i,j) *= scale(j);
+			}
+			matrix(i,3) = position(i);
+		}
+		return matrix;
+	}
+};
+
+/// Interpolates position and scale linearly and the rotation with nlerp
+template<typename T>
+Transform3<T> interpolate(const Transform3<T>& from, const Transform3<T>& to, T frac){
+	Transform3<T> transform;
+	transform.position = lerp(from.position, to.position, frac);
+	transform.rotation = nlerp(from.rotation, to.rotation, frac);
+	transform.scale = lerp(from.scale, to.scale, frac);
+	return transform;
+}
+
+/// Transforms as separate arrays per component, so batches can be processed several at once
+template<typename T>
+class Transform3Batch {
+public:
+	std::vector<T> px, py, pz;
+	std::vector<T> qx, qy, qz, qw;
+	std::vector<T> sx, sy, sz;
+
+	size_t size() const {
+		return px.size();
+	}
+
+	void clear(){
+		for(std::vector<T>* component : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}){
+			component->clear();
+		}
+	}
+
+	void reserve(size_t size){
+		for(std::vector<T>* component : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}){
+			component->reserve(size);
+		}
+	}
+
+	/// Doesn't throw if reserve() made room for it
+	void push_back(const Transform3<T>& transform){
+		px.push_back(transform.position(0));
+		py.push_back(transform.position(1));
+		pz.push_back(transform.position(2));
+		qx.push_back(transform.rotation.x());
+		qy.push_back(transform.rotation.y());
+		qz.push_back(transform.rotation.z());
+		qw.push_back(transform.rotation.w());
+		sx.push_back(transform.scale(0));
+		sy.push_back(transform.scale(1));
+		sz.push_back(transform.scale(2));
+	}
+
+	Transform3<T> get(size_t i) const {
+		Transform3<T> transform;
+		transform.position = {px[i], py[i], pz[i]};
+		transform.rotation = {qx[i], qy[i], qz[i], qw[i]};
+		transform.scale = {sx[i], sy[i], sz[i]};
+		return transform;
+	}
+};
+
+namespace impl {
+template<typename T>
+size_t buildModelMatricesSimd(const Transform3Batch<T>&, const Transform3Batch<T>&, T, T*, size_t begin, size_t){
+	return begin;
+}
+
+#if defined(__AVX__) || defined(__SSE2__)
+#if defined(__AVX__)
+using SimdFloat = __m256;
+constexpr size_t simd_width = 8;
+
+inline __m256 simdLoad(const float* ptr){ return _mm256_loadu_ps(ptr); }
+inline __m256 simdSet(float value){ return _mm256_set1_ps(value); }
+inline __m256 simdAdd(__m256 a, __m256 b){ return _mm256_add_ps(a, b); }
+inline __m256 simdSub(__m256 a, __m256 b){ return _mm256_sub_ps(a, b); }
+inline __m256 simdMul(__m256 a, __m256 b){ return _mm256_mul_ps(a, b); }
+inline __m256 simdDiv(__m256 a, __m256 b){ return _mm256_div_ps(a, b); }
+inline __m256 simdSqrt(__m256 a){ return _mm256_sqrt_ps(a); }
+inline __m256 simdAnd(__m256 a, __m256 b){ return _mm256_and_ps(a, b); }
+inline __m256 simdXor(__m256 a, __m256 b){ return _mm256_xor_ps(a, b); }
+#else
+using SimdFloat = __m128;
+constexpr size_t simd_width = 4;
+
+inline __m128 simdLoad(const float* ptr){ return _mm_loadu_ps(ptr); }
+inline __m128 simdSet(float value){ return _mm_set1_ps(value); }
+inline __m128 simdAdd(__m128 a, __m128 b){ return _mm_add_ps(a, b); }
+inline __m128 simdSub(__m128 a, __m128 b){ return _mm_sub_ps(a, b); }
+inline __m128 simdMul(__m128 a, __m128 b){ return _mm_mul_ps(a, b); }
+inline __m128 simdDiv(__m128 a, __m128 b){ return _mm_div_ps(a, b); }
+inline __m128 simdSqrt(__m128 a){ return _mm_sqrt_ps(a); }
+inline __m128 simdAnd(__m128 a, __m128 b){ return _mm_and_ps(a, b); }
+inline __m128 simdXor(__m128 a, __m128 b){ return _mm_xor_ps(a, b); }
+#endif
+
+/// Transposes the x, y, z rows of the four columns into one column major matrix per lane
+inline void storeColumns(const __m128 (&rows)[4][3], float* out){
+	for(size_t c = 0; c < 4; ++c){
+		__m128 a = rows[c][0];
+		__m128 b = rows[c][1];
+		__m128 d = rows[c][2];
+		__m128 w = _mm_set1_ps(c == 3 ? 1.f : 0.f);
+		_MM_TRANSPOSE4_PS(a, b, d, w);
+		_mm_storeu_ps(out + c * 4, a);
+		_mm_storeu_ps(out + 16 + c * 4, b);
+		_mm_storeu_ps(out + 32 + c * 4, d);
+		_mm_storeu_ps(out + 48 + c * 4, w);
+	}
+}
+
+inline void storeLanes(const SimdFloat (&rows)[4][3], float* out){
+#if defined(__AVX__)
+	for(size_t half = 0; half < 2; ++half){
+		__m128 lanes[4][3];
+		for(size_t c = 0; c < 4; ++c){
+			for(size_t r = 0; r < 3; ++r){
+				lanes[c][r] = half == 0 ? _mm256_castps256_ps128(rows[c][r]) : _mm256_extractf128_ps(rows[c][r], 1);
+			}
+		}
+		storeColumns(lanes, out + half * 64);
+	}
+#else
+	storeColumns(rows, out);
+#endif
+}
+
+inline size_t buildModelMatricesSimd(const Transform3Batch<float>& from, const Transform3Batch<float>& to, float frac, float* out, size_t begin, size_t end){
+	const SimdFloat t = simdSet(frac);
+	const SimdFloat one = simdSet(1.f);
+	const SimdFloat two = simdSet(2.f);
+	const SimdFloat sign_mask = simdSet(-0.f);
+
+	auto lerp = [&t](SimdFloat a, SimdFloat b){
+		return simdAdd(a, simdMul(simdSub(b, a), t));
+	};
+
+	size_t i = begin;
+	for(; i + simd_width <= end; i += simd_width){
+		SimdFloat ax = simdLoad(&from.qx[i]), ay = simdLoad(&from.qy[i]), az = simdLoad(&from.qz[i]), aw = simdLoad(&from.qw[i]);
+		SimdFloat bx = simdLoad(&to.qx[i]), by = simdLoad(&to.qy[i]), bz = simdLoad(&to.qz[i]), bw = simdLoad(&to.qw[i]);
+
+		// Flips the target to the shorter arc by copying the sign of the dot product onto it
+		SimdFloat dot = simdAdd(simdAdd(simdMul(ax, bx), simdMul(ay, by)), simdAdd(simdMul(az, bz), simdMul(aw, bw)));
+		SimdFloat sign = simdAnd(dot, sign_mask);
+		SimdFloat x = lerp(ax, simdXor(bx, sign));
+		SimdFloat y = lerp(ay, simdXor(by, sign));
+		SimdFloat z = lerp(az, simdXor(bz, sign));
+		SimdFloat w = lerp(aw, simdXor(bw, sign));
+
+		SimdFloat len = simdSqrt(simdAdd(simdAdd(simdMul(x, x), simdMul(y, y)), simdAdd(simdMul(z, z), simdMul(w, w))));
+		SimdFloat inv = simdDiv(one, len);
+		x = simdMul(x, inv);
+		y = simdMul(y, inv);
+		z = simdMul(z, inv);
+		w = simdMul(w, inv);
+
+		SimdFloat xx = simdMul(x, x), yy = simdMul(y, y), zz = simdMul(z, z);
+		SimdFloat xy = simdMul(x, y), xz = simdMul(x, z), yz = simdMul(y, z);
+		SimdFloat xw = simdMul(x, w), yw = simdMul(y, w), zw = simdMul(z, w);
+
+		SimdFloat sx = lerp(simdLoad(&from.sx[i]), simdLoad(&to.sx[i]));
+		SimdFloat sy = lerp(simdLoad(&from.sy[i]), simdLoad(&to.sy[i]));
+		SimdFloat sz = lerp(simdLoad(&from.sz[i]), simdLoad(&to.sz[i]));
+
+		SimdFloat rows[4][3] = {
+			{
+				simdMul(simdSub(one, simdMul(two, simdAdd(yy, zz))), sx),
+				simdMul(simdMul(two, simdAdd(xy, zw)), sx),
+				simdMul(simdMul(two, simdSub(xz, yw)), sx)
+			},
+			{
+				simdMul(simdMul(two, simdSub(xy, zw)), sy),
+				simdMul(simdSub(one, simdMul(two, simdAdd(xx, zz))), sy),
+				simdMul(simdMul(two, simdAdd(yz, xw)), sy)
+			},
+			{
+				simdMul(simdMul(two, simdAdd(xz, yw)), sz),
+				simdMul(simdMul(two, simdSub(yz, xw)), sz),
+				simdMul(simdSub(one, simdMul(two, simdAdd(xx, yy))), sz)
+			},
+			{
+				lerp(simdLoad(&from.px[i]), simdLoad(&to.px[i])),
+				lerp(simdLoad(&from.py[i]), simdLoad(&to.py[i])),
+				lerp(simdLoad(&from.pz[i]), simdLoad(&to.pz[i]))
+			}
+		};
+		storeLanes(rows, out + i * 16);
+	}
+	return i;
+}
+#endif
+}
+
+/// Like buildModelMatrices below, but only for transforms [begin, end), which are still written at their index in out
+template<typename T>
+void buildModelMatrices(const Transform3Batch<T>& from, const Transform3Batch<T>& to, T frac, T* out, size_t begin, size_t end){
+	end = std::min(end, std::min(from.size(), to.size()));
+	size_t i = impl::buildModelMatricesSimd(from, to, frac, out, begin, end);
+
+	for(; i < end; ++i){
+		Matrix<T, 4, 4> matrix = interpolate(from.get(i), to.get(i), frac).toMatrix();
+		T* column = out + i * 16;
+		for(size_t c = 0; c < 4; ++c){
+			for(size_t r = 0; r < 4; ++r){
+				column[c * 4 + r] = matrix(r,c);
+			}
+		}
+	}
+}
+
+/**
+* Writes the model matrix of every transform interpolated between both batches
+* as 16 values in column major order, the layout GL expects. Both batches need
+* the same size. Floats are processed eight at a time with AVX or four at a time
+* with SSE2, other types and the remainder go through interpolate().
+*/
+template<typename T>
+void buildModelMatrices(const Transform3Batch<T>& from, const Transform3Batch<T>& to, T frac, T* out){
+	buildModelMatrices(from, to, frac, out, 0, std::min(from.size(), to.size()));
+}
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gin {
+/**
+ * Hands values from one writer thread to one reader thread without locks.
+ * Writer and reader own a slot each, the third one holds the latest published
+ * value. Publishing and acquiring swap the own slot with that one, so neither
+ * side ever waits and the reader skips values it was too slow for.
+ *
+ * Slots are reused, so the writer gets back a slot holding an older value and
+ * has to overwrite all of it. Containers in T keep their capacity that way.
+ */
+template <typename T> class TripleBuffer {
+private:
+	std::array<T, 3> slots;
+
+	static constexpr uint8_t fresh_bit = 4;
+	// Index of the shared slot, fresh_bit is set until the reader takes it
+	std::atomic<uint8_t> shared{1};
+
+	uint8_t write_index = 0;
+	uint8_t read_index = 2;
+
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer &) = delete;
+	TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+	/// Only for the writer thread, owned by it until publish
+	T &writeSlot() { return slots[write_index]; }
+
+	/// Makes the write slot the latest value and hands the writer another one
+	void publish() {
+		uint8_t old = shared.exchange(write_index | fresh_bit,
+									  std::memory_order_acq_rel);
+		write_index = old & ~fresh_bit;
+	}
+
+	/**
+	 * Only for the reader thread. Takes the latest value if there is a new
+	 * one since the last call, otherwise the read slot stays as it is.
+	 *
+	 * @return true if the read slot changed
+	 */
+	bool acquire() {
+		if (!(shared.load(std::memory_order_relaxed) & fresh_bit)) {
+			return false;
+		}
+		uint8_t old = shared.exchange(read_index, std::memory_order_acq_rel);
+		read_index = old & ~fresh_bit;
+		return true;
+	}
+
+	/// Only for the reader thread, holds the last acquired value
+	const T &readSlot() const { return slots[read_index]; }
+};
+} // namespace gin
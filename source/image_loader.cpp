@@ -0,0 +1,285 @@
+#include "image_loader.h"
+
+#include <array>
+#include <cassert>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <png.h>
+
+namespace gin {
+namespace {
+ErrorOr<Image> decodePng(const std::filesystem::path &path) noexcept {
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&png, path.c_str())) {
+		return criticalError("Couldn't read png header");
+	}
+
+	png.format = PNG_FORMAT_RGBA;
+
+	Image image;
+	try {
+		image.pixels.resize(PNG_IMAGE_SIZE(png));
+	} catch (const std::bad_alloc &) {
+		png_image_free(&png);
+		return criticalError("Out of memory");
+	}
+	image.width = png.width;
+	image.height = png.height;
+	image.channels = 4;
+
+	if (!png_image_finish_read(&png, nullptr, image.pixels.data(), 0,
+							   nullptr)) {
+		png_image_free(&png);
+		return criticalError("Couldn't decode png");
+	}
+
+	return image;
+}
+
+struct JpegErrorManager {
+	jpeg_error_mgr manager;
+	std::jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr info) {
+	JpegErrorManager *error = reinterpret_cast<JpegErrorManager *>(info->err);
+	std::longjmp(error->jump, 1);
+}
+
+/**
+ * libjpeg reports errors by jumping back here. The image lives in the callers
+ * frame, so it stays valid even if it was modified after setjmp.
+ */
+bool decodeJpegInto(FILE *file, Image &image) noexcept {
+	jpeg_decompress_struct info;
+	JpegErrorManager error;
+
+	info.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = jpegErrorExit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&info);
+		return false;
+	}
+
+	jpeg_create_decompress(&info);
+	jpeg_stdio_src(&info, file);
+	jpeg_read_header(&info, TRUE);
+
+	info.out_color_space = JCS_EXT_RGBA;
+	jpeg_start_decompress(&info);
+
+	image.width = info.output_width;
+	image.height = info.output_height;
+	image.channels = 4;
+	try {
+		image.pixels.resize(image.width * image.height * image.channels);
+	} catch (const std::bad_alloc &) {
+		jpeg_destroy_decompress(&info);
+		return false;
+	}
+
+	const size_t stride = image.width * image.channels;
+	while (info.output_scanline < info.output_height) {
+		JSAMPROW row = &image.pixels[info.output_scanline * stride];
+		jpeg_read_scanlines(&info, &row, 1);
+	}
+
+	jpeg_finish_decompress(&info);
+	jpeg_destroy_decompress(&info);
+	return true;
+}
+
+ErrorOr<Image> decodeJpeg(const std::filesystem::path &path) noexcept {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return criticalError("Couldn't open jpeg");
+	}
+
+	Image image;
+	bool decoded = decodeJpegInto(file, image);
+	fclose(file);
+
+	if (!decoded) {
+		return criticalError("Couldn't decode jpeg");
+	}
+	return image;
+}
+
+std::string cacheKey(const std::filesystem::path &path) {
+	std::error_code ec;
+	auto write_time = std::filesystem::last_write_time(path, ec);
+	if (ec) {
+		return {};
+	}
+
+	return path.string() + '@' +
+		   std::to_string(write_time.time_since_epoch().count());
+}
+} // namespace
+
+ErrorOr<Image> decodeImage(const std::filesystem::path &path) noexcept {
+	std::array<uint8_t, 4> magic{};
+
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return criticalError("Couldn't open image");
+	}
+	size_t n = fread(magic.data(), 1, magic.size(), file);
+	fclose(file);
+
+	if (n >= 4 && magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' &&
+		magic[3] == 'G') {
+		return decodePng(path);
+	}
+	if (n >= 2 && magic[0] == 0xFF && magic[1] == 0xD8) {
+		return decodeJpeg(path);
+	}
+
+	return criticalError("Unsupported image format");
+}
+
+ImageCache::ImageCache(size_t max_bytes) : max_bytes{max_bytes} {}
+
+void ImageCache::evict() {
+	while (used_bytes > max_bytes && !entries.empty()) {
+		Entry &last = entries.back();
+		used_bytes -= last.bytes;
+		lookup.erase(last.key);
+		entries.pop_back();
+	}
+}
+
+Our<const Image> ImageCache::find(const std::string &key) {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	auto find = lookup.find(key);
+	if (find == lookup.end()) {
+		return nullptr;
+	}
+
+	entries.splice(entries.begin(), entries, find->second);
+	return find->second->image;
+}
+
+void ImageCache::insert(const std::string &key, Our<const Image> image) {
+	assert(image);
+	size_t bytes = image->pixels.size();
+
+	std::lock_guard<std::mutex> lock{mutex};
+	if (bytes > max_bytes) {
+		return;
+	}
+
+	auto find = lookup.find(key);
+	if (find != lookup.end()) {
+		used_bytes -= find->second->bytes;
+		entries.erase(find->second);
+		lookup.erase(find);
+	}
+
+	entries.push_front(Entry{key, std::move(image), bytes});
+	lookup.insert(std::make_pair(key, entries.begin()));
+	used_bytes += bytes;
+
+	evict();
+}
+
+void ImageCache::clear() {
+	std::lock_guard<std::mutex> lock{mutex};
+	entries.clear();
+	lookup.clear();
+	used_bytes = 0;
+}
+
+size_t ImageCache::size() const {
+	std::lock_guard<std::mutex> lock{mutex};
+	return used_bytes;
+}
+
+size_t ImageCache::capacity() const { return max_bytes; }
+
+ImageLoader::ImageLoader(size_t thread_count, size_t cache_bytes)
+	: cache{cache_bytes}, workers{thread_count} {}
+
+void ImageLoader::decode(uint64_t request, const std::filesystem::path &path) {
+	std::string key = cacheKey(path);
+
+	ErrorOr<Our<const Image>> image = [&]() -> ErrorOr<Our<const Image>> {
+		if (!key.empty()) {
+			Our<const Image> cached = cache.find(key);
+			if (cached) {
+				return cached;
+			}
+		}
+
+		ErrorOr<Image> decoded = decodeImage(path);
+		if (decoded.isError()) {
+			return std::move(decoded.error());
+		}
+
+		Our<const Image> shared;
+		try {
+			shared = share<const Image>(std::move(decoded.value()));
+		} catch (const std::bad_alloc &) {
+			return criticalError("Out of memory");
+		}
+		if (!key.empty()) {
+			cache.insert(key, shared);
+		}
+		return shared;
+	}();
+
+	std::lock_guard<std::mutex> lock{result_mutex};
+	results.push_back(Result{request, std::move(image)});
+}
+
+Conveyor<Our<const Image>>
+ImageLoader::load(const std::filesystem::path &path) {
+	auto caf = newConveyorAndFeeder<Our<const Image>>();
+
+	uint64_t request = next_request++;
+	feeders.insert(std::make_pair(request, std::move(caf.feeder)));
+
+	workers.submit([this, request, path]() { decode(request, path); });
+
+	return std::move(caf.conveyor);
+}
+
+size_t ImageLoader::poll() {
+	std::vector<Result> done;
+	{
+		std::lock_guard<std::mutex> lock{result_mutex};
+		done.swap(results);
+	}
+
+	for (auto &iter : done) {
+		auto find = feeders.find(iter.request);
+		assert(find != feeders.end());
+		if (find == feeders.end()) {
+			continue;
+		}
+
+		if (iter.image.isValue()) {
+			find->second->feed(std::move(iter.image.value()));
+		} else {
+			find->second->fail(std::move(iter.image.error()));
+		}
+		feeders.erase(find);
+	}
+
+	return done.size();
+}
+
+size_t ImageLoader::pending() const { return feeders.size(); }
+
+void ImageLoader::clearCache() { cache.clear(); }
+
+size_t ImageLoader::cacheSize() const { return cache.size(); }
+} // namespace gin
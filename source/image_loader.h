@@ -0,0 +1,109 @@
+#pragma once
+
+#include "./render/render.h"
+#include "./worker_pool.h"
+
+#include <kelgin/async.h>
+#include <kelgin/common.h>
+#include <kelgin/error.h>
+
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gin {
+/**
+ * Decodes a PNG or JPEG file into an RGBA8 image. The decoders write into
+ * Image::pixels directly, so no intermediate buffer is copied.
+ */
+ErrorOr<Image> decodeImage(const std::filesystem::path &path) noexcept;
+
+/**
+ * Size bounded least recently used cache of decoded images.
+ * Entries are keyed by path and modification time, so a changed file on disk
+ * is decoded again. Thread safe.
+ */
+class ImageCache {
+private:
+	struct Entry {
+		std::string key;
+		Our<const Image> image;
+		size_t bytes;
+	};
+
+	mutable std::mutex mutex;
+	std::list<Entry> entries;
+	std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+
+	size_t max_bytes;
+	size_t used_bytes = 0;
+
+	void evict();
+
+public:
+	ImageCache(size_t max_bytes);
+
+	Our<const Image> find(const std::string &key);
+	void insert(const std::string &key, Our<const Image> image);
+	void clear();
+
+	size_t size() const;
+	size_t capacity() const;
+};
+
+/**
+ * Decodes images on a worker pool and hands them back through conveyors.
+ * Images are shared with the cache instead of being copied, so they are
+ * handed out immutable.
+ *
+ * Results are collected by the workers and delivered on the calling thread
+ * in poll(), which should be called from the thread running the event loop.
+ */
+class ImageLoader {
+private:
+	struct Result {
+		uint64_t request;
+		ErrorOr<Our<const Image>> image;
+	};
+
+	ImageCache cache;
+
+	uint64_t next_request = 0;
+	std::unordered_map<uint64_t, Own<ConveyorFeeder<Our<const Image>>>> feeders;
+
+	std::mutex result_mutex;
+	std::vector<Result> results;
+
+	// Destroyed first, so no worker outlives the cache or the result queue
+	WorkerPool workers;
+
+	void decode(uint64_t request, const std::filesystem::path &path);
+
+public:
+	/**
+	 * @param thread_count amount of decoding threads. 0 picks the amount of
+	 * hardware threads
+	 * @param cache_bytes upper bound of decoded pixel data kept in the cache
+	 */
+	ImageLoader(size_t thread_count = 0, size_t cache_bytes = 128u << 20);
+
+	Conveyor<Our<const Image>> load(const std::filesystem::path &path);
+
+	/**
+	 * Feeds all finished decodes into their conveyors.
+	 * Returns the amount of delivered images.
+	 */
+	size_t poll();
+
+	/**
+	 * Amount of requested images which haven't been delivered by poll() yet.
+	 */
+	size_t pending() const;
+
+	void clearCache();
+	size_t cacheSize() const;
+};
+} // namespace gin
@@ -0,0 +1,383 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace gin {
+namespace impl {
+struct Job {
+	std::function<void()> func;
+	JobCounter *counter;
+};
+
+JobDeque::Ring::Ring(int64_t capacity)
+	: capacity{capacity}, slots{new std::atomic<Job *>[static_cast<size_t>(
+							  capacity)]} {}
+
+JobDeque::JobDeque() {
+	rings.push_back(std::make_unique<Ring>(64));
+	ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+JobDeque::Ring *JobDeque::grow(Ring *old, int64_t top, int64_t bottom) {
+	auto bigger = std::make_unique<Ring>(old->capacity * 2);
+	for (int64_t i = top; i < bottom; ++i) {
+		bigger->put(i, old->get(i));
+	}
+
+	Ring *result = bigger.get();
+	rings.push_back(std::move(bigger));
+	ring.store(result, std::memory_order_release);
+	return result;
+}
+
+void JobDeque::push(Job *job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	Ring *r = ring.load(std::memory_order_relaxed);
+	if (b - t > r->capacity - 1) {
+		r = grow(r, t, b);
+	}
+
+	r->put(b, job);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Job *JobDeque::pop() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Ring *r = ring.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job *job = r->get(b);
+	if (t == b) {
+		// The last job, thieves may be after it as well
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+										 std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job *JobDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b) {
+		return nullptr;
+	}
+
+	Ring *r = ring.load(std::memory_order_acquire);
+	Job *job = r->get(t);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+									 std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+size_t JobDeque::size() const {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_relaxed);
+	return b > t ? static_cast<size_t>(b - t) : 0;
+}
+} // namespace impl
+
+bool JobCounter::done() const {
+	std::lock_guard<std::mutex> lock{mutex};
+	return pending == 0;
+}
+
+namespace {
+// Set on worker threads, so jobs they run go to their own deque
+thread_local const JobSystem *current_system = nullptr;
+thread_local size_t current_index = 0;
+
+// Rounds an idle worker yields before it goes to sleep
+constexpr size_t spin_rounds = 64;
+} // namespace
+
+struct JobSystem::RangeTask {
+	const std::function<void(size_t, size_t)> &func;
+	size_t grain;
+	JobCounter counter;
+
+	RangeTask(const std::function<void(size_t, size_t)> &func, size_t grain)
+		: func{func}, grain{grain} {}
+};
+
+JobSystem::JobSystem(size_t thread_count) {
+	if (thread_count == 0) {
+		thread_count =
+			std::max(static_cast<size_t>(std::thread::hardware_concurrency()),
+					 static_cast<size_t>(1));
+	}
+
+	// The waiting thread is the last one
+	workers.reserve(thread_count - 1);
+	for (size_t i = 0; i + 1 < thread_count; ++i) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+	// Only started once the deques exist, since every worker steals from all
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i]->thread = std::thread{[this, i]() { work(i); }};
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock{sleep_mutex};
+		running = false;
+	}
+	condition.notify_all();
+
+	for (auto &iter : workers) {
+		if (iter->thread.joinable()) {
+			iter->thread.join();
+		}
+	}
+
+	for (auto &iter : workers) {
+		while (impl::Job *job = iter->deque.pop()) {
+			delete job;
+		}
+	}
+	for (auto &iter : injected) {
+		delete iter;
+	}
+}
+
+void JobSystem::work(size_t index) {
+	current_system = this;
+	current_index = index;
+
+	size_t idle = 0;
+	while (running.load(std::memory_order_relaxed)) {
+		impl::Job *job = findJob();
+		if (job) {
+			execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < spin_rounds) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock{sleep_mutex};
+		sleeping.fetch_add(1);
+		condition.wait(lock, [this]() { return !running || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+impl::Job *JobSystem::findJob() {
+	bool is_worker = current_system == this;
+	if (is_worker) {
+		impl::Job *job = workers[current_index]->deque.pop();
+		if (job) {
+			queued.fetch_sub(1);
+			return job;
+		}
+	}
+
+	if (queued.load(std::memory_order_relaxed) == 0) {
+		return nullptr;
+	}
+
+	if (inject_count.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock{inject_mutex};
+		if (!injected.empty()) {
+			impl::Job *job = injected.front();
+			injected.pop_front();
+			inject_count.fetch_sub(1, std::memory_order_relaxed);
+			queued.fetch_sub(1);
+			return job;
+		}
+	}
+
+	// Starting after the own index spreads the thieves over the victims
+	size_t start = is_worker ? current_index + 1 : 0;
+	for (size_t i = 0; i < workers.size(); ++i) {
+		size_t victim = (start + i) % workers.size();
+		if (is_worker && victim == current_index) {
+			continue;
+		}
+		impl::Job *job = workers[victim]->deque.steal();
+		if (job) {
+			queued.fetch_sub(1);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::schedule(impl::Job *job) {
+	if (current_system == this) {
+		// Counted first, so thieves never see more jobs than queued
+		queued.fetch_add(1);
+		try {
+			workers[current_index]->deque.push(job);
+		} catch (const std::bad_alloc &) {
+			queued.fetch_sub(1);
+			throw;
+		}
+	} else {
+		std::lock_guard<std::mutex> lock{inject_mutex};
+		injected.push_back(job);
+		inject_count.fetch_add(1, std::memory_order_relaxed);
+		queued.fetch_add(1);
+	}
+
+	// Taking the lock orders the wakeup after a worker started waiting
+	if (sleeping.load() > 0) {
+		{ std::lock_guard<std::mutex> lock{sleep_mutex}; }
+		condition.notify_one();
+	}
+}
+
+void JobSystem::execute(impl::Job *job) {
+	job->func();
+
+	JobCounter *counter = job->counter;
+	delete job;
+	if (counter) {
+		finish(*counter);
+	}
+}
+
+void JobSystem::finish(JobCounter &counter) {
+	std::vector<impl::Job *> ready;
+	{
+		std::lock_guard<std::mutex> lock{counter.mutex};
+		assert(counter.pending > 0);
+		if (--counter.pending == 0) {
+			ready.swap(counter.waiting);
+		}
+	}
+	// The counter may be gone already, a waiter can see it done from here on
+	for (auto &iter : ready) {
+		schedule(iter);
+	}
+}
+
+void JobSystem::run(std::function<void()> &&func, JobCounter *counter,
+					JobCounter *after) {
+	auto job = std::make_unique<impl::Job>(impl::Job{std::move(func), counter});
+
+	// Counted before the job can run, which may happen as soon as after is
+	// done
+	if (counter) {
+		std::lock_guard<std::mutex> lock{counter->mutex};
+		++counter->pending;
+	}
+
+	try {
+		if (after) {
+			std::lock_guard<std::mutex> lock{after->mutex};
+			if (after->pending > 0) {
+				after->waiting.push_back(job.get());
+				job.release();
+				return;
+			}
+		}
+		schedule(job.get());
+		job.release();
+	} catch (const std::bad_alloc &) {
+		if (counter) {
+			finish(*counter);
+		}
+		throw;
+	}
+}
+
+void JobSystem::wait(const JobCounter &counter) {
+	while (!counter.done()) {
+		impl::Job *job = findJob();
+		if (job) {
+			execute(job);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+Conveyor<void> JobSystem::whenDone(JobCounter &counter) {
+	auto caf = newConveyorAndFeeder<void>();
+	watches.push_back(Watch{&counter, std::move(caf.feeder)});
+	return std::move(caf.conveyor);
+}
+
+size_t JobSystem::poll() {
+	size_t kept = 0;
+	for (size_t i = 0; i < watches.size(); ++i) {
+		if (watches[i].counter->done()) {
+			watches[i].feeder->feed();
+			continue;
+		}
+		if (kept != i) {
+			watches[kept] = std::move(watches[i]);
+		}
+		++kept;
+	}
+
+	size_t resolved = watches.size() - kept;
+	watches.erase(watches.begin() + kept, watches.end());
+	return resolved;
+}
+
+bool JobSystem::hungry() const {
+	if (workers.empty()) {
+		return false;
+	}
+	if (current_system == this) {
+		return workers[current_index]->deque.size() == 0;
+	}
+	return inject_count.load(std::memory_order_relaxed) == 0;
+}
+
+void JobSystem::runRange(RangeTask &task, size_t begin, size_t end) {
+	while (begin < end) {
+		if (end - begin > task.grain && hungry()) {
+			size_t middle = begin + (end - begin) / 2;
+			run([this, &task, middle, end]() { runRange(task, middle, end); },
+				&task.counter);
+			end = middle;
+			continue;
+		}
+
+		size_t stop = std::min(end, begin + task.grain);
+		task.func(begin, stop);
+		begin = stop;
+	}
+}
+
+void JobSystem::parallelFor(
+	size_t count, const std::function<void(size_t begin, size_t end)> &func,
+	size_t grain) {
+	if (count == 0) {
+		return;
+	}
+	if (grain == 0) {
+		grain = std::max(count / (threadCount() * 32), static_cast<size_t>(1));
+	}
+
+	RangeTask task{func, grain};
+	runRange(task, 0, count);
+	wait(task.counter);
+}
+
+size_t JobSystem::threadCount() const { return workers.size() + 1; }
+} // namespace gin
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <kelgin/async.h>
+#include <kelgin/common.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gin {
+class JobSystem;
+
+namespace impl {
+struct Job;
+
+/**
+ * Chase-Lev work-stealing deque. The owning worker pushes and pops at the
+ * bottom without locks, other threads steal from the top. The ring grows on
+ * demand, outgrown rings are kept until destruction, since a thief may still
+ * read from one.
+ */
+class JobDeque {
+private:
+	struct Ring {
+		int64_t capacity;
+		std::unique_ptr<std::atomic<Job *>[]> slots;
+
+		Ring(int64_t capacity);
+
+		Job *get(int64_t index) const {
+			return slots[index & (capacity - 1)].load(
+				std::memory_order_relaxed);
+		}
+
+		void put(int64_t index, Job *job) {
+			slots[index & (capacity - 1)].store(job, std::memory_order_relaxed);
+		}
+	};
+
+	std::atomic<int64_t> top{0};
+	std::atomic<int64_t> bottom{0};
+	std::atomic<Ring *> ring;
+	// Only touched by the owner
+	std::vector<std::unique_ptr<Ring>> rings;
+
+	Ring *grow(Ring *old, int64_t top, int64_t bottom);
+
+public:
+	JobDeque();
+
+	JobDeque(const JobDeque &) = delete;
+	JobDeque &operator=(const JobDeque &) = delete;
+
+	/// Owner only
+	void push(Job *job);
+	/// Owner only, nullptr if empty
+	Job *pop();
+	/// Any thread, nullptr if empty or lost against another thread
+	Job *steal();
+
+	/// Estimate, exact only for the owner while nobody steals
+	size_t size() const;
+};
+} // namespace impl
+
+/**
+ * Counts unfinished jobs. Jobs run with a counter increment it until they
+ * finished, jobs run after it start once it drops to zero.
+ *
+ * A counter has to outlive its jobs, waiting for it in JobSystem::wait before
+ * destroying it is enough.
+ */
+class JobCounter {
+private:
+	friend class JobSystem;
+
+	mutable std::mutex mutex;
+	size_t pending = 0;
+	std::vector<impl::Job *> waiting;
+
+public:
+	JobCounter() = default;
+
+	JobCounter(const JobCounter &) = delete;
+	JobCounter &operator=(const JobCounter &) = delete;
+
+	bool done() const;
+};
+
+/**
+ * Work-stealing job system. Every worker has a deque of its own, which it
+ * works on last in first out. Idle workers steal the oldest jobs of the
+ * others, so large chunks of work move and small ones stay warm in the cache.
+ * Jobs run from other threads are handed in through a shared queue.
+ *
+ * Threads waiting for jobs work on pending ones in the meantime, so jobs may
+ * wait for other jobs without starving the workers.
+ */
+class JobSystem {
+private:
+	struct Worker {
+		impl::JobDeque deque;
+		std::thread thread;
+	};
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::mutex inject_mutex;
+	std::deque<impl::Job *> injected;
+	// Size of injected, checked without taking the lock
+	std::atomic<size_t> inject_count{0};
+
+	// Jobs in a deque or the shared queue, idle workers sleep while it's 0
+	std::atomic<size_t> queued{0};
+	std::atomic<size_t> sleeping{0};
+	std::mutex sleep_mutex;
+	std::condition_variable condition;
+	std::atomic<bool> running{true};
+
+	struct Watch {
+		JobCounter *counter;
+		Own<ConveyorFeeder<void>> feeder;
+	};
+	std::vector<Watch> watches;
+
+	struct RangeTask;
+
+	void work(size_t index);
+	/// Own deque first, then the shared queue, then the other workers
+	impl::Job *findJob();
+	void schedule(impl::Job *job);
+	void execute(impl::Job *job);
+	/// Counts a job of the counter as finished and starts the jobs after it
+	void finish(JobCounter &counter);
+	/// Whether the calling thread should hand off work, see parallelFor
+	bool hungry() const;
+	void runRange(RangeTask &task, size_t begin, size_t end);
+
+public:
+	/**
+	 * @param thread_count amount of threads working on jobs, including a
+	 * thread waiting for them. 0 picks the amount of hardware threads. With 1
+	 * jobs only run while some thread waits.
+	 */
+	JobSystem(size_t thread_count = 0);
+	/**
+	 * Pending jobs are dropped without running them. Jobs waiting on a
+	 * counter have to be started before.
+	 */
+	~JobSystem();
+
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	/**
+	 * Queues func. If counter is given it counts the job until func returned.
+	 * If after is given the job only starts once after is done.
+	 */
+	void run(std::function<void()> &&func, JobCounter *counter = nullptr,
+			 JobCounter *after = nullptr);
+
+	/// Works on pending jobs until counter is done
+	void wait(const JobCounter &counter);
+
+	/**
+	 * Resolves once counter is done. Counters are only checked in poll, so
+	 * the conveyor resolves on the thread running the event loop.
+	 */
+	Conveyor<void> whenDone(JobCounter &counter);
+
+	/**
+	 * Feeds the conveyors of all counters which are done. Has to be called
+	 * regularly by the owner of the job system, the ogl33 renderer does so in
+	 * every step. Returns the amount of resolved conveyors.
+	 */
+	size_t poll();
+
+	/**
+	 * Calls func for consecutive ranges covering [0, count) and blocks until
+	 * all of them are done. The calling thread works on the ranges as well,
+	 * so it is safe to call this from within a job.
+	 *
+	 * The range is split lazily: a thread hands off the upper half of what
+	 * it has left whenever its queue ran dry, so work is only split as far
+	 * as idle threads ask for it. func gets at most grain elements per call,
+	 * 0 picks a grain giving every thread a few dozen calls.
+	 */
+	void parallelFor(size_t count,
+					 const std::function<void(size_t begin, size_t end)> &func,
+					 size_t grain = 0);
+
+	/// Including a waiting thread
+	size_t threadCount() const;
+};
+} // namespace gin
@@ -0,0 +1,386 @@
+#include "mesh_simplification.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace gin {
+namespace {
+/**
+ * Sum of squared distances to a set of planes as the upper triangle of a
+ * symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2.
+ */
+struct Quadric {
+	std::array<double, 10> q{};
+
+	void addPlane(double a, double b, double c, double d, double weight) {
+		q[0] += weight * a * a;
+		q[1] += weight * a * b;
+		q[2] += weight * a * c;
+		q[3] += weight * a * d;
+		q[4] += weight * b * b;
+		q[5] += weight * b * c;
+		q[6] += weight * b * d;
+		q[7] += weight * c * c;
+		q[8] += weight * c * d;
+		q[9] += weight * d * d;
+	}
+
+	void add(const Quadric &rhs) {
+		for (size_t i = 0; i < q.size(); ++i) {
+			q[i] += rhs.q[i];
+		}
+	}
+
+	double error(const std::array<float, 3> &p) const {
+		double x = p[0], y = p[1], z = p[2];
+		return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z +
+			   2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z +
+			   2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+	}
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+struct PositionHash {
+	size_t operator()(const std::array<uint32_t, 3> &bits) const {
+		uint64_t h = bits[0];
+		h = h * 0x9E3779B97F4A7C15ull ^ bits[1];
+		h = h * 0x9E3779B97F4A7C15ull ^ bits[2];
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return a < b ? (static_cast<uint64_t>(a) << 32) | b
+				 : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+std::array<float, 3> triangleNormal(const std::array<float, 3> &a,
+									const std::array<float, 3> &b,
+									const std::array<float, 3> &c) {
+	std::array<float, 3> e0{{b[0] - a[0], b[1] - a[1], b[2] - a[2]}};
+	std::array<float, 3> e1{{c[0] - a[0], c[1] - a[1], c[2] - a[2]}};
+	return {{e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2],
+			 e0[0] * e1[1] - e0[1] * e1[0]}};
+}
+
+float dot(const std::array<float, 3> &a, const std::array<float, 3> &b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/// Vertices with bitwise equal positions share the id of the first one
+std::vector<uint32_t>
+weldPositions(const std::vector<Mesh3dData::Vertex> &vertices) {
+	std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> ids;
+	ids.reserve(vertices.size());
+
+	std::vector<uint32_t> position_ids(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		std::array<uint32_t, 3> bits;
+		std::memcpy(bits.data(), vertices[i].position.data(), sizeof(bits));
+		position_ids[i] =
+			ids.emplace(bits, static_cast<uint32_t>(i)).first->second;
+	}
+	return position_ids;
+}
+
+/**
+ * Rejects collapses which turn a remaining triangle around by more than about
+ * 60 degrees, since those fold the surface over itself.
+ */
+bool flipsTriangle(const std::vector<Mesh3dData::Vertex> &vertices,
+				   const std::vector<unsigned int> &indices,
+				   const std::vector<uint32_t> &position_ids,
+				   const std::vector<uint32_t> &remap,
+				   const uint32_t *triangles, size_t triangle_count,
+				   uint32_t from, uint32_t to) {
+	for (size_t t = 0; t < triangle_count; ++t) {
+		const unsigned int *corners = &indices[triangles[t] * 3];
+		std::array<uint32_t, 3> ids{
+			{remap[corners[0]], remap[corners[1]], remap[corners[2]]}};
+
+		bool degenerate = false;
+		for (auto &id : ids) {
+			degenerate |= position_ids[id] == position_ids[to];
+		}
+		if (degenerate) {
+			continue;
+		}
+
+		std::array<float, 3> before =
+			triangleNormal(vertices[ids[0]].position, vertices[ids[1]].position,
+						   vertices[ids[2]].position);
+		for (auto &id : ids) {
+			if (id == from) {
+				id = to;
+			}
+		}
+		std::array<float, 3> after =
+			triangleNormal(vertices[ids[0]].position, vertices[ids[1]].position,
+						   vertices[ids[2]].position);
+
+		float limit = 0.5f * std::sqrt(dot(before, before) * dot(after, after));
+		if (dot(before, after) < limit) {
+			return true;
+		}
+	}
+	return false;
+}
+} // namespace
+
+ErrorOr<std::vector<unsigned int>>
+simplifyMesh3d(const std::vector<Mesh3dData::Vertex> &vertices,
+			   const std::vector<unsigned int> &indices,
+			   size_t target_triangles) noexcept {
+	if (indices.size() % 3 != 0) {
+		return criticalError("Index count isn't a multiple of 3");
+	}
+	for (auto &index : indices) {
+		if (index >= vertices.size()) {
+			return criticalError("Index out of range");
+		}
+	}
+
+	try {
+		std::vector<unsigned int> result = indices;
+		size_t triangles = result.size() / 3;
+		if (triangles <= target_triangles) {
+			return result;
+		}
+
+		const size_t vertex_count = vertices.size();
+		std::vector<uint32_t> position_ids = weldPositions(vertices);
+
+		// Seams have several vertices at one position
+		std::vector<uint8_t> locked(vertex_count, 0);
+		std::vector<uint32_t> position_uses(vertex_count, 0);
+		for (size_t i = 0; i < vertex_count; ++i) {
+			++position_uses[position_ids[i]];
+		}
+		for (size_t i = 0; i < vertex_count; ++i) {
+			if (position_uses[position_ids[i]] > 1) {
+				locked[position_ids[i]] = 1;
+			}
+		}
+
+		// Border edges belong to a single triangle
+		std::unordered_map<uint64_t, uint32_t> edge_uses;
+		edge_uses.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; ++k) {
+				++edge_uses[edgeKey(position_ids[result[i + k]],
+									position_ids[result[i + (k + 1) % 3]])];
+			}
+		}
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; ++k) {
+				uint32_t a = position_ids[result[i + k]];
+				uint32_t b = position_ids[result[i + (k + 1) % 3]];
+				if (edge_uses[edgeKey(a, b)] == 1) {
+					locked[a] = 1;
+					locked[b] = 1;
+				}
+			}
+		}
+
+		// Weighted by area, so small triangles don't dominate the error
+		std::vector<Quadric> quadrics(vertex_count);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const std::array<float, 3> &p0 = vertices[result[i]].position;
+			std::array<float, 3> normal =
+				triangleNormal(p0, vertices[result[i + 1]].position,
+							   vertices[result[i + 2]].position);
+			double length = std::sqrt(dot(normal, normal));
+			if (length <= 0.0) {
+				continue;
+			}
+			double a = normal[0] / length;
+			double b = normal[1] / length;
+			double c = normal[2] / length;
+			double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+			for (size_t k = 0; k < 3; ++k) {
+				quadrics[position_ids[result[i + k]]].addPlane(a, b, c, d,
+															   length * 0.5);
+			}
+		}
+
+		std::vector<uint32_t> remap(vertex_count);
+		std::vector<uint8_t> touched(vertex_count);
+		std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+
+		/**
+		 * Every pass collapses the cheapest edges whose vertices weren't touched
+		 * yet in this pass, so the costs of the remaining ones stay valid.
+		 */
+		while (triangles > target_triangles) {
+			std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+			for (auto &index : result) {
+				++adjacency_offsets[index + 1];
+			}
+			for (size_t i = 0; i < vertex_count; ++i) {
+				adjacency_offsets[i + 1] += adjacency_offsets[i];
+			}
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacency_offsets.begin(),
+									   adjacency_offsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i) {
+				adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			// The survivor inherits both quadrics, so the cost is their sum at
+			// the kept position
+			auto collapseCost = [&](uint32_t from, uint32_t to) {
+				const std::array<float, 3> &kept = vertices[to].position;
+				return quadrics[position_ids[from]].error(kept) +
+					   quadrics[position_ids[to]].error(kept);
+			};
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (size_t k = 0; k < 3; ++k) {
+					uint32_t a = result[i + k];
+					uint32_t b = result[i + (k + 1) % 3];
+					if (!locked[position_ids[a]]) {
+						collapses.push_back(Collapse{a, b, collapseCost(a, b)});
+					}
+					if (!locked[position_ids[b]]) {
+						collapses.push_back(Collapse{b, a, collapseCost(b, a)});
+					}
+				}
+			}
+			if (collapses.empty()) {
+				break;
+			}
+			std::sort(collapses.begin(), collapses.end(),
+					  [](const Collapse &a, const Collapse &b) {
+						  return a.cost < b.cost;
+					  });
+
+			for (size_t i = 0; i < vertex_count; ++i) {
+				remap[i] = static_cast<uint32_t>(i);
+			}
+			std::fill(touched.begin(), touched.end(), 0);
+
+			// Most collapses remove two triangles
+			size_t budget = (triangles - target_triangles + 1) / 2;
+			size_t collapsed = 0;
+			for (auto &collapse : collapses) {
+				if (collapsed >= budget) {
+					break;
+				}
+				uint32_t from_id = position_ids[collapse.from];
+				uint32_t to_id = position_ids[collapse.to];
+				if (touched[from_id] || touched[to_id]) {
+					continue;
+				}
+				if (flipsTriangle(vertices, result, position_ids, remap,
+								  &adjacency[adjacency_offsets[collapse.from]],
+								  adjacency_offsets[collapse.from + 1] -
+									  adjacency_offsets[collapse.from],
+								  collapse.from, collapse.to)) {
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				touched[from_id] = 1;
+				touched[to_id] = 1;
+				// Later passes measure the survivor against the planes of both
+				quadrics[to_id].add(quadrics[from_id]);
+				++collapsed;
+			}
+			if (collapsed == 0) {
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				unsigned int a = remap[result[i]];
+				unsigned int b = remap[result[i + 1]];
+				unsigned int c = remap[result[i + 2]];
+				if (position_ids[a] == position_ids[b] ||
+					position_ids[b] == position_ids[c] ||
+					position_ids[a] == position_ids[c]) {
+					continue;
+				}
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+			triangles = write / 3;
+		}
+
+		return result;
+	} catch (const std::bad_alloc &) {
+		return criticalError("Out of memory");
+	}
+}
+
+Error generateMesh3dLods(Mesh3dData &mesh, size_t levels, float reduction,
+						 float screen_size) noexcept {
+	if (!(reduction > 0.f && reduction < 1.f)) {
+		return criticalError("Reduction has to lie between 0 and 1");
+	}
+	for (auto &lod : mesh.lods) {
+		if (lod.first_index + lod.index_count > mesh.indices.size()) {
+			return criticalError("Invalid lod range");
+		}
+	}
+
+	float step = std::sqrt(reduction);
+	try {
+		if (mesh.lods.empty()) {
+			mesh.lods.push_back(
+				Mesh3dData::Lod{0, mesh.indices.size(), screen_size});
+		}
+		if (!(mesh.lods.back().screen_size > 0.f)) {
+			mesh.lods.back().screen_size =
+				screen_size *
+				std::pow(step, static_cast<float>(mesh.lods.size() - 1));
+		}
+
+		for (size_t l = 0; l < levels; ++l) {
+			const Mesh3dData::Lod last = mesh.lods.back();
+			std::vector<unsigned int> source(
+				mesh.indices.begin() + last.first_index,
+				mesh.indices.begin() + last.first_index + last.index_count);
+
+			size_t target = static_cast<size_t>(
+				static_cast<float>(last.index_count / 3) * reduction);
+			ErrorOr<std::vector<unsigned int>> simplified =
+				simplifyMesh3d(mesh.vertices, source, target);
+			if (simplified.isError()) {
+				return simplified.error().copyError();
+			}
+
+			// Locked borders and seams can stop the reduction early
+			std::vector<unsigned int> &indices = simplified.value();
+			float reached = static_cast<float>(indices.size()) /
+							static_cast<float>(last.index_count);
+			if (indices.empty() || reached > (1.f + reduction) * 0.5f) {
+				break;
+			}
+
+			size_t first = mesh.indices.size();
+			mesh.indices.insert(mesh.indices.end(), indices.begin(),
+								indices.end());
+			mesh.lods.push_back(Mesh3dData::Lod{first, indices.size(),
+												last.screen_size * step});
+		}
+	} catch (const std::bad_alloc &) {
+		return criticalError("Out of memory");
+	}
+
+	return noError();
+}
+} // namespace gin
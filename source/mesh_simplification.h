@@ -0,0 +1,37 @@
+#pragma once
+
+#include "./render/render.h"
+
+#include <kelgin/error.h>
+
+#include <vector>
+
+namespace gin {
+/**
+ * Reduces the triangles to about the target count by collapsing edges in the
+ * order of their quadric error. Vertices are never moved or added, only the
+ * index list shrinks, so the result can share the vertex buffer of the
+ * original mesh. Vertices on open borders and on attribute seams (several
+ * vertices at the same position) stay in place, which keeps the silhouette and
+ * the texture mapping intact, but may stop the reduction early.
+ *
+ * @param indices triangle list indexing into vertices
+ */
+ErrorOr<std::vector<unsigned int>>
+simplifyMesh3d(const std::vector<Mesh3dData::Vertex> &vertices,
+			   const std::vector<unsigned int> &indices,
+			   size_t target_triangles) noexcept;
+
+/**
+ * Appends up to levels simplified index ranges to the mesh's lod chain. Every
+ * level keeps about reduction of the triangles of the one before, and
+ * generation stops once a level doesn't get noticeably smaller.
+ *
+ * The full detail level is used while the mesh covers at least screen_size,
+ * further levels take over at sizes shrinking with the square root of
+ * reduction, so the triangles per covered pixel stay about the same.
+ */
+Error generateMesh3dLods(Mesh3dData &mesh, size_t levels,
+						 float reduction = 0.5f,
+						 float screen_size = 0.25f) noexcept;
+} // namespace gin
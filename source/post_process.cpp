@@ -0,0 +1,21 @@
+#include "post_process.h"
+
+namespace gin {
+ErrorOr<std::vector<RenderPostPass>>
+gaussianBlurPasses(const PostProgramId &blur, const PostProgramId &copy,
+				   const std::vector<float> &scales) noexcept {
+	std::vector<RenderPostPass> passes;
+	try {
+		passes.reserve(scales.size() * 2 + 1);
+		for (float scale : scales) {
+			passes.push_back(RenderPostPass{blur, scale, {1.f, 0.f}});
+			passes.push_back(RenderPostPass{blur, scale, {0.f, 1.f}});
+		}
+		passes.push_back(RenderPostPass{copy, 1.f, {0.f, 0.f}});
+	} catch (const std::bad_alloc &) {
+		return criticalError("Out of memory");
+	}
+
+	return passes;
+}
+} // namespace gin
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "./render/render.h"
+
+#include <kelgin/error.h>
+
+#include <vector>
+
+namespace gin {
+/**
+ * Passes of a separable Gaussian blur. Every scale gets a horizontal and a
+ * vertical pass with the blur program, each reading the one before, so the
+ * blur widens with every smaller scale. The copy program scales the result
+ * back up to the output.
+ *
+ * @param blur program made by createPostBlurProgram
+ * @param copy program made by createPostProgram without a source
+ */
+ErrorOr<std::vector<RenderPostPass>>
+gaussianBlurPasses(const PostProgramId &blur, const PostProgramId &copy,
+				   const std::vector<float> &scales = {0.5f, 0.25f}) noexcept;
+} // namespace gin
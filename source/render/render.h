@@ -2,11 +2,13 @@
 
 #include "../common/id.h"
 #include "../common/shapes.h"
+#include "../common/triple_buffer.h"
 
 #include <kelgin/async.h>
 #include <kelgin/io.h>
 
 #include <chrono>
+#include <filesystem>
 #include <variant>
 
 namespace gin {
@@ -24,6 +26,36 @@ using RenderObjectId = ResourceId;
 using RenderSceneId = ResourceId;
 using RenderStageId = ResourceId;
 using RenderAnimationId = ResourceId;
+using RenderTilemapId = ResourceId;
+using RenderEmitterId = ResourceId;
+
+using PostProgramId = ResourceId;
+using RenderPostStageId = ResourceId;
+
+/**
+ * Tile 0 is empty. Tile n shows cell n-1 of the tilemap's atlas, counted row
+ * by row from the top left.
+ */
+using TileIndex = uint16_t;
+
+/**
+ * Bitmask of program features. Every set bit enables the matching
+ * "#define FEATURE_*" in the program sources. Bits without a name below are
+ * defined as FEATURE_BIT_<n>.
+ */
+using ProgramFeatures = uint32_t;
+namespace ProgramFeature {
+/// Multiplies the output with the "tint" uniform
+constexpr ProgramFeatures Tint = 1u << 0;
+/// Discards fragments with an alpha below 0.5
+constexpr ProgramFeatures AlphaTest = 1u << 1;
+/**
+ * Keeps the previous and current object transforms on the GPU and
+ * interpolates them in the vertex shader. Transforms are only uploaded when
+ * they change.
+ */
+constexpr ProgramFeatures GpuInterpolation = 1u << 2;
+}
 
 using Mesh3dId = ResourceId;
 using Program3dId = ResourceId;
@@ -55,8 +87,27 @@ public:
 
 	static_assert(sizeof(Vertex) == sizeof(float)*8, "Mesh3dData::Vertex is not continuously set");
 
+	/**
+	 * Range of indices drawing the mesh with a certain level of detail. All
+	 * levels share the vertices.
+	 */
+	struct Lod {
+		size_t first_index = 0;
+		size_t index_count = 0;
+		/**
+		 * Used while the bounding sphere's radius covers at least this
+		 * fraction of half the viewport height. The last level is used below.
+		 */
+		float screen_size = 0.f;
+	};
+
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
+	/**
+	 * From the most detailed level, no level may have more indices than the
+	 * one before. Empty draws all indices at any size.
+	 */
+	std::vector<Lod> lods;
 };
 
 /// @todo build a valid image on default or at least don't leave it
@@ -68,6 +119,19 @@ public:
 	uint8_t channels = 0;
 };
 
+enum class TextureFormat : uint8_t { RGBA8, BC1, BC3, BC7 };
+
+/**
+ * Block compressed image data. Blocks are 4x4 pixels, stored row by row.
+ * BC1 uses 8 bytes per block, BC3 and BC7 16 bytes.
+ */
+class CompressedImage {
+public:
+	size_t width = 0, height = 0;
+	TextureFormat format = TextureFormat::BC1;
+	std::vector<uint8_t> blocks;
+};
+
 struct RenderEvent {
 	struct Keyboard {
 		uint32_t key_code;
@@ -93,6 +157,172 @@ struct RenderEvent {
 	using Events = std::variant<Keyboard, Resize, Mouse, MouseMove>;
 };
 
+/**
+ * Active objects are still interpolating towards their last set transform,
+ * static ones are skipped by updateTime.
+ */
+struct RenderSceneStatistics {
+	size_t active_objects = 0;
+	size_t static_objects = 0;
+	/// Objects merged into static chunks, see setObjectStatic
+	size_t baked_objects = 0;
+	size_t static_chunks = 0;
+};
+
+/**
+ * Transforms of a scene's objects at one simulation tick, as packed arrays
+ * with one entry per listed object. Filling them again with the same objects
+ * in the same order is cheapest.
+ */
+struct RenderSceneSnapshot {
+	std::chrono::steady_clock::time_point time;
+	std::vector<RenderObjectId> objects;
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> angle;
+};
+using RenderSceneSnapshots = TripleBuffer<RenderSceneSnapshot>;
+
+/// Like RenderSceneSnapshot for 3D scenes
+struct RenderScene3dSnapshot {
+	std::chrono::steady_clock::time_point time;
+	std::vector<RenderObject3dId> objects;
+	Transform3Batch<float> transforms;
+};
+using RenderScene3dSnapshots = TripleBuffer<RenderScene3dSnapshot>;
+
+/**
+ * Passes a 3D stage draws its objects with.
+ */
+struct RenderStage3dPasses {
+	/**
+	 * Draws opaque objects from front to back, so hidden fragments fail the
+	 * depth test early. Otherwise they are only ordered to minimise state
+	 * changes.
+	 */
+	bool sort_opaque = true;
+	/**
+	 * Lays down the depth of all opaque objects first, so every pixel is shaded
+	 * once. Pays off for expensive fragment programs and heavy overdraw.
+	 *
+	 * The pre-pass uses a variant of the stage's program with DEPTH_PREPASS
+	 * defined in the fragment shader, which may skip everything except its
+	 * discards under it. Custom vertex shaders have to declare
+	 * "invariant gl_Position;", otherwise the two passes may compute slightly
+	 * different depths and drop fragments.
+	 */
+	bool depth_prepass = false;
+	/**
+	 * Draws transparent properties after the opaque objects, back to front and
+	 * blended. Otherwise they are drawn like opaque ones.
+	 */
+	bool transparent_pass = true;
+};
+
+/**
+ * Counted during the last frame the 3D stage drew.
+ */
+struct RenderStage3dStatistics {
+	size_t drawn_objects = 0;
+	size_t transparent_objects = 0;
+	/// Without the depth pre-pass
+	size_t draw_calls = 0;
+	size_t drawn_triangles = 0;
+	/// Triangles saved by the chosen levels of detail against drawing every object at full detail
+	size_t saved_triangles = 0;
+};
+
+/**
+ * One full-screen pass of a post-process stage. It draws at scale times the
+ * size of the stage's output, except for the last pass, which always draws
+ * into the output itself.
+ */
+struct RenderPostPass {
+	PostProgramId program = 0;
+	float scale = 1.f;
+	/// Passed to the program as "direction", e.g. the axis of a blur
+	std::array<float, 2> direction = {0.f, 0.f};
+};
+
+/**
+ * GPU time of each pass. Timings are read back once the driver has them, so
+ * they lag a few frames behind.
+ */
+struct RenderPostStageStatistics {
+	std::vector<float> pass_milliseconds;
+};
+
+/**
+ * Programs built since the renderer started, either compiled from source or
+ * loaded from the program cache.
+ */
+struct RenderProgramStatistics {
+	size_t compiled_programs = 0;
+	float compile_milliseconds = 0.f;
+	size_t cached_programs = 0;
+	float cache_milliseconds = 0.f;
+};
+
+/**
+ * Particles spawn at the emitter with a random velocity and lifetime within
+ * the given ranges. Size and colour follow the particle's normalized life.
+ */
+struct ParticleEmitterParameters {
+	/// Particles per second
+	float rate = 10.f;
+	float lifetime_min = 1.f;
+	float lifetime_max = 1.f;
+	std::array<float, 2> velocity_min = {{-1.f, -1.f}};
+	std::array<float, 2> velocity_max = {{1.f, 1.f}};
+	std::array<float, 2> gravity = {{0.f, 0.f}};
+	/// Share of the velocity lost per second
+	float drag = 0.f;
+	float size_begin = 1.f;
+	float size_end = 1.f;
+
+	struct ColourKey {
+		float time;
+		std::array<float, 4> colour;
+	};
+	/// Keys sorted by time in [0, 1], linearly interpolated. Empty is white.
+	std::vector<ColourKey> colour_over_life;
+
+	size_t max_particles = 1024;
+};
+
+/**
+ * Keyframe tracks applied to an object. Keys are sorted by their time in
+ * seconds since the start of the animation. Position, rotation and layer are
+ * interpolated linearly, visibility and property switch at their keys.
+ * Empty tracks leave the object alone.
+ */
+struct RenderAnimationData {
+	template<typename T>
+	struct Key {
+		float time;
+		T value;
+	};
+
+	std::vector<Key<std::array<float, 2>>> position;
+	std::vector<Key<float>> rotation;
+	std::vector<Key<float>> layer;
+	std::vector<Key<bool>> visibility;
+	std::vector<Key<RenderPropertyId>> property;
+};
+
+/**
+ * Sprite sheet animation of a property. Frame i shows the rect frames[i],
+ * given as u, v, width and height, of the property's texture. Each object
+ * counts the frames from its own start, so objects sharing the property are
+ * still drawn together.
+ */
+struct FlipbookData {
+	std::vector<std::array<float, 4>> frames;
+	float fps = 12.f;
+	/// Otherwise the last frame is held
+	bool loop = true;
+};
+
 struct RenderVideoMode {
 	size_t width;
 	size_t height;
@@ -114,7 +344,21 @@ public:
 	// Program Operations
 	virtual ErrorOr<ProgramId> createProgram(const std::string& vertex_src, const std::string& fragment_src) noexcept = 0;
 	virtual ErrorOr<ProgramId> createProgram() noexcept = 0;
+	/**
+	 * Doesn't wait for the driver to compile and link the program. The id
+	 * arrives during a later step().
+	 */
+	virtual Conveyor<ProgramId> createProgramAsync(const std::string& vertex_src, const std::string& fragment_src) noexcept = 0;
 	virtual Error destroyProgram(const ProgramId&) noexcept = 0;
+	/**
+	 * Returns the variant of a program with the given features. Asking for the
+	 * same features returns the same id. Variants are compiled on their first
+	 * use unless they are prewarmed.
+	 */
+	virtual ErrorOr<ProgramId> getProgramVariant(const ProgramId& base, ProgramFeatures) noexcept = 0;
+	/// Compiles the variants now, so their first use doesn't stall a frame
+	virtual Error prewarmProgramVariants(const ProgramId& base, const std::vector<ProgramFeatures>&) noexcept = 0;
+	virtual Error setProgramTint(const ProgramId&, float r, float g, float b, float a) noexcept = 0;
 
 	// Camera Operations
 	virtual ErrorOr<RenderCameraId> createCamera() noexcept = 0;
@@ -127,6 +371,9 @@ public:
 	virtual ErrorOr<RenderPropertyId> createProperty(const MeshId&, const TextureId&) noexcept = 0;
 	virtual Error setPropertyMesh(const RenderPropertyId&, const MeshId& id) noexcept = 0;
 	virtual Error setPropertyTexture(const RenderPropertyId&, const TextureId& id) noexcept = 0;
+	virtual ErrorOr<RenderPropertyId> createFlipbookProperty(const MeshId&, const TextureId& atlas, const FlipbookData&) noexcept = 0;
+	/// No frames turn the property back into a plain one
+	virtual Error setPropertyFlipbook(const RenderPropertyId&, const FlipbookData&) noexcept = 0;
 	virtual Error destroyProperty(const RenderPropertyId&) noexcept = 0;
 
 	// Scene and Object Operations
@@ -136,13 +383,83 @@ public:
 	virtual Error setObjectPosition(const RenderSceneId&, const RenderObjectId&, float, float, bool interpolate = true) noexcept = 0;
 	virtual Error setObjectRotation(const RenderSceneId&, const RenderObjectId&, float, bool interpolate = true) noexcept = 0;
 	virtual Error setObjectVisibility(const RenderSceneId&, const RenderObjectId&, bool) noexcept = 0;
+	/**
+	 * Positions and rotations of the object become relative to the parent. A
+	 * parent of 0 detaches the object. Children of destroyed objects become
+	 * roots.
+	 */
+	virtual Error setObjectParent(const RenderSceneId&, const RenderObjectId&, const RenderObjectId& parent) noexcept = 0;
+	/**
+	 * Static objects are baked into merged meshes per texture, layer and area
+	 * of the scene, which are drawn with one call each. Changing a baked
+	 * object only rebakes its chunk. Baked objects aren't interpolated.
+	 */
+	virtual Error setObjectStatic(const RenderSceneId&, const RenderObjectId&, bool) noexcept = 0;
+	/// Treats every object on the layer as static
+	virtual Error setLayerStatic(const RenderSceneId&, float layer, bool) noexcept = 0;
 	virtual Error setObjectLayer(const RenderSceneId& id, const RenderObjectId&, float) noexcept = 0;
+	/// Switching to another property restarts the object's flipbook
 	virtual Error setObjectProperty(const RenderSceneId& id, const RenderObjectId&, const RenderPropertyId&) noexcept = 0;
+	/// Restarts the flipbook at the time of the last updateTime
+	virtual Error restartObjectFlipbook(const RenderSceneId&, const RenderObjectId&) noexcept = 0;
 	virtual Error destroyScene(const RenderSceneId&) noexcept = 0;
+	virtual ErrorOr<RenderSceneStatistics> getSceneStatistics(const RenderSceneId&) noexcept = 0;
+	/**
+	 * Lock-free channel from a simulation thread into the scene, made on the
+	 * first call and living as long as the scene. The simulation fills the
+	 * writeSlot at every tick and publishes it. From then on step places the
+	 * listed objects between the two latest snapshots, one tick behind the
+	 * latest. updateTime only moves objects the latest snapshot doesn't list,
+	 * and the whole scene is drawn at the snapshots' pace.
+	 */
+	virtual ErrorOr<RenderSceneSnapshots*> createSceneSnapshots(const RenderSceneId&) noexcept = 0;
+
+	// Tilemap Operations
+	/**
+	 * Grid of width x height tiles in the scene, drawn from an atlas split
+	 * into columns x rows cells. The tiles are split into chunks which are
+	 * only built when they become visible, so changing a tile only rebuilds
+	 * its chunk.
+	 */
+	virtual ErrorOr<RenderTilemapId> createTilemap(const RenderSceneId&, const TextureId& atlas, size_t atlas_columns, size_t atlas_rows, size_t width, size_t height, float tile_size) noexcept = 0;
+	virtual Error setTilemapTile(const RenderSceneId&, const RenderTilemapId&, size_t x, size_t y, TileIndex) noexcept = 0;
+	/// Tiles are given row by row
+	virtual Error setTilemapTiles(const RenderSceneId&, const RenderTilemapId&, size_t x, size_t y, size_t width, size_t height, const std::vector<TileIndex>&) noexcept = 0;
+	/// Position of the bottom left corner of tile (0, 0)
+	virtual Error setTilemapPosition(const RenderSceneId&, const RenderTilemapId&, float x, float y) noexcept = 0;
+	virtual Error setTilemapLayer(const RenderSceneId&, const RenderTilemapId&, float) noexcept = 0;
+	virtual Error destroyTilemap(const RenderSceneId&, const RenderTilemapId&) noexcept = 0;
+
+	// Particle Emitter Operations
+	/**
+	 * Emitters are simulated during updateTime and drawn with one instanced
+	 * call each, after the scene's objects.
+	 */
+	virtual ErrorOr<RenderEmitterId> createEmitter(const RenderSceneId&, const TextureId&, const ParticleEmitterParameters&) noexcept = 0;
+	virtual Error setEmitterParameters(const RenderSceneId&, const RenderEmitterId&, const ParticleEmitterParameters&) noexcept = 0;
+	virtual Error setEmitterPosition(const RenderSceneId&, const RenderEmitterId&, float x, float y) noexcept = 0;
+	virtual Error setEmitterLayer(const RenderSceneId&, const RenderEmitterId&, float) noexcept = 0;
+	/// Inactive emitters stop spawning, existing particles live on
+	virtual Error setEmitterActive(const RenderSceneId&, const RenderEmitterId&, bool) noexcept = 0;
+	virtual Error destroyEmitter(const RenderSceneId&, const RenderEmitterId&) noexcept = 0;
+
+	// Animation Operations
+	virtual ErrorOr<RenderAnimationId> createAnimation(const RenderAnimationData&) noexcept = 0;
+	virtual Error destroyAnimation(const RenderAnimationId&) noexcept = 0;
+	/**
+	 * Plays the animation on the object, starting with the last updateTime.
+	 * The conveyor resolves once the animation finished. Looping animations
+	 * only end by stopAnimations, which fails the conveyor, as does
+	 * destroying the object or the animation.
+	 */
+	virtual Conveyor<void> playAnimation(const RenderSceneId&, const RenderObjectId&, const RenderAnimationId&, bool loop = false) noexcept = 0;
+	virtual Error stopAnimations(const RenderSceneId&, const RenderObjectId&) noexcept = 0;
 
 	// Stage Operations
 	virtual ErrorOr<RenderStageId> createStage(const RenderTargetId& id, const RenderViewportId&, const RenderSceneId&, const RenderCameraId&, const ProgramId&) noexcept = 0;
 	virtual Error destroyStage(const RenderStageId&) noexcept = 0;
+	/// Render textures the stage reads, which are drawn before it. Replaces the previous inputs.
+	virtual Error setStageInputs(const RenderStageId&, const std::vector<RenderTextureId>&) noexcept = 0;
 };
 
 class LowLevelRender3D {
@@ -156,6 +473,8 @@ public:
 	// Property3d Operations
 	virtual ErrorOr<RenderProperty3dId> createProperty3d(const Mesh3dId&, const TextureId&) noexcept = 0;
 	virtual Error destroyProperty3d(const RenderProperty3dId&) noexcept = 0;
+	/// Transparent properties blend with what's behind them, see RenderStage3dPasses
+	virtual Error setProperty3dTransparent(const RenderProperty3dId&, bool) noexcept = 0;
 
 	// Program3d Operations
 	virtual ErrorOr<Program3dId> createProgram3d(const std::string& vertex_src, const std::string& fragment_src) noexcept = 0;
@@ -165,18 +484,45 @@ public:
 	// Camera3d Operations
 	virtual ErrorOr<RenderCamera3dId> createCamera3d() noexcept = 0;
 	virtual Error setCamera3dPosition(const RenderCamera3dId&, float, float, float) noexcept = 0;
+	/// Rotates around x, then y, then z
+	virtual Error setCamera3dRotation(const RenderCamera3dId&, float alpha, float beta, float gamma) noexcept = 0;
+	/// Rotation as a unit quaternion x, y, z, w. Replaces the one set by setCamera3dRotation.
+	virtual Error setCamera3dOrientation(const RenderCamera3dId&, float x, float y, float z, float w) noexcept = 0;
+	/// Left, right, top, bottom, near and far. The camera looks along -z.
 	virtual Error setCamera3dOrthographic(const RenderCamera3dId&, float, float, float, float, float, float) noexcept = 0;
+	/**
+	 * Vertical field of view in radians, aspect ratio, near and far. A far plane of 0
+	 * lies at infinity. Reversed depth maps near to 1 and far to 0, which keeps the
+	 * depth precision over the whole distance.
+	 */
+	virtual Error setCamera3dPerspective(const RenderCamera3dId&, float fov_y, float aspect, float near, float far, bool reverse_depth) noexcept = 0;
 	virtual Error destroyCamera3d(const RenderCamera3dId&) noexcept = 0;
 	
 	// Scene3d and Object3d Operations
 	virtual ErrorOr<RenderScene3dId> createScene3d() noexcept = 0;
 	virtual ErrorOr<RenderObject3dId> createObject3d(const RenderScene3dId&, const RenderProperty3dId&) noexcept = 0;
 	virtual Error destroyObject3d(const RenderScene3dId&, const RenderObject3dId&) noexcept = 0;
+	/**
+	 * Positions and rotations are interpolated like 2D objects, from the
+	 * values at the previous updateTime to the ones set afterwards.
+	 */
+	virtual Error setObject3dPosition(const RenderScene3dId&, const RenderObject3dId&, float x, float y, float z) noexcept = 0;
+	/// Rotates around x, then y, then z
+	virtual Error setObject3dRotation(const RenderScene3dId&, const RenderObject3dId&, float alpha, float beta, float gamma) noexcept = 0;
+	/// Rotation as a unit quaternion x, y, z, w. Rotations are interpolated along the shorter arc.
+	virtual Error setObject3dOrientation(const RenderScene3dId&, const RenderObject3dId&, float x, float y, float z, float w) noexcept = 0;
+	virtual Error setObject3dVisibility(const RenderScene3dId&, const RenderObject3dId&, bool) noexcept = 0;
 	virtual Error destroyScene3d(const RenderScene3dId&) noexcept = 0;
+	/// Like createSceneSnapshots for 3D scenes
+	virtual ErrorOr<RenderScene3dSnapshots*> createScene3dSnapshots(const RenderScene3dId&) noexcept = 0;
 
 	// Stage3d Operations
 	virtual ErrorOr<RenderStage3dId> createStage3d(const RenderTargetId&, const RenderViewportId&, const RenderScene3dId&, const RenderCamera3dId&, const Program3dId&) noexcept = 0;
 	virtual Error destroyStage3d(const RenderStage3dId&) noexcept = 0;
+	virtual Error setStage3dPasses(const RenderStage3dId&, const RenderStage3dPasses&) noexcept = 0;
+	virtual ErrorOr<RenderStage3dStatistics> getStage3dStatistics(const RenderStage3dId&) noexcept = 0;
+	/// Render textures the stage reads, which are drawn before it. Replaces the previous inputs.
+	virtual Error setStage3dInputs(const RenderStage3dId&, const std::vector<RenderTextureId>&) noexcept = 0;
 
 	// Animation3d Operations
 	// virtual Conveyor<RenderAnimation3d>
@@ -193,21 +539,71 @@ public:
 
 	// Texture Operations
 	virtual ErrorOr<TextureId> createTexture(const Image&) noexcept = 0;
+	virtual ErrorOr<TextureId> createTexture(const CompressedImage&) noexcept = 0;
+	virtual bool supportsTextureFormat(TextureFormat) const noexcept = 0;
 	virtual Error destroyTexture(const TextureId&) noexcept = 0;
 
 	// Window Operations
 	virtual ErrorOr<RenderWindowId> createWindow(const RenderVideoMode&, const std::string& title) noexcept = 0;
 	virtual Error setWindowDesiredFPS(const RenderWindowId&, float fps) noexcept = 0;
 	virtual Error setWindowVisibility(const RenderWindowId& id, bool show) noexcept = 0;
+	/**
+	 * Lets the window skip steps while the GPU still works on its last frame,
+	 * instead of holding up the other windows until it's done. Off by default,
+	 * so every due step draws.
+	 */
+	virtual Error setWindowIndependentPresent(const RenderWindowId&, bool) noexcept = 0;
 	virtual Error destroyWindow(const RenderWindowId& id) noexcept = 0;
 
 	virtual Conveyor<RenderEvent::Events> listenToWindowEvents(const RenderWindowId&) noexcept = 0;
 
+	// Render Texture Operations
+	/**
+	 * Offscreen target for stages. It's only drawn in frames in which a stage
+	 * reading it is drawn. Transient render textures keep their contents just
+	 * within a frame, which lets ones whose uses don't overlap share memory.
+	 */
+	virtual ErrorOr<RenderTextureId> createRenderTexture(size_t width, size_t height, bool transient) noexcept = 0;
+	/// Texture for sampling the render texture, destroyed along with it
+	virtual ErrorOr<TextureId> getRenderTextureTexture(const RenderTextureId&) noexcept = 0;
+	/// Colour windows and render textures are cleared to before their first stage in a frame
+	virtual Error setRenderTargetClearColour(const RenderTargetId&, float r, float g, float b, float a) noexcept = 0;
+	virtual Error destroyRenderTexture(const RenderTextureId&) noexcept = 0;
+
+	// Post Process Operations
+	/**
+	 * Fragment program drawn over the whole target. It samples the previous
+	 * pass, or the stage's input, through the "source" sampler at "uv". The
+	 * size of one source texel is in "texel_size".
+	 */
+	virtual ErrorOr<PostProgramId> createPostProgram(const std::string& fragment_src) noexcept = 0;
+	/// Copies the source, which scales it to the size of the pass
+	virtual ErrorOr<PostProgramId> createPostProgram() noexcept = 0;
+	/// Gaussian blur over nine source texels along the pass' direction
+	virtual ErrorOr<PostProgramId> createPostBlurProgram() noexcept = 0;
+	virtual Error destroyPostProgram(const PostProgramId&) noexcept = 0;
+
+	/**
+	 * Runs its passes over the input render texture into the output target.
+	 * Intermediate passes draw into textures the stage manages itself.
+	 */
+	virtual ErrorOr<RenderPostStageId> createPostStage(const RenderTextureId& input, const RenderTargetId& output) noexcept = 0;
+	virtual Error setPostStagePasses(const RenderPostStageId&, const std::vector<RenderPostPass>&) noexcept = 0;
+	virtual ErrorOr<RenderPostStageStatistics> getPostStageStatistics(const RenderPostStageId&) noexcept = 0;
+	virtual Error destroyPostStage(const RenderPostStageId&) noexcept = 0;
+
 	// Viewport Operations
 	virtual ErrorOr<RenderViewportId> createViewport() noexcept = 0;
 	virtual Error setViewportRect(const RenderViewportId&, float, float, float, float) noexcept = 0;
 	virtual Error destroyViewport(const RenderViewportId&) noexcept = 0;
 
+	/**
+	* Directory for caching linked program binaries between runs.
+	* An empty path disables the cache.
+	*/
+	virtual Error setProgramCacheDirectory(const std::filesystem::path&) noexcept = 0;
+	virtual RenderProgramStatistics getProgramStatistics() noexcept = 0;
+
 	/// @todo change time_point to microseconds and independent to steady_clock type
 	virtual void step(const std::chrono::steady_clock::time_point&) noexcept = 0;
 	virtual void flush() noexcept = 0;
@@ -0,0 +1,768 @@
+#include "texture_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gin {
+namespace {
+/**
+ * Pixels of one 4x4 block as separate channels, so that the index search can
+ * work on four pixels at once.
+ */
+struct Block {
+	std::array<float, 16> r;
+	std::array<float, 16> g;
+	std::array<float, 16> b;
+	std::array<float, 16> a;
+};
+
+void fetchBlock(const Image &image, size_t block_x, size_t block_y,
+				Block &block) {
+	for (size_t y = 0; y < 4; ++y) {
+		size_t py = std::min(block_y * 4 + y, image.height - 1);
+		for (size_t x = 0; x < 4; ++x) {
+			size_t px = std::min(block_x * 4 + x, image.width - 1);
+			const uint8_t *pixel =
+				&image.pixels[(py * image.width + px) * image.channels];
+
+			size_t i = y * 4 + x;
+			switch (image.channels) {
+			case 1:
+				block.r[i] = block.g[i] = block.b[i] = pixel[0];
+				block.a[i] = 255.f;
+				break;
+			case 2:
+				block.r[i] = block.g[i] = block.b[i] = pixel[0];
+				block.a[i] = pixel[1];
+				break;
+			case 3:
+				block.r[i] = pixel[0];
+				block.g[i] = pixel[1];
+				block.b[i] = pixel[2];
+				block.a[i] = 255.f;
+				break;
+			default:
+				block.r[i] = pixel[0];
+				block.g[i] = pixel[1];
+				block.b[i] = pixel[2];
+				block.a[i] = pixel[3];
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * Picks the nearest palette entry for each of the 16 pixels and returns the
+ * summed squared error.
+ */
+template <size_t C, size_t P>
+float selectIndices(const std::array<const float *, C> &channels,
+					const std::array<std::array<float, C>, P> &palette,
+					std::array<uint8_t, 16> &indices) {
+	float error = 0.f;
+#ifdef __SSE2__
+	for (size_t i = 0; i < 16; i += 4) {
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i best_index = _mm_setzero_si128();
+
+		for (size_t p = 0; p < P; ++p) {
+			__m128 dist = _mm_setzero_ps();
+			for (size_t c = 0; c < C; ++c) {
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(channels[c] + i),
+									  _mm_set1_ps(palette[p][c]));
+				dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+			}
+
+			__m128i less = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+			best = _mm_min_ps(dist, best);
+			best_index = _mm_or_si128(
+				_mm_and_si128(less, _mm_set1_epi32(static_cast<int>(p))),
+				_mm_andnot_si128(less, best_index));
+		}
+
+		alignas(16) std::array<int32_t, 4> index_lanes;
+		alignas(16) std::array<float, 4> error_lanes;
+		_mm_store_si128(reinterpret_cast<__m128i *>(index_lanes.data()),
+						best_index);
+		_mm_store_ps(error_lanes.data(), best);
+		for (size_t j = 0; j < 4; ++j) {
+			indices[i + j] = static_cast<uint8_t>(index_lanes[j]);
+			error += error_lanes[j];
+		}
+	}
+#else
+	for (size_t i = 0; i < 16; ++i) {
+		float best = FLT_MAX;
+		for (size_t p = 0; p < P; ++p) {
+			float dist = 0.f;
+			for (size_t c = 0; c < C; ++c) {
+				float d = channels[c][i] - palette[p][c];
+				dist += d * d;
+			}
+			if (dist < best) {
+				best = dist;
+				indices[i] = static_cast<uint8_t>(p);
+			}
+		}
+		error += best;
+	}
+#endif
+	return error;
+}
+
+/**
+ * Endpoints spanning the block along its principal axis. Fast only uses the
+ * bounding box diagonal.
+ */
+template <size_t C>
+void fitEndpoints(const std::array<const float *, C> &channels,
+				  CompressionPreset preset, std::array<float, C> &e0,
+				  std::array<float, C> &e1) {
+	std::array<float, C> min;
+	std::array<float, C> max;
+	std::array<float, C> mean;
+	for (size_t c = 0; c < C; ++c) {
+		min[c] = *std::min_element(channels[c], channels[c] + 16);
+		max[c] = *std::max_element(channels[c], channels[c] + 16);
+		mean[c] = 0.f;
+		for (size_t i = 0; i < 16; ++i) {
+			mean[c] += channels[c][i];
+		}
+		mean[c] /= 16.f;
+	}
+
+	if (preset == CompressionPreset::Fast) {
+		for (size_t c = 0; c < C; ++c) {
+			float inset = (max[c] - min[c]) / 16.f;
+			e0[c] = max[c] - inset;
+			e1[c] = min[c] + inset;
+		}
+		return;
+	}
+
+	std::array<std::array<float, C>, C> covariance{};
+	for (size_t i = 0; i < 16; ++i) {
+		for (size_t j = 0; j < C; ++j) {
+			for (size_t k = 0; k < C; ++k) {
+				covariance[j][k] += (channels[j][i] - mean[j]) *
+									(channels[k][i] - mean[k]);
+			}
+		}
+	}
+
+	std::array<float, C> axis;
+	for (size_t c = 0; c < C; ++c) {
+		axis[c] = max[c] - min[c];
+	}
+	for (size_t iteration = 0; iteration < 8; ++iteration) {
+		std::array<float, C> next{};
+		float length = 0.f;
+		for (size_t j = 0; j < C; ++j) {
+			for (size_t k = 0; k < C; ++k) {
+				next[j] += covariance[j][k] * axis[k];
+			}
+			length = std::max(length, std::abs(next[j]));
+		}
+		if (length < 1e-6f) {
+			break;
+		}
+		for (size_t c = 0; c < C; ++c) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float length = 0.f;
+	for (size_t c = 0; c < C; ++c) {
+		length += axis[c] * axis[c];
+	}
+	if (length < 1e-12f) {
+		e0 = mean;
+		e1 = mean;
+		return;
+	}
+	length = std::sqrt(length);
+	for (size_t c = 0; c < C; ++c) {
+		axis[c] /= length;
+	}
+
+	float t_min = FLT_MAX;
+	float t_max = -FLT_MAX;
+	for (size_t i = 0; i < 16; ++i) {
+		float t = 0.f;
+		for (size_t c = 0; c < C; ++c) {
+			t += (channels[c][i] - mean[c]) * axis[c];
+		}
+		t_min = std::min(t_min, t);
+		t_max = std::max(t_max, t);
+	}
+
+	for (size_t c = 0; c < C; ++c) {
+		e0[c] = std::clamp(mean[c] + axis[c] * t_max, 0.f, 255.f);
+		e1[c] = std::clamp(mean[c] + axis[c] * t_min, 0.f, 255.f);
+	}
+}
+
+/**
+ * Least squares endpoints for fixed indices. weights[i] is the share of e1
+ * for palette index i. Returns false if the system is degenerate.
+ */
+template <size_t C, size_t P>
+bool refineEndpoints(const std::array<const float *, C> &channels,
+					 const std::array<uint8_t, 16> &indices,
+					 const std::array<float, P> &weights,
+					 std::array<float, C> &e0, std::array<float, C> &e1) {
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	std::array<float, C> ax{};
+	std::array<float, C> bx{};
+
+	for (size_t i = 0; i < 16; ++i) {
+		float b = weights[indices[i]];
+		float a = 1.f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (size_t c = 0; c < C; ++c) {
+			ax[c] += a * channels[c][i];
+			bx[c] += b * channels[c][i];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f) {
+		return false;
+	}
+
+	for (size_t c = 0; c < C; ++c) {
+		e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.f, 255.f);
+		e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.f, 255.f);
+	}
+	return true;
+}
+
+size_t refineIterations(CompressionPreset preset) {
+	switch (preset) {
+	case CompressionPreset::Fast:
+		return 0;
+	case CompressionPreset::Balanced:
+		return 1;
+	case CompressionPreset::Quality:
+		return 4;
+	}
+	return 0;
+}
+
+void writeLittleEndian(uint8_t *out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) {
+		out[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+/*
+ * BC1
+ */
+uint16_t packRgb565(const std::array<float, 3> &colour) {
+	uint16_t r = static_cast<uint16_t>(
+		std::clamp(std::lround(colour[0] * 31.f / 255.f), 0l, 31l));
+	uint16_t g = static_cast<uint16_t>(
+		std::clamp(std::lround(colour[1] * 63.f / 255.f), 0l, 63l));
+	uint16_t b = static_cast<uint16_t>(
+		std::clamp(std::lround(colour[2] * 31.f / 255.f), 0l, 31l));
+	return (r << 11) | (g << 5) | b;
+}
+
+std::array<float, 3> unpackRgb565(uint16_t colour) {
+	uint16_t r = (colour >> 11) & 0x1F;
+	uint16_t g = (colour >> 5) & 0x3F;
+	uint16_t b = colour & 0x1F;
+	return {static_cast<float>((r << 3) | (r >> 2)),
+			static_cast<float>((g << 2) | (g >> 4)),
+			static_cast<float>((b << 3) | (b >> 2))};
+}
+
+struct Bc1Candidate {
+	uint16_t c0;
+	uint16_t c1;
+	std::array<uint8_t, 16> indices;
+	float error;
+};
+
+Bc1Candidate evaluateBc1(const std::array<const float *, 3> &channels,
+						 const std::array<float, 3> &e0,
+						 const std::array<float, 3> &e1) {
+	Bc1Candidate candidate;
+	candidate.c0 = packRgb565(e0);
+	candidate.c1 = packRgb565(e1);
+	// Four colour mode requires c0 > c1
+	if (candidate.c0 < candidate.c1) {
+		std::swap(candidate.c0, candidate.c1);
+	}
+
+	if (candidate.c0 == candidate.c1) {
+		std::array<std::array<float, 3>, 1> palette{unpackRgb565(candidate.c0)};
+		candidate.error = selectIndices(channels, palette, candidate.indices);
+		return candidate;
+	}
+
+	std::array<float, 3> p0 = unpackRgb565(candidate.c0);
+	std::array<float, 3> p1 = unpackRgb565(candidate.c1);
+	std::array<std::array<float, 3>, 4> palette;
+	for (size_t c = 0; c < 3; ++c) {
+		palette[0][c] = p0[c];
+		palette[1][c] = p1[c];
+		palette[2][c] = (2.f * p0[c] + p1[c]) / 3.f;
+		palette[3][c] = (p0[c] + 2.f * p1[c]) / 3.f;
+	}
+	candidate.error = selectIndices(channels, palette, candidate.indices);
+	return candidate;
+}
+
+void encodeBc1(const Block &block, CompressionPreset preset, uint8_t *out) {
+	std::array<const float *, 3> channels{block.r.data(), block.g.data(),
+										  block.b.data()};
+
+	std::array<float, 3> e0;
+	std::array<float, 3> e1;
+	fitEndpoints(channels, preset, e0, e1);
+
+	Bc1Candidate best = evaluateBc1(channels, e0, e1);
+
+	const std::array<float, 4> weights{0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+	size_t iterations = refineIterations(preset);
+	for (size_t i = 0; i < iterations && best.c0 != best.c1; ++i) {
+		if (!refineEndpoints(channels, best.indices, weights, e0, e1)) {
+			break;
+		}
+		Bc1Candidate candidate = evaluateBc1(channels, e0, e1);
+		if (candidate.error >= best.error) {
+			break;
+		}
+		best = candidate;
+	}
+
+	uint32_t index_bits = 0;
+	for (size_t i = 0; i < 16; ++i) {
+		index_bits |= static_cast<uint32_t>(best.indices[i]) << (i * 2);
+	}
+
+	writeLittleEndian(out, best.c0, 2);
+	writeLittleEndian(out + 2, best.c1, 2);
+	writeLittleEndian(out + 4, index_bits, 4);
+}
+
+/*
+ * BC3 alpha
+ */
+struct AlphaCandidate {
+	uint8_t a0;
+	uint8_t a1;
+	std::array<uint8_t, 16> indices;
+	float error;
+};
+
+AlphaCandidate evaluateAlpha(const std::array<const float *, 1> &channels,
+							 uint8_t a0, uint8_t a1) {
+	AlphaCandidate candidate{a0, a1, {}, 0.f};
+
+	std::array<std::array<float, 1>, 8> palette;
+	palette[0][0] = a0;
+	palette[1][0] = a1;
+	if (a0 > a1) {
+		for (size_t i = 1; i < 7; ++i) {
+			palette[i + 1][0] = ((7.f - i) * a0 + i * a1) / 7.f;
+		}
+	} else {
+		for (size_t i = 1; i < 5; ++i) {
+			palette[i + 1][0] = ((5.f - i) * a0 + i * a1) / 5.f;
+		}
+		palette[6][0] = 0.f;
+		palette[7][0] = 255.f;
+	}
+	candidate.error = selectIndices(channels, palette, candidate.indices);
+	return candidate;
+}
+
+void encodeAlpha(const Block &block, CompressionPreset preset, uint8_t *out) {
+	std::array<const float *, 1> channels{block.a.data()};
+
+	auto range = std::minmax_element(block.a.begin(), block.a.end());
+	uint8_t min = static_cast<uint8_t>(*range.first);
+	uint8_t max = static_cast<uint8_t>(*range.second);
+
+	AlphaCandidate best = evaluateAlpha(channels, max, min);
+
+	// The six value mode has exact 0 and 255, which helps blocks with fully
+	// transparent or opaque pixels around a soft edge
+	if (preset != CompressionPreset::Fast && min != max) {
+		uint8_t inner_min = 255;
+		uint8_t inner_max = 0;
+		for (float a : block.a) {
+			uint8_t value = static_cast<uint8_t>(a);
+			if (value != 0 && value != 255) {
+				inner_min = std::min(inner_min, value);
+				inner_max = std::max(inner_max, value);
+			}
+		}
+		if (inner_min <= inner_max) {
+			AlphaCandidate candidate =
+				evaluateAlpha(channels, inner_min, inner_max);
+			if (candidate.error < best.error) {
+				best = candidate;
+			}
+		}
+	}
+
+	uint64_t index_bits = 0;
+	for (size_t i = 0; i < 16; ++i) {
+		index_bits |= static_cast<uint64_t>(best.indices[i]) << (i * 3);
+	}
+
+	out[0] = best.a0;
+	out[1] = best.a1;
+	writeLittleEndian(out + 2, index_bits, 6);
+}
+
+void encodeBc3(const Block &block, CompressionPreset preset, uint8_t *out) {
+	encodeAlpha(block, preset, out);
+	encodeBc1(block, preset, out + 8);
+}
+
+/*
+ * BC7 mode 6. One subset with RGBA endpoints of 7 bits plus a p-bit each and
+ * 4 bit indices.
+ */
+constexpr std::array<uint8_t, 16> bc7_weights{0,  4,  9,  13, 17, 21, 26, 30,
+											  34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Endpoint {
+	std::array<uint8_t, 4> q;
+	uint8_t p;
+
+	float value(size_t c) const { return static_cast<float>((q[c] << 1) | p); }
+};
+
+Bc7Endpoint quantizeBc7(const std::array<float, 4> &e) {
+	Bc7Endpoint best{};
+	float best_error = FLT_MAX;
+	for (uint8_t p = 0; p < 2; ++p) {
+		Bc7Endpoint endpoint{};
+		endpoint.p = p;
+		float error = 0.f;
+		for (size_t c = 0; c < 4; ++c) {
+			endpoint.q[c] = static_cast<uint8_t>(
+				std::clamp(std::lround((e[c] - p) / 2.f), 0l, 127l));
+			float d = endpoint.value(c) - e[c];
+			error += d * d;
+		}
+		if (error < best_error) {
+			best_error = error;
+			best = endpoint;
+		}
+	}
+	return best;
+}
+
+struct Bc7Candidate {
+	Bc7Endpoint e0;
+	Bc7Endpoint e1;
+	std::array<uint8_t, 16> indices;
+	float error;
+};
+
+Bc7Candidate evaluateBc7(const std::array<const float *, 4> &channels,
+						 const std::array<float, 4> &e0,
+						 const std::array<float, 4> &e1) {
+	Bc7Candidate candidate;
+	candidate.e0 = quantizeBc7(e0);
+	candidate.e1 = quantizeBc7(e1);
+
+	std::array<std::array<float, 4>, 16> palette;
+	for (size_t i = 0; i < 16; ++i) {
+		for (size_t c = 0; c < 4; ++c) {
+			uint32_t a = static_cast<uint32_t>(candidate.e0.value(c));
+			uint32_t b = static_cast<uint32_t>(candidate.e1.value(c));
+			palette[i][c] = static_cast<float>(
+				((64 - bc7_weights[i]) * a + bc7_weights[i] * b + 32) >> 6);
+		}
+	}
+	candidate.error = selectIndices(channels, palette, candidate.indices);
+	return candidate;
+}
+
+class BitWriter {
+private:
+	uint8_t *out;
+	size_t position = 0;
+
+public:
+	BitWriter(uint8_t *out) : out{out} {}
+
+	void write(uint32_t value, size_t bits) {
+		for (size_t i = 0; i < bits; ++i, ++position) {
+			if ((value >> i) & 1) {
+				out[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+			}
+		}
+	}
+};
+
+void encodeBc7(const Block &block, CompressionPreset preset, uint8_t *out) {
+	std::array<const float *, 4> channels{block.r.data(), block.g.data(),
+										  block.b.data(), block.a.data()};
+
+	std::array<float, 4> e0;
+	std::array<float, 4> e1;
+	fitEndpoints(channels, preset, e0, e1);
+
+	Bc7Candidate best = evaluateBc7(channels, e0, e1);
+
+	std::array<float, 16> weights;
+	for (size_t i = 0; i < 16; ++i) {
+		weights[i] = bc7_weights[i] / 64.f;
+	}
+	size_t iterations = refineIterations(preset);
+	for (size_t i = 0; i < iterations; ++i) {
+		if (!refineEndpoints(channels, best.indices, weights, e0, e1)) {
+			break;
+		}
+		Bc7Candidate candidate = evaluateBc7(channels, e0, e1);
+		if (candidate.error >= best.error) {
+			break;
+		}
+		best = candidate;
+	}
+
+	// The anchor index is stored with its most significant bit implied zero
+	if (best.indices[0] & 0x8) {
+		std::swap(best.e0, best.e1);
+		for (auto &index : best.indices) {
+			index = 15 - index;
+		}
+	}
+
+	memset(out, 0, 16);
+	BitWriter writer{out};
+	writer.write(1 << 6, 7);
+	for (size_t c = 0; c < 4; ++c) {
+		writer.write(best.e0.q[c], 7);
+		writer.write(best.e1.q[c], 7);
+	}
+	writer.write(best.e0.p, 1);
+	writer.write(best.e1.p, 1);
+	writer.write(best.indices[0], 3);
+	for (size_t i = 1; i < 16; ++i) {
+		writer.write(best.indices[i], 4);
+	}
+}
+
+/*
+ * DDS
+ */
+constexpr uint32_t dds_magic = 0x20534444;
+constexpr uint32_t dds_header_size = 124;
+constexpr uint32_t dds_pixel_format_size = 32;
+constexpr uint32_t dds_flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000;
+constexpr uint32_t dds_fourcc_flag = 0x4;
+constexpr uint32_t dds_caps_texture = 0x1000;
+constexpr uint32_t dxgi_format_bc7_unorm = 98;
+constexpr uint32_t d3d10_resource_dimension_texture2d = 3;
+
+constexpr uint32_t fourCC(char a, char b, char c, char d) {
+	return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+		   (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+uint32_t readLittleEndian(const uint8_t *in) {
+	return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) |
+		   (static_cast<uint32_t>(in[2]) << 16) |
+		   (static_cast<uint32_t>(in[3]) << 24);
+}
+} // namespace
+
+size_t compressedBlockSize(TextureFormat format) noexcept {
+	switch (format) {
+	case TextureFormat::BC1:
+		return 8;
+	case TextureFormat::BC3:
+	case TextureFormat::BC7:
+		return 16;
+	case TextureFormat::RGBA8:
+		return 0;
+	}
+	return 0;
+}
+
+ErrorOr<CompressedImage> compressImage(const Image &image, TextureFormat format,
+									   CompressionPreset preset,
+									   WorkerPool *pool) noexcept {
+	size_t block_size = compressedBlockSize(format);
+	if (block_size == 0) {
+		return criticalError("Not a block compressed format");
+	}
+	if (image.width == 0 || image.height == 0 || image.channels == 0 ||
+		image.channels > 4 ||
+		image.pixels.size() < image.width * image.height * image.channels) {
+		return criticalError("Invalid image");
+	}
+
+	size_t blocks_x = (image.width + 3) / 4;
+	size_t blocks_y = (image.height + 3) / 4;
+
+	CompressedImage compressed;
+	compressed.width = image.width;
+	compressed.height = image.height;
+	compressed.format = format;
+	try {
+		compressed.blocks.resize(blocks_x * blocks_y * block_size);
+	} catch (const std::bad_alloc &) {
+		return criticalError("Out of memory");
+	}
+
+	auto encodeRows = [&](size_t begin, size_t end) {
+		Block block;
+		for (size_t y = begin; y < end; ++y) {
+			for (size_t x = 0; x < blocks_x; ++x) {
+				fetchBlock(image, x, y, block);
+				uint8_t *out =
+					&compressed.blocks[(y * blocks_x + x) * block_size];
+				switch (format) {
+				case TextureFormat::BC1:
+					encodeBc1(block, preset, out);
+					break;
+				case TextureFormat::BC3:
+					encodeBc3(block, preset, out);
+					break;
+				case TextureFormat::BC7:
+					encodeBc7(block, preset, out);
+					break;
+				case TextureFormat::RGBA8:
+					break;
+				}
+			}
+		}
+	};
+
+	if (pool) {
+		pool->parallelFor(blocks_y, encodeRows);
+	} else {
+		encodeRows(0, blocks_y);
+	}
+
+	return compressed;
+}
+
+Error writeDds(const CompressedImage &image,
+			   const std::filesystem::path &path) noexcept {
+	uint32_t four_cc = 0;
+	switch (image.format) {
+	case TextureFormat::BC1:
+		four_cc = fourCC('D', 'X', 'T', '1');
+		break;
+	case TextureFormat::BC3:
+		four_cc = fourCC('D', 'X', 'T', '5');
+		break;
+	case TextureFormat::BC7:
+		four_cc = fourCC('D', 'X', '1', '0');
+		break;
+	case TextureFormat::RGBA8:
+		return criticalError("Not a block compressed format");
+	}
+
+	std::array<uint8_t, 4 + dds_header_size + 20> header{};
+	writeLittleEndian(&header[0], dds_magic, 4);
+	uint8_t *dds = &header[4];
+	writeLittleEndian(dds + 0, dds_header_size, 4);
+	writeLittleEndian(dds + 4, dds_flags, 4);
+	writeLittleEndian(dds + 8, image.height, 4);
+	writeLittleEndian(dds + 12, image.width, 4);
+	writeLittleEndian(dds + 16, image.blocks.size(), 4);
+	// Pixel format at offset 72
+	writeLittleEndian(dds + 72, dds_pixel_format_size, 4);
+	writeLittleEndian(dds + 76, dds_fourcc_flag, 4);
+	writeLittleEndian(dds + 80, four_cc, 4);
+	writeLittleEndian(dds + 104, dds_caps_texture, 4);
+
+	size_t header_size = 4 + dds_header_size;
+	if (image.format == TextureFormat::BC7) {
+		uint8_t *dx10 = &header[header_size];
+		writeLittleEndian(dx10 + 0, dxgi_format_bc7_unorm, 4);
+		writeLittleEndian(dx10 + 4, d3d10_resource_dimension_texture2d, 4);
+		writeLittleEndian(dx10 + 12, 1, 4);
+		header_size += 20;
+	}
+
+	std::ofstream file{path, std::ios::binary | std::ios::trunc};
+	if (!file) {
+		return criticalError("Couldn't open dds file");
+	}
+	file.write(reinterpret_cast<const char *>(header.data()), header_size);
+	file.write(reinterpret_cast<const char *>(image.blocks.data()),
+			   image.blocks.size());
+	if (!file) {
+		return criticalError("Couldn't write dds file");
+	}
+
+	return noError();
+}
+
+ErrorOr<CompressedImage> readDds(const std::filesystem::path &path) noexcept {
+	std::ifstream file{path, std::ios::binary};
+	if (!file) {
+		return criticalError("Couldn't open dds file");
+	}
+
+	std::array<uint8_t, 4 + dds_header_size> header;
+	if (!file.read(reinterpret_cast<char *>(header.data()), header.size())) {
+		return criticalError("Couldn't read dds header");
+	}
+	const uint8_t *dds = &header[4];
+	if (readLittleEndian(&header[0]) != dds_magic ||
+		readLittleEndian(dds) != dds_header_size) {
+		return criticalError("Not a dds file");
+	}
+
+	CompressedImage image;
+	image.height = readLittleEndian(dds + 8);
+	image.width = readLittleEndian(dds + 12);
+
+	uint32_t four_cc = readLittleEndian(dds + 80);
+	if (four_cc == fourCC('D', 'X', 'T', '1')) {
+		image.format = TextureFormat::BC1;
+	} else if (four_cc == fourCC('D', 'X', 'T', '5')) {
+		image.format = TextureFormat::BC3;
+	} else if (four_cc == fourCC('D', 'X', '1', '0')) {
+		std::array<uint8_t, 20> dx10;
+		if (!file.read(reinterpret_cast<char *>(dx10.data()), dx10.size())) {
+			return criticalError("Couldn't read dds dx10 header");
+		}
+		if (readLittleEndian(dx10.data()) != dxgi_format_bc7_unorm) {
+			return criticalError("Unsupported dxgi format");
+		}
+		image.format = TextureFormat::BC7;
+	} else {
+		return criticalError("Unsupported dds format");
+	}
+
+	size_t size = ((image.width + 3) / 4) * ((image.height + 3) / 4) *
+				  compressedBlockSize(image.format);
+	try {
+		image.blocks.resize(size);
+	} catch (const std::bad_alloc &) {
+		return criticalError("Out of memory");
+	}
+	if (!file.read(reinterpret_cast<char *>(image.blocks.data()), size)) {
+		return criticalError("Couldn't read dds blocks");
+	}
+
+	return image;
+}
+} // namespace gin
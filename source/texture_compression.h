@@ -0,0 +1,43 @@
+#pragma once
+
+#include "./render/render.h"
+#include "./worker_pool.h"
+
+#include <kelgin/error.h>
+
+#include <filesystem>
+
+namespace gin {
+/**
+ * Fast only fits the bounding box of each block. Balanced fits the principal
+ * axis and refines the endpoints once, Quality refines them until the error
+ * stops improving.
+ */
+enum class CompressionPreset : uint8_t { Fast, Balanced, Quality };
+
+/**
+ * Bytes per 4x4 block. Returns 0 for uncompressed formats.
+ */
+size_t compressedBlockSize(TextureFormat format) noexcept;
+
+/**
+ * Encodes the image into BC1, BC3 or BC7 (mode 6) blocks. Images which aren't
+ * a multiple of 4 are padded by repeating the edge pixels.
+ *
+ * This doesn't touch any render state, so it can be used both while loading
+ * and for building asset packs offline.
+ *
+ * @param pool optional worker pool used to encode block rows in parallel
+ */
+ErrorOr<CompressedImage>
+compressImage(const Image &image, TextureFormat format,
+			  CompressionPreset preset = CompressionPreset::Balanced,
+			  WorkerPool *pool = nullptr) noexcept;
+
+/**
+ * Stores compressed images as DDS files. BC7 uses the DX10 header extension.
+ */
+Error writeDds(const CompressedImage &image,
+			   const std::filesystem::path &path) noexcept;
+ErrorOr<CompressedImage> readDds(const std::filesystem::path &path) noexcept;
+} // namespace gin
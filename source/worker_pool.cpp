@@ -0,0 +1,124 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace gin {
+WorkerPool::WorkerPool(size_t thread_count) {
+	if (thread_count == 0) {
+		thread_count =
+			std::max(static_cast<size_t>(std::thread::hardware_concurrency()),
+					 static_cast<size_t>(1));
+	}
+
+	threads.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		threads.emplace_back([this]() { work(); });
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		running = false;
+	}
+	condition.notify_all();
+
+	for (auto &iter : threads) {
+		if (iter.joinable()) {
+			iter.join();
+		}
+	}
+}
+
+void WorkerPool::work() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock{mutex};
+			condition.wait(lock, [this]() { return !running || !tasks.empty(); });
+
+			if (tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> &&task) {
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+namespace {
+struct ParallelForState {
+	std::atomic<size_t> next_chunk{0};
+	size_t chunk_count;
+	size_t chunk_size;
+	size_t count;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	size_t done_chunks = 0;
+
+	/// Returns false once all chunks are taken
+	bool runChunk(const std::function<void(size_t, size_t)> &func) {
+		size_t chunk = next_chunk.fetch_add(1);
+		if (chunk >= chunk_count) {
+			return false;
+		}
+
+		size_t begin = chunk * chunk_size;
+		func(begin, std::min(begin + chunk_size, count));
+
+		std::lock_guard<std::mutex> lock{mutex};
+		++done_chunks;
+		if (done_chunks == chunk_count) {
+			condition.notify_all();
+		}
+		return true;
+	}
+};
+} // namespace
+
+void WorkerPool::parallelFor(
+	size_t count, const std::function<void(size_t begin, size_t end)> &func) {
+	if (count == 0) {
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>();
+	state->chunk_count = std::min(count, threads.size() * 4);
+	state->chunk_size = (count + state->chunk_count - 1) / state->chunk_count;
+	state->chunk_count = (count + state->chunk_size - 1) / state->chunk_size;
+	state->count = count;
+
+	size_t helpers = std::min(threads.size(), state->chunk_count - 1);
+	for (size_t i = 0; i < helpers; ++i) {
+		// func outlives the helpers, since we only return after every chunk
+		// has been run. Late helpers only see an exhausted chunk counter.
+		submit([state, &func]() {
+			while (state->runChunk(func)) {
+			}
+		});
+	}
+
+	while (state->runChunk(func)) {
+	}
+
+	std::unique_lock<std::mutex> lock{state->mutex};
+	state->condition.wait(
+		lock, [&state]() { return state->done_chunks == state->chunk_count; });
+}
+
+size_t WorkerPool::threadCount() const { return threads.size(); }
+} // namespace gin
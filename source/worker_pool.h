@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gin {
+/**
+ * Fixed size pool of threads working on a shared FIFO queue.
+ * Tasks are executed in submission order, but may finish out of order.
+ */
+class WorkerPool {
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::function<void()>> tasks;
+	std::vector<std::thread> threads;
+	bool running = true;
+
+	void work();
+
+public:
+	/**
+	 * @param thread_count amount of worker threads. 0 picks the amount of
+	 * hardware threads
+	 */
+	WorkerPool(size_t thread_count = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	void submit(std::function<void()> &&task);
+
+	/**
+	 * Calls func for consecutive ranges covering [0, count) and blocks until
+	 * all of them are done. The calling thread works on the ranges as well,
+	 * so it is safe to call this from within a task.
+	 */
+	void parallelFor(size_t count,
+					 const std::function<void(size_t begin, size_t end)> &func);
+
+	size_t threadCount() const;
+};
+} // namespace gin